@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "converter.h"
+
+/**
+ * The digit loop string_to_bcd used before, with the digit read fixed.
+ */
+static void legacy_string_to_bcd(const char _str[], uint8_t _bcd[], const size_t _size)
+{
+    size_t len = strlen(_str);
+    bool is_even = !(len % 2);
+
+    memset(_bcd, 0, _size);
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        int value = _str[i] - '0';
+
+        _bcd[(2 * _size - len + i) / 2] |= value << (4 * ((is_even ? i + 1 : i) % 2));
+    }
+}
+
+/**
+ * Unpack through sprintf, what callers did without an inverse.
+ */
+static void legacy_bcd_to_string(const uint8_t _bcd[], const size_t _size, char _str[])
+{
+    for (size_t i = 0; i < _size; i++)
+    {
+        sprintf(_str + 2 * i, "%X%X", _bcd[i] >> 4, _bcd[i] & 0x0F);
+    }
+}
+
+static void run(const char *_name, const size_t _digits, const size_t _count, const std::function<void()> &_f)
+{
+    size_t rounds = 0;
+    auto begin = std::chrono::steady_clock::now();
+    double seconds = 0.0;
+
+    do
+    {
+        _f();
+        rounds++;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    } while (0.3 > seconds);
+
+    double ids = (double)rounds * _count;
+
+    printf("  %-22s %8.2f ns/id %8.1f Mdigits/s\n", _name, seconds * 1e9 / ids, ids * _digits / seconds / 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = 1 < argc ? strtoul(argv[1], nullptr, 0) : 100000;
+
+    // terminal numbers (12 digits in 6 bytes) and a long 40 digit field
+    for (size_t digits : {12, 40})
+    {
+        size_t size = digits / 2;
+        std::vector<char> column(count * digits);
+        std::vector<char> strs(count * (digits + 1));
+        std::vector<uint8_t> bcd(count * size);
+        std::vector<char> out(count * (2 * size + 1));
+
+        for (size_t i = 0; i < count; i++)
+        {
+            for (size_t j = 0; j < digits; j++)
+            {
+                column[i * digits + j] = strs[i * (digits + 1) + j] = (char)('0' + rand() % 10);
+            }
+        }
+
+        printf("%zu digits, %zu ids\n pack\n", digits, count);
+
+        run("legacy digit loop", digits, count, [&]()
+        {
+            for (size_t i = 0; i < count; i++) legacy_string_to_bcd(&strs[i * (digits + 1)], &bcd[i * size], size);
+        });
+        run("string_to_bcd", digits, count, [&]()
+        {
+            for (size_t i = 0; i < count; i++) string_to_bcd(&strs[i * (digits + 1)], &bcd[i * size], size);
+        });
+        run("string_to_bcd_var", digits, count, [&]()
+        {
+            for (size_t i = 0; i < count; i++) string_to_bcd_var(&strs[i * (digits + 1)], &bcd[i * size], size);
+        });
+        run("string_to_bcd_batch", digits, count, [&]()
+        {
+            string_to_bcd_batch(column.data(), digits, count, bcd.data(), size);
+        });
+
+        printf(" unpack\n");
+
+        run("legacy sprintf", digits, count, [&]()
+        {
+            for (size_t i = 0; i < count; i++) legacy_bcd_to_string(&bcd[i * size], size, &out[i * (2 * size + 1)]);
+        });
+        run("bcd_to_string", digits, count, [&]()
+        {
+            for (size_t i = 0; i < count; i++) bcd_to_string(&bcd[i * size], size, &out[i * (2 * size + 1)]);
+        });
+        run("bcd_to_string_var", digits, count, [&]()
+        {
+            for (size_t i = 0; i < count; i++) bcd_to_string_var(&bcd[i * size], size, &out[i * (2 * size + 1)]);
+        });
+        run("bcd_to_string_batch", digits, count, [&]()
+        {
+            bcd_to_string_batch(bcd.data(), size, count, out.data());
+        });
+    }
+
+    return 0;
+}
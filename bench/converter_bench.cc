@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iconv.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "converter.h"
+
+typedef int (*Convert)(char*, size_t, char*, size_t);
+
+/**
+ * The conversion before the descriptor cache, an iconv_open per call.
+ */
+static int legacy_convert(const char *_from, const char *_to, char *_in, size_t _inlen, char *_out, size_t _outlen)
+{
+    iconv_t cd = iconv_open(_to, _from);
+
+    if ((iconv_t)-1 == cd)
+    {
+        return -1;
+    }
+
+    memset(_out, 0, _outlen);
+    size_t ret = iconv(cd, &_in, &_inlen, &_out, &_outlen);
+    iconv_close(cd);
+
+    return (size_t)-1 == ret ? -1 : 0;
+}
+
+static int legacy_utf8_to_gbk(char *_in, size_t _inlen, char *_out, size_t _outlen)
+{
+    return legacy_convert("utf-8", "gbk", _in, _inlen, _out, _outlen);
+}
+
+static int legacy_gbk_to_utf8(char *_in, size_t _inlen, char *_out, size_t _outlen)
+{
+    return legacy_convert("gbk", "utf-8", _in, _inlen, _out, _outlen);
+}
+
+static void run(const char *_name, Convert _convert, std::vector<std::string> &_inputs, const size_t _iterations)
+{
+    char out[256];
+    size_t bytes = 0;
+    size_t failed = 0;
+    auto begin = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < _iterations; i++)
+    {
+        std::string &in = _inputs[i % _inputs.size()];
+
+        if (0 != _convert(&in[0], in.size(), out, sizeof(out)))
+        {
+            failed++;
+        }
+
+        bytes += in.size();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    printf("  %-14s %8.1f ns/op %8.1f MB/s%s\n", _name, seconds * 1e9 / _iterations, bytes / seconds / 1e6,
+        0 == failed ? "" : " (failed)");
+}
+
+static void bench(const char *_title, std::vector<std::string> _utf8, const size_t _iterations)
+{
+    std::vector<std::string> gbk;
+
+    for (auto &s : _utf8)
+    {
+        char out[256];
+
+        utf8_to_gbk(&s[0], s.size(), out, sizeof(out));
+        gbk.push_back(std::string(out, strlen(out)));
+    }
+
+    printf("%s\n utf8_to_gbk\n", _title);
+    run("legacy iconv", legacy_utf8_to_gbk, _utf8, _iterations / 10);
+    run("cached iconv", utf8_to_gbk_iconv, _utf8, _iterations);
+    run("table", utf8_to_gbk, _utf8, _iterations);
+
+    printf(" gbk_to_utf8\n");
+    run("legacy iconv", legacy_gbk_to_utf8, gbk, _iterations / 10);
+    run("cached iconv", gbk_to_utf8_iconv, gbk, _iterations);
+    run("table", gbk_to_utf8, gbk, _iterations);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t iterations = 1 < argc ? strtoul(argv[1], nullptr, 0) : 1000000;
+
+    // vehicle ids and user data as they are reported
+    bench("ascii vehicle id", {"LSVAU2180N2183294", "VEH-000123", "B12345X"}, iterations);
+    bench("plate vehicle id", {"粤B12345", "京A88888", "沪C0G2T1"}, iterations);
+    bench("user data", {"前方路口左转，限速40km/h，注意行人", "route 12: 人民路 -> 中山路 (3.2 km)"}, iterations);
+
+    return 0;
+}
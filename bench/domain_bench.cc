@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "packer.h"
+#include "domain.h"
+#include "state_builder.h"
+
+using namespace protocol;
+
+static volatile uint64_t s_sink;
+
+static void run(const char *_name, const size_t _count, const std::function<uint64_t()> &_f)
+{
+    size_t rounds = 0;
+    auto begin = std::chrono::steady_clock::now();
+    double seconds = 0.0;
+
+    do
+    {
+        s_sink = _f();
+        rounds++;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    } while (0.3 > seconds);
+
+    printf("  %-30s %8.2f ns/state\n", _name, seconds * 1e9 / ((double)rounds * _count));
+}
+
+/**
+ * Fleet view over the hot fields: moving vehicles, mean speed, harshest
+ * braking and the bounding box of positions.
+ */
+template<typename T, typename F>
+static uint64_t scan(const std::vector<T> &_fleet, F _fields)
+{
+    uint64_t moving = 0, speed = 0, brake = 0, lon_min = ~0U, lon_max = 0;
+
+    for (auto &s : _fleet)
+    {
+        uint16_t velocity, acc_lon;
+        uint32_t longitude;
+        uint8_t mode;
+
+        _fields(s, velocity, acc_lon, longitude, mode);
+        moving += 0 != velocity && DRIVE_MODE_AUTO == mode;
+        speed += velocity;
+        brake = acc_lon > brake ? acc_lon : brake;
+        lon_min = longitude < lon_min ? longitude : lon_min;
+        lon_max = longitude > lon_max ? longitude : lon_max;
+    }
+
+    return moving + speed / _fleet.size() + brake + lon_max - lon_min;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = 1 < argc ? strtoul(argv[1], nullptr, 0) : 10000;
+    std::vector<std::shared_ptr<MessageBuffer>> frames;
+    std::vector<Veh2CloudState> packed;
+    std::vector<VehicleState> aligned(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        char id[16];
+
+        snprintf(id, sizeof(id), "Q%07u", (unsigned)(i % 10000000));
+        packed.emplace_back(0x01, 1600000000000ULL + i, 0xFC, id, std::vector<uint8_t>{1}, 1600000000000ULL + i,
+            rand() % 3000, Position(1160000000 + rand() % 10000000, 390000000 + rand() % 10000000, 700), rand() % 3600000,
+            4, 200000, rand() % 3000, rand() % 600, 400, 300, 200, 500, 3000, 50000, BREAK_FLAG_UP, 500, 20000, 1000,
+            1 + rand() % 4, Position2D(1214000000, 313000000), std::vector<Position2D>(4, Position2D(1213000000, 312000000)));
+        frames.push_back(Packer::pack(packed.back()));
+        DomainCodec::decode(frames.back()->data, frames.back()->size, aligned[i]);
+    }
+
+    printf("%zu vehicles, Veh2CloudState %zu bytes packed, VehicleState %zu bytes aligned\n",
+        count, sizeof(Veh2CloudState), sizeof(VehicleState));
+
+    printf(" scan\n");
+
+    run("Veh2CloudState", count, [&]()
+    {
+        return scan(packed, [](const Veh2CloudState &_s, uint16_t &_v, uint16_t &_a, uint32_t &_lon, uint8_t &_m)
+        {
+            _v = _s.velocity_;
+            _a = _s.acc_lon_;
+            _lon = _s.position_.longitude;
+            _m = _s.drive_mode_;
+        });
+    });
+    run("VehicleState", count, [&]()
+    {
+        return scan(aligned, [](const VehicleState &_s, uint16_t &_v, uint16_t &_a, uint32_t &_lon, uint8_t &_m)
+        {
+            _v = _s.velocity;
+            _a = _s.acc_lon;
+            _lon = _s.position.longitude;
+            _m = _s.drive_mode;
+        });
+    });
+
+    printf(" update, dead reckoning a 100 ms tick\n");
+
+    run("Veh2CloudState", count, [&]()
+    {
+        for (auto &s : packed)
+        {
+            s.timestamp_ += 100;
+            s.gnss_timestamp_ += 100;
+            s.position_.longitude += s.velocity_ / 10;
+            s.position_.latitude += s.acc_lat_ / 10;
+            s.heading_ = (s.heading_ + s.yaw_rate_) % 3600000;
+            s.velocity_ += (uint16_t)(s.acc_lon_ / 10);
+        }
+
+        return packed[0].velocity_;
+    });
+    run("VehicleState", count, [&]()
+    {
+        for (auto &s : aligned)
+        {
+            s.timestamp += 100;
+            s.gnss_timestamp += 100;
+            s.position.longitude += s.velocity / 10;
+            s.position.latitude += s.acc_lat / 10;
+            s.heading = (s.heading + s.yaw_rate) % 3600000;
+            s.velocity += (uint16_t)(s.acc_lon / 10);
+        }
+
+        return aligned[0].velocity;
+    });
+
+    printf(" decode\n");
+
+    run("Veh2CloudState::decode", count, [&]()
+    {
+        for (size_t i = 0; i < count; i++) packed[i].decode(frames[i]->data, frames[i]->size);
+        return packed[count - 1].velocity_;
+    });
+    run("DomainCodec::decode", count, [&]()
+    {
+        for (size_t i = 0; i < count; i++) DomainCodec::decode(frames[i]->data, frames[i]->size, aligned[i]);
+        return aligned[count - 1].velocity;
+    });
+
+    std::vector<data::Veh2CloudState> generated(count);
+
+    run("data::Veh2CloudState::decode", count, [&]()
+    {
+        for (size_t i = 0; i < count; i++) generated[i].decode(frames[i]->data, frames[i]->size);
+        return generated[count - 1].velocity;
+    });
+
+    printf(" encode\n");
+
+    std::vector<uint8_t> buf(StateBuilder::MAX_SIZE);
+
+    run("Veh2CloudState::to_bytes", count, [&]()
+    {
+        size_t size = 0;
+        for (size_t i = 0; i < count; i++) size += packed[i].to_bytes(buf.data(), buf.size());
+        return size;
+    });
+    run("DomainCodec::encode", count, [&]()
+    {
+        size_t size = 0;
+        for (size_t i = 0; i < count; i++) size += DomainCodec::encode(aligned[i], buf.data(), buf.size());
+        return size;
+    });
+    run("data::Veh2CloudState::encode", count, [&]()
+    {
+        size_t size = 0;
+        for (size_t i = 0; i < count; i++) size += generated[i].encode(buf.data(), buf.size());
+        return size;
+    });
+
+    return 0;
+}
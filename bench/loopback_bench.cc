@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cloud_stub.h"
+#include "controller.h"
+#include "histogram.h"
+#include "util.h"
+
+#define MESSAGE_ID_POS  (FRAME_VEHICLE_ID_POS + 8)
+#define ENQUEUE_SLOTS   (1 << 20)
+
+static void usage(const char *_name)
+{
+    printf("Usage: %s [options]\n"
+        "  -a <addr>     server address, default 127.0.0.1\n"
+        "  -u <port>     upstream port, default 50111\n"
+        "  -d <port>     downstream port, default 50112\n"
+        "  -x            use a stand-in already running at the address instead of forking one\n"
+        "  -r <rates>    comma separated states/s, 0 as fast as the link drains, default 1000,5000,20000,50000,0\n"
+        "  -t <seconds>  duration of each rate, default 2\n"
+        "  -p <count>    pass_pos entries per state, default 0\n"
+        "  -w <frames>   frames in flight at rate 0, default 1024\n"
+        "  -j            JSON output\n", _name);
+}
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double cpu_seconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/**
+ * Times states from Controller::send to the socket write and requests to
+ * their responses, through the controller's tracer.
+ */
+class Probe : public Tracer::Sink
+{
+public:
+    void on_frame(const uint32_t _direction, const void *_buf, const size_t _size) override
+    {
+        const uint8_t *frame = (const uint8_t*)_buf;
+        uint8_t data_type = frame[FRAME_DATA_TYPE_POS];
+        uint64_t now = now_ns();
+
+        if (TRACE_UP_TX == _direction && VEH2CLOUD_STATE == data_type)
+        {
+            uint64_t seq = 0;
+
+            // message_id_ goes out byte reversed, the sequence big endian
+            memcpy(&seq, frame + MESSAGE_ID_POS, sizeof(seq));
+            seq = __builtin_bswap64(seq);
+
+            enqueue_to_wire.record(now - enqueued[seq % ENQUEUE_SLOTS]);
+            wire.fetch_add(1, std::memory_order_release);
+            last_wire = now;
+        }
+        else if (TRACE_UP_RX == _direction && CLOUD2VEH_INH_RES == data_type)
+        {
+            inh_rtt.record(now - pop(inh));
+        }
+        else if (TRACE_DOWN_RX == _direction && HEARTBEAT_RES == data_type)
+        {
+            heartbeat_rtt.record(now - pop(heartbeat));
+        }
+    }
+
+    void push(std::deque<uint64_t> &_fifo, const uint64_t _time)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        _fifo.push_back(_time);
+    }
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        enqueue_to_wire.reset();
+        inh_rtt.reset();
+        heartbeat_rtt.reset();
+    }
+
+    std::vector<uint64_t> enqueued = std::vector<uint64_t>(ENQUEUE_SLOTS);
+    std::atomic<uint64_t> wire{0};
+    std::atomic<uint64_t> last_wire{0};
+    Histogram enqueue_to_wire;
+    Histogram inh_rtt;
+    Histogram heartbeat_rtt;
+    std::deque<uint64_t> inh;
+    std::deque<uint64_t> heartbeat;
+
+private:
+    uint64_t pop(std::deque<uint64_t> &_fifo)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // responses come back in request order on one connection
+        if (_fifo.empty())
+        {
+            return now_ns();
+        }
+
+        uint64_t t = _fifo.front();
+        _fifo.pop_front();
+
+        return t;
+    }
+
+    std::mutex mutex_;
+};
+
+class ConnectCallback : public Controller::Callback
+{
+public:
+    void on_up_connect_state(const socketlib::ConnectState _state) override
+    {
+        up = socketlib::ConnectState::CONNECTED == _state;
+    }
+
+    void on_down_connect_state(const socketlib::ConnectState _state) override
+    {
+        down = socketlib::ConnectState::CONNECTED == _state;
+    }
+
+    std::atomic<bool> up{false};
+    std::atomic<bool> down{false};
+};
+
+struct Step
+{
+    uint64_t rate;
+    uint64_t sent;
+    uint64_t wire;
+    double   seconds;
+    double   cpu;
+    Histogram enqueue_to_wire;
+    Histogram inh_rtt;
+    Histogram heartbeat_rtt;
+};
+
+/**
+ * The stand-in in a child process, its CPU stays out of the measurement.
+ */
+static pid_t fork_stub(const char _addr[], const uint32_t _up_port, const uint32_t _down_port)
+{
+    int fds[2];
+
+    if (0 != pipe(fds))
+    {
+        return -1;
+    }
+
+    pid_t pid = fork();
+
+    if (0 == pid)
+    {
+        close(fds[0]);
+
+        CloudStub stub;
+        char ready = 0 == stub.start(_addr, _up_port, _down_port) ? 1 : 0;
+
+        if (1 != write(fds[1], &ready, 1) || 0 == ready)
+        {
+            _exit(1);
+        }
+
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGTERM);
+        sigprocmask(SIG_BLOCK, &set, nullptr);
+
+        int sig = 0;
+        sigwait(&set, &sig);
+        stub.stop();
+        _exit(0);
+    }
+
+    close(fds[1]);
+
+    char ready = 0;
+
+    if (0 > pid || 1 != read(fds[0], &ready, 1) || 0 == ready)
+    {
+        close(fds[0]);
+        return -1;
+    }
+
+    close(fds[0]);
+
+    return pid;
+}
+
+static Veh2CloudState make_state(const uint64_t _seq, const std::vector<Position2D> &_pass_pos)
+{
+    std::vector<uint8_t> message_id(8);
+
+    for (size_t i = 0; i < 8; i++)
+    {
+        message_id[i] = (uint8_t)(_seq >> (8 * i));
+    }
+
+    return Veh2CloudState(
+        0x01, get_utc_timestamp_ms(), 0xFC, "Q1001", message_id, get_utc_timestamp_ms(),
+        4000, Position(1213000000, 312000000, 700), 100000, 31, 200000, 4100, 500, 400, 300, 200, 500, 3000, 50000,
+        1, 500, 20000, 1000, 1, Position2D(1214000000, 313000000), _pass_pos);
+}
+
+static void run_step(Controller &_controller, Probe &_probe, const uint64_t _rate, const double _duration,
+    const std::vector<Position2D> &_pass_pos, const uint64_t _window, uint64_t &_seq, Step &_step)
+{
+    const uint64_t request_interval = 10000000;
+    uint64_t sent = 0;
+    uint64_t wire_base = _probe.wire.load();
+    uint64_t next_request = 0;
+
+    _probe.reset();
+
+    double cpu = cpu_seconds();
+    uint64_t begin = now_ns();
+    uint64_t end = begin + (uint64_t)(_duration * 1e9);
+    uint64_t now = begin;
+
+    while (now < end)
+    {
+        // an INH and a HEARTBEAT every 10 ms for the request latencies
+        if (now >= next_request)
+        {
+            _probe.push(_probe.inh, now_ns());
+            _controller.send(Veh2CloudInh(
+                0x01, get_utc_timestamp_ms(), 0xFC, "Q1001", "sw_v1.0", "hw_v1.0", "ad_v1.0",
+                COMM_TYPE_4G, 15, TIME_SYNC_GNSS, GNSS_TYPE_GCJ02, ""));
+            _probe.push(_probe.heartbeat, now_ns());
+            _controller.send(MessageHeader(0, HEARTBEAT, 0x01, get_utc_timestamp_ms(), 0xFC));
+            next_request = now + request_interval;
+        }
+
+        uint64_t due = 0 == _rate ? _probe.wire.load() - wire_base + _window : (now - begin) * _rate / 1000000000 + 1;
+
+        if (sent >= due)
+        {
+            if (0 != _rate)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        for (; sent < due; sent++, _seq++)
+        {
+            Veh2CloudState msg = make_state(_seq, _pass_pos);
+
+            _probe.enqueued[_seq % ENQUEUE_SLOTS] = now_ns();
+            _controller.send(msg);
+        }
+
+        now = now_ns();
+    }
+
+    // drain, at most 5 s
+    uint64_t deadline = now_ns() + 5000000000ULL;
+
+    while (_probe.wire.load() - wire_base < sent && now_ns() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    uint64_t last = std::max(_probe.last_wire.load(), end);
+
+    _step.rate = _rate;
+    _step.sent = sent;
+    _step.wire = _probe.wire.load() - wire_base;
+    _step.seconds = (last - begin) / 1e9;
+    _step.cpu = cpu_seconds() - cpu;
+    _step.enqueue_to_wire = _probe.enqueue_to_wire;
+    _step.inh_rtt = _probe.inh_rtt;
+    _step.heartbeat_rtt = _probe.heartbeat_rtt;
+}
+
+static void print_text(FILE *_fp, const std::vector<Step> &_steps)
+{
+    fprintf(_fp, "%8s %10s %10s %8s | %28s | %28s | %28s\n", "rate", "frames/s", "cpu us/fr", "lost",
+        "enqueue->wire us p50/99/999", "inh->res us p50/99/999", "heartbeat us p50/99/999");
+
+    for (auto &s : _steps)
+    {
+        fprintf(_fp, "%8s %10.0f %10.2f %8" PRIu64 " | %8.1f %8.1f %10.1f | %8.1f %8.1f %10.1f | %8.1f %8.1f %10.1f\n",
+            0 == s.rate ? "max" : std::to_string(s.rate).c_str(), s.wire / s.seconds, s.cpu * 1e6 / std::max<uint64_t>(1, s.wire),
+            s.sent - s.wire,
+            s.enqueue_to_wire.percentile(50) / 1e3, s.enqueue_to_wire.percentile(99) / 1e3, s.enqueue_to_wire.percentile(99.9) / 1e3,
+            s.inh_rtt.percentile(50) / 1e3, s.inh_rtt.percentile(99) / 1e3, s.inh_rtt.percentile(99.9) / 1e3,
+            s.heartbeat_rtt.percentile(50) / 1e3, s.heartbeat_rtt.percentile(99) / 1e3, s.heartbeat_rtt.percentile(99.9) / 1e3);
+    }
+}
+
+static void print_histogram(FILE *_fp, const char *_name, const Histogram &_h, const bool _last)
+{
+    fprintf(_fp, "\"%s\":{\"count\":%" PRIu64 ",\"p50_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64 ",\"p999_ns\":%" PRIu64
+        ",\"max_ns\":%" PRIu64 "}%s", _name, _h.count(), _h.percentile(50), _h.percentile(99), _h.percentile(99.9),
+        _h.max(), _last ? "" : ",");
+}
+
+static void print_json(FILE *_fp, const std::vector<Step> &_steps)
+{
+    fprintf(_fp, "[\n");
+
+    for (size_t i = 0; i < _steps.size(); i++)
+    {
+        const Step &s = _steps[i];
+
+        fprintf(_fp, "  {\"rate\":%" PRIu64 ",\"sent\":%" PRIu64 ",\"wire\":%" PRIu64 ",\"seconds\":%.3f,"
+            "\"frames_per_sec\":%.0f,\"cpu_us_per_frame\":%.3f,", s.rate, s.sent, s.wire, s.seconds,
+            s.wire / s.seconds, s.cpu * 1e6 / std::max<uint64_t>(1, s.wire));
+        print_histogram(_fp, "enqueue_to_wire", s.enqueue_to_wire, false);
+        print_histogram(_fp, "inh_to_res", s.inh_rtt, false);
+        print_histogram(_fp, "heartbeat_to_res", s.heartbeat_rtt, true);
+        fprintf(_fp, "}%s\n", i + 1 < _steps.size() ? "," : "");
+    }
+
+    fprintf(_fp, "]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *addr = "127.0.0.1";
+    uint32_t up_port = 50111;
+    uint32_t down_port = 50112;
+    bool external = false;
+    std::string rates = "1000,5000,20000,50000,0";
+    double duration = 2.0;
+    size_t pass_pos_num = 0;
+    uint64_t window = 1024;
+    bool json = false;
+    int opt = 0;
+
+    while (-1 != (opt = getopt(argc, argv, "a:u:d:xr:t:p:w:jh")))
+    {
+        switch (opt)
+        {
+        case 'a': addr = optarg; break;
+        case 'u': up_port = atoi(optarg); break;
+        case 'd': down_port = atoi(optarg); break;
+        case 'x': external = true; break;
+        case 'r': rates = optarg; break;
+        case 't': duration = atof(optarg); break;
+        case 'p': pass_pos_num = std::min(255, atoi(optarg)); break;
+        case 'w': window = std::max(1, atoi(optarg)); break;
+        case 'j': json = true; break;
+        default:
+            usage(argv[0]);
+            return 'h' == opt ? 0 : 1;
+        }
+    }
+
+    // fork before any thread exists
+    pid_t stub = external ? 0 : fork_stub(addr, up_port, down_port);
+
+    if (0 > stub)
+    {
+        fprintf(stderr, "stand-in failed to listen on %s %u/%u\n", addr, up_port, down_port);
+        return 1;
+    }
+
+    std::vector<Position2D> pass_pos;
+
+    for (size_t i = 0; i < pass_pos_num; i++)
+    {
+        pass_pos.push_back(Position2D(1213000000 + i * 100, 312000000 + i * 50));
+    }
+
+    Controller controller;
+    ConnectCallback callback;
+    Probe probe;
+
+    controller.set_callback(&callback);
+    controller.tracer().set_sink(&probe);
+    controller.tracer().set_sample(1);
+    controller.tracer().set_all_types(true);
+    controller.tracer().enable(TRACE_UP_TX | TRACE_UP_RX | TRACE_DOWN_RX);
+    controller.start(addr, up_port, addr, down_port);
+
+    for (int i = 0; i < 2000 && !(callback.up && callback.down); i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    int ret = 0;
+
+    if (!(callback.up && callback.down))
+    {
+        fprintf(stderr, "no connection to %s %u/%u\n", addr, up_port, down_port);
+        ret = 1;
+    }
+    else
+    {
+        std::vector<Step> steps;
+        uint64_t seq = 0;
+        size_t pos = 0;
+
+        while (pos < rates.size())
+        {
+            size_t comma = rates.find(',', pos);
+            std::string rate = rates.substr(pos, std::string::npos == comma ? std::string::npos : comma - pos);
+
+            steps.push_back(Step());
+            run_step(controller, probe, strtoull(rate.c_str(), nullptr, 0), duration, pass_pos, window, seq, steps.back());
+
+            if (!json)
+            {
+                fprintf(stderr, ".");
+            }
+
+            pos = std::string::npos == comma ? rates.size() : comma + 1;
+        }
+
+        if (!json)
+        {
+            fprintf(stderr, "\n");
+        }
+
+        json ? print_json(stdout, steps) : print_text(stdout, steps);
+    }
+
+    controller.stop();
+    controller.tracer().disable(TRACE_ALL);
+    controller.tracer().set_sink(nullptr);
+
+    if (0 < stub)
+    {
+        kill(stub, SIGTERM);
+        waitpid(stub, nullptr, 0);
+    }
+
+    return ret;
+}
@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "packer.h"
+#include "state_builder.h"
+#include "util.h"
+
+using namespace protocol;
+
+static std::atomic<uint64_t> s_allocs{0};
+
+// counting replacements of the global allocator, every new and new[] has its
+// delete, plain and sized. The deletes stay out of line: inlined, gcc would
+// see free() on the result of operator new at the call site.
+void* operator new(size_t _size)
+{
+    s_allocs.fetch_add(1, std::memory_order_relaxed);
+
+    void *p = malloc(0 == _size ? 1 : _size);
+
+    if (nullptr == p)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void* operator new[](size_t _size)
+{
+    return operator new(_size);
+}
+
+__attribute__((noinline)) void operator delete(void *_p) noexcept
+{
+    free(_p);
+}
+
+__attribute__((noinline)) void operator delete[](void *_p) noexcept
+{
+    free(_p);
+}
+
+__attribute__((noinline)) void operator delete(void *_p, size_t) noexcept
+{
+    free(_p);
+}
+
+__attribute__((noinline)) void operator delete[](void *_p, size_t) noexcept
+{
+    free(_p);
+}
+
+static void usage(const char *_name)
+{
+    printf("Usage: %s [options]\n"
+        "  -j            JSON output\n"
+        "  -t <seconds>  minimum time per case, default 0.2\n"
+        "  -f <filter>   only cases whose name contains filter\n", _name);
+}
+
+/**
+ * Discards everything, operator<< is measured without the terminal.
+ */
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int _c) override { return _c; }
+
+    std::streamsize xsputn(const char *, std::streamsize _n) override { return _n; }
+};
+
+/**
+ * Decodes and drops, Packer::unpack without handler work.
+ */
+class NullHandler : public Packer::Handler
+{
+public:
+    void on_unpack(const MessageHeader &_msg) override { count_++; }
+
+    void on_unpack(const Veh2CloudInh &_msg) override { count_++; }
+
+    void on_unpack(const Cloud2VehInhRes &_msg) override { count_++; }
+
+    void on_unpack(const Veh2CloudState &_msg) override { count_++; }
+
+    uint64_t count_ = 0;
+};
+
+struct Result
+{
+    std::string name;
+    uint64_t    iterations;
+    size_t      bytes;
+    double      ns_per_op;
+    double      bytes_per_sec;
+    double      allocs_per_op;
+};
+
+static double s_min_time = 0.2;
+static const char *s_filter = nullptr;
+static std::vector<Result> s_results;
+
+static volatile size_t s_sink;
+
+/**
+ * Runs _op in doubling batches until the minimum time is reached.
+ */
+static void run(const std::string &_name, const size_t _bytes, const std::function<size_t()> &_op)
+{
+    if (nullptr != s_filter && std::string::npos == _name.find(s_filter))
+    {
+        return;
+    }
+
+    // warm up
+    for (int i = 0; i < 100; i++)
+    {
+        s_sink = _op();
+    }
+
+    uint64_t iterations = 0;
+    uint64_t batch = 64;
+    uint64_t allocs = s_allocs.load(std::memory_order_relaxed);
+    double seconds = 0.0;
+    auto begin = std::chrono::steady_clock::now();
+
+    while (seconds < s_min_time)
+    {
+        for (uint64_t i = 0; i < batch; i++)
+        {
+            s_sink = _op();
+        }
+
+        iterations += batch;
+        batch *= 2;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    Result r;
+    r.name = _name;
+    r.iterations = iterations;
+    r.bytes = _bytes;
+    r.ns_per_op = seconds * 1e9 / iterations;
+    r.bytes_per_sec = _bytes * iterations / seconds;
+    r.allocs_per_op = (double)(s_allocs.load(std::memory_order_relaxed) - allocs) / iterations;
+    s_results.push_back(r);
+}
+
+template<typename T>
+static void bench(const std::string &_name, const T &_msg)
+{
+    static std::ostream null(new NullBuffer());
+    std::vector<uint8_t> frame(_msg.get_header_length() + _msg.get_data_length());
+    std::vector<uint8_t> buf(frame.size());
+    NullHandler handler;
+    Packer::Pools pools;
+
+    _msg.to_bytes(frame.data(), frame.size());
+
+    run(_name + "/pack", frame.size(), [&]() { return (size_t)Packer::pack(_msg)->size; });
+    run(_name + "/to_bytes", frame.size(), [&]() { return _msg.to_bytes(buf.data(), buf.size()); });
+    run(_name + "/parse", frame.size(), [&]() { return (size_t)T(frame.data(), frame.size()).data_len_; });
+    run(_name + "/unpack", frame.size(), [&]()
+    {
+        Packer::unpack(frame.data(), frame.size(), handler);
+        return (size_t)handler.count_;
+    });
+    run(_name + "/unpack_pooled", frame.size(), [&]()
+    {
+        Packer::unpack(frame.data(), frame.size(), handler, pools);
+        return (size_t)handler.count_;
+    });
+    run(_name + "/ostream", frame.size(), [&]()
+    {
+        null << _msg;
+        return (size_t)0;
+    });
+}
+
+static Veh2CloudState make_state(const size_t _pass_pos)
+{
+    std::vector<Position2D> pass_pos;
+
+    for (size_t i = 0; i < _pass_pos; i++)
+    {
+        pass_pos.push_back(Position2D(1213000000 + i * 100, 312000000 + i * 50));
+    }
+
+    return Veh2CloudState(
+        0x01, get_utc_timestamp_ms(), 0xFC, "Q1001", std::vector<uint8_t>{1, 2, 3, 4, 5, 6, 7, 8}, get_utc_timestamp_ms(),
+        4000, Position(1213000000, 312000000, 700), 100000, 31, 200000, 4100, 500, 400, 300, 200, 500, 3000, 50000,
+        1, 500, 20000, 1000, 1, Position2D(1214000000, 313000000), pass_pos);
+}
+
+/**
+ * A new state per tick: the constructor and pack against updating the
+ * changed fields of a StateBuilder and handing off its frame.
+ */
+static void bench_builder(const size_t _pass_pos)
+{
+    Veh2CloudState msg = make_state(_pass_pos);
+    StateBuilder builder(msg);
+    std::string name = "StateBuilder/" + std::to_string(_pass_pos);
+    uint32_t i = 0;
+
+    run(name + "/construct+pack", builder.size(), [&]()
+    {
+        i++;
+
+        return (size_t)Packer::pack(Veh2CloudState(
+            0x01, 1600000000000ULL + i, 0xFC, "Q1001", std::vector<uint8_t>{1, 2, 3, 4, 5, 6, 7, 8}, 1600000000000ULL + i,
+            4000, Position(1213000000 + i, 312000000, 700), 100000, 31, 200000, 4100 + (i & 7), 500, 400, 300, 200, 500,
+            3000, 50000, 1, 500, 20000, 1000, 1, Position2D(1214000000, 313000000), msg.pass_pos_))->size;
+    });
+
+    run(name + "/update+build", builder.size(), [&]()
+    {
+        i++;
+
+        return (size_t)builder.timestamp(1600000000000ULL + i).gnss_timestamp(1600000000000ULL + i)
+            .position(Position(1213000000 + i, 312000000, 700)).velocity(4100 + (i & 7)).build()->size;
+    });
+}
+
+static void print_text(FILE *_fp)
+{
+    fprintf(_fp, "%-36s %12s %10s %12s %10s\n", "case", "iterations", "ns/op", "MB/s", "allocs/op");
+
+    for (auto &r : s_results)
+    {
+        fprintf(_fp, "%-36s %12" PRIu64 " %10.1f %12.1f %10.2f\n",
+            r.name.c_str(), r.iterations, r.ns_per_op, r.bytes_per_sec / 1e6, r.allocs_per_op);
+    }
+}
+
+static void print_json(FILE *_fp)
+{
+    fprintf(_fp, "[\n");
+
+    for (size_t i = 0; i < s_results.size(); i++)
+    {
+        const Result &r = s_results[i];
+
+        fprintf(_fp, "  {\"name\":\"%s\",\"iterations\":%" PRIu64 ",\"bytes\":%zu,\"ns_per_op\":%.2f,"
+            "\"bytes_per_sec\":%.0f,\"allocs_per_op\":%.3f}%s\n", r.name.c_str(), r.iterations, r.bytes,
+            r.ns_per_op, r.bytes_per_sec, r.allocs_per_op, i + 1 < s_results.size() ? "," : "");
+    }
+
+    fprintf(_fp, "]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bool json = false;
+    int opt = 0;
+
+    while (-1 != (opt = getopt(argc, argv, "jt:f:h")))
+    {
+        switch (opt)
+        {
+        case 'j': json = true; break;
+        case 't': s_min_time = atof(optarg); break;
+        case 'f': s_filter = optarg; break;
+        default:
+            usage(argv[0]);
+            return 'h' == opt ? 0 : 1;
+        }
+    }
+
+    bench("MessageHeader", MessageHeader(0, HEARTBEAT, 0x01, get_utc_timestamp_ms(), 0xFC));
+    bench("Veh2CloudInh", Veh2CloudInh(
+        0x01, get_utc_timestamp_ms(), 0xFC, "Q1001", "sw_v1.0", "hw_v1.0", "ad_v1.0",
+        COMM_TYPE_4G, 15, TIME_SYNC_GNSS, GNSS_TYPE_GCJ02, "VEH2CLOUD_INH"));
+    bench("Cloud2VehInhRes", Cloud2VehInhRes(0x01, get_utc_timestamp_ms(), 0xFC, "Q1001", CLOUD2VEH_INH_RES_COMFIRM));
+    bench("Veh2CloudState/0", make_state(0));
+    bench("Veh2CloudState/16", make_state(16));
+    bench("Veh2CloudState/255", make_state(255));
+    bench_builder(0);
+    bench_builder(16);
+
+    if (json)
+    {
+        print_json(stdout);
+    }
+    else
+    {
+        print_text(stdout);
+    }
+
+    return 0;
+}
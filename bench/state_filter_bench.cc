@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <math.h>
+
+#include <chrono>
+#include <vector>
+
+#include "recorder.h"
+#include "state_publisher.h"
+
+using namespace protocol;
+
+static void usage(const char *_name)
+{
+    printf("Usage: %s [options]\n"
+        "  -i <dir>      capture directory to filter, default a synthetic drive recorded to a temp dir\n"
+        "  -p <prefix>   capture prefix, default capture\n"
+        "  -m <ms>       max interval between sends, default 1000\n", _name);
+}
+
+/**
+ * Collects the upstream states of a capture.
+ */
+class StateVisitor : public FrameReader::Visitor
+{
+public:
+    bool on_frame(const FrameReader::Frame &_frame) override
+    {
+        if (RECORD_UP_TX == _frame.direction && VEH2CLOUD_STATE == _frame.data_type)
+        {
+            states.emplace_back(_frame.data, _frame.size);
+        }
+
+        return true;
+    }
+
+    std::vector<Veh2CloudState> states;
+};
+
+/**
+ * 10 minutes at 10 Hz: parked, city traffic with stops, highway, parked.
+ * GNSS and sensors jitter by a few units throughout.
+ */
+static int32_t record_drive(const char _dir[], const char _prefix[])
+{
+    FrameRecorder recorder;
+
+    if (0 != recorder.open(_dir, _prefix))
+    {
+        return -1;
+    }
+
+    uint64_t t0 = 1600000000000ULL;
+    double lon = 1163000000, lat = 399000000, heading = 900000, speed = 0; // 1e-7 deg, 1e-4 deg, 0.01 m/s
+
+    for (uint32_t i = 0; i < 6000; i++)
+    {
+        double t = i / 10.0;
+        double target = 0;
+
+        if (120 <= t && 420 > t)
+        {
+            target = 60 > fmod(t - 120, 90) ? 1200 : 0; // 90 s cycles, 30 s at a light
+        }
+        else if (420 <= t && 540 > t)
+        {
+            target = 2800;
+        }
+
+        double acc = fmax(-300, fmin(200, (target - speed) * 2)); // 0.01 m/s2
+        speed = fmax(0, speed + acc / 10);
+        heading = fmod(heading + (0 < speed && 0 == i % 300 ? 900000 : 0), 3600000);
+        lon += speed / 100 * sin(heading / 1e4 * M_PI / 180) * 0.1 * 90;
+        lat += speed / 100 * cos(heading / 1e4 * M_PI / 180) * 0.1 * 90;
+
+        int jitter = rand() % 3;
+        uint64_t timestamp = t0 + i * 100;
+        uint8_t gear = 0 == speed ? 1 : 4;
+        uint64_t id = i;
+
+        auto buf = Packer::pack(Veh2CloudState(0x01, timestamp, 0xFC, "Q1001",
+            std::vector<uint8_t>((uint8_t*)&id, (uint8_t*)&id + sizeof(id)), timestamp,
+            (uint16_t)(speed + jitter), Position((uint32_t)lon + jitter, (uint32_t)lat + jitter, 500 + jitter),
+            (uint32_t)heading, gear, 0, (uint16_t)speed, (uint16_t)(1000 + acc + jitter), (uint16_t)(1000 + jitter),
+            (uint16_t)(1000 + jitter), (uint16_t)(1000 + jitter), 0 < acc ? (uint16_t)acc : 0, (uint16_t)(800 + speed / 2),
+            (uint32_t)(100 + (0 < acc ? acc : 0)), 0 > acc ? BREAK_FLAG_DOWN : BREAK_FLAG_UP, 0 > acc ? (uint16_t)-acc : 0,
+            0 > acc ? (uint16_t)(-acc * 10) : 0, (uint16_t)(i / 100), DRIVE_MODE_MANUAL, Position2D(1164000000, 399500000),
+            std::vector<Position2D>()));
+
+        recorder.record(RECORD_UP_TX, buf->data, buf->size);
+    }
+
+    recorder.close();
+
+    return 0;
+}
+
+static void run(const char *_name, const StateDeadband &_deadband, const std::vector<Veh2CloudState> &_states)
+{
+    uint64_t bytes = 0;
+    StatePublisher publisher([&bytes](const Veh2CloudState &_msg)
+    {
+        bytes += _msg.get_header_length() + _msg.get_data_length();
+    });
+
+    publisher.configure(_deadband);
+
+    auto begin = std::chrono::steady_clock::now();
+
+    for (auto &s : _states)
+    {
+        publisher.publish(s);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    double total = publisher.published() + publisher.suppressed();
+
+    printf("  %-10s %7llu sent %7llu suppressed %5.1f%% %9llu B sent %9llu B saved %6.1f ns/state\n", _name,
+        (unsigned long long)publisher.published(), (unsigned long long)publisher.suppressed(),
+        100.0 * publisher.suppressed() / total, (unsigned long long)bytes,
+        (unsigned long long)publisher.saved_bytes(), seconds * 1e9 / total);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir = nullptr;
+    const char *prefix = "capture";
+    uint32_t max_interval = 1000;
+    char tmp[] = "/tmp/state_filter_bench_XXXXXX";
+    int opt = 0;
+
+    while (-1 != (opt = getopt(argc, argv, "i:p:m:h")))
+    {
+        switch (opt)
+        {
+        case 'i': dir = optarg; break;
+        case 'p': prefix = optarg; break;
+        case 'm': max_interval = strtoul(optarg, nullptr, 0); break;
+        default: usage(argv[0]); return 0;
+        }
+    }
+
+    if (nullptr == dir)
+    {
+        if (nullptr == mkdtemp(tmp) || 0 != record_drive(tmp, prefix))
+        {
+            printf("recording the synthetic drive failed\n");
+            return 1;
+        }
+
+        dir = tmp;
+    }
+
+    FrameReader reader;
+    StateVisitor visitor;
+
+    if (0 != reader.open(dir, prefix))
+    {
+        printf("open %s/%s failed\n", dir, prefix);
+        return 1;
+    }
+
+    reader.read(visitor);
+    printf("%zu states from %s\n", visitor.states.size(), dir);
+
+    StateDeadband exact;
+    StateDeadband fine;
+    StateDeadband coarse;
+
+    exact.max_interval = fine.max_interval = coarse.max_interval = max_interval;
+
+    // about 0.5 m, 1 deg, 0.1 m/s
+    fine.position = 50; fine.elevation = 50; fine.heading = 10000; fine.steering_angle = 100;
+    fine.velocity = 10; fine.acc = 10; fine.yaw_rate = 10; fine.pedal = 10; fine.break_pressure = 50;
+    fine.engine_speed = 50; fine.engine_torque = 20; fine.fuel_consume = 1;
+
+    // about 2 m, 5 deg, 0.5 m/s
+    coarse.position = 200; coarse.elevation = 200; coarse.heading = 50000; coarse.steering_angle = 500;
+    coarse.velocity = 50; coarse.acc = 50; coarse.yaw_rate = 50; coarse.pedal = 50; coarse.break_pressure = 200;
+    coarse.engine_speed = 200; coarse.engine_torque = 100; coarse.fuel_consume = 10;
+
+    run("exact", exact, visitor.states);
+    run("fine", fine, visitor.states);
+    run("coarse", coarse, visitor.states);
+
+    return 0;
+}
@@ -0,0 +1,27 @@
+# Generates the message codecs of include/protocol/data/*.def at build time.
+#
+# Builds tool/codegen.cc for the host and runs it whenever it or a
+# definition changes. Sets CSAE_GENERATED_SRCS, to be compiled with the
+# library sources, and adds the output directory to the include path.
+# CSAE_EXTRA_DEFINITIONS, set before the include, adds definitions of this
+# build only, e.g. test fixtures.
+
+set(CSAE_ROOT ${CMAKE_CURRENT_LIST_DIR}/..)
+set(CSAE_GENERATED_DIR ${CMAKE_CURRENT_BINARY_DIR}/generated)
+
+file(GLOB CSAE_DEFINITIONS ${CSAE_ROOT}/include/protocol/data/*.def)
+list(APPEND CSAE_DEFINITIONS ${CSAE_EXTRA_DEFINITIONS})
+file(MAKE_DIRECTORY ${CSAE_GENERATED_DIR})
+
+add_executable(csae_codegen ${CSAE_ROOT}/tool/codegen.cc)
+
+add_custom_command(
+    OUTPUT ${CSAE_GENERATED_DIR}/csae295.h ${CSAE_GENERATED_DIR}/csae295.cc
+    COMMAND csae_codegen -o ${CSAE_GENERATED_DIR} -n csae295 ${CSAE_DEFINITIONS}
+    DEPENDS csae_codegen ${CSAE_DEFINITIONS}
+    COMMENT "Generating CSAE 295.2 codecs"
+)
+
+set(CSAE_GENERATED_SRCS ${CSAE_GENERATED_DIR}/csae295.h ${CSAE_GENERATED_DIR}/csae295.cc)
+
+include_directories(${CSAE_GENERATED_DIR})
@@ -1,6 +1,8 @@
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "controller.h"
+#include "state_publisher.h"
 #include "util.h"
 
 #define UP_SERVER_ADDRESS   "60.16.59.129"
@@ -9,11 +11,55 @@
 #define DOWN_SERVER_PORT    50012
 
 Controller g_controller;
-Timer g_hb_timer;
 Timer g_state_timer;
-Timer g_inh_timer;
-bool g_inh_res = false;
-size_t g_inh_count = 0;
+bool g_state_running = false;
+StateSpool g_spool;
+StatePublisher g_publisher([](const Veh2CloudState &_msg)
+{
+    g_controller.send(_msg);
+});
+
+static void start_states()
+{
+    if (g_state_running)
+    {
+        return;
+    }
+
+    // at up to 10 Hz, as fast as the link currently takes
+    g_state_timer.start(100, [](void *_param)
+    {
+        static uint64_t last = 0;
+        uint64_t now = get_utc_timestamp_ms();
+
+        if (now - last + 50 < g_controller.state_interval())
+        {
+            return;
+        }
+
+        last = now;
+
+        Veh2CloudState msg(
+            0x01, get_utc_timestamp_ms(), 0xFC, "Q1001", std::vector<uint8_t>{1}, get_utc_timestamp_ms(), 
+            4000, Position(90, 90, 700), 100000, 31, 200000, 4100, 500, 400, 300, 200, 500, 3000, 50000, 
+            1, 500, 20000, 1000, 1, Position2D(80, 80), std::vector<Position2D>());
+        g_publisher.publish(msg);
+    }, nullptr);
+
+    g_state_running = true;
+}
+
+static void stop_states()
+{
+    // keep producing, the controller spools while disconnected
+    if (g_spool.is_open())
+    {
+        return;
+    }
+
+    g_state_timer.stop();
+    g_state_running = false;
+}
 
 class ControllerCallback: public Controller::Callback
 {
@@ -26,40 +72,27 @@ public:
         {
             LOGD(TAG, "on_up_connect_state: The connection is established.\n");
 
-            g_inh_timer.start(1000, [](void *_param)
+            // the cloud gets the current state right away
+            g_publisher.reset();
+
+            Veh2CloudInh inh(
+                0x01, get_utc_timestamp_ms(), 0xFC, "Q1001", "sw_v1.0", "hw_v1.0", "ad_v1.0", 
+                COMM_TYPE_4G, 15, TIME_SYNC_GNSS, GNSS_TYPE_GCJ02, "VEH2CLOUD_INH");
+            g_controller.request(inh, [](const int32_t _status, const Cloud2VehInhRes *_res)
             {
-                 if (3 <= g_inh_count)
+                if (REQUEST_TIMEOUT == _status)
                 {
-                    LOGE("veh2cloud_inh", "connection exception! VEH2CLOUD_INH count %zu", g_inh_count);
-                    g_inh_timer.stop();
-                    return;
+                    LOGE("veh2cloud_inh", "connection exception! no CLOUD2VEH_INH_RES after 3 tries\n");
                 }
+            }, 1000, 3);
 
-                Veh2CloudInh msg(
-                    0x01, get_utc_timestamp_ms(), 0xFC, "Q1001", "sw_v1.0", "hw_v1.0", "ad_v1.0", 
-                    COMM_TYPE_4G, 15, TIME_SYNC_GNSS, GNSS_TYPE_GCJ02, "VEH2CLOUD_INH");
-                g_controller.send(msg);
-                g_inh_count++;
-            }, nullptr);
-
-            g_state_timer.start(200, [](void *_param)
-            {
-                Veh2CloudState msg(
-                    0x01, get_utc_timestamp_ms(), 0xFC, "Q1001", std::vector<uint8_t>{1}, get_utc_timestamp_ms(), 
-                    4000, Position(90, 90, 700), 100000, 31, 200000, 4100, 500, 400, 300, 200, 500, 3000, 50000, 
-                    1, 500, 20000, 1000, 1, Position2D(80, 80), std::vector<Position2D>());
-                g_controller.send(msg);
-            }, nullptr);
+            start_states();
         }
         else
         {
             LOGW(TAG, "on_up_connect_state: The connection is lost, and a reconnection is scheduled in 5 seconds.\n");
 
-            g_hb_timer.stop();
-            g_inh_timer.stop();
-            g_state_timer.stop();
-            g_inh_res = false;
-            g_inh_count = 0;
+            stop_states();
             g_controller.stop();
 
             std::thread t([]()
@@ -78,22 +111,12 @@ public:
         if (socketlib::ConnectState::CONNECTED == _state)
         {
             LOGD(TAG, "on_down_connect_state: The connection is established.\n");
-
-            g_hb_timer.start(60000, [](void *_param)
-            {
-                MessageHeader msg(0, HEARTBEAT, 0x01, get_utc_timestamp_ms(), 0xFC);
-                g_controller.send(msg);
-            }, nullptr);
         }
         else
         {
             LOGW(TAG, "on_down_connect_state: The connection is lost, and a reconnection is scheduled in 5 seconds.\n");
 
-            g_hb_timer.stop();
-            g_state_timer.stop();
-            g_inh_timer.stop();
-            g_inh_res = false;
-            g_inh_count = 0;
+            stop_states();
             g_controller.stop();
 
             std::thread t([]()
@@ -108,9 +131,21 @@ public:
     void on_cloud2veh_inh_res(const Cloud2VehInhRes &_msg) 
     {
         LOGD(TAG, "on_cloud2veh_inh_res\n");
+    }
 
-        g_inh_timer.stop();
-        g_inh_res = true;
+    void on_heartbeat_dead(const uint32_t _missed)
+    {
+        LOGW(TAG, "on_heartbeat_dead: %u heartbeats missed, and a reconnection is scheduled in 5 seconds.\n", _missed);
+
+        stop_states();
+        g_controller.stop();
+
+        std::thread t([]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5000));
+            g_controller.start(UP_SERVER_ADDRESS, UP_SERVER_PORT, DOWN_SERVER_ADDRESS, DOWN_SERVER_PORT);
+        });
+        t.detach();
     }
 
 private:
@@ -120,19 +155,44 @@ private:
 int main(int argc, char *argv[])
 {
     ControllerCallback ccallback;
+    MetricsEndpoint metrics;
+
+    // e.g. CSAE_METRICS_SOCKET=/tmp/csae.metrics
+    if (nullptr != getenv("CSAE_METRICS_SOCKET"))
+    {
+        metrics.start(getenv("CSAE_METRICS_SOCKET"));
+    }
 
     g_controller.set_callback(&ccallback);
+    g_controller.set_heartbeat(60000, 5000, 3);
+    g_controller.set_dispatch(DISPATCH_POOL, 1, 1024);
+    g_controller.set_pacing(PACE_DATA, 32 << 10, 50);
+    g_controller.set_adaptive_rate(1, 10);
+
+    // send on change, at least once a second
+    StateDeadband deadband;
+    deadband.position = 50;
+    deadband.heading = 10000;
+    deadband.velocity = 10;
+    deadband.acc = 10;
+    g_publisher.configure(deadband);
+
+    // e.g. CSAE_SPOOL=/var/lib/csae/state.spool
+    if (nullptr != getenv("CSAE_SPOOL") && 0 == g_spool.open(getenv("CSAE_SPOOL"), 16 << 20, true))
+    {
+        g_controller.set_spool(&g_spool, 50);
+    }
+#ifdef _UDEBUG
+    g_controller.tracer().enable(TRACE_ALL);
+#endif
     g_controller.start(UP_SERVER_ADDRESS, UP_SERVER_PORT, DOWN_SERVER_ADDRESS, DOWN_SERVER_PORT);
 
     while (1) {}
     
     // never reach
-    g_hb_timer.stop();
     g_state_timer.stop();
-    g_inh_timer.stop();
-    g_inh_res = false;
-    g_inh_count = 0;
     g_controller.stop();
+    g_spool.close();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef __CLOUD_STUB_H__
+#define __CLOUD_STUB_H__
+
+#include <atomic>
+#include <thread>
+
+#include "packer.h"
+
+/**
+ * Local stand-in for the cloud servers.
+ *
+ * Listens on an upstream and a downstream port and serves one connection per
+ * port at a time. VEH2CLOUD_INH is answered with CLOUD2VEH_INH_RES and
+ * HEARTBEAT with HEARTBEAT_RES on the connection the request came in on,
+ * both echoing the request timestamp_. States are counted, not decoded.
+ */
+class CloudStub
+{
+public:
+    struct Stats
+    {
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> states{0};
+        std::atomic<uint64_t> inhs{0};
+        std::atomic<uint64_t> heartbeats{0};
+        std::atomic<uint64_t> connections{0};
+    };
+
+    ~CloudStub();
+
+    int32_t start(const char _addr[], const uint32_t _up_port, const uint32_t _down_port);
+
+    void stop();
+
+    /**
+     * Result of the CLOUD2VEH_INH_RES answers, CLOUD2VEH_INH_RES_COMFIRM by default.
+     */
+    void set_inh_res(const uint8_t _res) { inh_res_ = _res; }
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    class Session;
+
+    void serve(const int _listen_fd, std::atomic<int> &_fd);
+
+    static constexpr const char *TAG = "CloudStub";
+
+    std::atomic<bool> stopped_{true};
+    std::atomic<int>  up_listen_fd_{-1};
+    std::atomic<int>  down_listen_fd_{-1};
+    std::atomic<int>  up_fd_{-1};
+    std::atomic<int>  down_fd_{-1};
+    std::thread       up_thread_;
+    std::thread       down_thread_;
+    uint8_t           inh_res_ = CLOUD2VEH_INH_RES_COMFIRM;
+    Stats             stats_;
+};
+
+#endif // __CLOUD_STUB_H__
@@ -2,12 +2,30 @@
 #define __CONTROLLER_H__
 
 #include "timer.h"
+#include "timer_wheel.h"
 #include "block_queue.h"
+#include "token_bucket.h"
+#include "adaptive_rate.h"
+#include "message_batch.h"
 #include "packer.h"
+#include "state_builder.h"
+#include "frame_assembler.h"
+#include "protocol_link.h"
+#include "recorder.h"
 #include "socketlib.h"
+#include "tracer.h"
+#include "metrics.h"
+#include "clock_sync.h"
+#include "pending_requests.h"
+#include "heartbeat.h"
+#include "dispatcher.h"
+#include "spool.h"
 
 using namespace protocol;
 
+#define PACE_DATA    0 // Veh2CloudState and replayed frames
+#define PACE_CONTROL 1 // handshakes, sent ahead of queued data
+
 /**
  * Controller.
  */
@@ -16,6 +34,9 @@ class Controller : public Packer::Handler
 public:
     /**
      * Controller callback.
+     *
+     * Message methods and request handlers run as set by set_dispatch(),
+     * on the socket threads by default.
      */
     class Callback
     {
@@ -28,9 +49,37 @@ public:
 
         virtual void on_cloud2veh_inh_res(const Cloud2VehInhRes &_msg) {};
 
+        virtual void on_veh2cloud_state(const Veh2CloudState &_msg) {};
+
+        /**
+         * Called for every received Veh2CloudState unless batched, copy _msg
+         * to keep the message past the call, it goes back to the
+         * connection's pool with the last copy. Forwards to
+         * on_veh2cloud_state() by default.
+         */
+        virtual void on_veh2cloud_state(const Pooled<Veh2CloudState> &_msg) { on_veh2cloud_state(*_msg); };
+
+        /**
+         * Instead of on_veh2cloud_state() when set_batch() is on, _msgs is
+         * valid only during the call.
+         */
+        virtual void on_veh2cloud_state_batch(const Veh2CloudState _msgs[], const size_t _count) {};
+
+        /**
+         * The downstream link missed _missed heartbeats in a row.
+         */
+        virtual void on_heartbeat_dead(const uint32_t _missed) {};
+
         // message
     };
 
+    /**
+     * Handshake completion, _res is null unless _status is REQUEST_OK.
+     */
+    typedef std::function<void(const int32_t _status, const Cloud2VehInhRes *_res)> InhHandler;
+
+    Controller();
+
     ~Controller();
 
     void set_callback(Callback *_callback);
@@ -39,6 +88,143 @@ public:
     
     void stop();
 
+    Tracer& tracer() { return tracer_; }
+
+    /**
+     * Record raw frames of both directions, set it before start().
+     */
+    void set_recorder(FrameRecorder *_recorder) { recorder_ = _recorder; }
+
+    /**
+     * Heartbeat the downstream link after _interval milliseconds without
+     * received traffic, 0 disables. Set it before start().
+     *
+     * @param _timeout    wait for HEARTBEAT_RES, in milliseconds
+     * @param _max_missed consecutive misses before on_heartbeat_dead()
+     */
+    void set_heartbeat(const uint32_t _interval, const uint32_t _timeout = 5000, const uint32_t _max_missed = 3)
+    {
+        heartbeat_.configure(_interval, _timeout, _max_missed);
+    }
+
+    HeartbeatStats heartbeat_stats() const { return heartbeat_.stats(); }
+
+    /**
+     * Run message callbacks and request handlers off the socket threads,
+     * see Dispatcher. Set it before start().
+     *
+     * @param _mode     DISPATCH_*
+     * @param _workers  threads of DISPATCH_POOL
+     * @param _capacity callbacks queued per worker before the socket
+     *                  thread waits
+     */
+    void set_dispatch(const uint32_t _mode, const size_t _workers = 1, const size_t _capacity = 1024)
+    {
+        dispatch_mode_ = _mode;
+        dispatch_workers_ = _workers;
+        dispatch_capacity_ = _capacity;
+    }
+
+    /**
+     * Spool Veh2CloudState while the upstream link is down or the controller
+     * stopped, and replay it at up to _rate frames/s once the link is back,
+     * only while the send queue is nearly empty so live traffic goes first.
+     * Set it before start(), _spool must be open.
+     *
+     * With a spool, stop() moves the states still queued into it and drops
+     * the other queued frames.
+     */
+    void set_spool(StateSpool *_spool, const uint32_t _rate = 50)
+    {
+        spool_ = _spool;
+        spool_rate_ = _rate;
+    }
+
+    /**
+     * Shape the upstream traffic of _class, PACE_*, with a token bucket,
+     * see TokenBucket. The send thread sleeps on the timer wheel until a
+     * held frame may go, so a burst should cover at least its 10 ms tick.
+     * Control frames are queued apart and bypass held data. Set it before
+     * start(), all 0 disables.
+     *
+     * @param _bytes  bytes/s
+     * @param _frames frames/s
+     */
+    void set_pacing(const uint8_t _class, const uint64_t _bytes, const uint32_t _frames,
+        const uint64_t _burst_bytes = 0, const uint32_t _burst_frames = 0)
+    {
+        pacers_[PACE_CONTROL == _class].configure(_bytes, _frames, _burst_bytes, _burst_frames);
+    }
+
+    /**
+     * Adapt the Veh2CloudState rate to the link, see AdaptiveRate: it drops
+     * while the upstream queue holds _depth frames or the heartbeat SRTT
+     * grows past _rtt_factor times its minimum, and recovers with them.
+     * Producers pace themselves by state_interval(). Set it before start(),
+     * the RTT needs set_heartbeat(). INH round trips count as RTT samples,
+     * without any for a second a heartbeat is sent despite traffic.
+     *
+     * @param _min, _max states/s
+     */
+    void set_adaptive_rate(const double _min, const double _max, const size_t _depth = 8, const double _rtt_factor = 2.0)
+    {
+        state_rate_.configure(_min, _max, _depth, _rtt_factor);
+    }
+
+    /**
+     * States/s the link currently takes, lock-free.
+     */
+    double state_rate() const { return state_rate_.rate(); }
+
+    /**
+     * Milliseconds between states at state_rate(), 0 without
+     * set_adaptive_rate().
+     */
+    uint32_t state_interval() const { return state_rate_.interval(); }
+
+    /**
+     * Deliver received Veh2CloudState in batches of up to _max, every frame
+     * of one read in one on_veh2cloud_state_batch() call. Each connection
+     * collects its own batches. Set it before start().
+     *
+     * @param _max     0 delivers one by one to on_veh2cloud_state()
+     * @param _latency let a batch collect over several reads for up to
+     *                 _latency milliseconds, rounded up to 10 ms
+     */
+    void set_batch(const size_t _max, const uint32_t _latency = 0);
+
+    /**
+     * With DISPATCH_LOOP, poll dispatcher().fd() for readable and call
+     * dispatcher().run() on the loop's thread.
+     */
+    Dispatcher& dispatcher() { return dispatcher_; }
+
+    /**
+     * Cloud clock estimate from heartbeat and INH round trips whose
+     * response the cloud stamped with its own time, e.g.
+     * clock().downlink(_msg.timestamp_, get_utc_timestamp_ms()) in a
+     * callback gives the corrected one-way latency of _msg.
+     */
+    const ClockSync& clock() const { return clock_; }
+
+    /**
+     * Run a connection of another protocol, e.g. jt808::Codec or
+     * jt1078::Codec, beside the CSAE links, started and stopped with them,
+     * see ProtocolLink. Add it before start().
+     *
+     * @param _handler receives the decoded messages on the link's receive
+     *                 thread, bound at compile time through H
+     */
+    template<typename Codec, typename H>
+    ProtocolLink<Codec, H>& add_link(const char _addr[], const uint32_t _port, H &_handler)
+    {
+        ProtocolLink<Codec, H> *link = new ProtocolLink<Codec, H>(_addr, _port, _handler);
+
+        links_.emplace_back(link);
+
+        return *link;
+    }
+
     // message
 
     void send(const MessageHeader &_msg);
@@ -49,6 +235,20 @@ public:
 
     void send(const Veh2CloudState &_msg);
 
+    /**
+     * An encoded VEH2CLOUD_STATE frame, e.g. from StateBuilder::build().
+     */
+    void send(const std::shared_ptr<protocol::MessageBuffer> &_state);
+
+    /**
+     * Send _msg and wait for its Cloud2VehInhRes, resending every _timeout
+     * milliseconds up to _tries attempts. Pending requests are cancelled by
+     * stop().
+     *
+     * @return -1 if a handshake of the vehicle is already pending
+     */
+    int32_t request(const Veh2CloudInh &_msg, InhHandler _handler, const uint32_t _timeout = 1000, const uint32_t _tries = 3);
+
     // virtual methods implementation
 
     void on_unpack(const MessageHeader &_msg) override;
@@ -59,7 +259,54 @@ public:
 
     void on_unpack(const Veh2CloudState &_msg) override;
 
+    void on_unpack(const Pooled<Veh2CloudState> &_msg) override;
+
 private:
+    typedef MessageBatch<Veh2CloudState> StateBatch;
+
+    /**
+     * Decoded messages of one CSAE connection, its states are batched apart
+     * from the other connection's, the rest goes to the Controller.
+     */
+    class Receiver : public Packer::Handler
+    {
+    public:
+        explicit Receiver(Controller &_controller): batch(_controller.wheel_), controller_(_controller) {}
+
+        void on_unpack(const MessageHeader &_msg) override { controller_.on_unpack(_msg); }
+
+        void on_unpack(const Veh2CloudInh &_msg) override { controller_.on_unpack(_msg); }
+
+        void on_unpack(const Cloud2VehInhRes &_msg) override { controller_.on_unpack(_msg); }
+
+        void on_unpack(const Veh2CloudState &_msg) override { controller_.on_state(_msg, batch); }
+
+        void on_unpack(const Pooled<Veh2CloudState> &_msg) override { controller_.on_state(_msg, batch); }
+
+        StateBatch batch;
+
+    private:
+        Controller &controller_;
+    };
+
+    void on_frame(const uint8_t _direction, const uint8_t *_frame, const size_t _size);
+
+    void on_state(const Veh2CloudState &_msg, StateBatch &_batch);
+
+    void on_state(const Pooled<Veh2CloudState> &_msg, StateBatch &_batch);
+
+    void on_round_trip(const uint64_t _request, const uint64_t _remote);
+
+    void on_received(const MessageHeader &_msg);
+
+    void on_state_batch(StateBatch &_owner, StateBatch::Batch *_batch);
+
+    void replay(const uint64_t _gen);
+
+    bool pace(const uint8_t _class, const size_t _size);
+
+    void adapt(const uint64_t _gen);
+
     // upstream
 
     void up_sock_recv_thread();
@@ -78,17 +325,45 @@ private:
     uint16_t serial_ = 0;
 
     Callback *callback_ = nullptr;
+    Tracer tracer_;
+    FrameRecorder *recorder_ = nullptr;
+    TimerWheel wheel_;
+    PendingRequests requests_{wheel_};
+    Heartbeat heartbeat_{wheel_, "down"};
+    ClockSync clock_;
+    Dispatcher dispatcher_;
+    StateSpool *spool_ = nullptr;
+    uint32_t spool_rate_ = 50;
+    std::atomic<uint64_t> replay_gen_{0};
+    uint32_t replay_budget_ = 0; // frames/s * ms, one frame per 1000
+    std::vector<uint8_t> replay_frame_;
+    AdaptiveRate state_rate_;
+    std::atomic<uint64_t> adapt_gen_{0};
+    uint32_t dispatch_mode_ = DISPATCH_INLINE;
+    size_t dispatch_workers_ = 1;
+    size_t dispatch_capacity_ = 1024;
+    std::vector<std::unique_ptr<Link>> links_;
 
     // upstream
+    std::atomic<bool> up_connected_{false};
     socketlib::Client up_sock_;
     std::thread  up_recv_thread_;
     std::thread  up_send_thread_;
+    FrameAssembler up_assembler_;
+    Csae295Codec up_codec_;
+    Receiver up_receiver_{*this};
     BlockQueue<std::shared_ptr<protocol::MessageBuffer>> up_send_queue_;
+    BlockQueue<std::shared_ptr<protocol::MessageBuffer>> up_control_queue_; // woken through up_send_queue_
+    TokenBucket pacers_[2];   // by PACE_*
+    uint64_t held_since_[2] = {0, 0}; // us, head frame waiting for tokens
 
     // downstream
     socketlib::Client down_sock_;
     std::thread down_recv_thread_;
     std::thread down_send_thread_;
+    FrameAssembler down_assembler_;
+    Csae295Codec down_codec_;
+    Receiver down_receiver_{*this};
     BlockQueue<std::shared_ptr<protocol::MessageBuffer>> down_send_queue_;
 };
 
@@ -0,0 +1,116 @@
+#ifndef __DISPATCHER_H__
+#define __DISPATCHER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+
+#define DISPATCH_INLINE 0 // on the calling thread
+#define DISPATCH_POOL   1 // on a pool of worker threads
+#define DISPATCH_LOOP   2 // on a user event loop woken through eventfd
+
+/**
+ * Runs callbacks off the socket threads.
+ *
+ * Tasks are keyed, e.g. by message data type, and the tasks of one key run
+ * in order: in DISPATCH_POOL a key always goes to the same worker, in
+ * DISPATCH_LOOP there is a single queue. Queues are bounded, dispatch()
+ * blocks while the target queue is full, which pushes back on the socket
+ * instead of growing without limit.
+ *
+ * The delay from dispatch() to the start of a task is recorded in ns as
+ * csae_dispatch_delay_ns.
+ */
+class Dispatcher
+{
+public:
+    typedef std::function<void()> task;
+
+    Dispatcher();
+
+    ~Dispatcher();
+
+    /**
+     * @param _workers  threads of DISPATCH_POOL
+     * @param _capacity tasks per queue
+     */
+    int32_t start(const uint32_t _mode, const size_t _workers = 1, const size_t _capacity = 1024);
+
+    /**
+     * Stop the workers after the queued tasks ran. Tasks still queued for
+     * a DISPATCH_LOOP are dropped. Called from a task, its worker is joined
+     * by the next start() or the destructor instead.
+     */
+    void stop();
+
+    uint32_t mode() const { return mode_; }
+
+    /**
+     * Run _task as configured, inline if not started.
+     */
+    void dispatch(const uint8_t _key, task _task);
+
+    /**
+     * Readable while a DISPATCH_LOOP has tasks queued, -1 in other modes.
+     */
+    int fd() const { return fd_; }
+
+    /**
+     * Run the queued tasks of a DISPATCH_LOOP on the calling thread.
+     *
+     * @return number of tasks run
+     */
+    size_t run();
+
+private:
+    struct Item
+    {
+        task     fn;
+        uint64_t time; // steady ns at dispatch()
+    };
+
+    struct Queue
+    {
+        std::deque<Item> items;
+        std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+        std::thread thread;
+        bool stopped = false; // under mutex
+    };
+
+    void work(Queue &_queue);
+
+    /**
+     * Join the workers left by a stop() from a task, except the calling
+     * one.
+     */
+    void reap();
+
+    void execute(Item &_item);
+
+    static constexpr const char *TAG = "Dispatcher";
+
+    uint32_t mode_ = DISPATCH_INLINE;
+    std::atomic<bool> stopped_{true};
+    size_t capacity_ = 0;
+    int fd_ = -1;
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::unique_ptr<Queue>> retired_; // of a worker that called start()
+
+    Histogram &delay_;
+    Gauge     &depth_;
+    Counter   &full_;
+};
+
+#endif // __DISPATCHER_H__
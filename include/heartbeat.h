@@ -0,0 +1,156 @@
+#ifndef __HEARTBEAT_H__
+#define __HEARTBEAT_H__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+#include "metrics.h"
+#include "timer_wheel.h"
+
+/**
+ * Heartbeat round trip estimate, in us.
+ */
+struct HeartbeatStats
+{
+    uint64_t srtt = 0;
+    uint64_t rttvar = 0;
+    uint64_t rto = 0;       // srtt + 4 * rttvar
+    uint64_t min_rtt = 0;
+    uint64_t last_rtt = 0;
+    uint64_t samples = 0;
+    uint64_t sent = 0;
+    uint64_t suppressed = 0;
+    uint32_t missed = 0;    // consecutive
+};
+
+/**
+ * Heartbeat of one link, sent only when the link has been idle.
+ *
+ * A received frame proves the peer alive, so activity() pushes the next
+ * heartbeat back by a full interval; a link busy with responses sends none.
+ * Each heartbeat carries its own timestamp_, a HEARTBEAT_RES echoing it
+ * gives an RTT sample for the RFC 6298 SRTT/RTTVAR estimate, as do the
+ * round trips of other requests passed to sample(). With probe() set, a
+ * busy link still sends one when the estimate has no fresh sample. The link
+ * is declared dead after a number of consecutive heartbeats go unanswered.
+ */
+class Heartbeat
+{
+public:
+    /**
+     * Send one heartbeat stamped _timestamp.
+     */
+    typedef std::function<void(const uint64_t _timestamp)> sender;
+
+    /**
+     * Link declared dead after _missed heartbeats, runs on the wheel's thread.
+     */
+    typedef std::function<void(const uint32_t _missed)> dead_handler;
+
+    Heartbeat(TimerWheel &_wheel, const char _link[]);
+
+    ~Heartbeat();
+
+    /**
+     * Set before start().
+     *
+     * @param _interval   idle time before a heartbeat, in milliseconds, 0 disables
+     * @param _timeout    wait for a response, in milliseconds
+     * @param _max_missed consecutive misses before the link is dead
+     */
+    void configure(const uint32_t _interval, const uint32_t _timeout, const uint32_t _max_missed);
+
+    /**
+     * Send a heartbeat despite traffic once no RTT sample came for _interval
+     * milliseconds, e.g. for a delay signal on a busy link, 0 disables.
+     * Set before start().
+     */
+    void probe(const uint32_t _interval);
+
+    void start(sender _send, dead_handler _dead);
+
+    void stop();
+
+    /**
+     * A frame was received on the link, lock-free.
+     */
+    void activity();
+
+    /**
+     * Match a HEARTBEAT_RES by the timestamp_ it echoes. One stamped with
+     * the peer's own time is taken as the answer to the outstanding
+     * heartbeat.
+     *
+     * @param _request set to the timestamp_ of the heartbeat answered
+     * @return false if it answers none of the recent heartbeats
+     */
+    bool response(const uint64_t _timestamp, uint64_t *_request = nullptr);
+
+    /**
+     * RTT of another request on the link, in us.
+     */
+    void sample(const uint64_t _rtt);
+
+    HeartbeatStats stats() const;
+
+private:
+    static const size_t RECENT = 4;
+
+    /**
+     * @return index in sent_, RECENT if not found
+     */
+    size_t find(const uint64_t _timestamp) const;
+
+    void schedule_idle(const uint32_t _delay);
+
+    /**
+     * Interval to the next idle check, the probe interval if shorter.
+     */
+    uint32_t idle_interval() const;
+
+    void on_idle(const uint64_t _gen);
+
+    void on_timeout(const uint64_t _gen, const uint64_t _timestamp);
+
+    /**
+     * Record a heartbeat under the lock, the caller sends it after unlocking.
+     *
+     * @return its timestamp_
+     */
+    uint64_t beat();
+
+    void update(const uint64_t _rtt);
+
+    static constexpr const char *TAG = "Heartbeat";
+
+    TimerWheel &wheel_;
+    uint32_t interval_ = 60000;
+    uint32_t timeout_ = 5000;
+    uint32_t max_missed_ = 3;
+    uint32_t probe_ = 0;
+
+    bool started_ = false;
+    uint64_t gen_ = 0;
+    uint64_t timer_ = 0;
+    uint64_t outstanding_ = 0; // timestamp_, 0 if none
+    uint64_t sent_[RECENT][2] = {{0}}; // timestamp_, steady us
+    size_t next_ = 0;
+    uint64_t last_sample_ = 0; // steady us
+    sender send_;
+    dead_handler dead_;
+    HeartbeatStats stats_;
+    std::atomic<uint64_t> last_rx_{0}; // steady ms
+    mutable std::mutex mutex_;
+
+    Histogram &rtt_;
+    Gauge     &srtt_;
+    Gauge     &rttvar_;
+    Counter   &sent_total_;
+    Counter   &suppressed_total_;
+    Counter   &missed_total_;
+};
+
+#endif // __HEARTBEAT_H__
@@ -0,0 +1,104 @@
+#ifndef __PENDING_REQUESTS_H__
+#define __PENDING_REQUESTS_H__
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "message.h"
+#include "metrics.h"
+#include "timer_wheel.h"
+
+#define REQUEST_OK         0
+#define REQUEST_TIMEOUT   -1
+#define REQUEST_CANCELLED -2
+
+/**
+ * Outstanding requests keyed by request data type and vehicle id, resent on
+ * timeout up to a bound and completed by the matching response.
+ *
+ * Each attempt carries its own timestamp_, so a response echoing it gives
+ * the RTT of that attempt; otherwise the RTT is taken only when there was a
+ * single attempt. Recorded in us as csae_request_rtt_us, and first send to
+ * completion as csae_request_duration_us.
+ */
+class PendingRequests
+{
+public:
+    /**
+     * Send one attempt stamped _timestamp.
+     */
+    typedef std::function<void(const uint64_t _timestamp)> sender;
+
+    /**
+     * Completion, _res is the response on REQUEST_OK and null otherwise.
+     */
+    typedef std::function<void(const int32_t _status, const protocol::MessageHeader *_res)> handler;
+
+    PendingRequests(TimerWheel &_wheel): wheel_(_wheel) {}
+
+    ~PendingRequests();
+
+    /**
+     * Send the first attempt and track it.
+     *
+     * @param _name    metric label of the request type, e.g. "inh"
+     * @param _timeout per attempt, in milliseconds
+     * @param _tries   attempts before REQUEST_TIMEOUT
+     * @return -1 if the key is already pending
+     */
+    int32_t add(const uint8_t _type, const std::string &_key, const char _name[],
+        sender _send, handler _done, const uint32_t _timeout, const uint32_t _tries);
+
+    /**
+     * @param _request set to the timestamp_ of the attempt answered, 0 if
+     *                 that is ambiguous
+     * @param _rtt     set to the RTT of that attempt in us, 0 if ambiguous
+     * @return false if nothing is pending under the key
+     */
+    bool complete(const uint8_t _type, const std::string &_key, const protocol::MessageHeader &_res,
+        uint64_t *_request = nullptr, uint64_t *_rtt = nullptr);
+
+    /**
+     * Complete everything with REQUEST_CANCELLED, e.g. on disconnect.
+     */
+    void cancel_all();
+
+    size_t size() const;
+
+private:
+    typedef std::pair<uint8_t, std::string> Key;
+
+    struct Request
+    {
+        uint64_t  seq;
+        sender    send;
+        handler   done;
+        uint32_t  timeout;
+        uint32_t  tries;
+        uint64_t  timer = 0;
+        uint64_t  first = 0;    // steady us
+        std::vector<std::pair<uint64_t, uint64_t>> attempts; // timestamp_, steady us
+        Histogram *rtt;
+        Histogram *duration;
+        Counter   *retries;
+        Counter   *timeouts;
+    };
+
+    void attempt(const Key &_key, Request &_req);
+
+    void on_timeout(const Key &_key, const uint64_t _seq);
+
+    static constexpr const char *TAG = "PendingRequests";
+
+    TimerWheel &wheel_;
+    uint64_t seq_ = 0;
+    std::map<Key, Request> requests_;
+    mutable std::mutex mutex_;
+};
+
+#endif // __PENDING_REQUESTS_H__
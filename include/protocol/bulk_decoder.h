@@ -0,0 +1,97 @@
+#ifndef __PROTOCOL_BULK_DECODER_H__
+#define __PROTOCOL_BULK_DECODER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "packer.h"
+
+namespace protocol
+{
+/**
+ * Parallel offline decoder for captures and raw TCP stream dumps.
+ *
+ * The mapped file is split into chunks. A chunk owns the frames starting
+ * inside it: raw streams are resynchronised on 0xF2 with a SIMD scan and
+ * data_len_ chained over the following frames, recorder segments on the
+ * 8-byte aligned record magic. Chunks are decoded on all threads with
+ * Packer::unpack and merged in file order.
+ */
+class BulkDecoder
+{
+public:
+    /**
+     * Per chunk handler, receives the chunk's frames in order.
+     */
+    class Handler : public Packer::Handler
+    {
+    public:
+        virtual void on_frame(const uint8_t *_frame, const size_t _size) {}
+    };
+
+    /**
+     * Creates a handler per chunk and merges them in chunk order on the
+     * thread calling decode(). merge() takes ownership of the handler.
+     */
+    class Factory
+    {
+    public:
+        virtual ~Factory() {}
+
+        virtual Handler* create(const size_t _chunk) = 0;
+
+        virtual void merge(Handler *_handler) = 0;
+    };
+
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        uint64_t skipped = 0;
+        uint64_t chunks = 0;
+        double   seconds = 0.0;
+    };
+
+    ~BulkDecoder();
+
+    int32_t open(const char _path[]);
+
+    void close();
+
+    bool is_capture() const { return capture_; }
+
+    size_t size() const { return size_; }
+
+    /**
+     * Decode the whole file, 0 _threads means all cores.
+     */
+    int32_t decode(Factory &_factory, size_t _threads, const size_t _chunk_size, Stats &_stats);
+
+private:
+    struct Result
+    {
+        Handler *handler = nullptr;
+        uint64_t frames = 0;
+        uint64_t skipped = 0;
+        bool     done = false;
+    };
+
+    void decode_chunk(const size_t _begin, const size_t _end, Result &_result) const;
+
+    void decode_stream(const size_t _begin, const size_t _end, Result &_result) const;
+
+    void decode_capture(const size_t _begin, const size_t _end, Result &_result) const;
+
+    size_t sync_stream(size_t _offset) const;
+
+    static constexpr const char *TAG = "protocol::BulkDecoder";
+
+    static const size_t MAX_FRAME = 65536;
+
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+    bool capture_ = false;
+};
+} // namespace protocal
+
+#endif // __PROTOCOL_BULK_DECODER_H__
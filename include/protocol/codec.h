@@ -0,0 +1,161 @@
+#ifndef __PROTOCOL_CODEC_H__
+#define __PROTOCOL_CODEC_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "packer.h"
+
+#define FRAME_IDENTIFIER     0xF2
+#define FRAME_HEADER_LENGTH  16
+#define FRAME_DATA_TYPE_POS  5
+#define FRAME_VEHICLE_ID_POS 16
+
+/**
+ * Protocol codecs.
+ *
+ * A codec is a class taken as a template parameter by BasicFrameAssembler
+ * and ProtocolLink, so framing, header decode and dispatch bind at compile
+ * time, nothing is virtual. A codec Codec provides
+ *
+ *   NAME            static constexpr const char*, the protocol label of
+ *                   metrics
+ *   HEADER_LENGTH   static const size_t, bytes of a frame start that always
+ *                   belong to the frame, at least its identifier
+ *   MAX_FRAME       static const size_t, longest frame on the wire
+ *   Header          decoded frame header
+ *   Handler         default receiver of the decoded messages
+ *
+ *   static const uint8_t* find_start(const uint8_t *_begin, const uint8_t *_end)
+ *       first byte in [_begin, _end) that may start a frame, a start cut
+ *       off by _end included, _end if none
+ *   static size_t frame_length(const uint8_t *_buf, const size_t _size)
+ *       length of the frame at _buf, 0 if _size bytes don't tell yet,
+ *       INVALID_FRAME if _buf doesn't start a frame
+ *   static bool decode_header(const uint8_t *_frame, const size_t _size, Header &_header)
+ *   template<typename H> size_t dispatch(const uint8_t *_frame, const size_t _size, H &_handler)
+ *       decode a complete frame and call _handler, 0 if rejected
+ *
+ * A codec object is per connection and holds what dispatch() recycles,
+ * e.g. message pools or an unescape buffer.
+ */
+namespace protocol
+{
+static const size_t INVALID_FRAME = (size_t)-1;
+
+/**
+ * First _byte in [_begin, _end), _end if none, 32 or 16 bytes per compare.
+ */
+inline const uint8_t* find_byte(const uint8_t *_begin, const uint8_t *_end, const uint8_t _byte)
+{
+    const uint8_t *p = _begin;
+
+#if defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi8((char)_byte);
+
+    for (; p + 32 <= _end; p += 32)
+    {
+        uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), needle));
+
+        if (0 != mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8((char)_byte);
+
+    for (; p + 16 <= _end; p += 16)
+    {
+        uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), needle));
+
+        if (0 != mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    for (; p < _end; p++)
+    {
+        if (_byte == *p)
+        {
+            return p;
+        }
+    }
+
+    return _end;
+}
+
+/**
+ * CSAE 295.2, 0xF2 frames with the data length in the header.
+ */
+class Csae295Codec
+{
+public:
+    static constexpr const char *NAME = "csae295";
+    static const size_t HEADER_LENGTH = FRAME_HEADER_LENGTH;
+    static const size_t MAX_FRAME = 65536;
+
+    typedef MessageHeader Header;
+    typedef Packer::Handler Handler;
+
+    static const uint8_t* find_start(const uint8_t *_begin, const uint8_t *_end)
+    {
+        return find_byte(_begin, _end, FRAME_IDENTIFIER);
+    }
+
+    static size_t frame_length(const uint8_t *_buf, const size_t _size)
+    {
+        if (0 != _size && FRAME_IDENTIFIER != _buf[0])
+        {
+            return INVALID_FRAME;
+        }
+
+        if (_size < FRAME_HEADER_LENGTH)
+        {
+            return 0;
+        }
+
+        uint32_t data_len = 0;
+        memcpy(&data_len, _buf + 1, sizeof(data_len));
+
+        return FRAME_HEADER_LENGTH + __builtin_bswap32(data_len);
+    }
+
+    static bool decode_header(const uint8_t *_frame, const size_t _size, Header &_header)
+    {
+        if (FRAME_HEADER_LENGTH > _size || FRAME_IDENTIFIER != _frame[0])
+        {
+            return false;
+        }
+
+        _header = MessageHeader(_frame, _size);
+
+        return true;
+    }
+
+    /**
+     * Through Packer::unpack(), states and INH from the pools of this
+     * connection.
+     */
+    template<typename H>
+    size_t dispatch(const uint8_t *_frame, const size_t _size, H &_handler)
+    {
+        Packer::unpack(_frame, _size, _handler, pools_);
+
+        return FRAME_HEADER_LENGTH > _size || FRAME_IDENTIFIER != _frame[0] ? 0 : _size;
+    }
+
+    Packer::Pools& pools() { return pools_; }
+
+private:
+    Packer::Pools pools_;
+};
+} // namespace protocal
+
+#endif // __PROTOCOL_CODEC_H__
@@ -0,0 +1,163 @@
+#ifndef __PROTOCOL_DOMAIN_H__
+#define __PROTOCOL_DOMAIN_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "veh2cloud_inh.h"
+#include "veh2cloud_state.h"
+
+namespace protocol
+{
+/**
+ * Point in the wire units, 1e-7 degrees and the elevation as sent.
+ */
+struct GeoPoint
+{
+    uint32_t longitude = 0;
+    uint32_t latitude = 0;
+    uint32_t elevation = 0;
+};
+
+struct GeoPoint2D
+{
+    GeoPoint2D() {}
+    GeoPoint2D(const uint32_t _longitude, const uint32_t _latitude): longitude(_longitude), latitude(_latitude) {}
+
+    uint32_t longitude = 0;
+    uint32_t latitude = 0;
+};
+
+/**
+ * VEH2CLOUD_STATE for application code.
+ *
+ * Naturally aligned, unlike the packed Veh2CloudState which is the wire
+ * layout. What a consumer reads for every state, the times, position,
+ * motion and mode, sits in the first 64 bytes; identity, powertrain
+ * details and the route follow.
+ */
+struct VehicleState
+{
+    // hot
+    uint64_t timestamp = 0;
+    uint64_t gnss_timestamp = 0;
+    GeoPoint position;
+    uint32_t heading = 0;
+    uint32_t steering_angle = 0;
+    uint16_t velocity = 0;
+    uint16_t gnss_velocity = 0;
+    uint16_t acc_lon = 0;
+    uint16_t acc_lat = 0;
+    uint16_t acc_ver = 0;
+    uint16_t yaw_rate = 0;
+    uint16_t accel_pos = 0;
+    uint16_t break_pos = 0;
+    uint8_t  gear = 0;
+    uint8_t  break_flag = 0;
+    uint8_t  drive_mode = 0;
+
+    // cold
+    uint8_t  version = 0x01;
+    uint32_t engine_torque = 0;
+    uint16_t engine_speed = 0;
+    uint16_t break_pressure = 0;
+    uint16_t fuel_consume = 0;
+    uint8_t  ctrl = 0xFC;
+    GeoPoint2D dest_location;
+    char     vehicle_id[8] = "";
+    uint64_t message_id = 0; // message_id_[0] lowest
+    std::vector<GeoPoint2D> pass_pos;
+};
+
+/**
+ * VEH2CLOUD_INH for application code.
+ */
+struct VehicleInh
+{
+    uint64_t timestamp = 0;
+    char     vehicle_id[8] = "";
+    uint8_t  version = 0x01;
+    uint8_t  ctrl = 0xFC;
+    uint8_t  com_type = COMM_TYPE_DEFAULT;
+    uint8_t  pos_confidence = 0;
+    uint8_t  time_sync = TIME_SYNC_DEFAULT;
+    uint8_t  gnss_type = GNSS_TYPE_GCJ02;
+    std::string sw_ver;
+    std::string hw_ver;
+    std::string ad_ver;
+    std::string user_data;
+};
+
+static_assert(64 >= offsetof(VehicleState, drive_mode) + sizeof(uint8_t), "VehicleState hot fields exceed a cache line");
+static_assert(8 == sizeof(GeoPoint2D) && 12 == sizeof(GeoPoint), "GeoPoint is not the wire layout");
+
+/**
+ * Codec between the wire and the domain types.
+ *
+ * Fields are read and written at their wire offsets with memcpy, so
+ * nothing depends on the packed message structs and no access is
+ * unaligned on the domain side. decode() keeps the capacity of the vector
+ * and strings it fills.
+ */
+class DomainCodec
+{
+public:
+    /**
+     * @return frame size, 0 if _buf is not a complete VEH2CLOUD_STATE
+     */
+    static size_t decode(const void *_buf, const size_t _size, VehicleState &_state);
+
+    /**
+     * Up to 255 pass_pos points, the rest are dropped.
+     *
+     * @return frame size, 0 if _size is too small
+     */
+    static size_t encode(const VehicleState &_state, void *_buf, const size_t _size);
+
+    /**
+     * @return frame size, 0 if _buf is not a complete VEH2CLOUD_INH
+     */
+    static size_t decode(const void *_buf, const size_t _size, VehicleInh &_inh);
+
+    /**
+     * Strings of 255 bytes or more are sent empty, as Veh2CloudInh does.
+     *
+     * @return frame size, 0 if _size is too small
+     */
+    static size_t encode(const VehicleInh &_inh, void *_buf, const size_t _size);
+
+    static size_t size(const VehicleState &_state);
+
+    static size_t size(const VehicleInh &_inh);
+
+    /**
+     * The frame of _t for the send queue.
+     */
+    template<typename T>
+    static std::shared_ptr<MessageBuffer> pack(const T &_t)
+    {
+        size_t size = DomainCodec::size(_t);
+        std::shared_ptr<MessageBuffer> p((MessageBuffer*)new uint8_t[size + sizeof(MessageBuffer)], MessageBuffer::deleter<MessageBuffer>);
+
+        p->size = encode(_t, p->data, size);
+
+        return p;
+    }
+
+    /**
+     * From a decoded message, e.g. one a Packer::Handler received.
+     */
+    static void convert(const Veh2CloudState &_msg, VehicleState &_state);
+
+    static void convert(const Veh2CloudInh &_msg, VehicleInh &_inh);
+
+private:
+    static constexpr const char *TAG = "protocol::DomainCodec";
+};
+} // namespace protocol
+
+#endif // __PROTOCOL_DOMAIN_H__
@@ -0,0 +1,156 @@
+#ifndef __PROTOCOL_FRAME_ASSEMBLER_H__
+#define __PROTOCOL_FRAME_ASSEMBLER_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "codec.h"
+
+namespace protocol
+{
+/**
+ * Splits a TCP byte stream into frames of Codec, see codec.h.
+ *
+ * Complete frames are handed out in place from the received buffer, only a
+ * partial frame at the end of a buffer is copied. On a bad frame start the
+ * stream is resynchronised on the next Codec::find_start().
+ */
+template<typename Codec>
+class BasicFrameAssembler
+{
+public:
+    explicit BasicFrameAssembler(const size_t _max_frame = Codec::MAX_FRAME): max_frame_(_max_frame) {}
+
+    /**
+     * First frame start in [_begin, _end), _end if none.
+     */
+    static const uint8_t* find_identifier(const uint8_t *_begin, const uint8_t *_end)
+    {
+        return Codec::find_start(_begin, _end);
+    }
+
+    /**
+     * Frame length from the header, 0 if the header isn't complete.
+     */
+    static size_t frame_length(const uint8_t *_buf, const size_t _size)
+    {
+        return Codec::frame_length(_buf, _size);
+    }
+
+    /**
+     * Feed received bytes, _on_frame(const uint8_t *_frame, size_t _size) is
+     * called for every complete frame.
+     */
+    template<typename F>
+    void feed(const void *_buf, const size_t _size, F &&_on_frame)
+    {
+        const uint8_t *buf = (const uint8_t*)_buf;
+        size_t size = _size;
+
+        // complete the pending frame first
+        while (!pending_.empty() && 0 < size)
+        {
+            size_t len = Codec::frame_length(pending_.data(), pending_.size());
+            bool invalid = len > max_frame_ || (0 == len && pending_.size() >= max_frame_);
+
+            // not a frame start after all, or the length isn't in a fixed
+            // header, e.g. delimited frames: frame the pending and the
+            // received bytes together
+            if (invalid || (0 == len && Codec::HEADER_LENGTH <= pending_.size()))
+            {
+                skipped_ += invalid;
+                joined_.assign(pending_.begin() + invalid, pending_.end());
+                joined_.insert(joined_.end(), buf, buf + size);
+                pending_.clear();
+                split(joined_.data(), joined_.size(), _on_frame);
+                return;
+            }
+
+            size_t need = 0 != len ? len - pending_.size() : Codec::HEADER_LENGTH - pending_.size();
+            size_t n = need < size ? need : size;
+
+            pending_.insert(pending_.end(), buf, buf + n);
+            buf += n;
+            size -= n;
+
+            if (pending_.size() == Codec::frame_length(pending_.data(), pending_.size()))
+            {
+                _on_frame((const uint8_t*)pending_.data(), pending_.size());
+                frames_++;
+                pending_.clear();
+            }
+        }
+
+        split(buf, size, _on_frame);
+    }
+
+    void reset()
+    {
+        pending_.clear();
+    }
+
+    size_t frames() const { return frames_; }
+
+    size_t skipped() const { return skipped_; }
+
+private:
+    /**
+     * Frames in place, the partial one at the end to pending_.
+     */
+    template<typename F>
+    void split(const uint8_t *_buf, const size_t _size, F &_on_frame)
+    {
+        const uint8_t *buf = _buf;
+        size_t size = _size;
+
+        while (0 < size)
+        {
+            size_t skip = Codec::find_start(buf, buf + size) - buf;
+
+            if (0 != skip)
+            {
+                skipped_ += skip;
+                buf += skip;
+                size -= skip;
+                continue;
+            }
+
+            size_t len = Codec::frame_length(buf, size);
+
+            if ((0 != len && len > max_frame_) || (0 == len && size >= max_frame_))
+            {
+                // not a frame start, resynchronise
+                skipped_++;
+                buf++;
+                size--;
+                continue;
+            }
+
+            if (0 == len || len > size)
+            {
+                pending_.assign(buf, buf + size);
+                break;
+            }
+
+            _on_frame(buf, len);
+            frames_++;
+            buf += len;
+            size -= len;
+        }
+    }
+
+    static constexpr const char *TAG = "protocol::FrameAssembler";
+
+    size_t max_frame_;
+    size_t frames_ = 0;
+    size_t skipped_ = 0;
+    std::vector<uint8_t> pending_;
+    std::vector<uint8_t> joined_;
+};
+
+typedef BasicFrameAssembler<Csae295Codec> FrameAssembler;
+} // namespace protocal
+
+#endif // __PROTOCOL_FRAME_ASSEMBLER_H__
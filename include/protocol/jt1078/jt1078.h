@@ -0,0 +1,189 @@
+#ifndef __PROTOCOL_JT1078_H__
+#define __PROTOCOL_JT1078_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+
+#include "codec.h"
+
+#define JT1078_MAGIC 0x30316364 // "01cd"
+
+namespace protocol
+{
+namespace jt1078
+{
+/**
+ * Payload types of Header::data_type.
+ */
+enum : uint8_t
+{
+    VIDEO_I     = 0x00,
+    VIDEO_P     = 0x01,
+    VIDEO_B     = 0x02,
+    AUDIO       = 0x03,
+    TRANSPARENT = 0x04,
+};
+
+/**
+ * Position of a packet in a media frame, Header::subpackage.
+ */
+enum : uint8_t
+{
+    ATOMIC = 0x00,
+    FIRST  = 0x01,
+    LAST   = 0x02,
+    MIDDLE = 0x03,
+};
+
+/**
+ * RTP like header of a JT/T 1078-2016 stream packet.
+ */
+struct Header
+{
+    uint8_t  flags = 0x81;       // V, P, X and CC
+    uint8_t  marker_type = 0;    // M and PT
+    uint16_t serial = 0;
+    uint8_t  sim[6] = {0};       // BCD
+    uint8_t  channel = 0;
+    uint8_t  data_type = 0;
+    uint8_t  subpackage = ATOMIC;
+    uint64_t timestamp = 0;      // ms, not with TRANSPARENT
+    uint16_t last_i_interval = 0; // ms, video only
+    uint16_t last_interval = 0;
+    uint16_t body_length = 0;
+
+    bool marker() const { return 0 != (marker_type & 0x80); }
+
+    uint8_t payload_type() const { return marker_type & 0x7F; }
+
+    bool video() const { return VIDEO_B >= data_type; }
+
+    /**
+     * Header bytes before the body.
+     */
+    size_t length() const { return header_length(data_type); }
+
+    static size_t header_length(const uint8_t _data_type)
+    {
+        return 16 + (TRANSPARENT != _data_type ? 8 : 0) + (VIDEO_B >= _data_type ? 4 : 0) + 2;
+    }
+};
+
+/**
+ * Receiver of stream packets. Methods are not virtual: a handler derives
+ * from it and hides the ones it needs, the codec calls them on the
+ * handler's own type. _body is valid only during the call.
+ */
+class Handler
+{
+public:
+    void on_packet(const Header &_header, const uint8_t *_body, const size_t _size) {}
+};
+
+/**
+ * JT/T 1078 stream codec, packets after the "01cd" magic with the body
+ * length in a header whose size depends on the data type, see codec.h.
+ * Packets are handed over one by one, a media frame split into FIRST,
+ * MIDDLE and LAST is joined by the handler.
+ */
+class Codec
+{
+public:
+    typedef jt1078::Header Header;
+    typedef jt1078::Handler Handler;
+
+    static constexpr const char *NAME = "jt1078";
+    static const size_t MAX_BODY = 950;
+    static const size_t HEADER_LENGTH = 16; // up to the data type
+    static const size_t MAX_FRAME = 30 + MAX_BODY;
+
+    /**
+     * Next '0' that begins the magic, or as much of it as _end leaves.
+     */
+    static const uint8_t* find_start(const uint8_t *_begin, const uint8_t *_end)
+    {
+        static const uint8_t magic[4] = {0x30, 0x31, 0x63, 0x64};
+
+        for (const uint8_t *p = find_byte(_begin, _end, magic[0]); p < _end; p = find_byte(p + 1, _end, magic[0]))
+        {
+            size_t n = (size_t)(_end - p) < sizeof(magic) ? _end - p : sizeof(magic);
+
+            if (0 == memcmp(p, magic, n))
+            {
+                return p;
+            }
+        }
+
+        return _end;
+    }
+
+    static size_t frame_length(const uint8_t *_buf, const size_t _size)
+    {
+        static const uint8_t magic[4] = {0x30, 0x31, 0x63, 0x64};
+        size_t n = _size < sizeof(magic) ? _size : sizeof(magic);
+
+        if (0 != memcmp(_buf, magic, n))
+        {
+            return INVALID_FRAME;
+        }
+
+        if (HEADER_LENGTH > _size)
+        {
+            return 0;
+        }
+
+        uint8_t data_type = _buf[15] >> 4;
+
+        if (TRANSPARENT < data_type)
+        {
+            return INVALID_FRAME;
+        }
+
+        size_t length = Header::header_length(data_type);
+
+        if (length > _size)
+        {
+            return 0;
+        }
+
+        size_t body = (size_t)(_buf[length - 2] << 8 | _buf[length - 1]);
+
+        return MAX_BODY < body ? INVALID_FRAME : length + body;
+    }
+
+    static bool decode_header(const uint8_t *_frame, const size_t _size, Header &_header);
+
+    /**
+     * Packet of _header and _body into _buf, _header.body_length is taken
+     * from _size.
+     *
+     * @return packet size, 0 if _buf is too small or _size above MAX_BODY
+     */
+    static size_t pack(const Header &_header, const uint8_t *_body, const size_t _size, uint8_t *_buf, const size_t _buf_size);
+
+    static std::shared_ptr<MessageBuffer> pack(const Header &_header, const uint8_t *_body, const size_t _size);
+
+    template<typename H>
+    size_t dispatch(const uint8_t *_frame, const size_t _size, H &_handler)
+    {
+        Header header;
+
+        if (!decode_header(_frame, _size, header) || header.length() + header.body_length != _size)
+        {
+            return 0;
+        }
+
+        _handler.on_packet(header, _frame + header.length(), header.body_length);
+
+        return _size;
+    }
+
+private:
+    static constexpr const char *TAG = "protocol::jt1078::Codec";
+};
+} // namespace jt1078
+} // namespace protocal
+
+#endif // __PROTOCOL_JT1078_H__
@@ -0,0 +1,258 @@
+#ifndef __PROTOCOL_JT808_H__
+#define __PROTOCOL_JT808_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+
+#include "codec.h"
+
+#define JT808_FLAG   0x7E
+#define JT808_ESCAPE 0x7D
+
+namespace protocol
+{
+namespace jt808
+{
+/**
+ * Message ids.
+ */
+enum : uint16_t
+{
+    TERMINAL_RESPONSE  = 0x0001,
+    TERMINAL_HEARTBEAT = 0x0002,
+    REGISTER           = 0x0100,
+    AUTHENTICATE       = 0x0102,
+    LOCATION_REPORT    = 0x0200,
+    PLATFORM_RESPONSE  = 0x8001,
+    REGISTER_RESPONSE  = 0x8100,
+};
+
+/**
+ * Message header, JT/T 808-2013 or, with VERSION_FLAG set, 808-2019.
+ */
+struct Header
+{
+    static const uint16_t LENGTH_MASK     = 0x03FF;
+    static const uint16_t SUBPACKAGE_FLAG = 0x2000;
+    static const uint16_t VERSION_FLAG    = 0x4000;
+
+    uint16_t id = 0;
+    uint16_t attr = 0;      // body length, encryption, subpackage and version flags
+    uint8_t  version = 0;   // 2019 only
+    uint8_t  phone[10] = {0}; // BCD, 6 bytes in 2013 and 10 in 2019
+    uint16_t serial = 0;
+    uint16_t packets = 0;   // subpackaged only
+    uint16_t packet = 0;
+
+    uint16_t body_length() const { return attr & LENGTH_MASK; }
+
+    uint8_t encryption() const { return (attr >> 10) & 0x07; }
+
+    bool subpackaged() const { return 0 != (attr & SUBPACKAGE_FLAG); }
+
+    bool v2019() const { return 0 != (attr & VERSION_FLAG); }
+
+    size_t phone_length() const { return v2019() ? 10 : 6; }
+
+    /**
+     * Header bytes before the body, unescaped.
+     */
+    size_t length() const { return 4 + (v2019() ? 11 : 6) + 2 + (subpackaged() ? 4 : 0); }
+};
+
+/**
+ * LOCATION_REPORT basic information, the additional items are left in the
+ * body.
+ */
+struct Location
+{
+    static const size_t LENGTH = 28;
+
+    uint32_t alarm = 0;
+    uint32_t status = 0;
+    uint32_t latitude = 0;  // 1e-6 degree
+    uint32_t longitude = 0;
+    uint16_t altitude = 0;  // m
+    uint16_t speed = 0;     // 0.1 km/h
+    uint16_t direction = 0; // degree
+    uint8_t  time[6] = {0}; // BCD YYMMDDhhmmss, GMT+8
+};
+
+/**
+ * PLATFORM_RESPONSE and TERMINAL_RESPONSE.
+ */
+struct GeneralResponse
+{
+    static const size_t LENGTH = 5;
+
+    uint16_t serial = 0; // of the answered message
+    uint16_t id = 0;
+    uint8_t  result = 0;
+};
+
+/**
+ * Receiver of decoded messages. Methods are not virtual: a handler derives
+ * from it and hides the ones it needs, the codec calls them on the
+ * handler's own type. _body is unescaped and valid only during the call.
+ */
+class Handler
+{
+public:
+    /**
+     * Every message, before the typed method.
+     */
+    void on_message(const Header &_header, const uint8_t *_body, const size_t _size) {}
+
+    void on_heartbeat(const Header &_header) {}
+
+    void on_location(const Header &_header, const Location &_msg, const uint8_t *_items, const size_t _size) {}
+
+    void on_response(const Header &_header, const GeneralResponse &_msg) {}
+};
+
+/**
+ * JT/T 808 codec, frames between 0x7E flags with 0x7E and 0x7D escaped,
+ * see codec.h.
+ */
+class Codec
+{
+public:
+    typedef jt808::Header Header;
+    typedef jt808::Handler Handler;
+
+    static constexpr const char *NAME = "jt808";
+    static const size_t MAX_BODY = Header::LENGTH_MASK;
+    static const size_t MAX_MESSAGE = 4 + 11 + 2 + 4 + MAX_BODY + 1; // header, body and check code
+    static const size_t HEADER_LENGTH = 1 + 4 + 6 + 2 + 1 + 1;       // shortest frame
+    static const size_t MAX_FRAME = 2 + 2 * MAX_MESSAGE;
+
+    static const uint8_t* find_start(const uint8_t *_begin, const uint8_t *_end)
+    {
+        return find_byte(_begin, _end, JT808_FLAG);
+    }
+
+    /**
+     * Up to the closing flag, two adjacent flags are an end and a start.
+     */
+    static size_t frame_length(const uint8_t *_buf, const size_t _size)
+    {
+        if (0 == _size)
+        {
+            return 0;
+        }
+
+        if (JT808_FLAG != _buf[0])
+        {
+            return INVALID_FRAME;
+        }
+
+        const uint8_t *end = find_byte(_buf + 1, _buf + _size, JT808_FLAG);
+
+        if (_buf + _size == end)
+        {
+            return 0;
+        }
+
+        size_t len = end - _buf + 1;
+
+        return HEADER_LENGTH > len ? INVALID_FRAME : len;
+    }
+
+    static bool decode_header(const uint8_t *_frame, const size_t _size, Header &_header);
+
+    /**
+     * Unescape and check a frame into _msg of at least MAX_MESSAGE bytes.
+     *
+     * @return body offset in _msg, 0 if the frame is malformed
+     */
+    static size_t decode(const uint8_t *_frame, const size_t _size, Header &_header, uint8_t *_msg, size_t &_body_size);
+
+    /**
+     * Frame of _header and _body into _buf, the body length bits of
+     * _header.attr are taken from _size.
+     *
+     * @return frame size, 0 if _buf is too small or _size above MAX_BODY
+     */
+    static size_t pack(const Header &_header, const uint8_t *_body, const size_t _size, uint8_t *_buf, const size_t _buf_size);
+
+    static std::shared_ptr<MessageBuffer> pack(const Header &_header, const uint8_t *_body, const size_t _size);
+
+    static size_t encode(const Location &_msg, uint8_t *_buf, const size_t _size);
+
+    static bool decode(const uint8_t *_buf, const size_t _size, Location &_msg);
+
+    static size_t encode(const GeneralResponse &_msg, uint8_t *_buf, const size_t _size);
+
+    static bool decode(const uint8_t *_buf, const size_t _size, GeneralResponse &_msg);
+
+    template<typename H>
+    size_t dispatch(const uint8_t *_frame, const size_t _size, H &_handler)
+    {
+        Header header;
+        size_t body_size = 0;
+        size_t offset = decode(_frame, _size, header, msg_, body_size);
+
+        if (0 == offset)
+        {
+            return 0;
+        }
+
+        const uint8_t *body = msg_ + offset;
+
+        _handler.on_message(header, body, body_size);
+
+        // a subpackage carries a part of the body only
+        if (header.subpackaged() && 1 < header.packets)
+        {
+            return _size;
+        }
+
+        switch (header.id)
+        {
+        case TERMINAL_HEARTBEAT:
+            _handler.on_heartbeat(header);
+            break;
+
+        case LOCATION_REPORT:
+        {
+            Location msg;
+
+            if (decode(body, body_size, msg))
+            {
+                _handler.on_location(header, msg, body + Location::LENGTH, body_size - Location::LENGTH);
+            }
+
+            break;
+        }
+
+        case TERMINAL_RESPONSE:
+        case PLATFORM_RESPONSE:
+        {
+            GeneralResponse msg;
+
+            if (decode(body, body_size, msg))
+            {
+                _handler.on_response(header, msg);
+            }
+
+            break;
+        }
+
+        default:
+            break;
+        }
+
+        return _size;
+    }
+
+private:
+    static constexpr const char *TAG = "protocol::jt808::Codec";
+
+    uint8_t msg_[MAX_MESSAGE]; // unescaped frame, per connection
+};
+} // namespace jt808
+} // namespace protocal
+
+#endif // __PROTOCOL_JT808_H__
@@ -94,7 +94,7 @@ struct MessageHeader
 
     uint8_t get_header_length() const
     {           
-        return sizeof(MessageHeader);
+        return HEADER_LENGTH;
     }
 
     uint32_t get_data_length() const
@@ -185,16 +185,20 @@ struct MessageHeader
     }
 
     static constexpr const char *TAG = "protocol::MessageHeader";
+    static const uint8_t HEADER_LENGTH = 16; // bytes on the wire
 
     uint8_t  id_ = 0xF2;
-    uint32_t data_len_;
-    uint8_t  data_type_;
-    uint8_t  version_;
-    uint64_t timestamp_;
-    uint8_t  ctrl_;
+    uint32_t data_len_ = 0; // all 0 when decoded from a short buffer
+    uint8_t  data_type_ = 0;
+    uint8_t  version_ = 0;
+    uint64_t timestamp_ = 0;
+    uint8_t  ctrl_ = 0;
 };
 
 #pragma pack()
+
+// the packed structs are the wire layout, only the codecs read them as such
+static_assert(MessageHeader::HEADER_LENGTH == sizeof(MessageHeader), "MessageHeader is not the wire header");
 } // namespace protocal
 
 #endif // __PROTOCOL_MESSAGE_H__
@@ -1,6 +1,8 @@
 #ifndef __PROTOCOL_VEH2CLOUD_INH_H__
 #define __PROTOCOL_VEH2CLOUD_INH_H__
 
+#include <algorithm>
+
 #include "message.h"
 
 #define COMM_TYPE_4G      0 
@@ -46,13 +48,12 @@ struct Veh2CloudInh: public MessageHeader
         const uint8_t _time_sync,
         const uint8_t _gnss_type,
         const std::string &_user_data):
-            MessageHeader(
-                sizeof(Veh2CloudInh) - sizeof(MessageHeader) - sizeof(sw_ver_) - sizeof(hw_ver_) 
-                - sizeof(ad_ver_) - sizeof(user_data_), VEH2CLOUD_INH, _version, _timestamp, _ctrl), 
+            MessageHeader(DATA_LENGTH, VEH2CLOUD_INH, _version, _timestamp, _ctrl), 
             sw_ver_(_sw_ver), hw_ver_(_hw_ver), ad_ver_(_ad_ver), com_type_(_com_type), pos_confidence_(_pos_confidence), 
             time_sync_(_time_sync), gnss_type_(_gnss_type), user_data_(_user_data)
     {
-        strncpy(vehicle_id_, _vehicle_id.c_str(), sizeof(vehicle_id_));
+        // 8 bytes on the wire, not terminated when all are used
+        memcpy(vehicle_id_, _vehicle_id.data(), std::min(_vehicle_id.size(), sizeof(vehicle_id_)));
  
         sw_ver_len_ = _sw_ver.length() >= 0xFF ? 0 : _sw_ver.length();
         data_len_ += sw_ver_len_;
@@ -70,62 +71,35 @@ struct Veh2CloudInh: public MessageHeader
     Veh2CloudInh(const void *_buf, const size_t _size, const bool _big_endian = true): 
         MessageHeader(_buf, _size, _big_endian)
     {
-        size_t offset = get_header_length();
-
-        if (_size - offset < get_data_length())
+        if (get_header_length() > _size || !decode_data(_buf, _size, _big_endian))
         {
-            LOGE(TAG, "Veh2CloudInh: Invalid size %ld, offset %ld, data length %d!\n", _size, offset, get_data_length());
-            return;
+            reset();
         }
-        
-        char *buf = (char*)_buf;
-
-        memcpy(vehicle_id_, buf + offset, sizeof(vehicle_id_));
-        offset += sizeof(vehicle_id_);
+    }
 
-        sw_ver_len_ = *(uint8_t*)(buf + offset);
-        offset += sizeof(sw_ver_len_);
-        if (0 != sw_ver_len_ && 0xFF !=  sw_ver_len_)
+    /**
+     * Decode _buf over this message, the strings keep their capacity.
+     *
+     * @return false if _buf is not a complete frame, the message is then
+     *         reset rather than left with the fields of the previous one
+     */
+    bool decode(const void *_buf, const size_t _size, const bool _big_endian = true)
+    {
+        if (nullptr == _buf || get_header_length() > _size)
         {
-            sw_ver_ = std::string(buf + offset, sw_ver_len_);
-            offset += sw_ver_len_;
+            reset();
+            return false;
         }
 
-        hw_ver_len_ = *(uint8_t*)(buf + offset);
-        offset += sizeof(hw_ver_len_);
-        if (0 != hw_ver_len_ && 0xFF !=  hw_ver_len_)
-        {
-            hw_ver_ = std::string(buf + offset, hw_ver_len_);
-            offset += hw_ver_len_;
-        }
+        MessageHeader::operator=(MessageHeader(_buf, _size, _big_endian));
 
-        ad_ver_len_ = *(uint8_t*)(buf + offset);
-        offset += sizeof(ad_ver_len_);
-        if (0 != ad_ver_len_ && 0xFF !=  ad_ver_len_)
+        if (!decode_data(_buf, _size, _big_endian))
         {
-            ad_ver_ = std::string(buf + offset, ad_ver_len_);
-            offset += ad_ver_len_;
+            reset();
+            return false;
         }
 
-        com_type_ = *(uint8_t*)(buf + offset);
-        offset += sizeof(com_type_);
-
-        pos_confidence_ = *(uint8_t*)(buf + offset);
-        offset += sizeof(pos_confidence_);
-
-        time_sync_ = *(uint8_t*)(buf + offset);
-        offset += sizeof(time_sync_);
-
-        gnss_type_ = *(uint8_t*)(buf + offset);
-        offset += sizeof(gnss_type_);
-
-        user_data_len_ = *(uint8_t*)(buf + offset);
-        offset += sizeof(user_data_len_);
-        if (0 != user_data_len_ )
-        {
-            user_data_ = std::string(buf + offset, user_data_len_);
-            offset += user_data_len_;
-        }
+        return true;
     }
 
     size_t to_bytes(void *_buf, const size_t _size, const bool _big_endian = true) const
@@ -151,11 +125,11 @@ struct Veh2CloudInh: public MessageHeader
             offset += sw_ver_len_;
         }
 
-        *(uint8_t *)(buf + offset) = sw_ver_len_;
+        *(uint8_t *)(buf + offset) = hw_ver_len_;
         offset += sizeof(hw_ver_len_);
         if (0 != hw_ver_len_ && 0xFF !=  hw_ver_len_)
         {
-            memcpy(buf + offset, sw_ver_.c_str(), hw_ver_len_);
+            memcpy(buf + offset, hw_ver_.c_str(), hw_ver_len_);
             offset += hw_ver_len_;
         }
 
@@ -163,7 +137,7 @@ struct Veh2CloudInh: public MessageHeader
         offset += sizeof(ad_ver_len_);
         if (0 != ad_ver_len_ && 0xFF !=  ad_ver_len_)
         {
-            memcpy(buf + offset, sw_ver_.c_str(), ad_ver_len_);
+            memcpy(buf + offset, ad_ver_.c_str(), ad_ver_len_);
             offset += ad_ver_len_;
         }
 
@@ -285,7 +259,121 @@ struct Veh2CloudInh: public MessageHeader
         return os;
     }
 
+    void reset()
+    {
+        MessageHeader::operator=(MessageHeader(0, VEH2CLOUD_INH, 0, 0, 0));
+        memset(vehicle_id_, 0, sizeof(vehicle_id_));
+        sw_ver_len_ = hw_ver_len_ = ad_ver_len_ = user_data_len_ = 0;
+        com_type_ = pos_confidence_ = time_sync_ = gnss_type_ = 0;
+        sw_ver_.clear();
+        hw_ver_.clear();
+        ad_ver_.clear();
+        user_data_.clear();
+    }
+
+    bool decode_data(const void *_buf, const size_t _size, const bool _big_endian)
+    {
+        sw_ver_.clear();
+        hw_ver_.clear();
+        ad_ver_.clear();
+        user_data_.clear();
+
+        size_t offset = get_header_length();
+
+        if (nullptr == _buf || _size < offset || _size - offset < get_data_length() || _size - offset < DATA_LENGTH)
+        {
+            LOGE(TAG, "Veh2CloudInh: Invalid size %ld, offset %ld, data length %d!\n", _size, offset, get_data_length());
+            return false;
+        }
+        
+        char *buf = (char*)_buf;
+        size_t end = offset + get_data_length();
+        size_t need = offset + DATA_LENGTH; // fixed fields, the strings are added as read
+
+        memcpy(vehicle_id_, buf + offset, sizeof(vehicle_id_));
+        offset += sizeof(vehicle_id_);
+
+        sw_ver_len_ = *(uint8_t*)(buf + offset);
+        offset += sizeof(sw_ver_len_);
+        if (0 != sw_ver_len_ && 0xFF !=  sw_ver_len_)
+        {
+            need += sw_ver_len_;
+
+            if (need > end)
+            {
+                LOGE(TAG, "Veh2CloudInh: sw_ver length %d past data length %d!\n", sw_ver_len_, get_data_length());
+                return false;
+            }
+
+            sw_ver_.assign(buf + offset, sw_ver_len_);
+            offset += sw_ver_len_;
+        }
+
+        hw_ver_len_ = *(uint8_t*)(buf + offset);
+        offset += sizeof(hw_ver_len_);
+        if (0 != hw_ver_len_ && 0xFF !=  hw_ver_len_)
+        {
+            need += hw_ver_len_;
+
+            if (need > end)
+            {
+                LOGE(TAG, "Veh2CloudInh: hw_ver length %d past data length %d!\n", hw_ver_len_, get_data_length());
+                return false;
+            }
+
+            hw_ver_.assign(buf + offset, hw_ver_len_);
+            offset += hw_ver_len_;
+        }
+
+        ad_ver_len_ = *(uint8_t*)(buf + offset);
+        offset += sizeof(ad_ver_len_);
+        if (0 != ad_ver_len_ && 0xFF !=  ad_ver_len_)
+        {
+            need += ad_ver_len_;
+
+            if (need > end)
+            {
+                LOGE(TAG, "Veh2CloudInh: ad_ver length %d past data length %d!\n", ad_ver_len_, get_data_length());
+                return false;
+            }
+
+            ad_ver_.assign(buf + offset, ad_ver_len_);
+            offset += ad_ver_len_;
+        }
+
+        com_type_ = *(uint8_t*)(buf + offset);
+        offset += sizeof(com_type_);
+
+        pos_confidence_ = *(uint8_t*)(buf + offset);
+        offset += sizeof(pos_confidence_);
+
+        time_sync_ = *(uint8_t*)(buf + offset);
+        offset += sizeof(time_sync_);
+
+        gnss_type_ = *(uint8_t*)(buf + offset);
+        offset += sizeof(gnss_type_);
+
+        user_data_len_ = *(uint8_t*)(buf + offset);
+        offset += sizeof(user_data_len_);
+        if (0 != user_data_len_ )
+        {
+            need += user_data_len_;
+
+            if (need > end)
+            {
+                LOGE(TAG, "Veh2CloudInh: user_data length %d past data length %d!\n", user_data_len_, get_data_length());
+                return false;
+            }
+
+            user_data_.assign(buf + offset, user_data_len_);
+            offset += user_data_len_;
+        }
+
+        return true;
+    }
+
     static constexpr const char *TAG = "protocol::Veh2CloudInh";
+    static const uint32_t DATA_LENGTH = 16; // bytes on the wire besides the strings
 
     char        vehicle_id_[8] = "";
     uint8_t     sw_ver_len_;
@@ -313,10 +401,10 @@ struct Cloud2VehInhRes: public MessageHeader
         const uint8_t  _ctrl, 
         const std::string &_vehicle_id,
         const uint8_t _res):
-            MessageHeader(sizeof(Cloud2VehInhRes) - sizeof(MessageHeader), 
-            CLOUD2VEH_INH_RES, _version, _timestamp, _ctrl), res_(_res)
+            MessageHeader(DATA_LENGTH, CLOUD2VEH_INH_RES, _version, _timestamp, _ctrl), res_(_res)
     {
-        strncpy(vehicle_id_, _vehicle_id.c_str(), sizeof(vehicle_id_));
+        // 8 bytes on the wire, not terminated when all are used
+        memcpy(vehicle_id_, _vehicle_id.data(), std::min(_vehicle_id.size(), sizeof(vehicle_id_)));
     }
 
     Cloud2VehInhRes(const void *_buf, const size_t _size, const bool _big_endian = true): 
@@ -385,11 +473,17 @@ struct Cloud2VehInhRes: public MessageHeader
     }
 
     static constexpr const char *TAG = "protocol::Cloud2VehInhRes";
+    static const uint32_t DATA_LENGTH = 9; // bytes on the wire
 
-    char        vehicle_id_[8];
+    char        vehicle_id_[8] = "";
     uint8_t     res_;
 };
 #pragma pack()
+
+static_assert(MessageHeader::HEADER_LENGTH + Veh2CloudInh::DATA_LENGTH
+    == sizeof(Veh2CloudInh) - 4 * sizeof(std::string), "Veh2CloudInh is not the wire layout");
+static_assert(MessageHeader::HEADER_LENGTH + Cloud2VehInhRes::DATA_LENGTH
+    == sizeof(Cloud2VehInhRes), "Cloud2VehInhRes is not the wire layout");
 } // namespace protocal
 
 #endif // __PROTOCOL_VEH2CLOUD_INH_H__
\ No newline at end of file
@@ -77,13 +77,14 @@ struct Veh2CloudState: public MessageHeader
         const uint8_t _drive_mode,
         const Position2D &_dest_location,
         const std::vector<Position2D> &_pass_pos):
-            MessageHeader(sizeof(Veh2CloudState) - sizeof(MessageHeader) - sizeof(pass_pos_) + _pass_pos.size(), VEH2CLOUD_STATE, _version, _timestamp, _ctrl), 
+            MessageHeader(DATA_LENGTH + _pass_pos.size() * sizeof(Position2D), VEH2CLOUD_STATE, _version, _timestamp, _ctrl), 
             gnss_timestamp_(_gnss_timestamp), gnss_velocity_(_gnss_velocity), position_(_position), heading_(_heading), gear_(_gear), 
             steering_angle_(_steering_angle), velocity_(_velocity), acc_lon_(_acc_lon), acc_lat_(_acc_lat), acc_ver_(_acc_ver), yaw_rate_(_yaw_rate), accel_pos_(_accel_pos), 
             engine_speed_(_engine_speed), engine_torque_(_engine_torque), break_flag_(_break_flag), break_pos_(_break_pos), break_pressure_(_break_pressure), 
             fuel_consume_(_fuel_consume), drive_mode_(_drive_mode), dest_location_(_dest_location), pass_pos_num_(_pass_pos.size()), pass_pos_(_pass_pos)
     {
-        strncpy(vehicle_id_, _vehicle_id.c_str(), sizeof(vehicle_id_));
+        // 8 bytes on the wire, not terminated when all are used
+        memcpy(vehicle_id_, _vehicle_id.data(), std::min(_vehicle_id.size(), sizeof(vehicle_id_)));
 
         size_t n = sizeof(message_id_) <= _message_id.size() ? sizeof(message_id_) : _message_id.size();
         memcpy(message_id_, _message_id.data(), n);
@@ -92,111 +93,35 @@ struct Veh2CloudState: public MessageHeader
     Veh2CloudState(const void *_buf, const size_t _size, const bool _big_endian = true): 
         MessageHeader(_buf, _size, _big_endian)
     {
-        size_t offset = get_header_length();
-
-        if (_size - offset < get_data_length())
+        if (get_header_length() > _size || !decode_data(_buf, _size, _big_endian))
         {
-            LOGE(TAG, "Veh2CloudState: Invalid size %ld, offset %ld, data length %d!\n", _size, offset, get_data_length());
-            return;
+            reset();
         }
-        
-        char *buf = (char*)_buf;
-
-        memcpy(vehicle_id_, buf + offset, sizeof(vehicle_id_));
-        offset += sizeof(vehicle_id_);
+    }
 
-        std::vector<uint8_t> v(buf + offset, buf + offset + sizeof(message_id_));
-        if (_big_endian)
+    /**
+     * Decode _buf over this message, pass_pos_ keeps its capacity.
+     *
+     * @return false if _buf is not a complete frame, the message is then
+     *         reset rather than left with the fields of the previous one
+     */
+    bool decode(const void *_buf, const size_t _size, const bool _big_endian = true)
+    {
+        if (nullptr == _buf || get_header_length() > _size)
         {
-            std::reverse(v.begin(), v.end());
+            reset();
+            return false;
         }
-        memcpy(message_id_, v.data(), sizeof(message_id_));
-        offset += sizeof(message_id_);
 
-        gnss_timestamp_ = _big_endian ? __builtin_bswap64(*(uint64_t*)(buf + offset)) : *(uint64_t*)(buf + offset);
-        offset += sizeof(gnss_timestamp_);
+        MessageHeader::operator=(MessageHeader(_buf, _size, _big_endian));
 
-        gnss_velocity_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
-        offset += sizeof(gnss_velocity_);
-
-        position_.longitude = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
-        offset += sizeof(position_.longitude);
-
-        position_.latitude = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
-        offset += sizeof(position_.latitude);
-
-        position_.elevation = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
-        offset += sizeof(position_.elevation);
-
-        heading_ = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
-        offset += sizeof(heading_);
-
-        gear_ = *(uint8_t*)(buf + offset);
-        offset += sizeof(gear_);
-
-        steering_angle_ = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
-        offset += sizeof(steering_angle_);
-
-        velocity_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
-        offset += sizeof(velocity_);
-
-        acc_lon_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
-        offset += sizeof(acc_lon_);
-
-        acc_lat_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
-        offset += sizeof(acc_lat_);
-
-        acc_ver_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
-        offset += sizeof(acc_ver_);
-    
-        yaw_rate_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
-        offset += sizeof(yaw_rate_);
-
-        accel_pos_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
-        offset += sizeof(accel_pos_);
-
-        engine_speed_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
-        offset += sizeof(engine_speed_);
-
-        engine_torque_ = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
-        offset += sizeof(engine_torque_);
-
-        break_flag_ = *(uint8_t*)(buf + offset);
-        offset += sizeof(break_flag_);
-
-        break_pos_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
-        offset += sizeof(break_pos_);
-
-        break_pressure_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
-        offset += sizeof(break_pressure_);
-
-        fuel_consume_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
-        offset += sizeof(fuel_consume_);
-
-        drive_mode_ = *(uint8_t*)(buf + offset);
-        offset += sizeof(drive_mode_);
-
-        dest_location_.longitude = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
-        offset += sizeof(dest_location_.longitude);
-
-        dest_location_.latitude = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
-        offset += sizeof(dest_location_.latitude);
-
-        pass_pos_num_ = *(uint8_t*)(buf + offset);
-        offset += sizeof(pass_pos_num_);
-
-        for (size_t i = 0; i < pass_pos_num_; i++)
+        if (!decode_data(_buf, _size, _big_endian))
         {
-            Position2D pos;
-
-            pos.longitude = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
-            offset += sizeof(pos.longitude);
-
-            pos.latitude = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
-            offset += sizeof(pos.latitude);
-
-            pass_pos_.emplace_back(pos);
+            reset();
+            return false;
         }
+
+        return true;
     }
 
     size_t to_bytes(void *_buf, const size_t _size, const bool _big_endian = true) const
@@ -466,7 +391,140 @@ struct Veh2CloudState: public MessageHeader
         return os;
     }
 
+    /**
+     * Zero header and data, the wire fields after the header are
+     * contiguous in the packed layout.
+     */
+    void reset()
+    {
+        MessageHeader::operator=(MessageHeader(0, VEH2CLOUD_STATE, 0, 0, 0));
+        memset(vehicle_id_, 0, DATA_LENGTH);
+        pass_pos_.clear();
+    }
+
+    bool decode_data(const void *_buf, const size_t _size, const bool _big_endian)
+    {
+        size_t offset = get_header_length();
+
+        pass_pos_.clear();
+
+        if (nullptr == _buf || _size < offset || _size - offset < get_data_length() || _size - offset < DATA_LENGTH)
+        {
+            LOGE(TAG, "Veh2CloudState: Invalid size %ld, offset %ld, data length %d!\n", _size, offset, get_data_length());
+            return false;
+        }
+        
+        char *buf = (char*)_buf;
+
+        memcpy(vehicle_id_, buf + offset, sizeof(vehicle_id_));
+        offset += sizeof(vehicle_id_);
+
+        if (_big_endian)
+        {
+            std::reverse_copy(buf + offset, buf + offset + sizeof(message_id_), message_id_);
+        }
+        else
+        {
+            memcpy(message_id_, buf + offset, sizeof(message_id_));
+        }
+        offset += sizeof(message_id_);
+
+        gnss_timestamp_ = _big_endian ? __builtin_bswap64(*(uint64_t*)(buf + offset)) : *(uint64_t*)(buf + offset);
+        offset += sizeof(gnss_timestamp_);
+
+        gnss_velocity_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
+        offset += sizeof(gnss_velocity_);
+
+        position_.longitude = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
+        offset += sizeof(position_.longitude);
+
+        position_.latitude = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
+        offset += sizeof(position_.latitude);
+
+        position_.elevation = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
+        offset += sizeof(position_.elevation);
+
+        heading_ = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
+        offset += sizeof(heading_);
+
+        gear_ = *(uint8_t*)(buf + offset);
+        offset += sizeof(gear_);
+
+        steering_angle_ = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
+        offset += sizeof(steering_angle_);
+
+        velocity_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
+        offset += sizeof(velocity_);
+
+        acc_lon_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
+        offset += sizeof(acc_lon_);
+
+        acc_lat_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
+        offset += sizeof(acc_lat_);
+
+        acc_ver_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
+        offset += sizeof(acc_ver_);
+    
+        yaw_rate_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
+        offset += sizeof(yaw_rate_);
+
+        accel_pos_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
+        offset += sizeof(accel_pos_);
+
+        engine_speed_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
+        offset += sizeof(engine_speed_);
+
+        engine_torque_ = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
+        offset += sizeof(engine_torque_);
+
+        break_flag_ = *(uint8_t*)(buf + offset);
+        offset += sizeof(break_flag_);
+
+        break_pos_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
+        offset += sizeof(break_pos_);
+
+        break_pressure_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
+        offset += sizeof(break_pressure_);
+
+        fuel_consume_ = _big_endian ? __builtin_bswap16(*(uint16_t*)(buf + offset)) : *(uint16_t*)(buf + offset);
+        offset += sizeof(fuel_consume_);
+
+        drive_mode_ = *(uint8_t*)(buf + offset);
+        offset += sizeof(drive_mode_);
+
+        dest_location_.longitude = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
+        offset += sizeof(dest_location_.longitude);
+
+        dest_location_.latitude = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
+        offset += sizeof(dest_location_.latitude);
+
+        pass_pos_num_ = *(uint8_t*)(buf + offset);
+        offset += sizeof(pass_pos_num_);
+
+        if (_size - offset < pass_pos_num_ * sizeof(Position2D))
+        {
+            LOGE(TAG, "Veh2CloudState: Invalid size %ld, offset %ld, pass position number %d!\n", _size, offset, pass_pos_num_);
+            return false;
+        }
+
+        for (size_t i = 0; i < pass_pos_num_; i++)
+        {
+            Position2D pos;
+
+            pos.longitude = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
+            offset += sizeof(pos.longitude);
+
+            pos.latitude = _big_endian ? __builtin_bswap32(*(uint32_t*)(buf + offset)) : *(uint32_t*)(buf + offset);
+            offset += sizeof(pos.latitude);
+
+            pass_pos_.emplace_back(pos);
+        }
+
+        return true;
+    }
+
     static constexpr const char *TAG = "protocol::Veh2CloudState";
+    static const uint32_t DATA_LENGTH = 82; // bytes on the wire before pass_pos_
 
     char                    vehicle_id_[8] = "";
     uint8_t                 message_id_[8] = {0};
@@ -495,6 +553,10 @@ struct Veh2CloudState: public MessageHeader
 
 };
 #pragma pack()
+
+static_assert(12 == sizeof(Position) && 8 == sizeof(Position2D), "Position is not the wire layout");
+static_assert(MessageHeader::HEADER_LENGTH + Veh2CloudState::DATA_LENGTH
+    == sizeof(Veh2CloudState) - sizeof(std::vector<Position2D>), "Veh2CloudState is not the wire layout");
 } // namespace protocal
 
 #endif // __PROTOCOL_VEH2CLOUD_STATE_H__
\ No newline at end of file
@@ -0,0 +1,225 @@
+#ifndef __PROTOCOL_MESSAGE_POOL_H__
+#define __PROTOCOL_MESSAGE_POOL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace protocol
+{
+/**
+ * Recycler of decoded messages of one connection.
+ *
+ * acquire() decodes a frame over a message given back earlier, through
+ * T::decode(), so its vectors and strings keep their capacity and a frame
+ * allocates nothing once the pool holds as many messages as are in use.
+ * A Handle shares the message like a shared_ptr without allocating a
+ * control block, and the last one gives it back. Handles may be kept and
+ * dropped on any thread and outlive the pool; messages coming back after
+ * it is gone, or beyond the POOL kept, are deleted.
+ */
+template<typename T>
+class MessagePool
+{
+    struct Shared;
+
+    struct Node
+    {
+        Node(Shared *_shared, const void *_buf, const size_t _size): msg(_buf, _size), shared(_shared) {}
+
+        T msg;
+        std::atomic<uint32_t> refs{1};
+        Shared *shared;
+    };
+
+    // lives until the pool and every node of it are gone
+    struct Shared
+    {
+        std::mutex mutex;
+        std::vector<Node*> free;
+        size_t refs = 1; // the pool and the nodes out of it
+        bool closed = false;
+    };
+
+public:
+    /**
+     * Shared reference to a pooled message.
+     */
+    class Handle
+    {
+    public:
+        Handle() {}
+
+        Handle(const Handle &_other): node_(_other.node_)
+        {
+            if (nullptr != node_)
+            {
+                node_->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        Handle(Handle &&_other): node_(_other.node_)
+        {
+            _other.node_ = nullptr;
+        }
+
+        ~Handle()
+        {
+            reset();
+        }
+
+        Handle& operator=(Handle _other)
+        {
+            std::swap(node_, _other.node_);
+            return *this;
+        }
+
+        void reset()
+        {
+            if (nullptr != node_ && 1 == node_->refs.fetch_sub(1, std::memory_order_acq_rel))
+            {
+                MessagePool::recycle(node_);
+            }
+
+            node_ = nullptr;
+        }
+
+        T* get() const { return nullptr != node_ ? &node_->msg : nullptr; }
+
+        T& operator*() const { return node_->msg; }
+
+        T* operator->() const { return &node_->msg; }
+
+        explicit operator bool() const { return nullptr != node_; }
+
+    private:
+        friend class MessagePool;
+
+        explicit Handle(Node *_node): node_(_node) {}
+
+        Node *node_ = nullptr;
+    };
+
+    static const size_t POOL = 64; // messages kept for reuse
+
+    MessagePool(): shared_(new Shared()) {}
+
+    MessagePool(const MessagePool&) = delete;
+
+    MessagePool& operator=(const MessagePool&) = delete;
+
+    ~MessagePool()
+    {
+        std::vector<Node*> free;
+        bool last = false;
+
+        {
+            std::lock_guard<std::mutex> lock(shared_->mutex);
+
+            shared_->closed = true;
+            free.swap(shared_->free);
+            shared_->refs -= free.size();
+            last = 0 == --shared_->refs;
+        }
+
+        for (auto n : free)
+        {
+            delete n;
+        }
+
+        if (last)
+        {
+            delete shared_;
+        }
+    }
+
+    /**
+     * Decode _buf into a recycled message, or a new one if none is free.
+     *
+     * @return empty if _buf failed to decode, the message goes back to
+     *         the pool
+     */
+    Handle acquire(const void *_buf, const size_t _size)
+    {
+        Node *node = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(shared_->mutex);
+
+            if (!shared_->free.empty())
+            {
+                node = shared_->free.back();
+                shared_->free.pop_back();
+            }
+            else
+            {
+                shared_->refs++;
+            }
+        }
+
+        if (nullptr == node)
+        {
+            // the buffer constructors reset what they cannot decode, and no
+            // frame of T comes with empty data
+            Handle handle(new Node(shared_, _buf, _size));
+            return 0 == handle->get_data_length() ? Handle() : handle;
+        }
+
+        node->refs.store(1, std::memory_order_relaxed);
+        Handle handle(node);
+
+        if (!node->msg.decode(_buf, _size))
+        {
+            return Handle();
+        }
+
+        return handle;
+    }
+
+    /**
+     * Messages waiting for reuse.
+     */
+    size_t idle() const
+    {
+        std::lock_guard<std::mutex> lock(shared_->mutex);
+        return shared_->free.size();
+    }
+
+private:
+    static void recycle(Node *_node)
+    {
+        Shared *shared = _node->shared;
+        bool last = false;
+
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+
+            if (!shared->closed && POOL > shared->free.size())
+            {
+                shared->free.push_back(_node);
+                return;
+            }
+
+            last = 0 == --shared->refs;
+        }
+
+        delete _node;
+
+        if (last)
+        {
+            delete shared;
+        }
+    }
+
+    Shared *shared_;
+};
+
+template<typename T>
+using Pooled = typename MessagePool<T>::Handle;
+} // namespace protocol
+
+#endif // __PROTOCOL_MESSAGE_POOL_H__
@@ -8,6 +8,9 @@
 
 #include "veh2cloud_inh.h"
 #include "veh2cloud_state.h"
+#include "message_pool.h"
+#include "metrics.h"
+#include "csae295.h"
 
 namespace protocol
 {
@@ -19,8 +22,11 @@ class Packer
 public:
     /**
      * Packer handler.
+     *
+     * Data types without a hand-written codec arrive through the
+     * data::Handler methods of the generated codecs.
      */
-    class Handler
+    class Handler : public data::Handler
     {
     public:
         virtual ~Handler() {}
@@ -32,6 +38,23 @@ public:
         virtual void on_unpack(const Cloud2VehInhRes &_msg) {}
 
         virtual void on_unpack(const Veh2CloudState &_msg) {}
+
+        /**
+         * From unpack() with pools, _msg may be kept beyond the call.
+         */
+        virtual void on_unpack(const Pooled<Veh2CloudInh> &_msg) { on_unpack(*_msg); }
+
+        virtual void on_unpack(const Pooled<Veh2CloudState> &_msg) { on_unpack(*_msg); }
+    };
+
+    /**
+     * Recyclers of the decoded messages that own heap memory, one per
+     * connection.
+     */
+    struct Pools
+    {
+        MessagePool<Veh2CloudInh>   inh;
+        MessagePool<Veh2CloudState> state;
     };
 
     template<typename T , typename std::enable_if<std::is_base_of<MessageHeader, T>::value>::type* = nullptr>
@@ -51,12 +74,30 @@ public:
         p->size = size;
         memcpy(p->data, v.data(), size);
 
+        static Counter &frames = Metrics::instance().counter("csae_packed_frames_total", "Frames packed.");
+        static Counter &bytes = Metrics::instance().counter("csae_packed_bytes_total", "Bytes packed.");
+        frames.add();
+        bytes.add(size);
+
         return p;
     }
 
+    /**
+     * Decode a frame and hand it to _handler. Frames shorter than their
+     * header or data, or whose data does not fit them, are dropped and
+     * counted, with or without pools.
+     */
     static void unpack(const void *_buf, const size_t _size, Handler &_handler);
 
+    /**
+     * Decode Veh2CloudInh and Veh2CloudState into messages of _pools and
+     * hand them over as Pooled handles.
+     */
+    static void unpack(const void *_buf, const size_t _size, Handler &_handler, Pools &_pools);
+
 private:
+    static void unpack(const void *_buf, const size_t _size, Handler &_handler, Pools *_pools);
+
     static constexpr const char *TAG = "protocol::Packer";
 };
 } // namespace protocal
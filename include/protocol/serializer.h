@@ -0,0 +1,161 @@
+#ifndef __PROTOCOL_SERIALIZER_H__
+#define __PROTOCOL_SERIALIZER_H__
+
+#include <stdlib.h>
+
+#include "veh2cloud_inh.h"
+#include "veh2cloud_state.h"
+
+namespace protocol
+{
+/**
+ * Growing byte buffer for text output, keeps its capacity across clear().
+ */
+class TextBuffer
+{
+public:
+    explicit TextBuffer(const size_t _capacity = 4096);
+
+    ~TextBuffer();
+
+    TextBuffer(const TextBuffer&) = delete;
+
+    TextBuffer& operator=(const TextBuffer&) = delete;
+
+    const char* data() const { return data_; }
+
+    size_t size() const { return size_; }
+
+    size_t capacity() const { return capacity_; }
+
+    void clear() { size_ = 0; }
+
+    /**
+     * Make room for _n more bytes and return the write position.
+     */
+    char* reserve(const size_t _n)
+    {
+        if (__builtin_expect(size_ + _n > capacity_, 0))
+        {
+            grow(size_ + _n);
+        }
+
+        return data_ + size_;
+    }
+
+    void commit(const size_t _n) { size_ += _n; }
+
+    void append(const char _c)
+    {
+        *reserve(1) = _c;
+        size_++;
+    }
+
+    void append(const char *_s, const size_t _n)
+    {
+        memcpy(reserve(_n), _s, _n);
+        size_ += _n;
+    }
+
+    template<size_t N>
+    void append_literal(const char (&_s)[N])
+    {
+        append(_s, N - 1);
+    }
+
+    /**
+     * Decimal conversion, two digits per table lookup.
+     */
+    void append_uint(uint64_t _value)
+    {
+        static const char digits[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+
+        size_t n = count_digits(_value);
+        char *p = reserve(20) + n;
+
+        size_ += n;
+
+        while (_value >= 100)
+        {
+            size_t i = (_value % 100) * 2;
+            _value /= 100;
+            *--p = digits[i + 1];
+            *--p = digits[i];
+        }
+
+        if (_value >= 10)
+        {
+            size_t i = _value * 2;
+            *--p = digits[i + 1];
+            *--p = digits[i];
+        }
+        else
+        {
+            *--p = (char)('0' + _value);
+        }
+    }
+
+    void append_hex(const void *_bytes, const size_t _size, const bool _reverse = false);
+
+private:
+    static size_t count_digits(uint64_t _value)
+    {
+        size_t n = 1;
+
+        for (;;)
+        {
+            if (_value < 10) return n;
+            if (_value < 100) return n + 1;
+            if (_value < 1000) return n + 2;
+            if (_value < 10000) return n + 3;
+            _value /= 10000;
+            n += 4;
+        }
+    }
+
+    void grow(const size_t _min);
+
+    static constexpr const char *TAG = "protocol::TextBuffer";
+
+    char  *data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+};
+
+/**
+ * JSON lines serializer, one object and a trailing '\n' per message.
+ */
+class JsonSerializer
+{
+public:
+    static void write(TextBuffer &_buf, const MessageHeader &_msg);
+
+    static void write(TextBuffer &_buf, const Veh2CloudInh &_msg);
+
+    static void write(TextBuffer &_buf, const Cloud2VehInhRes &_msg);
+
+    static void write(TextBuffer &_buf, const Veh2CloudState &_msg);
+};
+
+/**
+ * CSV serializer, one row per message, columns fixed per data type.
+ */
+class CsvSerializer
+{
+public:
+    static void write_header(TextBuffer &_buf, const uint8_t _data_type);
+
+    static void write(TextBuffer &_buf, const MessageHeader &_msg);
+
+    static void write(TextBuffer &_buf, const Veh2CloudInh &_msg);
+
+    static void write(TextBuffer &_buf, const Cloud2VehInhRes &_msg);
+
+    static void write(TextBuffer &_buf, const Veh2CloudState &_msg);
+};
+} // namespace protocal
+
+#endif // __PROTOCOL_SERIALIZER_H__
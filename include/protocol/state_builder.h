@@ -0,0 +1,182 @@
+#ifndef __PROTOCOL_STATE_BUILDER_H__
+#define __PROTOCOL_STATE_BUILDER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "veh2cloud_state.h"
+
+namespace protocol
+{
+/**
+ * Persistent VEH2CLOUD_STATE frame of one vehicle, edited in place.
+ *
+ * The frame is kept encoded, big-endian as Packer writes it, and each
+ * setter stores only its field at the fixed wire offset; only pass_pos()
+ * with a new point count moves the frame end and rewrites data_len_. So
+ * a new state costs the stores of what changed and build(), which copies
+ * the frame into a recycled MessageBuffer for the send queue. Not thread
+ * safe, one producer owns a builder, the buffers it built may be released
+ * on any thread and outlive it.
+ */
+class StateBuilder
+{
+public:
+    // wire offsets
+    static const size_t TIMESTAMP = 7;
+    static const size_t VEHICLE_ID = 16;
+    static const size_t MESSAGE_ID = 24;
+    static const size_t GNSS_TIMESTAMP = 32;
+    static const size_t GNSS_VELOCITY = 40;
+    static const size_t POSITION = 42;
+    static const size_t HEADING = 54;
+    static const size_t GEAR = 58;
+    static const size_t STEERING_ANGLE = 59;
+    static const size_t VELOCITY = 63;
+    static const size_t ACC = 65;          // lon, lat, ver
+    static const size_t YAW_RATE = 71;
+    static const size_t ACCEL_POS = 73;
+    static const size_t ENGINE_SPEED = 75;
+    static const size_t ENGINE_TORQUE = 77;
+    static const size_t BREAK_FLAG = 81;
+    static const size_t BREAK_POS = 82;
+    static const size_t BREAK_PRESSURE = 84;
+    static const size_t FUEL_CONSUME = 86;
+    static const size_t DRIVE_MODE = 88;
+    static const size_t DEST_LOCATION = 89;
+    static const size_t PASS_POS_NUM = 97;
+    static const size_t PASS_POS = 98;
+    static const size_t MAX_PASS_POS = 255;
+    static const size_t MAX_SIZE = PASS_POS + MAX_PASS_POS * sizeof(Position2D);
+    static const size_t POOL = 64; // buffers kept for reuse
+
+    /**
+     * A frame of zeroed fields and no pass_pos_.
+     */
+    StateBuilder(const char _vehicle_id[], const uint8_t _version = 0x01, const uint8_t _ctrl = 0xFC);
+
+    /**
+     * Start from the fields of _msg.
+     */
+    explicit StateBuilder(const Veh2CloudState &_msg);
+
+    StateBuilder& timestamp(const uint64_t _timestamp) { return put64(TIMESTAMP, _timestamp); }
+
+    /**
+     * message_id_ as the integer its bytes encode, message_id_[0] lowest.
+     */
+    StateBuilder& message_id(const uint64_t _id) { return put64(MESSAGE_ID, _id); }
+
+    StateBuilder& gnss_timestamp(const uint64_t _timestamp) { return put64(GNSS_TIMESTAMP, _timestamp); }
+
+    StateBuilder& gnss_velocity(const uint16_t _velocity) { return put16(GNSS_VELOCITY, _velocity); }
+
+    StateBuilder& position(const Position &_position)
+    {
+        put32(POSITION, _position.longitude);
+        put32(POSITION + 4, _position.latitude);
+        return put32(POSITION + 8, _position.elevation);
+    }
+
+    StateBuilder& heading(const uint32_t _heading) { return put32(HEADING, _heading); }
+
+    StateBuilder& gear(const uint8_t _gear) { return put8(GEAR, _gear); }
+
+    StateBuilder& steering_angle(const uint32_t _angle) { return put32(STEERING_ANGLE, _angle); }
+
+    StateBuilder& velocity(const uint16_t _velocity) { return put16(VELOCITY, _velocity); }
+
+    StateBuilder& acc(const uint16_t _lon, const uint16_t _lat, const uint16_t _ver)
+    {
+        put16(ACC, _lon);
+        put16(ACC + 2, _lat);
+        return put16(ACC + 4, _ver);
+    }
+
+    StateBuilder& yaw_rate(const uint16_t _yaw_rate) { return put16(YAW_RATE, _yaw_rate); }
+
+    StateBuilder& accel_pos(const uint16_t _pos) { return put16(ACCEL_POS, _pos); }
+
+    StateBuilder& engine_speed(const uint16_t _speed) { return put16(ENGINE_SPEED, _speed); }
+
+    StateBuilder& engine_torque(const uint32_t _torque) { return put32(ENGINE_TORQUE, _torque); }
+
+    StateBuilder& break_flag(const uint8_t _flag) { return put8(BREAK_FLAG, _flag); }
+
+    StateBuilder& break_pos(const uint16_t _pos) { return put16(BREAK_POS, _pos); }
+
+    StateBuilder& break_pressure(const uint16_t _pressure) { return put16(BREAK_PRESSURE, _pressure); }
+
+    StateBuilder& fuel_consume(const uint16_t _fuel) { return put16(FUEL_CONSUME, _fuel); }
+
+    StateBuilder& drive_mode(const uint8_t _mode) { return put8(DRIVE_MODE, _mode); }
+
+    StateBuilder& dest_location(const Position2D &_location)
+    {
+        put32(DEST_LOCATION, _location.longitude);
+        return put32(DEST_LOCATION + 4, _location.latitude);
+    }
+
+    /**
+     * Up to MAX_PASS_POS points, the rest are dropped.
+     */
+    StateBuilder& pass_pos(const Position2D _points[], const size_t _count);
+
+    StateBuilder& pass_pos(const std::vector<Position2D> &_points) { return pass_pos(_points.data(), _points.size()); }
+
+    /**
+     * The frame as it stands, for the send queue.
+     */
+    std::shared_ptr<MessageBuffer> build();
+
+    const uint8_t* data() const { return frame_; }
+
+    size_t size() const { return size_; }
+
+private:
+    struct Pool
+    {
+        std::mutex mutex;
+        std::vector<MessageBuffer*> free;
+
+        ~Pool();
+    };
+
+    StateBuilder& put8(const size_t _offset, const uint8_t _v)
+    {
+        frame_[_offset] = _v;
+        return *this;
+    }
+
+    StateBuilder& put16(const size_t _offset, const uint16_t _v)
+    {
+        *(uint16_t*)(frame_ + _offset) = __builtin_bswap16(_v);
+        return *this;
+    }
+
+    StateBuilder& put32(const size_t _offset, const uint32_t _v)
+    {
+        *(uint32_t*)(frame_ + _offset) = __builtin_bswap32(_v);
+        return *this;
+    }
+
+    StateBuilder& put64(const size_t _offset, const uint64_t _v)
+    {
+        *(uint64_t*)(frame_ + _offset) = __builtin_bswap64(_v);
+        return *this;
+    }
+
+    uint8_t frame_[MAX_SIZE];
+    size_t size_ = PASS_POS;
+    std::shared_ptr<Pool> pool_;
+};
+
+static_assert(MessageHeader::HEADER_LENGTH + Veh2CloudState::DATA_LENGTH == StateBuilder::PASS_POS,
+    "StateBuilder offsets are not the wire layout");
+} // namespace protocol
+
+#endif // __PROTOCOL_STATE_BUILDER_H__
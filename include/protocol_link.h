@@ -0,0 +1,201 @@
+#ifndef __PROTOCOL_LINK_H__
+#define __PROTOCOL_LINK_H__
+
+#include <errno.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "frame_assembler.h"
+#include "block_queue.h"
+#include "socketlib.h"
+#include "metrics.h"
+#include "log.h"
+
+/**
+ * Connection of one protocol that Controller runs beside its CSAE links.
+ */
+class Link
+{
+public:
+    virtual ~Link() {}
+
+    virtual void start() = 0;
+
+    virtual void stop() = 0;
+};
+
+/**
+ * Client connection speaking Codec, see codec.h.
+ *
+ * A receive thread frames the stream with BasicFrameAssembler<Codec> and
+ * decodes it with a Codec of its own, a send thread writes the queued
+ * frames. Handler methods run on the receive thread and are resolved at
+ * compile time, only start() and stop() are virtual.
+ */
+template<typename Codec, typename H = typename Codec::Handler>
+class ProtocolLink : public Link
+{
+public:
+    ProtocolLink(const char _addr[], const uint32_t _port, H &_handler):
+        addr_(_addr), port_(_port), handler_(_handler)
+    {
+        std::string protocol = std::string("protocol=\"") + Codec::NAME + "\"";
+        const char *help = "Frames sent and received by protocol links.";
+
+        frames_[0] = &Metrics::instance().counter("csae_link_frames_total", help, (protocol + ",direction=\"tx\"").c_str());
+        frames_[1] = &Metrics::instance().counter("csae_link_frames_total", help, (protocol + ",direction=\"rx\"").c_str());
+        help = "Bytes sent and received by protocol links.";
+        bytes_[0] = &Metrics::instance().counter("csae_link_bytes_total", help, (protocol + ",direction=\"tx\"").c_str());
+        bytes_[1] = &Metrics::instance().counter("csae_link_bytes_total", help, (protocol + ",direction=\"rx\"").c_str());
+        rejected_ = &Metrics::instance().counter("csae_link_rejected_total", "Frames the codec rejected.", protocol.c_str());
+        send_errors_ = &Metrics::instance().counter("csae_link_send_errors_total", "Frames not fully written.", protocol.c_str());
+        send_queue_.set_metrics(&Metrics::instance().gauge("csae_link_send_queue_depth", "Frames waiting in the send queue.",
+            protocol.c_str()), nullptr);
+
+        sock_.set_connect_state_callback([](const socketlib::ConnectState _state, void *_param)
+        {
+            ((ProtocolLink*)_param)->connected_.store(socketlib::ConnectState::CONNECTED == _state, std::memory_order_release);
+        }, this);
+    }
+
+    ~ProtocolLink()
+    {
+        stop();
+    }
+
+    void start() override
+    {
+        if (!stopped_)
+        {
+            return;
+        }
+
+        stopped_ = false;
+        assembler_.reset();
+        sock_.open(addr_.c_str(), port_);
+
+        recv_thread_ = std::thread([this]()
+        {
+            this->recv_loop();
+        });
+
+        send_thread_ = std::thread([this]()
+        {
+            this->send_loop();
+        });
+    }
+
+    void stop() override
+    {
+        if (stopped_)
+        {
+            return;
+        }
+
+        stopped_ = true;
+
+        sock_.close();
+        recv_thread_.join();
+        send_queue_.notify();
+        send_thread_.join();
+        connected_.store(false, std::memory_order_release);
+    }
+
+    /**
+     * An encoded frame, e.g. from Codec::pack().
+     */
+    void send(const std::shared_ptr<protocol::MessageBuffer> &_frame)
+    {
+        send_queue_.put(_frame);
+    }
+
+    bool connected() const { return connected_.load(std::memory_order_acquire); }
+
+    Codec& codec() { return codec_; }
+
+    const protocol::BasicFrameAssembler<Codec>& assembler() const { return assembler_; }
+
+private:
+    void recv_loop()
+    {
+        uint8_t buf[4096] = {0};
+        ssize_t size = 0;
+
+        while (!stopped_)
+        {
+            size = sock_.recv(buf, sizeof(buf));
+
+            if (0 == size)
+            {
+                LOGW(TAG, "recv_loop: %s remote shutdown, exit!\n", Codec::NAME);
+                return;
+            }
+            else if (0 > size)
+            {
+                if (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno)
+                {
+                    continue;
+                }
+
+                LOGE(TAG, "recv_loop: %s receive error, exit!\n", Codec::NAME);
+                return;
+            }
+
+            assembler_.feed(buf, size, [this](const uint8_t *_frame, const size_t _size)
+            {
+                this->frames_[1]->add();
+                this->bytes_[1]->add(_size);
+
+                if (0 == this->codec_.dispatch(_frame, _size, this->handler_))
+                {
+                    this->rejected_->add();
+                }
+            });
+        }
+    }
+
+    void send_loop()
+    {
+        while (!stopped_)
+        {
+            auto p = send_queue_.take();
+
+            if (nullptr == p)
+            {
+                continue;
+            }
+
+            if ((ssize_t)p->size != sock_.send(p->data, p->size))
+            {
+                send_errors_->add();
+            }
+
+            frames_[0]->add();
+            bytes_[0]->add(p->size);
+            send_queue_.pull();
+        }
+    }
+
+    static constexpr const char *TAG = "ProtocolLink";
+
+    std::string addr_;
+    uint32_t port_;
+    H &handler_;
+    std::atomic<bool> stopped_{true};
+    std::atomic<bool> connected_{false};
+    socketlib::Client sock_;
+    std::thread recv_thread_;
+    std::thread send_thread_;
+    protocol::BasicFrameAssembler<Codec> assembler_;
+    Codec codec_;
+    BlockQueue<std::shared_ptr<protocol::MessageBuffer>> send_queue_;
+    Counter *frames_[2];  // tx, rx
+    Counter *bytes_[2];
+    Counter *rejected_;
+    Counter *send_errors_;
+};
+
+#endif // __PROTOCOL_LINK_H__
@@ -0,0 +1,219 @@
+#ifndef __RECORDER_H__
+#define __RECORDER_H__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define RECORD_UP_TX   0
+#define RECORD_UP_RX   1
+#define RECORD_DOWN_TX 2
+#define RECORD_DOWN_RX 3
+
+#define RECORD_MAGIC         0x46525343 // "CSRF"
+#define RECORD_WRAP          0x50415257 // "WRAP", ring only
+#define RECORD_SEGMENT_MAGIC 0x3147455345415343ULL // "CSAESEG1"
+#define RECORD_INDEX_MAGIC   0x3158444945415343ULL // "CSAEIDX1"
+
+#define RECORD_INDEX_INTERVAL (64 << 10) // bytes of records per index entry
+
+#pragma pack(1)
+
+/**
+ * Segment file header.
+ */
+struct RecordSegmentHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t sequence;
+    uint64_t monotonic_base; // CLOCK_MONOTONIC ns at open
+    uint64_t realtime_base;  // CLOCK_REALTIME ns at open
+    uint8_t  reserved[32];
+};
+
+/**
+ * Record header, followed by the raw frame padded to 8 bytes.
+ */
+struct RecordHeader
+{
+    uint32_t magic;
+    uint32_t size;
+    uint64_t timestamp; // CLOCK_MONOTONIC ns
+    uint8_t  direction;
+    uint8_t  data_type;
+    uint8_t  reserved[6];
+    char     vehicle_id[8];
+};
+
+/**
+ * Sparse index entry, one per block of records.
+ */
+struct RecordIndexEntry
+{
+    uint64_t offset;
+    uint64_t first_timestamp;
+    uint64_t last_timestamp;
+    uint64_t vehicle_bloom;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+#pragma pack()
+
+/**
+ * Frame recorder.
+ *
+ * Every socket thread owns a single-producer ring, record() never blocks and
+ * drops the frame when the ring is full. close() waits for a record() in
+ * progress before freeing the rings. A writer thread drains the rings into
+ * preallocated mmap'd segment files and writes a sparse index of timestamp
+ * ranges and vehicle blooms beside each sealed segment.
+ */
+class FrameRecorder
+{
+public:
+    ~FrameRecorder();
+
+    int32_t open(const char _dir[], const char _prefix[] = "capture",
+        const size_t _segment_size = 64 << 20, const size_t _ring_size = 1 << 20);
+
+    void close();
+
+    bool is_open() const { return !stopped_.load(std::memory_order_acquire); }
+
+    /**
+     * Record a raw frame, called from the socket thread owning _direction.
+     */
+    bool record(const uint8_t _direction, const void *_buf, const size_t _size);
+
+    uint64_t recorded() const { return recorded_.load(std::memory_order_relaxed); }
+
+    uint64_t dropped() const;
+
+    static uint64_t now();
+
+    static uint64_t vehicle_bloom(const char _vehicle_id[8]);
+
+    static size_t record_length(const size_t _size)
+    {
+        return sizeof(RecordHeader) + ((_size + 7) & ~(size_t)7);
+    }
+
+private:
+    /**
+     * Single producer, single consumer byte ring.
+     */
+    struct Ring
+    {
+        uint8_t *buf = nullptr;
+        size_t   capacity = 0;
+        alignas(64) std::atomic<size_t> head{0};
+        std::atomic<bool> writing{false}; // record() in progress, see close()
+        alignas(64) std::atomic<size_t> tail{0};
+        std::atomic<uint64_t> dropped{0};
+    };
+
+    bool push(Ring &_ring, const uint8_t _direction, const void *_buf, const size_t _size);
+
+    void writer_thread();
+
+    size_t drain(Ring &_ring);
+
+    void write(const RecordHeader *_record);
+
+    int32_t open_segment();
+
+    void seal_segment();
+
+    static constexpr const char *TAG = "FrameRecorder";
+
+    std::atomic<bool> stopped_{true};
+    std::string dir_;
+    std::string prefix_;
+    size_t segment_size_ = 0;
+    Ring rings_[4];
+    std::thread thread_;
+    std::atomic<uint64_t> recorded_{0};
+
+    // writer thread only
+    uint32_t sequence_ = 0;
+    int fd_ = -1;
+    uint8_t *segment_ = nullptr;
+    size_t used_ = 0;
+    std::vector<RecordIndexEntry> index_;
+};
+
+/**
+ * Reader of recorded segments, frames point into the mapped files.
+ */
+class FrameReader
+{
+public:
+    struct Frame
+    {
+        uint64_t timestamp;
+        uint8_t  direction;
+        uint8_t  data_type;
+        const char    *vehicle_id;
+        const uint8_t *data;
+        uint32_t size;
+    };
+
+    /**
+     * Frame visitor, return false to stop reading.
+     */
+    class Visitor
+    {
+    public:
+        virtual ~Visitor() {}
+
+        virtual bool on_frame(const Frame &_frame) = 0;
+    };
+
+    ~FrameReader();
+
+    int32_t open(const char _dir[], const char _prefix[] = "capture");
+
+    void close();
+
+    /**
+     * Visit frames with _begin <= timestamp < _end, optionally of one vehicle,
+     * only index blocks overlapping the range are scanned.
+     */
+    size_t read(const uint64_t _begin, const uint64_t _end, const char *_vehicle_id, Visitor &_visitor) const;
+
+    size_t read(Visitor &_visitor) const
+    {
+        return read(0, UINT64_MAX, nullptr, _visitor);
+    }
+
+    uint64_t first_timestamp() const;
+
+    uint64_t last_timestamp() const;
+
+    size_t segment_count() const { return segments_.size(); }
+
+private:
+    struct Segment
+    {
+        std::string path;
+        uint32_t sequence = 0;
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+        std::vector<RecordIndexEntry> index;
+    };
+
+    static int32_t load_index(Segment &_segment);
+
+    static void build_index(Segment &_segment);
+
+    static constexpr const char *TAG = "FrameReader";
+
+    std::vector<Segment> segments_;
+};
+
+#endif // __RECORDER_H__
@@ -0,0 +1,83 @@
+#ifndef __REPLAYER_H__
+#define __REPLAYER_H__
+
+#include <stdio.h>
+
+#include "controller.h"
+#include "histogram.h"
+#include "recorder.h"
+
+/**
+ * Replays recorded frames.
+ *
+ * Frames are read in place from the mapped capture and fed either to a
+ * Packer::Handler in process or to a Controller over loopback sockets, at the
+ * original pace, a multiple of it or as fast as possible.
+ */
+class Replayer
+{
+public:
+    /**
+     * Replay report, latencies in ns.
+     */
+    struct Report
+    {
+        uint64_t  frames = 0;
+        uint64_t  bytes = 0;
+        uint64_t  lost = 0;
+        double    seconds = 0.0;
+        Histogram latency; // in process: unpack + handler, loopback: write to decode of the same frame
+        Histogram lag;     // behind schedule when the frame was fed
+
+        void print(FILE *_fp) const;
+    };
+
+    int32_t open(const char _dir[], const char _prefix[] = "capture");
+
+    void close();
+
+    /**
+     * 1.0 original pace, 2.0 twice as fast, 0 as fast as possible.
+     */
+    void set_speed(const double _speed) { speed_ = 0 > _speed ? 0 : _speed; }
+
+    void set_range(const uint64_t _begin, const uint64_t _end) { begin_ = _begin; end_ = _end; }
+
+    void set_vehicle(const char *_vehicle_id);
+
+    /**
+     * Directions to replay as bits of 1 << RECORD_*, all by default.
+     */
+    void set_directions(const uint32_t _directions) { directions_ = _directions; }
+
+    int32_t replay(protocol::Packer::Handler &_handler, Report &_report);
+
+    /**
+     * Listen on 127.0.0.1 _up_port and _down_port, start _controller against
+     * them and write UP and DOWN frames to the accepted sockets. The
+     * controller's tracer is used to time frames and is reset afterwards.
+     */
+    int32_t replay(Controller &_controller, const uint32_t _up_port, const uint32_t _down_port, Report &_report);
+
+private:
+    /**
+     * Sleep until the frame is due, return how far behind schedule it is.
+     */
+    uint64_t pace(const uint64_t _timestamp);
+
+    static constexpr const char *TAG = "Replayer";
+
+    FrameReader reader_;
+    double      speed_ = 1.0;
+    uint64_t    begin_ = 0;
+    uint64_t    end_ = UINT64_MAX;
+    bool        has_vehicle_ = false;
+    char        vehicle_id_[9] = "";
+    uint32_t    directions_ = 0x0F;
+
+    // pacing
+    uint64_t first_timestamp_ = 0;
+    uint64_t start_ = 0;
+};
+
+#endif // __REPLAYER_H__
@@ -0,0 +1,164 @@
+#ifndef __SPOOL_H__
+#define __SPOOL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "metrics.h"
+
+#define SPOOL_MAGIC        0x314C505345415343ULL // "CSAESPL1"
+#define SPOOL_RECORD_MAGIC 0x4C505343            // "CSPL"
+#define SPOOL_WRAP         0x50415257            // "WRAP"
+
+#define SPOOL_RAW   0 // frame as is
+#define SPOOL_KEY   1 // zero run length coded frame
+#define SPOOL_DELTA 2 // zero run length coded XOR with the previous frame
+
+#define SPOOL_KEY_INTERVAL 32 // records per SPOOL_KEY when compact
+
+#pragma pack(1)
+
+/**
+ * Spool file header, followed by the base of a delta at the tail, the data
+ * area follows at 4096.
+ */
+struct SpoolFileHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t compact;
+    uint64_t capacity;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t used;  // bytes, including the skipped end before a wrap
+    uint64_t count;
+    uint32_t base_size; // of the frame before a SPOOL_DELTA tail, 0 if none
+    uint8_t  reserved[4];
+};
+
+/**
+ * Spool record header, followed by the encoded frame padded to 8 bytes.
+ */
+struct SpoolRecord
+{
+    uint32_t magic;
+    uint32_t size;        // encoded
+    uint32_t frame_size;  // decoded
+    uint8_t  encoding;    // SPOOL_*
+    uint8_t  reserved[3];
+    uint64_t key;
+};
+
+#pragma pack()
+
+/**
+ * Store-and-forward spool of packed VEH2CLOUD_STATE frames.
+ *
+ * A ring in one preallocated mmap'd file, so it survives a restart and
+ * never grows past its cap: when full, the oldest frames are evicted. With
+ * compact encoding each frame is stored as the zero run length coding of
+ * its XOR with the previous one, consecutive states differ in few bytes.
+ * Every SPOOL_KEY_INTERVAL-th record stands alone, and eviction always
+ * leaves one of those at the tail. When pop() leaves a delta at the tail,
+ * its base is written after the file header so a reopen can decode it.
+ *
+ * Frames are deduplicated by message_id_ and timestamp_ against the recent
+ * ones appended or sent live, see sent().
+ */
+class StateSpool
+{
+public:
+    static const size_t DEDUP = 4096; // recent keys remembered
+
+    StateSpool();
+
+    ~StateSpool();
+
+    /**
+     * Open or create the spool file, an existing one is reused if it was
+     * written with the same capacity and encoding.
+     *
+     * @param _capacity bytes of frames kept on disk
+     */
+    int32_t open(const char _path[], const size_t _capacity = 16 << 20, const bool _compact = false);
+
+    void close();
+
+    bool is_open() const { return nullptr != map_; }
+
+    /**
+     * @return false if not open, a duplicate, or larger than the spool
+     */
+    bool append(const void *_frame, const size_t _size);
+
+    /**
+     * Decode the oldest frame into _frame without removing it, frames that
+     * fail to decode are dropped.
+     *
+     * @return false if empty
+     */
+    bool front(std::vector<uint8_t> &_frame);
+
+    void pop();
+
+    /**
+     * Remember a frame sent live, so appending it again is a duplicate.
+     */
+    void sent(const void *_frame, const size_t _size);
+
+    size_t count() const;
+
+    size_t bytes() const;
+
+    /**
+     * Key of a packed VEH2CLOUD_STATE from its timestamp_ and message_id_,
+     * 0 if it is not a complete state frame.
+     */
+    static uint64_t key(const void *_frame, const size_t _size);
+
+private:
+    static const size_t DATA_OFFSET = 4096;
+
+    size_t encode(const uint8_t *_frame, const size_t _size, const std::vector<uint8_t> *_base, uint8_t *_out) const;
+
+    bool decode(const SpoolRecord *_record, std::vector<uint8_t> &_frame);
+
+    const SpoolRecord* tail_record();
+
+    void evict();
+
+    void save_base();
+
+    void remember(const uint64_t _key);
+
+    static constexpr const char *TAG = "StateSpool";
+
+    std::string path_;
+    int fd_ = -1;
+    uint8_t *map_ = nullptr;
+    size_t map_size_ = 0;
+    SpoolFileHeader *header_ = nullptr;
+    uint8_t *data_ = nullptr;
+
+    uint64_t appended_ = 0;          // records since open, for the key cadence
+    std::vector<uint8_t> last_;      // last appended frame
+    std::vector<uint8_t> read_base_; // frame before the tail
+    std::vector<uint8_t> scratch_;
+
+    std::unordered_set<uint64_t> keys_;
+    std::deque<uint64_t> order_;
+    mutable std::mutex mutex_;
+
+    Gauge   &depth_;
+    Counter &appended_total_;
+    Counter &evicted_total_;
+    Counter &duplicates_total_;
+};
+
+#endif // __SPOOL_H__
@@ -0,0 +1,95 @@
+#ifndef __STATE_PUBLISHER_H__
+#define __STATE_PUBLISHER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "metrics.h"
+#include "packer.h"
+
+/**
+ * Deadbands of Veh2CloudState fields, in the fields' wire units. A field
+ * differing from the last sent state by more than its deadband triggers a
+ * send, 0 sends on any change.
+ */
+struct StateDeadband
+{
+    uint32_t position = 0;       // longitude and latitude each
+    uint32_t elevation = 0;
+    uint32_t heading = 0;
+    uint32_t steering_angle = 0;
+    uint16_t velocity = 0;       // velocity_ and gnss_velocity_
+    uint16_t acc = 0;            // acc_lon_, acc_lat_, acc_ver_
+    uint16_t yaw_rate = 0;
+    uint16_t pedal = 0;          // accel_pos_ and break_pos_
+    uint16_t break_pressure = 0;
+    uint16_t engine_speed = 0;
+    uint32_t engine_torque = 0;
+    uint16_t fuel_consume = 0;
+    uint32_t max_interval = 1000; // ms of timestamp_ between sends regardless
+    uint32_t heading_circle = 3600000; // heading_ of 360 degrees, 1e-4 degree
+};
+
+/**
+ * Send-on-change filter in front of Controller::send(Veh2CloudState).
+ *
+ * Each state is compared with the last one sent: it goes out when a field
+ * leaves its deadband, gear_, break_flag_, drive_mode_ or the route
+ * changed, or max_interval passed since the last send, so a parked vehicle
+ * reports at max_interval instead of its sample rate. Comparing with the
+ * last sent rather than the previous state lets a slow drift through once
+ * it adds up. Times are the states' timestamp_, so a recorded drive
+ * filters as it did live.
+ */
+class StatePublisher
+{
+public:
+    typedef std::function<void(const protocol::Veh2CloudState &_msg)> sender;
+
+    StatePublisher(sender _send);
+
+    void configure(const StateDeadband &_deadband);
+
+    /**
+     * Send _msg if it changed enough.
+     *
+     * @return true if sent
+     */
+    bool publish(const protocol::Veh2CloudState &_msg);
+
+    /**
+     * Send the next state regardless, e.g. after a reconnect.
+     */
+    void reset();
+
+    /**
+     * Counts of this publisher, the csae_state_* metrics sum all of them.
+     */
+    uint64_t published() const { return published_count_; }
+
+    uint64_t suppressed() const { return suppressed_count_; }
+
+    uint64_t saved_bytes() const { return saved_bytes_count_; }
+
+private:
+    bool changed(const protocol::Veh2CloudState &_msg) const;
+
+    sender send_;
+    StateDeadband deadband_;
+    std::unique_ptr<protocol::Veh2CloudState> last_; // last sent
+    std::mutex mutex_;
+
+    uint64_t published_count_ = 0;
+    uint64_t suppressed_count_ = 0;
+    uint64_t saved_bytes_count_ = 0;
+
+    Counter &published_;
+    Counter &suppressed_;
+    Counter &saved_bytes_;
+};
+
+#endif // __STATE_PUBLISHER_H__
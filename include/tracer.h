@@ -0,0 +1,107 @@
+#ifndef __TRACER_H__
+#define __TRACER_H__
+
+#include <atomic>
+
+#include "packer.h"
+
+#define TRACE_NONE    0x00
+#define TRACE_UP_TX   0x01
+#define TRACE_UP_RX   0x02
+#define TRACE_DOWN_TX 0x04
+#define TRACE_DOWN_RX 0x08
+#define TRACE_MESSAGE 0x10
+#define TRACE_ALL     0x1F
+
+/**
+ * Frame tracer, off by default.
+ *
+ * Enabled per direction (TRACE_*) and per data type, with 1-in-N sampling.
+ * When a direction is off the check costs one relaxed load and one branch.
+ */
+class Tracer
+{
+public:
+    /**
+     * Trace sink, decoded messages arrive through the Packer::Handler methods.
+     */
+    class Sink : public protocol::Packer::Handler
+    {
+    public:
+        virtual void on_frame(const uint32_t _direction, const void *_buf, const size_t _size) {}
+    };
+
+    /**
+     * Sink printing to stdout, the former Controller output.
+     */
+    class StdoutSink : public Sink
+    {
+    public:
+        void on_frame(const uint32_t _direction, const void *_buf, const size_t _size) override;
+
+        void on_unpack(const protocol::MessageHeader &_msg) override;
+
+        void on_unpack(const protocol::Veh2CloudInh &_msg) override;
+
+        void on_unpack(const protocol::Cloud2VehInhRes &_msg) override;
+
+        void on_unpack(const protocol::Veh2CloudState &_msg) override;
+    };
+
+    Tracer();
+
+    void set_sink(Sink *_sink);
+
+    void enable(const uint32_t _directions);
+
+    void disable(const uint32_t _directions);
+
+    void enable_type(const uint8_t _data_type);
+
+    void disable_type(const uint8_t _data_type);
+
+    void set_all_types(const bool _enabled);
+
+    void set_sample(const uint32_t _n);
+
+    bool enabled(const uint32_t _direction) const
+    {
+        return 0 != (directions_.load(std::memory_order_relaxed) & _direction);
+    }
+
+    void frame(const uint32_t _direction, const void *_buf, const size_t _size)
+    {
+        if (__builtin_expect(enabled(_direction), 0))
+        {
+            trace_frame(_direction, _buf, _size);
+        }
+    }
+
+    template<typename T, typename std::enable_if<std::is_base_of<protocol::MessageHeader, T>::value>::type* = nullptr>
+    void message(const T &_msg)
+    {
+        if (__builtin_expect(enabled(TRACE_MESSAGE), 0))
+        {
+            if (accept(TRACE_MESSAGE, _msg.data_type_))
+            {
+                sink_.load(std::memory_order_acquire)->on_unpack(_msg);
+            }
+        }
+    }
+
+private:
+    void trace_frame(const uint32_t _direction, const void *_buf, const size_t _size);
+
+    bool accept(const uint32_t _direction, const uint8_t _data_type);
+
+    static constexpr const char *TAG = "Tracer";
+
+    std::atomic<uint32_t> directions_;
+    std::atomic<uint64_t> types_[4];
+    std::atomic<uint32_t> sample_;
+    std::atomic<uint32_t> counters_[5];
+    std::atomic<Sink*>    sink_;
+    StdoutSink            stdout_sink_;
+};
+
+#endif // __TRACER_H__
@@ -0,0 +1,63 @@
+#ifndef __TRAJECTORY_H__
+#define __TRAJECTORY_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include "packer.h"
+
+#define TRAJECTORY_MAX_POINTS 255 // pass_pos_num_ is one byte
+
+/**
+ * Result of a simplification.
+ */
+struct TrajectoryStats
+{
+    size_t in = 0;
+    size_t out = 0;
+    double max_deviation = 0; // m, of a dropped point from the kept line
+
+    double ratio() const { return 0 == out ? 1.0 : (double)in / out; }
+};
+
+/**
+ * Douglas-Peucker simplification of pass_pos_ style trajectories.
+ *
+ * Points are 1e-7 degree longitude and latitude, projected to integer
+ * millimetres around the first point, which is exact to well under the
+ * tolerance over the few kilometres a trajectory spans. Every dropped point
+ * lies within _tolerance metres of the polyline kept, the first and last
+ * points are always kept. The recursion runs on a fixed stack and the
+ * state lives in arrays of TRAJECTORY_MAX_POINTS on the call stack, so
+ * nothing is allocated; each level scans its span once, n log n for the
+ * usual road shapes.
+ */
+class Trajectory
+{
+public:
+    /**
+     * Simplify _count points of _in into _out, which may be _in. More than
+     * TRAJECTORY_MAX_POINTS points are copied unchanged.
+     *
+     * @param _tolerance metres
+     * @return points written to _out
+     */
+    static size_t simplify(const protocol::Position2D _in[], const size_t _count, const double _tolerance,
+        protocol::Position2D _out[], TrajectoryStats *_stats = nullptr);
+
+    /**
+     * In place, the vector only shrinks.
+     */
+    static size_t simplify(std::vector<protocol::Position2D> &_points, const double _tolerance, TrajectoryStats *_stats = nullptr)
+    {
+        size_t n = simplify(_points.data(), _points.size(), _tolerance, _points.data(), _stats);
+
+        _points.resize(n);
+
+        return n;
+    }
+};
+
+#endif // __TRAJECTORY_H__
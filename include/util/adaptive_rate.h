@@ -0,0 +1,67 @@
+#ifndef __ADAPTIVE_RATE_H__
+#define __ADAPTIVE_RATE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+
+/**
+ * AIMD reporting rate from the send queue depth and the link RTT.
+ *
+ * update() runs periodically. The link is congested when the queue holds
+ * _depth frames or more, or the smoothed RTT exceeds _rtt_factor times the
+ * minimum seen by more than RTT_SLACK; then the rate halves, and holds for
+ * HOLD updates so the backlog can drain before it is judged again. With
+ * the queue below a quarter of _depth and the RTT back down the rate grows
+ * by a twentieth of the range per update, so a recovered link regains the
+ * full rate in a few seconds without overshooting into a new backlog.
+ *
+ * Reads are lock-free for producers, update() has a single caller.
+ */
+class AdaptiveRate
+{
+public:
+    static const uint32_t HOLD = 2;
+    static const uint64_t RTT_SLACK = 10000; // us, ignore RTT growth below
+
+    /**
+     * Starts at _max.
+     *
+     * @param _min, _max reports/s
+     */
+    void configure(const double _min, const double _max, const size_t _depth = 8, const double _rtt_factor = 2.0);
+
+    bool enabled() const { return 0 < max_; }
+
+    /**
+     * @param _depth   frames in the send queue
+     * @param _srtt    smoothed RTT in us, 0 if unknown
+     * @param _min_rtt minimum RTT in us, 0 if unknown
+     * @return the new rate
+     */
+    double update(const size_t _depth, const uint64_t _srtt, const uint64_t _min_rtt);
+
+    /**
+     * Reports/s allowed, the configured max while disabled.
+     */
+    double rate() const { return rate_.load(std::memory_order_relaxed); }
+
+    /**
+     * Milliseconds between reports at rate(), 0 while disabled.
+     */
+    uint32_t interval() const;
+
+    bool congested() const { return congested_; }
+
+private:
+    double min_ = 0;
+    double max_ = 0;
+    size_t depth_ = 8;
+    double rtt_factor_ = 2.0;
+    uint32_t hold_ = 0;
+    bool congested_ = false;
+    std::atomic<double> rate_{0};
+};
+
+#endif // __ADAPTIVE_RATE_H__
@@ -6,6 +6,8 @@
 #include <condition_variable>
 #include <functional>
 
+#include "metrics.h"
+
 /**
  * Blocking queue, thread safety.
  */
@@ -15,21 +17,55 @@ class BlockQueue : public std::queue<T>
 public:
     using base = std::queue<T>;
 
+    /**
+     * Report the depth and the puts, either may be null.
+     */
+    void set_metrics(Gauge *_depth, Counter *_puts)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        depth_ = _depth;
+        puts_ = _puts;
+
+        if (nullptr != depth_)
+        {
+            depth_->set(base::size());
+        }
+    }
+
     void put(const T &_t)
     {
         std::lock_guard<std::mutex> lock(mutex_);
 
         base::push(_t);
         cond_.notify_all();
+
+        if (nullptr != depth_)
+        {
+            depth_->add();
+        }
+
+        if (nullptr != puts_)
+        {
+            puts_->add();
+        }
     }
 
     T& take()
     {
         std::unique_lock<std::mutex> lock(mutex_);
 
+        cond_.wait(lock, [this]()
+        {
+            return 0 != base::size() || notified_;
+        });
+
+        notified_ = false;
+
+        // woken by notify() with nothing queued
         if (0 == base::size())
         {
-            cond_.wait(lock);
+            return null_;
         }
 
         return base::front();
@@ -45,17 +81,74 @@ public:
         }
 
         base::pop();
+
+        if (nullptr != depth_)
+        {
+            depth_->sub();
+        }
+    }
+
+    /**
+     * Number of queued items, under the lock.
+     */
+    size_t pending()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return base::size();
+    }
+
+    /**
+     * Remove every queued item, handing each to _f.
+     */
+    template<typename F>
+    void drain(F _f)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        while (0 != base::size())
+        {
+            _f(base::front());
+            base::pop();
+
+            if (nullptr != depth_)
+            {
+                depth_->sub();
+            }
+        }
     }
 
+    /**
+     * Wake take() or wait(), or the next call of either if none is waiting.
+     */
     void notify()
     {
         std::lock_guard<std::mutex> lock(mutex_);
+        notified_ = true;
         cond_.notify_all();
     }
 
+    /**
+     * Wait for notify() regardless of the queued items.
+     */
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        cond_.wait(lock, [this]()
+        {
+            return notified_;
+        });
+
+        notified_ = false;
+    }
+
 private:
     std::mutex mutex_;
     std::condition_variable cond_;
+    T null_ = T();
+    Gauge *depth_ = nullptr;
+    Counter *puts_ = nullptr;
+    bool notified_ = false;
 };
 
 #endif // __BLOCK_QUEUE_H__
\ No newline at end of file
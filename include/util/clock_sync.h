@@ -0,0 +1,114 @@
+#ifndef __CLOCK_SYNC_H__
+#define __CLOCK_SYNC_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <mutex>
+
+/**
+ * Clock offset estimate, offset is the remote clock minus the local one.
+ */
+struct ClockStats
+{
+    int64_t  offset = 0;    // ms, at the reference time
+    double   drift = 0;     // ppm, remote clock rate relative to the local one
+    uint64_t delay = 0;     // ms, round trip of the sample the offset came from
+    uint64_t samples = 0;
+    bool     synced = false;
+};
+
+/**
+ * NTP style offset and drift estimator between the local clock and a remote
+ * one, from round trips whose response carries a remote timestamp.
+ *
+ * A round trip sent at local t0, stamped remote T and received at local t3
+ * gives offset T - (t0 + t3) / 2, exact when both legs take equally long.
+ * Of the last few samples the one with the shortest round trip is trusted,
+ * as queueing rarely hits it in both directions. Drift is the least
+ * squares slope of the trusted offsets once they span DRIFT_SPAN ms.
+ *
+ * Reads are lock-free, so they can run per received frame.
+ */
+class ClockSync
+{
+public:
+    static const size_t WINDOW = 8;       // clock filter samples
+    static const size_t HISTORY = 16;     // trusted offsets for the drift
+    static const uint64_t DRIFT_SPAN = 60000;
+    static constexpr double MAX_DRIFT = 500; // ppm
+
+    /**
+     * All times in UTC ms, _request and _response by the local clock.
+     *
+     * @return false if _remote only echoes _request, or the times are not
+     *         in order
+     */
+    bool sample(const uint64_t _request, const uint64_t _remote, const uint64_t _response);
+
+    void reset();
+
+    bool synced() const { return synced_.load(std::memory_order_acquire); }
+
+    /**
+     * Remote minus local clock at local time _now, in ms.
+     */
+    int64_t offset(const uint64_t _now) const;
+
+    /**
+     * Remote time _remote on the local clock.
+     */
+    int64_t to_local(const uint64_t _remote) const
+    {
+        return (int64_t)_remote - offset(_remote);
+    }
+
+    /**
+     * Corrected one-way latency of a message sent locally at _sent and
+     * stamped remotely at _remote, in ms.
+     */
+    int64_t uplink(const uint64_t _sent, const uint64_t _remote) const
+    {
+        return to_local(_remote) - (int64_t)_sent;
+    }
+
+    /**
+     * Corrected one-way latency of a message stamped remotely at _remote and
+     * received locally at _received, in ms.
+     */
+    int64_t downlink(const uint64_t _remote, const uint64_t _received) const
+    {
+        return (int64_t)_received - to_local(_remote);
+    }
+
+    ClockStats stats() const;
+
+private:
+    struct Sample
+    {
+        uint64_t time;  // local, ms
+        int64_t  offset;
+        uint64_t delay;
+    };
+
+    void update_drift();
+
+    // estimate, written under mutex_ and read lock-free
+    std::atomic<bool>    synced_{false};
+    std::atomic<int64_t> offset_{0};
+    std::atomic<uint64_t> ref_{0};    // local time of offset_
+    std::atomic<int64_t> drift_{0};   // ppb
+
+    Sample window_[WINDOW];
+    size_t window_size_ = 0;
+    size_t window_next_ = 0;
+    Sample history_[HISTORY];
+    size_t history_size_ = 0;
+    size_t history_next_ = 0;
+    uint64_t delay_ = 0;
+    uint64_t samples_ = 0;
+    mutable std::mutex mutex_;
+};
+
+#endif // __CLOCK_SYNC_H__
@@ -19,14 +19,40 @@ void print_buffer(const char _prefix[], const uint32_t _id, const void *_buf, co
 
 void bytes_to_string(const void *_bytes, const size_t _size, char _str[]);
 
-void string_to_bcd(const char _str[], uint8_t _bcd[], const size_t _size);
+/* fixed length BCD, right aligned with leading zeros, -1 on a non-digit */
+int string_to_bcd(const char _str[], uint8_t _bcd[], const size_t _size);
 
+/* 2 * _size digits and a NUL, -1 on a nibble above 9 */
+int bcd_to_string(const uint8_t _bcd[], const size_t _size, char _str[]);
+
+/* variable length BCD, 0xF filled after the last digit, returns the bytes of digits */
+int string_to_bcd_var(const char _str[], uint8_t _bcd[], const size_t _size);
+
+/* digits up to the first 0xF nibble, returns the digit count */
+int bcd_to_string_var(const uint8_t _bcd[], const size_t _size, char _str[]);
+
+/* a column of _count ids of _len digits each, no separators, to _size bytes each */
+int string_to_bcd_batch(const char _strs[], const size_t _len, const size_t _count, uint8_t _bcd[], const size_t _size);
+
+/* _count ids of _size bytes to 2 * _size digits each, no separators */
+int bcd_to_string_batch(const uint8_t _bcd[], const size_t _size, const size_t _count, char _strs[]);
+
+/* iconv conversion, descriptors are cached per thread */
 int code_convert(char *from_charset, char *to_charset, char *inbuf, size_t inlen, char *outbuf, size_t outlen);
 
+/* table driven GBK (CP936) <-> UTF-8, ASCII runs are copied through */
 int utf8_to_gbk(char *inbuf, size_t inlen, char *outbuf, size_t outlen);
 
 int gbk_to_utf8(char *inbuf, size_t inlen, char *outbuf, size_t outlen);
 
+/* the same conversions through iconv */
+int utf8_to_gbk_iconv(char *inbuf, size_t inlen, char *outbuf, size_t outlen);
+
+int gbk_to_utf8_iconv(char *inbuf, size_t inlen, char *outbuf, size_t outlen);
+
+/* length of the leading pure-ASCII run, 16 bytes per step with SSE2 */
+size_t ascii_length(const void *_buf, const size_t _size);
+
 #ifdef __cplusplus
 }
 #endif
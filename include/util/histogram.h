@@ -0,0 +1,184 @@
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+
+/**
+ * Log-linear histogram, HDR style.
+ *
+ * 32 linear sub-buckets per power of two give about 3% relative error over
+ * the whole uint64_t range. record() is lock-free and wait-free.
+ */
+class Histogram
+{
+public:
+    static const uint32_t SUB_BITS = 5;
+    static const uint32_t SUB_COUNT = 1 << SUB_BITS;
+    static const uint32_t BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS;
+
+    Histogram()
+    {
+        reset();
+    }
+
+    Histogram(const Histogram &_other)
+    {
+        reset();
+        merge(_other);
+    }
+
+    Histogram& operator=(const Histogram &_other)
+    {
+        if (this != &_other)
+        {
+            reset();
+            merge(_other);
+        }
+
+        return *this;
+    }
+
+    static uint32_t bucket(const uint64_t _value)
+    {
+        if (_value < SUB_COUNT)
+        {
+            return (uint32_t)_value;
+        }
+
+        uint32_t e = 63 - __builtin_clzll(_value);
+
+        return ((e - SUB_BITS + 1) << SUB_BITS) + (uint32_t)((_value >> (e - SUB_BITS)) & (SUB_COUNT - 1));
+    }
+
+    /**
+     * Highest value counted in bucket _index.
+     */
+    static uint64_t bucket_value(const uint32_t _index)
+    {
+        if (_index < SUB_COUNT)
+        {
+            return _index;
+        }
+
+        uint32_t e = (_index >> SUB_BITS) - 1 + SUB_BITS;
+        uint64_t low = (uint64_t)(SUB_COUNT + (_index & (SUB_COUNT - 1))) << (e - SUB_BITS);
+
+        return low + ((1ULL << (e - SUB_BITS)) - 1);
+    }
+
+    void record(const uint64_t _value)
+    {
+        counts_[bucket(_value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(_value, std::memory_order_relaxed);
+
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (_value > max && !max_.compare_exchange_weak(max, _value, std::memory_order_relaxed)) {}
+
+        uint64_t min = min_.load(std::memory_order_relaxed);
+        while (_value < min && !min_.compare_exchange_weak(min, _value, std::memory_order_relaxed)) {}
+    }
+
+    void reset()
+    {
+        for (auto &c : counts_)
+        {
+            c.store(0, std::memory_order_relaxed);
+        }
+
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+        min_.store(UINT64_MAX, std::memory_order_relaxed);
+    }
+
+    void merge(const Histogram &_other)
+    {
+        for (uint32_t i = 0; i < BUCKETS; i++)
+        {
+            uint64_t n = _other.counts_[i].load(std::memory_order_relaxed);
+
+            if (0 != n)
+            {
+                counts_[i].fetch_add(n, std::memory_order_relaxed);
+            }
+        }
+
+        count_.fetch_add(_other.count(), std::memory_order_relaxed);
+        sum_.fetch_add(_other.sum(), std::memory_order_relaxed);
+
+        uint64_t max = _other.max();
+        uint64_t cur = max_.load(std::memory_order_relaxed);
+        while (max > cur && !max_.compare_exchange_weak(cur, max, std::memory_order_relaxed)) {}
+
+        uint64_t min = _other.min_.load(std::memory_order_relaxed);
+        cur = min_.load(std::memory_order_relaxed);
+        while (min < cur && !min_.compare_exchange_weak(cur, min, std::memory_order_relaxed)) {}
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    uint64_t min() const
+    {
+        uint64_t min = min_.load(std::memory_order_relaxed);
+        return UINT64_MAX == min ? 0 : min;
+    }
+
+    double mean() const
+    {
+        uint64_t n = count();
+        return 0 == n ? 0.0 : (double)sum() / n;
+    }
+
+    uint64_t bucket_count(const uint32_t _index) const
+    {
+        return counts_[_index].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Value at percentile _p (0 - 100), clamped to the recorded max.
+     */
+    uint64_t percentile(const double _p) const
+    {
+        uint64_t n = count();
+
+        if (0 == n)
+        {
+            return 0;
+        }
+
+        uint64_t rank = (uint64_t)(_p / 100.0 * n + 0.5);
+        rank = 0 == rank ? 1 : (rank > n ? n : rank);
+
+        uint64_t seen = 0;
+
+        for (uint32_t i = 0; i < BUCKETS; i++)
+        {
+            seen += counts_[i].load(std::memory_order_relaxed);
+
+            if (seen >= rank)
+            {
+                uint64_t value = bucket_value(i);
+                return value < max() ? value : max();
+            }
+        }
+
+        return max();
+    }
+
+private:
+    std::atomic<uint64_t> counts_[BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+    std::atomic<uint64_t> min_;
+};
+
+#endif // __HISTOGRAM_H__
@@ -0,0 +1,238 @@
+#ifndef __MESSAGE_BATCH_H__
+#define __MESSAGE_BATCH_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "timer_wheel.h"
+
+/**
+ * Collects decoded messages into batches, flushed when full, at the end of
+ * a read (flush()) or when the oldest has waited the latency bound.
+ *
+ * A batch is a contiguous array handed to the sink, which gives it back
+ * with release() once consumed, possibly on another thread. Batches are
+ * recycled and their slots assigned over, so the messages' own buffers are
+ * reused instead of allocated per message. The sink is called outside the
+ * batch lock, a message may be added while it runs, and one hand-over at a
+ * time so batches arrive in order.
+ */
+template<typename T>
+class MessageBatch
+{
+public:
+    struct Batch
+    {
+        std::vector<T> msgs; // only the first count are valid
+        size_t count = 0;
+
+        const T* data() const { return msgs.data(); }
+
+        size_t size() const { return count; }
+    };
+
+    typedef std::function<void(Batch *_batch)> sink;
+
+    static const size_t POOL = 8;
+
+    MessageBatch(TimerWheel &_wheel): wheel_(_wheel) {}
+
+    ~MessageBatch()
+    {
+        for (auto b : pool_)
+        {
+            delete b;
+        }
+
+        delete current_;
+    }
+
+    /**
+     * @param _max     messages per batch, 0 disables batching
+     * @param _latency longest a message waits for its batch, in milliseconds,
+     *                 0 to wait only for the end of the read
+     */
+    void configure(const size_t _max, const uint32_t _latency, sink _sink)
+    {
+        std::lock_guard<std::mutex> order(sink_mutex_);
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        max_ = _max;
+        latency_ = _latency;
+        sink_ = std::move(_sink);
+    }
+
+    bool enabled() const { return 0 != max_; }
+
+    void add(const T &_msg)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            if (!append(_msg))
+            {
+                return;
+            }
+        }
+
+        hand_over([this]()
+        {
+            return nullptr != this->current_ && this->max_ <= this->current_->count;
+        });
+    }
+
+    /**
+     * End of a read, hand over what is collected unless a latency bound
+     * lets it wait for more.
+     */
+    void flush(const bool _force = false)
+    {
+        hand_over([this, _force]()
+        {
+            return nullptr != this->current_ && (0 == this->latency_ || _force);
+        });
+    }
+
+    /**
+     * Give a batch back once its messages are consumed.
+     */
+    void release(Batch *_batch)
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+
+        _batch->count = 0;
+
+        if (POOL > pool_.size())
+        {
+            pool_.push_back(_batch);
+        }
+        else
+        {
+            delete _batch;
+        }
+    }
+
+private:
+    /**
+     * Under mutex_.
+     *
+     * @return true if the current batch is full
+     */
+    bool append(const T &_msg)
+    {
+        if (nullptr == current_)
+        {
+            current_ = acquire();
+        }
+
+        if (current_->count < current_->msgs.size())
+        {
+            current_->msgs[current_->count] = _msg;
+        }
+        else
+        {
+            current_->msgs.push_back(_msg);
+        }
+
+        current_->count++;
+
+        if (1 == current_->count && 0 != latency_)
+        {
+            uint64_t gen = ++gen_;
+
+            timer_ = wheel_.schedule(latency_, [this, gen]()
+            {
+                this->on_timer(gen);
+            });
+        }
+
+        return max_ <= current_->count;
+    }
+
+    /**
+     * Take the current batch if _ready() under mutex_ and call the sink
+     * after unlocking it.
+     */
+    template<typename F>
+    void hand_over(F _ready)
+    {
+        std::lock_guard<std::mutex> order(sink_mutex_);
+        Batch *b = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            if (!_ready())
+            {
+                return;
+            }
+
+            b = take();
+        }
+
+        sink_(b);
+    }
+
+    Batch* acquire()
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+
+        if (pool_.empty())
+        {
+            return new Batch();
+        }
+
+        Batch *b = pool_.back();
+        pool_.pop_back();
+
+        return b;
+    }
+
+    Batch* take()
+    {
+        Batch *b = current_;
+
+        current_ = nullptr;
+
+        if (0 != timer_)
+        {
+            wheel_.cancel(timer_);
+            timer_ = 0;
+        }
+
+        return b;
+    }
+
+    void on_timer(const uint64_t _gen)
+    {
+        hand_over([this, _gen]()
+        {
+            // flushed meanwhile
+            if (_gen != this->gen_ || nullptr == this->current_)
+            {
+                return false;
+            }
+
+            this->timer_ = 0;
+            return true;
+        });
+    }
+
+    TimerWheel &wheel_;
+    size_t max_ = 0;
+    uint32_t latency_ = 0;
+    sink sink_;
+    Batch *current_ = nullptr;
+    std::vector<Batch*> pool_;
+    uint64_t timer_ = 0;
+    uint64_t gen_ = 0;
+    std::mutex mutex_;
+    std::mutex sink_mutex_; // hand-overs, taken before mutex_
+    std::mutex pool_mutex_; // release() may run inside the sink
+};
+
+#endif // __MESSAGE_BATCH_H__
@@ -0,0 +1,178 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "histogram.h"
+
+/**
+ * Counter sharded per thread, add() touches only the calling thread's
+ * cache line.
+ */
+class Counter
+{
+public:
+    static const size_t SHARDS = 16;
+
+    void add(const uint64_t _n = 1)
+    {
+        shards_[shard()].value.fetch_add(_n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const
+    {
+        uint64_t sum = 0;
+
+        for (size_t i = 0; i < SHARDS; i++)
+        {
+            sum += shards_[i].value.load(std::memory_order_relaxed);
+        }
+
+        return sum;
+    }
+
+private:
+    struct Shard
+    {
+        std::atomic<uint64_t> value{0};
+        char pad[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    static size_t shard()
+    {
+        static thread_local size_t index = next_.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+        return index;
+    }
+
+    static std::atomic<size_t> next_;
+
+    Shard shards_[SHARDS];
+};
+
+/**
+ * Gauge, a value that goes up and down.
+ */
+class Gauge
+{
+public:
+    void set(const int64_t _value) { value_.store(_value, std::memory_order_relaxed); }
+
+    void add(const int64_t _n = 1) { value_.fetch_add(_n, std::memory_order_relaxed); }
+
+    void sub(const int64_t _n = 1) { value_.fetch_sub(_n, std::memory_order_relaxed); }
+
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+#define METRIC_COUNTER   0
+#define METRIC_GAUGE     1
+#define METRIC_HISTOGRAM 2
+
+/**
+ * Process wide metrics registry.
+ *
+ * Registration takes a lock and returns a reference that stays valid for
+ * the life of the process, so callers look a metric up once and update it
+ * lock-free. Labels are given preformatted, e.g. "direction=\"up_tx\"".
+ */
+class Metrics
+{
+public:
+    /**
+     * One metric in a snapshot, histograms in their recorded unit.
+     */
+    struct Sample
+    {
+        std::string name;
+        std::string labels;
+        uint32_t    type = METRIC_COUNTER;
+        int64_t     value = 0;
+        uint64_t    count = 0;
+        uint64_t    sum = 0;
+        uint64_t    p50 = 0;
+        uint64_t    p90 = 0;
+        uint64_t    p99 = 0;
+        uint64_t    p999 = 0;
+        uint64_t    max = 0;
+    };
+
+    static Metrics& instance();
+
+    Counter& counter(const char _name[], const char _help[], const char _labels[] = "");
+
+    Gauge& gauge(const char _name[], const char _help[], const char _labels[] = "");
+
+    Histogram& histogram(const char _name[], const char _help[], const char _labels[] = "");
+
+    /**
+     * Fill _samples in registration order, reusing its strings when polled
+     * repeatedly with the same vector.
+     */
+    void snapshot(std::vector<Sample> &_samples) const;
+
+    /**
+     * Prometheus text exposition format, histograms as summaries.
+     */
+    void write_prometheus(std::string &_out) const;
+
+private:
+    struct Entry
+    {
+        std::string name;
+        std::string help;
+        std::string labels;
+        uint32_t    type;
+        void       *metric;
+    };
+
+    void snapshot_locked(std::vector<Sample> &_samples) const;
+
+    void* find(const char _name[], const char _labels[], const uint32_t _type) const;
+
+    void* add(const char _name[], const char _help[], const char _labels[], const uint32_t _type, void *_metric);
+
+    static constexpr const char *TAG = "Metrics";
+
+    mutable std::mutex mutex_;
+    std::deque<Entry> entries_;
+    std::deque<std::unique_ptr<Counter>> counters_;
+    std::deque<std::unique_ptr<Gauge>> gauges_;
+    std::deque<std::unique_ptr<Histogram>> histograms_;
+};
+
+/**
+ * Serves the Prometheus text of Metrics::instance() on a local Unix socket,
+ * one dump per connection, e.g. `socat - UNIX-CONNECT:/tmp/csae.metrics`.
+ */
+class MetricsEndpoint
+{
+public:
+    ~MetricsEndpoint();
+
+    int32_t start(const char _path[]);
+
+    void stop();
+
+private:
+    void serve();
+
+    static constexpr const char *TAG = "MetricsEndpoint";
+
+    std::atomic<int> fd_{-1};
+    std::string path_;
+    std::thread thread_;
+};
+
+#endif // __METRICS_H__
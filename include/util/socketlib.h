@@ -49,6 +49,7 @@ namespace socketlib
 
         int sockfd_;
         ConnectState state_ = CLOSED;
+        bool opened_ = false;
         // bool done_ = true;
         // std::thread thread_;
         timer_t timer_;
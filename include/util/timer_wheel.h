@@ -0,0 +1,85 @@
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Hashed timer wheel for one-shot timeouts, O(1) schedule and cancel.
+ *
+ * Handlers run on the wheel's thread outside its lock, so they may schedule
+ * or cancel. The thread sleeps while nothing is scheduled.
+ */
+class TimerWheel
+{
+public:
+    typedef std::function<void()> handler;
+
+    /**
+     * @param _tick  resolution in milliseconds
+     * @param _slots number of slots, timeouts beyond _tick * _slots take
+     *               extra rounds
+     */
+    TimerWheel(const uint32_t _tick = 10, const size_t _slots = 512);
+
+    ~TimerWheel();
+
+    int32_t start();
+
+    /**
+     * Stop the thread, pending timers are dropped without running.
+     */
+    void stop();
+
+    /**
+     * Run _handler once after _delay milliseconds, rounded up to a tick.
+     *
+     * @return timer id for cancel(), 0 if the wheel is not started
+     */
+    uint64_t schedule(const uint32_t _delay, handler _handler);
+
+    /**
+     * @return false if the timer already ran or never existed
+     */
+    bool cancel(const uint64_t _id);
+
+    size_t size() const;
+
+private:
+    struct Entry
+    {
+        uint64_t id;
+        uint64_t expire; // tick
+        handler  fn;
+    };
+
+    typedef std::list<Entry> Slot;
+
+    uint64_t current_tick() const;
+
+    void run();
+
+    static constexpr const char *TAG = "TimerWheel";
+
+    const uint32_t tick_;
+    bool stopped_ = true;
+    uint64_t next_id_ = 1;
+    uint64_t processed_ = 0; // last tick handled
+    std::chrono::steady_clock::time_point base_;
+    std::vector<Slot> slots_;
+    std::unordered_map<uint64_t, Slot::iterator> index_;
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    std::thread thread_;
+};
+
+#endif // __TIMER_WHEEL_H__
@@ -0,0 +1,57 @@
+#ifndef __TOKEN_BUCKET_H__
+#define __TOKEN_BUCKET_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Token bucket shaping a stream of frames by bytes/s and frames/s.
+ *
+ * Each limit refills its own bucket up to its burst, a frame goes once both
+ * hold enough: one frame token, and its size in bytes, or the whole byte
+ * burst for a frame larger than it, which then leaves the bucket in debt.
+ * Times are steady microseconds supplied by the caller. Not thread safe,
+ * one sender owns a bucket.
+ */
+class TokenBucket
+{
+public:
+    /**
+     * @param _bytes        bytes/s, 0 for no byte limit
+     * @param _frames       frames/s, 0 for no frame limit
+     * @param _burst_bytes  byte bucket size, 0 for 100 ms worth of _bytes
+     * @param _burst_frames frame bucket size, 0 for 100 ms worth of _frames
+     */
+    void configure(const uint64_t _bytes, const uint32_t _frames, const uint64_t _burst_bytes = 0, const uint32_t _burst_frames = 0);
+
+    bool enabled() const { return 0 != bytes_ || 0 != frames_; }
+
+    /**
+     * Take the tokens of a frame of _size bytes if it may go at _now.
+     *
+     * @return 0 if taken, otherwise microseconds until it may go
+     */
+    uint64_t reserve(const size_t _size, const uint64_t _now);
+
+    /**
+     * Bytes/s let through over the last full second.
+     */
+    uint64_t rate() const { return rate_; }
+
+private:
+    void refill(const uint64_t _now);
+
+    uint64_t bytes_ = 0;
+    uint32_t frames_ = 0;
+    double burst_bytes_ = 0;
+    double burst_frames_ = 0;
+    double byte_tokens_ = 0;
+    double frame_tokens_ = 0;
+    uint64_t last_ = 0;         // refilled up to, us
+
+    uint64_t window_ = 0;       // start of the rate window, us
+    uint64_t window_bytes_ = 0;
+    uint64_t rate_ = 0;
+};
+
+#endif // __TOKEN_BUCKET_H__
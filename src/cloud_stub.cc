@@ -0,0 +1,250 @@
+#include <string.h>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "cloud_stub.h"
+#include "frame_assembler.h"
+#include "log.h"
+
+using namespace protocol;
+
+static int listen_on(const char _addr[], const uint32_t _port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(_port);
+
+    if (1 != inet_pton(AF_INET, _addr, &addr.sin_addr))
+    {
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (0 > fd)
+    {
+        return -1;
+    }
+
+    int value = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value));
+
+    if (0 != bind(fd, (struct sockaddr*)&addr, sizeof(addr)) || 0 != listen(fd, 1))
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static bool write_all(const int _fd, const uint8_t *_buf, size_t _size)
+{
+    while (0 < _size)
+    {
+        ssize_t n = ::send(_fd, _buf, _size, MSG_NOSIGNAL);
+
+        if (0 > n)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+
+            return false;
+        }
+
+        _buf += n;
+        _size -= n;
+    }
+
+    return true;
+}
+
+/**
+ * One accepted connection, answers requests on its own socket.
+ */
+class CloudStub::Session : public Packer::Handler
+{
+public:
+    Session(CloudStub &_stub, const int _fd): stub_(_stub), fd_(_fd) {}
+
+    void on_frame(const uint8_t *_frame, const size_t _size)
+    {
+        stub_.stats_.frames.fetch_add(1, std::memory_order_relaxed);
+        stub_.stats_.bytes.fetch_add(_size, std::memory_order_relaxed);
+
+        // states are only counted
+        if (VEH2CLOUD_STATE == _frame[FRAME_DATA_TYPE_POS])
+        {
+            stub_.stats_.states.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        Packer::unpack(_frame, _size, *this);
+    }
+
+    void on_unpack(const MessageHeader &_msg) override
+    {
+        if (HEARTBEAT != _msg.data_type_)
+        {
+            return;
+        }
+
+        stub_.stats_.heartbeats.fetch_add(1, std::memory_order_relaxed);
+
+        uint8_t buf[FRAME_HEADER_LENGTH];
+        MessageHeader res(0, HEARTBEAT_RES, _msg.version_, _msg.timestamp_, _msg.ctrl_);
+        write_all(fd_, buf, res.to_bytes(buf, sizeof(buf)));
+    }
+
+    void on_unpack(const Veh2CloudInh &_msg) override
+    {
+        stub_.stats_.inhs.fetch_add(1, std::memory_order_relaxed);
+
+        uint8_t buf[64];
+        Cloud2VehInhRes res(_msg.version_, _msg.timestamp_, _msg.ctrl_,
+            std::string(_msg.vehicle_id_, strnlen(_msg.vehicle_id_, sizeof(_msg.vehicle_id_))), stub_.inh_res_);
+        write_all(fd_, buf, res.to_bytes(buf, sizeof(buf)));
+    }
+
+private:
+    CloudStub &stub_;
+    int fd_;
+};
+
+CloudStub::~CloudStub()
+{
+    stop();
+}
+
+int32_t CloudStub::start(const char _addr[], const uint32_t _up_port, const uint32_t _down_port)
+{
+    if (!stopped_)
+    {
+        LOGE(TAG, "start: already started!\n");
+        return -1;
+    }
+
+    int up_listen = listen_on(_addr, _up_port);
+    int down_listen = listen_on(_addr, _down_port);
+
+    if (0 > up_listen || 0 > down_listen)
+    {
+        LOGE(TAG, "start: listen on %s %u/%u error(%d), %s!\n", _addr, _up_port, _down_port, errno, strerror(errno));
+
+        if (0 <= up_listen) ::close(up_listen);
+        if (0 <= down_listen) ::close(down_listen);
+
+        return -1;
+    }
+
+    stopped_ = false;
+    up_listen_fd_ = up_listen;
+    down_listen_fd_ = down_listen;
+
+    up_thread_ = std::thread([this, up_listen]()
+    {
+        this->serve(up_listen, up_fd_);
+    });
+
+    down_thread_ = std::thread([this, down_listen]()
+    {
+        this->serve(down_listen, down_fd_);
+    });
+
+    return 0;
+}
+
+void CloudStub::stop()
+{
+    if (stopped_)
+    {
+        return;
+    }
+
+    stopped_ = true;
+
+    // wake accept() and recv()
+    for (std::atomic<int> *fd : {&up_listen_fd_, &down_listen_fd_, &up_fd_, &down_fd_})
+    {
+        int value = fd->load();
+
+        if (0 <= value)
+        {
+            shutdown(value, SHUT_RDWR);
+        }
+    }
+
+    up_thread_.join();
+    down_thread_.join();
+
+    ::close(up_listen_fd_.exchange(-1));
+    ::close(down_listen_fd_.exchange(-1));
+}
+
+// private
+
+void CloudStub::serve(const int _listen_fd, std::atomic<int> &_fd)
+{
+    uint8_t buf[16384];
+
+    while (!stopped_)
+    {
+        int fd = accept(_listen_fd, nullptr, nullptr);
+
+        if (0 > fd)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        int value = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+
+        _fd = fd;
+        stats_.connections.fetch_add(1, std::memory_order_relaxed);
+
+        // closed by stop() between accept and the store
+        if (stopped_)
+        {
+            shutdown(fd, SHUT_RDWR);
+        }
+
+        Session session(*this, fd);
+        FrameAssembler assembler;
+
+        while (true)
+        {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+
+            if (0 > n && EINTR == errno)
+            {
+                continue;
+            }
+
+            if (0 >= n)
+            {
+                break;
+            }
+
+            assembler.feed(buf, n, [&session](const uint8_t *_frame, const size_t _size)
+            {
+                session.on_frame(_frame, _size);
+            });
+        }
+
+        _fd = -1;
+        ::close(fd);
+    }
+}
@@ -1,23 +1,141 @@
+#include <chrono>
+
 #include "controller.h"
 #include "log.h"
 #include "util.h"
 
-Controller::~Controller()
+#define FRAMES_HELP    "Frames sent and received per direction."
+#define BYTES_HELP     "Bytes sent and received per direction."
+#define CALLBACK_HELP  "Time spent in Controller::Callback methods, ns."
+#define LATENCY_HELP   "One-way latency corrected by the cloud clock offset, ms."
+#define PACER_RATE_HELP  "Upstream bytes/s let through by the pacer over the last second."
+#define PACER_DELAY_HELP "Time frames waited at the head of the queue for pacer tokens, us."
+
+#define SPOOL_REPLAY_TICK  10 // ms
+#define SPOOL_REPLAY_QUEUE 4  // frames queued before replay holds back
+
+#define ADAPT_TICK  200 // ms between state rate updates
+#define ADAPT_PROBE 1000 // ms without an RTT sample before a heartbeat probes a busy link
+
+/**
+ * Controller metrics, shared by all controllers of the process.
+ */
+struct ControllerMetrics
 {
-    stop();
+    ControllerMetrics():
+        frames{
+            &Metrics::instance().counter("csae_frames_total", FRAMES_HELP, "direction=\"up_tx\""),
+            &Metrics::instance().counter("csae_frames_total", FRAMES_HELP, "direction=\"up_rx\""),
+            &Metrics::instance().counter("csae_frames_total", FRAMES_HELP, "direction=\"down_tx\""),
+            &Metrics::instance().counter("csae_frames_total", FRAMES_HELP, "direction=\"down_rx\"")},
+        bytes{
+            &Metrics::instance().counter("csae_bytes_total", BYTES_HELP, "direction=\"up_tx\""),
+            &Metrics::instance().counter("csae_bytes_total", BYTES_HELP, "direction=\"up_rx\""),
+            &Metrics::instance().counter("csae_bytes_total", BYTES_HELP, "direction=\"down_tx\""),
+            &Metrics::instance().counter("csae_bytes_total", BYTES_HELP, "direction=\"down_rx\"")},
+        send_errors{
+            &Metrics::instance().counter("csae_send_errors_total", "Frames not fully written.", "direction=\"up\""),
+            &Metrics::instance().counter("csae_send_errors_total", "Frames not fully written.", "direction=\"down\"")},
+        queue_depth{
+            &Metrics::instance().gauge("csae_send_queue_depth", "Frames waiting in the send queue.", "direction=\"up\""),
+            &Metrics::instance().gauge("csae_send_queue_depth", "Frames waiting in the send queue.", "direction=\"down\"")},
+        queue_puts{
+            &Metrics::instance().counter("csae_send_queue_puts_total", "Frames queued for sending.", "direction=\"up\""),
+            &Metrics::instance().counter("csae_send_queue_puts_total", "Frames queued for sending.", "direction=\"down\"")},
+        connects{
+            &Metrics::instance().counter("csae_connects_total", "Connections established.", "direction=\"up\""),
+            &Metrics::instance().counter("csae_connects_total", "Connections established.", "direction=\"down\"")},
+        disconnects{
+            &Metrics::instance().counter("csae_disconnects_total", "Connections lost.", "direction=\"up\""),
+            &Metrics::instance().counter("csae_disconnects_total", "Connections lost.", "direction=\"down\"")},
+        callback_up_connect_state(Metrics::instance().histogram("csae_callback_ns", CALLBACK_HELP, "callback=\"up_connect_state\"")),
+        callback_down_connect_state(Metrics::instance().histogram("csae_callback_ns", CALLBACK_HELP, "callback=\"down_connect_state\"")),
+        callback_inh_res(Metrics::instance().histogram("csae_callback_ns", CALLBACK_HELP, "callback=\"cloud2veh_inh_res\"")),
+        callback_heartbeat_dead(Metrics::instance().histogram("csae_callback_ns", CALLBACK_HELP, "callback=\"heartbeat_dead\"")),
+        callback_state(Metrics::instance().histogram("csae_callback_ns", CALLBACK_HELP, "callback=\"veh2cloud_state\"")),
+        callback_state_batch(Metrics::instance().histogram("csae_callback_ns", CALLBACK_HELP, "callback=\"veh2cloud_state_batch\"")),
+        pacer_rate{
+            &Metrics::instance().gauge("csae_pacer_rate_bytes", PACER_RATE_HELP, "class=\"data\""),
+            &Metrics::instance().gauge("csae_pacer_rate_bytes", PACER_RATE_HELP, "class=\"control\"")},
+        pacer_delay{
+            &Metrics::instance().histogram("csae_pacer_delay_us", PACER_DELAY_HELP, "class=\"data\""),
+            &Metrics::instance().histogram("csae_pacer_delay_us", PACER_DELAY_HELP, "class=\"control\"")},
+        pacer_held{
+            &Metrics::instance().counter("csae_pacer_held_total", "Frames held back by the pacer.", "class=\"data\""),
+            &Metrics::instance().counter("csae_pacer_held_total", "Frames held back by the pacer.", "class=\"control\"")},
+        state_rate(Metrics::instance().gauge("csae_state_rate_mhz", "Veh2CloudState rate allowed by the adaptive rate, mHz.")),
+        congested(Metrics::instance().counter("csae_state_rate_congested_total", "Rate updates that found the link congested.")),
+        replayed(&Metrics::instance().counter("csae_spool_replayed_total", "Spooled frames queued for sending.")),
+        state_batch_size(Metrics::instance().histogram("csae_batch_size", "Messages per batch callback.", "type=\"state\"")),
+        uplink(Metrics::instance().histogram("csae_one_way_latency_ms", LATENCY_HELP, "direction=\"up\"")),
+        downlink(Metrics::instance().histogram("csae_one_way_latency_ms", LATENCY_HELP, "direction=\"down\"")),
+        clock_offset(Metrics::instance().gauge("csae_clock_offset_ms", "Cloud minus vehicle clock, ms.")),
+        clock_drift(Metrics::instance().gauge("csae_clock_drift_ppb", "Cloud clock rate relative to the vehicle's, ppb."))
+    {
+    }
+
+    Counter   *frames[4];      // by RECORD_* direction
+    Counter   *bytes[4];
+    Counter   *send_errors[2]; // up, down
+    Gauge     *queue_depth[2];
+    Counter   *queue_puts[2];
+    Counter   *connects[2];
+    Counter   *disconnects[2];
+    Histogram &callback_up_connect_state;
+    Histogram &callback_down_connect_state;
+    Histogram &callback_inh_res;
+    Histogram &callback_heartbeat_dead;
+    Histogram &callback_state;
+    Histogram &callback_state_batch;
+    Gauge     *pacer_rate[2];  // by PACE_*
+    Histogram *pacer_delay[2];
+    Counter   *pacer_held[2];
+    Gauge     &state_rate;
+    Counter   &congested;
+    Counter   *replayed;
+    Histogram &state_batch_size;
+    Histogram &uplink;         // request sent to cloud timestamp_
+    Histogram &downlink;       // cloud timestamp_ to frame received
+    Gauge     &clock_offset;
+    Gauge     &clock_drift;
+};
+
+static ControllerMetrics& metrics()
+{
+    static ControllerMetrics m;
+    return m;
 }
 
-void Controller::set_callback(Callback *_callback)
+static uint64_t now_ns()
 {
-    callback_ = _callback;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t now_us()
+{
+    return now_ns() / 1000;
+}
+
+Controller::Controller()
+{
+    up_send_queue_.set_metrics(metrics().queue_depth[0], metrics().queue_puts[0]);
+    up_control_queue_.set_metrics(metrics().queue_depth[0], metrics().queue_puts[0]);
+    down_send_queue_.set_metrics(metrics().queue_depth[1], metrics().queue_puts[1]);
+    wheel_.start();
 
     up_sock_.set_connect_state_callback([](const socketlib::ConnectState _state, void *_param)
     {
         Controller *p = (Controller*)_param;
 
+        (socketlib::ConnectState::CONNECTED == _state ? metrics().connects : metrics().disconnects)[0]->add();
+        p->up_connected_.store(socketlib::ConnectState::CONNECTED == _state, std::memory_order_release);
+
         if (nullptr != p->callback_)
         {
+            uint64_t begin = now_ns();
             p->callback_->on_up_connect_state(_state);
+            metrics().callback_up_connect_state.record(now_ns() - begin);
         }
     }, this);
 
@@ -25,20 +143,38 @@ void Controller::set_callback(Callback *_callback)
     {
         Controller *p = (Controller*)_param;
 
+        (socketlib::ConnectState::CONNECTED == _state ? metrics().connects : metrics().disconnects)[1]->add();
+
         if (nullptr != p->callback_)
         {
+            uint64_t begin = now_ns();
             p->callback_->on_down_connect_state(_state);
+            metrics().callback_down_connect_state.record(now_ns() - begin);
         }
     }, this);
 }
 
+Controller::~Controller()
+{
+    stop();
+    wheel_.stop();
+}
+
+void Controller::set_callback(Callback *_callback)
+{
+    callback_ = _callback;
+}
+
 void Controller::start(const char _up_addr[], const uint32_t _up_port, const char _down_addr[], const uint32_t _down_port)
 {
     stopped = false;
 
+    dispatcher_.start(dispatch_mode_, dispatch_workers_, dispatch_capacity_);
+
     // upstream
 
     // create socket and connect it to server
+    up_assembler_.reset();
     up_sock_.open(_up_addr, _up_port);
     
     // receive thread
@@ -56,6 +192,7 @@ void Controller::start(const char _up_addr[], const uint32_t _up_port, const cha
     // downstream
 
     // create socket and connect it to server
+    down_assembler_.reset();
     down_sock_.open(_down_addr, _down_port);
     
     // receive thread
@@ -69,6 +206,48 @@ void Controller::start(const char _up_addr[], const uint32_t _up_port, const cha
     {
         this->down_sock_send_thread();
     });
+
+    for (auto &link : links_)
+    {
+        link->start();
+    }
+
+    if (nullptr != spool_)
+    {
+        uint64_t gen = ++replay_gen_;
+
+        replay_budget_ = 0;
+        wheel_.schedule(SPOOL_REPLAY_TICK, [this, gen]()
+        {
+            this->replay(gen);
+        });
+    }
+
+    if (state_rate_.enabled())
+    {
+        uint64_t gen = ++adapt_gen_;
+
+        metrics().state_rate.set((int64_t)(state_rate_.rate() * 1000));
+        wheel_.schedule(ADAPT_TICK, [this, gen]()
+        {
+            this->adapt(gen);
+        });
+    }
+
+    // the adaptive rate needs an RTT also while traffic suppresses heartbeats
+    heartbeat_.probe(state_rate_.enabled() ? ADAPT_PROBE : 0);
+    heartbeat_.start([this](const uint64_t _timestamp)
+    {
+        this->send(MessageHeader(0, HEARTBEAT, 0x01, _timestamp, 0xFC));
+    }, [this](const uint32_t _missed)
+    {
+        if (nullptr != callback_)
+        {
+            uint64_t begin = now_ns();
+            callback_->on_heartbeat_dead(_missed);
+            metrics().callback_heartbeat_dead.record(now_ns() - begin);
+        }
+    });
 }
 
 void Controller::stop()
@@ -80,15 +259,44 @@ void Controller::stop()
 
     stopped = true;
 
+    heartbeat_.stop();
+    requests_.cancel_all();
+
     up_sock_.close();
     up_recv_thread_.join();
     up_send_queue_.notify();
     up_send_thread_.join();
+    up_connected_.store(false, std::memory_order_release);
+    replay_gen_++;
+    adapt_gen_++;
+
+    if (nullptr != spool_)
+    {
+        up_send_queue_.drain([this](std::shared_ptr<protocol::MessageBuffer> &_buf)
+        {
+            if (VEH2CLOUD_STATE == _buf->data[FRAME_DATA_TYPE_POS])
+            {
+                this->spool_->append(_buf->data, _buf->size);
+            }
+        });
+
+        up_control_queue_.drain([](std::shared_ptr<protocol::MessageBuffer> &_buf) {});
+    }
 
     down_sock_.close();
     down_recv_thread_.join();
     down_send_queue_.notify();
     down_send_thread_.join();
+
+    for (auto &link : links_)
+    {
+        link->stop();
+    }
+
+    // after the cancelled requests and the last batch were handed over
+    up_receiver_.batch.flush(true);
+    down_receiver_.batch.flush(true);
+    dispatcher_.stop();
 }
 
 // message
@@ -102,37 +310,96 @@ void Controller::send(const MessageHeader &_msg)
 void Controller::send(const Veh2CloudInh &_msg)
 {
     auto buf = Packer::pack(_msg);
-    up_send_queue_.put(buf); 
+    up_control_queue_.put(buf);
+    up_send_queue_.notify();
 }
 
 void Controller::send(const Cloud2VehInhRes &_msg)
 {
     auto buf = Packer::pack(_msg);
-    up_send_queue_.put(buf); 
+    up_control_queue_.put(buf);
+    up_send_queue_.notify();
 }
 
 void Controller::send(const Veh2CloudState &_msg)
 {
-    auto buf = Packer::pack(_msg);
-    up_send_queue_.put(buf); 
+    send(Packer::pack(_msg));
 }
 
-// virtual methods implementation
-
-void Controller::on_unpack(const MessageHeader &_msg)
+void Controller::send(const std::shared_ptr<protocol::MessageBuffer> &_state)
 {
-    std::cout << std::endl << _msg;
-
-    if (nullptr == callback_)
+    // store and forward while the link is down
+    if (nullptr != spool_ && (stopped || !up_connected_.load(std::memory_order_acquire)))
     {
+        spool_->append(_state->data, _state->size);
         return;
     }
 
+    up_send_queue_.put(_state);
+}
+
+void Controller::set_batch(const size_t _max, const uint32_t _latency)
+{
+    for (StateBatch *batch : {&up_receiver_.batch, &down_receiver_.batch})
+    {
+        batch->configure(_max, _latency, [this, batch](StateBatch::Batch *_batch)
+        {
+            this->on_state_batch(*batch, _batch);
+        });
+    }
+}
+
+int32_t Controller::request(const Veh2CloudInh &_msg, InhHandler _handler, const uint32_t _timeout, const uint32_t _tries)
+{
+    std::string vehicle_id(_msg.vehicle_id_, strnlen(_msg.vehicle_id_, sizeof(_msg.vehicle_id_)));
+    Veh2CloudInh msg = _msg;
+
+    return requests_.add(VEH2CLOUD_INH, vehicle_id, "inh", [this, msg](const uint64_t _timestamp) mutable
+    {
+        msg.timestamp_ = _timestamp;
+        this->send(msg);
+    }, [this, _handler](const int32_t _status, const MessageHeader *_res)
+    {
+        if (!_handler)
+        {
+            return;
+        }
+
+        // the response may not outlive this call
+        std::shared_ptr<Cloud2VehInhRes> res;
+
+        if (nullptr != _res)
+        {
+            res = std::make_shared<Cloud2VehInhRes>(*(const Cloud2VehInhRes*)_res);
+        }
+
+        this->dispatcher_.dispatch(CLOUD2VEH_INH_RES, [_handler, _status, res]()
+        {
+            _handler(_status, res.get());
+        });
+    }, _timeout, _tries);
+}
+
+// virtual methods implementation
+
+void Controller::on_unpack(const MessageHeader &_msg)
+{
+    tracer_.message(_msg);
+    on_received(_msg);
+
     switch (_msg.data_type_)
     {
     case HEARTBEAT_RES:
-        // TODO: 
+    {
+        uint64_t request = 0;
+
+        if (heartbeat_.response(_msg.timestamp_, &request))
+        {
+            on_round_trip(request, _msg.timestamp_);
+        }
+
         break;
+    }
     
     default:
         break;
@@ -141,26 +408,280 @@ void Controller::on_unpack(const MessageHeader &_msg)
 
 void Controller::on_unpack(const Veh2CloudInh &_msg)
 {
-    std::cout << std::endl << _msg;
+    tracer_.message(_msg);
+    on_received(_msg);
 }
 
 void Controller::on_unpack(const Cloud2VehInhRes &_msg)
 {
-    std::cout << std::endl << _msg;
+    uint64_t request = 0;
+    uint64_t rtt = 0;
+
+    tracer_.message(_msg);
+    on_received(_msg);
+
+    if (requests_.complete(VEH2CLOUD_INH, std::string(_msg.vehicle_id_, strnlen(_msg.vehicle_id_, sizeof(_msg.vehicle_id_))), _msg, &request, &rtt)
+        && 0 != request)
+    {
+        heartbeat_.sample(rtt);
+        on_round_trip(request, _msg.timestamp_);
+    }
 
     if (nullptr != callback_)
     {
-        callback_->on_cloud2veh_inh_res(_msg);
+        Callback *callback = callback_;
+
+        dispatcher_.dispatch(_msg.data_type_, [callback, _msg]()
+        {
+            uint64_t begin = now_ns();
+            callback->on_cloud2veh_inh_res(_msg);
+            metrics().callback_inh_res.record(now_ns() - begin);
+        });
     }
 }
 
 void Controller::on_unpack(const Veh2CloudState &_msg)
 {
-    std::cout << std::endl << _msg;
+    on_state(_msg, up_receiver_.batch);
+}
+
+void Controller::on_unpack(const Pooled<Veh2CloudState> &_msg)
+{
+    on_state(_msg, up_receiver_.batch);
 }
 
 // private
 
+void Controller::on_state(const Veh2CloudState &_msg, StateBatch &_batch)
+{
+    tracer_.message(_msg);
+    on_received(_msg);
+
+    if (nullptr == callback_)
+    {
+        return;
+    }
+
+    if (_batch.enabled())
+    {
+        _batch.add(_msg);
+        return;
+    }
+
+    Callback *callback = callback_;
+
+    dispatcher_.dispatch(_msg.data_type_, [callback, _msg]()
+    {
+        uint64_t begin = now_ns();
+        callback->on_veh2cloud_state(_msg);
+        metrics().callback_state.record(now_ns() - begin);
+    });
+}
+
+void Controller::on_state(const Pooled<Veh2CloudState> &_msg, StateBatch &_batch)
+{
+    tracer_.message(*_msg);
+    on_received(*_msg);
+
+    if (nullptr == callback_)
+    {
+        return;
+    }
+
+    if (_batch.enabled())
+    {
+        _batch.add(*_msg);
+        return;
+    }
+
+    Callback *callback = callback_;
+
+    // no task to build, the handle is all a frame costs
+    if (DISPATCH_INLINE == dispatcher_.mode())
+    {
+        uint64_t begin = now_ns();
+        callback->on_veh2cloud_state(_msg);
+        metrics().callback_state.record(now_ns() - begin);
+        return;
+    }
+
+    dispatcher_.dispatch(_msg->data_type_, [callback, _msg]()
+    {
+        uint64_t begin = now_ns();
+        callback->on_veh2cloud_state(_msg);
+        metrics().callback_state.record(now_ns() - begin);
+    });
+}
+
+void Controller::on_frame(const uint8_t _direction, const uint8_t *_frame, const size_t _size)
+{
+    // TRACE_* flags are the RECORD_* directions as bits
+    tracer_.frame(1 << _direction, _frame, _size);
+    metrics().frames[_direction]->add();
+    metrics().bytes[_direction]->add(_size);
+
+    if (nullptr != recorder_)
+    {
+        recorder_->record(_direction, _frame, _size);
+    }
+
+    if (RECORD_UP_RX == _direction)
+    {
+        up_codec_.dispatch(_frame, _size, up_receiver_);
+    }
+    else
+    {
+        down_codec_.dispatch(_frame, _size, down_receiver_);
+    }
+}
+
+void Controller::on_round_trip(const uint64_t _request, const uint64_t _remote)
+{
+    // nothing to learn from a response that echoes the request time
+    if (!clock_.sample(_request, _remote, get_utc_timestamp_ms()))
+    {
+        return;
+    }
+
+    int64_t uplink = clock_.uplink(_request, _remote);
+    ClockStats stats = clock_.stats();
+
+    metrics().uplink.record(0 > uplink ? 0 : uplink);
+    metrics().clock_offset.set(stats.offset);
+    metrics().clock_drift.set((int64_t)(stats.drift * 1e3));
+}
+
+void Controller::on_state_batch(StateBatch &_owner, StateBatch::Batch *_batch)
+{
+    Callback *callback = callback_;
+    StateBatch *owner = &_owner;
+
+    metrics().state_batch_size.record(_batch->size());
+    dispatcher_.dispatch(VEH2CLOUD_STATE, [callback, owner, _batch]()
+    {
+        if (nullptr != callback)
+        {
+            uint64_t begin = now_ns();
+            callback->on_veh2cloud_state_batch(_batch->data(), _batch->size());
+            metrics().callback_state_batch.record(now_ns() - begin);
+        }
+
+        owner->release(_batch);
+    });
+}
+
+void Controller::replay(const uint64_t _gen)
+{
+    if (_gen != replay_gen_ || stopped)
+    {
+        return;
+    }
+
+    if (up_connected_.load(std::memory_order_acquire) && 0 != spool_->count())
+    {
+        replay_budget_ += spool_rate_ * SPOOL_REPLAY_TICK;
+
+        // live frames first
+        while (1000 <= replay_budget_ && SPOOL_REPLAY_QUEUE > up_send_queue_.pending() && spool_->front(replay_frame_))
+        {
+            std::shared_ptr<MessageBuffer> buf((MessageBuffer*)new uint8_t[replay_frame_.size() + sizeof(MessageBuffer)],
+                MessageBuffer::deleter<MessageBuffer>);
+
+            buf->size = replay_frame_.size();
+            memcpy(buf->data, replay_frame_.data(), buf->size);
+            up_send_queue_.put(buf);
+            spool_->pop();
+            metrics().replayed->add();
+            replay_budget_ -= 1000;
+        }
+
+        // no bursts after an idle spell
+        if (replay_budget_ > spool_rate_ * SPOOL_REPLAY_TICK)
+        {
+            replay_budget_ = spool_rate_ * SPOOL_REPLAY_TICK;
+        }
+    }
+    else
+    {
+        replay_budget_ = 0;
+    }
+
+    wheel_.schedule(SPOOL_REPLAY_TICK, [this, _gen]()
+    {
+        this->replay(_gen);
+    });
+}
+
+void Controller::adapt(const uint64_t _gen)
+{
+    if (_gen != adapt_gen_ || stopped)
+    {
+        return;
+    }
+
+    HeartbeatStats hb = heartbeat_.stats();
+    double rate = state_rate_.update(up_send_queue_.pending(), hb.srtt, hb.min_rtt);
+
+    if (state_rate_.congested())
+    {
+        metrics().congested.add();
+    }
+
+    metrics().state_rate.set((int64_t)(rate * 1000));
+
+    wheel_.schedule(ADAPT_TICK, [this, _gen]()
+    {
+        this->adapt(_gen);
+    });
+}
+
+bool Controller::pace(const uint8_t _class, const size_t _size)
+{
+    TokenBucket &pacer = pacers_[_class];
+
+    if (!pacer.enabled())
+    {
+        return true;
+    }
+
+    uint64_t now = now_us();
+    uint64_t wait = pacer.reserve(_size, now);
+
+    if (0 == wait)
+    {
+        metrics().pacer_delay[_class]->record(0 != held_since_[_class] ? now - held_since_[_class] : 0);
+        metrics().pacer_rate[_class]->set(pacer.rate());
+        held_since_[_class] = 0;
+        return true;
+    }
+
+    if (0 == held_since_[_class])
+    {
+        held_since_[_class] = now;
+        metrics().pacer_held[_class]->add();
+    }
+
+    // sleep until the tokens are due, a control frame or stop() wakes early
+    uint64_t timer = wheel_.schedule((uint32_t)((wait + 999) / 1000), [this]()
+    {
+        this->up_send_queue_.notify();
+    });
+
+    up_send_queue_.wait();
+    wheel_.cancel(timer);
+
+    return false;
+}
+
+void Controller::on_received(const MessageHeader &_msg)
+{
+    if (clock_.synced())
+    {
+        int64_t downlink = clock_.downlink(_msg.timestamp_, get_utc_timestamp_ms());
+        metrics().downlink.record(0 > downlink ? 0 : downlink);
+    }
+}
+
 // upstream
 
 void Controller::up_sock_recv_thread()
@@ -191,27 +712,63 @@ void Controller::up_sock_recv_thread()
             }
         }
         
-        printf("\n");
-        print_buffer("SOCK-RX(UP)", 0, buf, size);
-        Packer::unpack(buf, size, *this);
+        up_assembler_.feed(buf, size, [this](const uint8_t *_frame, const size_t _size)
+        {
+            this->on_frame(RECORD_UP_RX, _frame, _size);
+        });
+
+        // one batch callback per read
+        up_receiver_.batch.flush();
     }
 }
 
 void Controller::up_sock_send_thread()
 {
     while (!stopped)
-    {	
-        auto p = up_send_queue_.take();
+    {
+        // control frames first, take() returns null when one is queued
+        uint8_t pace_class = 0 != up_control_queue_.pending() ? PACE_CONTROL : PACE_DATA;
+        auto &queue = PACE_CONTROL == pace_class ? up_control_queue_ : up_send_queue_;
+        auto p = queue.take();
 
         if (nullptr == p)
         {
             continue;
         }
-        
-        printf("\n");
-        print_buffer("SOCK-TX(UP)", 0, p->data, p->size);
-        up_sock_.send(p->data, p->size);
-        up_send_queue_.pull();
+
+        if (!pace(pace_class, p->size))
+        {
+            continue;
+        }
+
+        tracer_.frame(TRACE_UP_TX, p->data, p->size);
+
+        bool state = nullptr != spool_ && VEH2CLOUD_STATE == p->data[FRAME_DATA_TYPE_POS];
+
+        if ((ssize_t)p->size != up_sock_.send(p->data, p->size))
+        {
+            metrics().send_errors[0]->add();
+
+            // keep it for the next connection
+            if (state)
+            {
+                spool_->append(p->data, p->size);
+            }
+        }
+        else if (state)
+        {
+            spool_->sent(p->data, p->size);
+        }
+
+        metrics().frames[RECORD_UP_TX]->add();
+        metrics().bytes[RECORD_UP_TX]->add(p->size);
+
+        if (nullptr != recorder_)
+        {
+            recorder_->record(RECORD_UP_TX, p->data, p->size);
+        }
+
+        queue.pull();
     }
 }
 
@@ -245,9 +802,14 @@ void Controller::down_sock_recv_thread()
             }
         }
         
-        printf("\n");
-        print_buffer("SOCK-RX(DOWN)", 0, buf, size);
-        Packer::unpack(buf, size, *this);
+        heartbeat_.activity();
+        down_assembler_.feed(buf, size, [this](const uint8_t *_frame, const size_t _size)
+        {
+            this->on_frame(RECORD_DOWN_RX, _frame, _size);
+        });
+
+        // one batch callback per read
+        down_receiver_.batch.flush();
     }
 }
 
@@ -262,9 +824,21 @@ void Controller::down_sock_send_thread()
             continue;
         }
         
-        printf("\n");
-        print_buffer("SOCK-TX(DOWN)",0, p->data, p->size);
-        down_sock_.send(p->data, p->size);
+        tracer_.frame(TRACE_DOWN_TX, p->data, p->size);
+
+        if ((ssize_t)p->size != down_sock_.send(p->data, p->size))
+        {
+            metrics().send_errors[1]->add();
+        }
+
+        metrics().frames[RECORD_DOWN_TX]->add();
+        metrics().bytes[RECORD_DOWN_TX]->add(p->size);
+
+        if (nullptr != recorder_)
+        {
+            recorder_->record(RECORD_DOWN_TX, p->data, p->size);
+        }
+
         down_send_queue_.pull();
     }
 }
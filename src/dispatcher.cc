@@ -0,0 +1,298 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <chrono>
+
+#include "dispatcher.h"
+#include "log.h"
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Dispatcher::Dispatcher():
+    delay_(Metrics::instance().histogram("csae_dispatch_delay_ns", "Callback dispatch to start, ns.")),
+    depth_(Metrics::instance().gauge("csae_dispatch_queue_depth", "Callbacks waiting to run.")),
+    full_(Metrics::instance().counter("csae_dispatch_full_total", "Dispatches that waited for a full queue."))
+{
+}
+
+Dispatcher::~Dispatcher()
+{
+    stop();
+    reap();
+
+    // destroyed from a task, the worker still runs on its queue
+    for (auto &q : queues_)
+    {
+        if (q->thread.joinable())
+        {
+            q->thread.detach();
+            q.release();
+        }
+    }
+
+    for (auto &q : retired_)
+    {
+        q->thread.detach();
+        q.release();
+    }
+}
+
+int32_t Dispatcher::start(const uint32_t _mode, const size_t _workers, const size_t _capacity)
+{
+    if (!stopped_)
+    {
+        LOGE(TAG, "start: already started!\n");
+        return -1;
+    }
+
+    if (DISPATCH_POOL != _mode && DISPATCH_LOOP != _mode)
+    {
+        mode_ = DISPATCH_INLINE;
+        return 0;
+    }
+
+    if (DISPATCH_LOOP == _mode)
+    {
+        fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (0 > fd_)
+        {
+            LOGE(TAG, "start: eventfd error(%d), %s!\n", errno, strerror(errno));
+            return -1;
+        }
+    }
+
+    size_t count = DISPATCH_POOL == _mode ? (0 == _workers ? 1 : _workers) : 1;
+
+    reap();
+
+    // the queue of the worker calling start() lives until it returns to it
+    for (auto &q : queues_)
+    {
+        if (q->thread.joinable())
+        {
+            retired_.push_back(std::move(q));
+        }
+    }
+
+    mode_ = _mode;
+    capacity_ = 0 == _capacity ? 1 : _capacity;
+    queues_.clear();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        queues_.emplace_back(new Queue());
+    }
+
+    stopped_ = false;
+
+    if (DISPATCH_POOL == _mode)
+    {
+        for (auto &q : queues_)
+        {
+            Queue *queue = q.get();
+
+            queue->thread = std::thread([this, queue]()
+            {
+                this->work(*queue);
+            });
+        }
+    }
+
+    return 0;
+}
+
+void Dispatcher::stop()
+{
+    if (stopped_.exchange(true))
+    {
+        return;
+    }
+
+    for (auto &q : queues_)
+    {
+        std::lock_guard<std::mutex> lock(q->mutex);
+
+        q->stopped = true;
+        q->not_empty.notify_all();
+        q->not_full.notify_all();
+    }
+
+    if (DISPATCH_POOL == mode_)
+    {
+        for (auto &q : queues_)
+        {
+            // stopped from one of its own tasks, joined by reap()
+            if (std::this_thread::get_id() != q->thread.get_id())
+            {
+                q->thread.join();
+            }
+        }
+    }
+    else if (DISPATCH_LOOP == mode_)
+    {
+        for (auto &q : queues_)
+        {
+            std::lock_guard<std::mutex> lock(q->mutex);
+
+            depth_.sub(q->items.size());
+            q->items.clear();
+        }
+
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+void Dispatcher::dispatch(const uint8_t _key, task _task)
+{
+    if (stopped_)
+    {
+        _task();
+        return;
+    }
+
+    Queue &q = *queues_[_key % queues_.size()];
+    bool queued = false;
+
+    {
+        std::unique_lock<std::mutex> lock(q.mutex);
+
+        // a task dispatching to its own full queue would wait forever
+        if (capacity_ <= q.items.size() && std::this_thread::get_id() != q.thread.get_id())
+        {
+            full_.add();
+            q.not_full.wait(lock, [this, &q]()
+            {
+                return capacity_ > q.items.size() || stopped_;
+            });
+        }
+
+        if (!stopped_)
+        {
+            q.items.push_back(Item{std::move(_task), now_ns()});
+            depth_.add();
+            q.not_empty.notify_one();
+            queued = true;
+        }
+    }
+
+    // stopped while waiting
+    if (!queued)
+    {
+        _task();
+        return;
+    }
+
+    if (DISPATCH_LOOP == mode_)
+    {
+        uint64_t one = 1;
+
+        if (sizeof(one) != write(fd_, &one, sizeof(one)))
+        {
+            LOGE(TAG, "dispatch: eventfd write error(%d), %s!\n", errno, strerror(errno));
+        }
+    }
+}
+
+size_t Dispatcher::run()
+{
+    if (DISPATCH_LOOP != mode_ || stopped_)
+    {
+        return 0;
+    }
+
+    uint64_t count = 0;
+    std::deque<Item> items;
+    Queue &q = *queues_[0];
+
+    // clear the readiness first, later dispatches set it again
+    if (0 > read(fd_, &count, sizeof(count)) && EAGAIN != errno)
+    {
+        LOGE(TAG, "run: eventfd read error(%d), %s!\n", errno, strerror(errno));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+
+        items.swap(q.items);
+        depth_.sub(items.size());
+        q.not_full.notify_all();
+    }
+
+    for (auto &item : items)
+    {
+        execute(item);
+    }
+
+    return items.size();
+}
+
+// private
+
+void Dispatcher::work(Queue &_queue)
+{
+    while (true)
+    {
+        Item item;
+
+        {
+            std::unique_lock<std::mutex> lock(_queue.mutex);
+
+            // not stopped_, a later start() may clear it before a retired
+            // worker gets here
+            _queue.not_empty.wait(lock, [&_queue]()
+            {
+                return !_queue.items.empty() || _queue.stopped;
+            });
+
+            // drained
+            if (_queue.items.empty())
+            {
+                return;
+            }
+
+            item = std::move(_queue.items.front());
+            _queue.items.pop_front();
+            depth_.sub();
+            _queue.not_full.notify_one();
+        }
+
+        execute(item);
+    }
+}
+
+void Dispatcher::reap()
+{
+    for (auto &q : queues_)
+    {
+        if (q->thread.joinable() && std::this_thread::get_id() != q->thread.get_id())
+        {
+            q->thread.join();
+        }
+    }
+
+    for (auto it = retired_.begin(); it != retired_.end(); )
+    {
+        if (std::this_thread::get_id() == (*it)->thread.get_id())
+        {
+            ++it;
+            continue;
+        }
+
+        (*it)->thread.join();
+        it = retired_.erase(it);
+    }
+}
+
+void Dispatcher::execute(Item &_item)
+{
+    delay_.record(now_ns() - _item.time);
+    _item.fn();
+}
@@ -0,0 +1,336 @@
+#include <string.h>
+
+#include <chrono>
+#include <string>
+
+#include "heartbeat.h"
+#include "log.h"
+#include "util.h"
+
+#define HEARTBEATS_HELP "Heartbeats sent, suppressed by traffic and missed."
+
+static uint64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string link_label(const char _link[], const char _state[] = nullptr)
+{
+    std::string labels = std::string("link=\"") + _link + "\"";
+
+    if (nullptr != _state)
+    {
+        labels += std::string(",state=\"") + _state + "\"";
+    }
+
+    return labels;
+}
+
+Heartbeat::Heartbeat(TimerWheel &_wheel, const char _link[]):
+    wheel_(_wheel),
+    rtt_(Metrics::instance().histogram("csae_heartbeat_rtt_us", "Heartbeat to HEARTBEAT_RES, us.", link_label(_link).c_str())),
+    srtt_(Metrics::instance().gauge("csae_heartbeat_srtt_us", "Smoothed heartbeat RTT, us.", link_label(_link).c_str())),
+    rttvar_(Metrics::instance().gauge("csae_heartbeat_rttvar_us", "Heartbeat RTT variation, us.", link_label(_link).c_str())),
+    sent_total_(Metrics::instance().counter("csae_heartbeats_total", HEARTBEATS_HELP, link_label(_link, "sent").c_str())),
+    suppressed_total_(Metrics::instance().counter("csae_heartbeats_total", HEARTBEATS_HELP, link_label(_link, "suppressed").c_str())),
+    missed_total_(Metrics::instance().counter("csae_heartbeats_total", HEARTBEATS_HELP, link_label(_link, "missed").c_str()))
+{
+}
+
+Heartbeat::~Heartbeat()
+{
+    stop();
+}
+
+void Heartbeat::configure(const uint32_t _interval, const uint32_t _timeout, const uint32_t _max_missed)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    interval_ = _interval;
+    timeout_ = 0 == _timeout ? 1 : _timeout;
+    max_missed_ = 0 == _max_missed ? 1 : _max_missed;
+}
+
+void Heartbeat::probe(const uint32_t _interval)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    probe_ = _interval;
+}
+
+void Heartbeat::start(sender _send, dead_handler _dead)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (started_ || 0 == interval_)
+    {
+        return;
+    }
+
+    started_ = true;
+    gen_++;
+    outstanding_ = 0;
+    next_ = 0;
+    memset(sent_, 0, sizeof(sent_));
+    stats_ = HeartbeatStats();
+    send_ = std::move(_send);
+    dead_ = std::move(_dead);
+    last_sample_ = now_us();
+    last_rx_.store(last_sample_ / 1000, std::memory_order_relaxed);
+    schedule_idle(idle_interval());
+}
+
+void Heartbeat::stop()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!started_)
+    {
+        return;
+    }
+
+    started_ = false;
+    gen_++;
+    outstanding_ = 0;
+    wheel_.cancel(timer_);
+}
+
+void Heartbeat::activity()
+{
+    last_rx_.store(now_us() / 1000, std::memory_order_relaxed);
+}
+
+bool Heartbeat::response(const uint64_t _timestamp, uint64_t *_request)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!started_ || 0 == _timestamp)
+    {
+        return false;
+    }
+
+    size_t i = find(_timestamp);
+
+    // not an echo, the peer stamped its own time
+    if (RECENT == i && 0 != outstanding_)
+    {
+        i = find(outstanding_);
+    }
+
+    if (RECENT == i)
+    {
+        return false;
+    }
+
+    uint64_t request = sent_[i][0];
+
+    update(now_us() - sent_[i][1]);
+    sent_[i][0] = 0;
+    stats_.missed = 0;
+
+    if (outstanding_ == request)
+    {
+        outstanding_ = 0;
+        wheel_.cancel(timer_);
+        schedule_idle(idle_interval());
+    }
+
+    if (nullptr != _request)
+    {
+        *_request = request;
+    }
+
+    return true;
+}
+
+void Heartbeat::sample(const uint64_t _rtt)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (started_ && 0 != _rtt)
+    {
+        update(_rtt);
+    }
+}
+
+HeartbeatStats Heartbeat::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+// private
+
+size_t Heartbeat::find(const uint64_t _timestamp) const
+{
+    size_t i = 0;
+
+    while (i < RECENT && sent_[i][0] != _timestamp)
+    {
+        i++;
+    }
+
+    return i;
+}
+
+void Heartbeat::schedule_idle(const uint32_t _delay)
+{
+    uint64_t gen = gen_;
+
+    timer_ = wheel_.schedule(_delay, [this, gen]()
+    {
+        this->on_idle(gen);
+    });
+}
+
+void Heartbeat::on_idle(const uint64_t _gen)
+{
+    sender send;
+    uint64_t timestamp = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!started_ || _gen != gen_)
+        {
+            return;
+        }
+
+        uint64_t now = now_us();
+        uint64_t idle = now / 1000 - last_rx_.load(std::memory_order_relaxed);
+        uint64_t stale = (now - last_sample_) / 1000;
+
+        // traffic proved the peer alive, wait for a full idle interval again
+        // unless the RTT estimate needs a probe
+        if (idle < interval_ && (0 == probe_ || stale < probe_))
+        {
+            uint32_t delay = interval_ - (uint32_t)idle;
+
+            if (0 != probe_ && probe_ - stale < delay)
+            {
+                delay = probe_ - (uint32_t)stale;
+            }
+
+            stats_.suppressed++;
+            suppressed_total_.add();
+            schedule_idle(delay);
+            return;
+        }
+
+        timestamp = beat();
+        send = send_;
+    }
+
+    send(timestamp);
+}
+
+void Heartbeat::on_timeout(const uint64_t _gen, const uint64_t _timestamp)
+{
+    dead_handler dead;
+    sender send;
+    uint64_t timestamp = 0;
+    uint32_t missed = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!started_ || _gen != gen_ || outstanding_ != _timestamp)
+        {
+            return;
+        }
+
+        outstanding_ = 0;
+        missed = ++stats_.missed;
+        missed_total_.add();
+
+        // probe again right away rather than after another idle interval
+        if (missed < max_missed_)
+        {
+            timestamp = beat();
+            send = send_;
+        }
+        else
+        {
+            LOGW(TAG, "on_timeout: %u heartbeats missed, link dead!\n", missed);
+
+            started_ = false;
+            gen_++;
+            dead = dead_;
+        }
+    }
+
+    if (send)
+    {
+        send(timestamp);
+    }
+
+    if (dead)
+    {
+        dead(missed);
+    }
+}
+
+uint64_t Heartbeat::beat()
+{
+    uint64_t timestamp = get_utc_timestamp_ms();
+    uint64_t last = sent_[(next_ + RECENT - 1) % RECENT][0];
+
+    // keep the heartbeats distinguishable
+    if (timestamp <= last)
+    {
+        timestamp = last + 1;
+    }
+
+    sent_[next_][0] = timestamp;
+    sent_[next_][1] = now_us();
+    next_ = (next_ + 1) % RECENT;
+    outstanding_ = timestamp;
+    stats_.sent++;
+    sent_total_.add();
+
+    uint64_t gen = gen_;
+    timer_ = wheel_.schedule(timeout_, [this, gen, timestamp]()
+    {
+        this->on_timeout(gen, timestamp);
+    });
+
+    return timestamp;
+}
+
+uint32_t Heartbeat::idle_interval() const
+{
+    return 0 != probe_ && probe_ < interval_ ? probe_ : interval_;
+}
+
+void Heartbeat::update(const uint64_t _rtt)
+{
+    // RFC 6298
+    if (0 == stats_.samples)
+    {
+        stats_.srtt = _rtt;
+        stats_.rttvar = _rtt / 2;
+        stats_.min_rtt = _rtt;
+    }
+    else
+    {
+        uint64_t err = stats_.srtt > _rtt ? stats_.srtt - _rtt : _rtt - stats_.srtt;
+
+        stats_.rttvar = (3 * stats_.rttvar + err) / 4;
+        stats_.srtt = (7 * stats_.srtt + _rtt) / 8;
+
+        if (_rtt < stats_.min_rtt)
+        {
+            stats_.min_rtt = _rtt;
+        }
+    }
+
+    stats_.rto = stats_.srtt + 4 * stats_.rttvar;
+    stats_.last_rtt = _rtt;
+    stats_.samples++;
+    last_sample_ = now_us();
+
+    rtt_.record(_rtt);
+    srtt_.set(stats_.srtt);
+    rttvar_.set(stats_.rttvar);
+}
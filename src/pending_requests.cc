@@ -0,0 +1,206 @@
+#include <chrono>
+
+#include "pending_requests.h"
+#include "log.h"
+#include "util.h"
+
+static uint64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string type_label(const char _name[])
+{
+    return std::string("type=\"") + _name + "\"";
+}
+
+PendingRequests::~PendingRequests()
+{
+    cancel_all();
+}
+
+int32_t PendingRequests::add(const uint8_t _type, const std::string &_key, const char _name[],
+    sender _send, handler _done, const uint32_t _timeout, const uint32_t _tries)
+{
+    std::string labels = type_label(_name);
+    Metrics &metrics = Metrics::instance();
+    Request req;
+
+    req.send = std::move(_send);
+    req.done = std::move(_done);
+    req.timeout = _timeout;
+    req.tries = 0 == _tries ? 1 : _tries;
+    req.rtt = &metrics.histogram("csae_request_rtt_us", "Request to matching response, us.", labels.c_str());
+    req.duration = &metrics.histogram("csae_request_duration_us", "First send to completion, us.", labels.c_str());
+    req.retries = &metrics.counter("csae_request_retries_total", "Requests resent on timeout.", labels.c_str());
+    req.timeouts = &metrics.counter("csae_request_timeouts_total", "Requests failed after the last try.", labels.c_str());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Key key(_type, _key);
+
+    if (requests_.end() != requests_.find(key))
+    {
+        LOGE(TAG, "add: type 0x%02X key %s already pending!\n", _type, _key.c_str());
+        return -1;
+    }
+
+    req.seq = ++seq_;
+    req.attempts.reserve(req.tries);
+
+    Request &r = requests_.emplace(key, std::move(req)).first->second;
+
+    r.first = now_us();
+    attempt(key, r);
+
+    return 0;
+}
+
+bool PendingRequests::complete(const uint8_t _type, const std::string &_key, const protocol::MessageHeader &_res,
+    uint64_t *_request, uint64_t *_rtt)
+{
+    handler done;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = requests_.find(Key(_type, _key));
+
+        if (requests_.end() == it)
+        {
+            return false;
+        }
+
+        Request &req = it->second;
+        uint64_t now = now_us();
+        uint64_t request = 1 == req.attempts.size() ? req.attempts[0].first : 0;
+        uint64_t sent = 1 == req.attempts.size() ? req.attempts[0].second : 0;
+
+        for (auto &a : req.attempts)
+        {
+            if (a.first == _res.timestamp_)
+            {
+                request = a.first;
+                sent = a.second;
+                break;
+            }
+        }
+
+        if (nullptr != _request)
+        {
+            *_request = request;
+        }
+
+        if (nullptr != _rtt)
+        {
+            *_rtt = 0 != sent ? now - sent : 0;
+        }
+
+        // ambiguous otherwise, which attempt was answered is unknown
+        if (0 != sent)
+        {
+            req.rtt->record(now - sent);
+        }
+
+        req.duration->record(now - req.first);
+        wheel_.cancel(req.timer);
+        done = std::move(req.done);
+        requests_.erase(it);
+    }
+
+    if (done)
+    {
+        done(REQUEST_OK, &_res);
+    }
+
+    return true;
+}
+
+void PendingRequests::cancel_all()
+{
+    std::vector<handler> done;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        for (auto &r : requests_)
+        {
+            wheel_.cancel(r.second.timer);
+            done.push_back(std::move(r.second.done));
+        }
+
+        requests_.clear();
+    }
+
+    for (auto &d : done)
+    {
+        if (d)
+        {
+            d(REQUEST_CANCELLED, nullptr);
+        }
+    }
+}
+
+size_t PendingRequests::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return requests_.size();
+}
+
+// private
+
+void PendingRequests::attempt(const Key &_key, Request &_req)
+{
+    uint64_t timestamp = get_utc_timestamp_ms();
+
+    // keep the attempts of one request distinguishable
+    if (!_req.attempts.empty() && timestamp <= _req.attempts.back().first)
+    {
+        timestamp = _req.attempts.back().first + 1;
+    }
+
+    _req.attempts.push_back(std::make_pair(timestamp, now_us()));
+    _req.send(timestamp);
+
+    uint64_t seq = _req.seq;
+    _req.timer = wheel_.schedule(_req.timeout, [this, _key, seq]()
+    {
+        this->on_timeout(_key, seq);
+    });
+}
+
+void PendingRequests::on_timeout(const Key &_key, const uint64_t _seq)
+{
+    handler done;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = requests_.find(_key);
+
+        // completed meanwhile, or replaced by a newer request
+        if (requests_.end() == it || it->second.seq != _seq)
+        {
+            return;
+        }
+
+        Request &req = it->second;
+
+        if (req.attempts.size() < req.tries)
+        {
+            req.retries->add();
+            attempt(_key, req);
+            return;
+        }
+
+        LOGW(TAG, "on_timeout: type 0x%02X key %s no response after %zu tries!\n",
+            _key.first, _key.second.c_str(), req.attempts.size());
+
+        req.timeouts->add();
+        done = std::move(req.done);
+        requests_.erase(it);
+    }
+
+    if (done)
+    {
+        done(REQUEST_TIMEOUT, nullptr);
+    }
+}
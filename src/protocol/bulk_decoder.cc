@@ -0,0 +1,307 @@
+#include <string.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "bulk_decoder.h"
+#include "frame_assembler.h"
+#include "recorder.h"
+#include "log.h"
+
+namespace protocol
+{
+BulkDecoder::~BulkDecoder()
+{
+    close();
+}
+
+int32_t BulkDecoder::open(const char _path[])
+{
+    close();
+
+    int fd = ::open(_path, O_RDONLY);
+
+    if (0 > fd)
+    {
+        LOGE(TAG, "open: open %s error(%d), %s!\n", _path, errno, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+
+    if (0 != fstat(fd, &st) || 0 == st.st_size)
+    {
+        LOGE(TAG, "open: %s is empty!\n", _path);
+        ::close(fd);
+        return -1;
+    }
+
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (MAP_FAILED == p)
+    {
+        LOGE(TAG, "open: mmap %s error(%d), %s!\n", _path, errno, strerror(errno));
+        return -1;
+    }
+
+    madvise(p, st.st_size, MADV_WILLNEED);
+
+    data_ = (const uint8_t*)p;
+    size_ = st.st_size;
+    capture_ = sizeof(RecordSegmentHeader) <= size_ && RECORD_SEGMENT_MAGIC == ((const RecordSegmentHeader*)data_)->magic;
+
+    return 0;
+}
+
+void BulkDecoder::close()
+{
+    if (nullptr != data_)
+    {
+        munmap((void*)data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+        capture_ = false;
+    }
+}
+
+int32_t BulkDecoder::decode(Factory &_factory, size_t _threads, const size_t _chunk_size, Stats &_stats)
+{
+    if (nullptr == data_)
+    {
+        LOGE(TAG, "decode: not open!\n");
+        return -1;
+    }
+
+    if (0 == _threads)
+    {
+        _threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    size_t chunk_size = (std::max<size_t>(_chunk_size, 4 * MAX_FRAME) + 7) & ~(size_t)7;
+    size_t base = capture_ ? sizeof(RecordSegmentHeader) : 0;
+    size_t count = (size_ - base + chunk_size - 1) / chunk_size;
+    size_t window = 4 * _threads;
+    std::vector<Result> results(count);
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t next = 0;
+    size_t merged = 0;
+    auto begin = std::chrono::steady_clock::now();
+
+    // workers run at most window chunks ahead of the merge
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            size_t i = 0;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+
+                cond.wait(lock, [&]() { return next >= count || next < merged + window; });
+
+                if (next >= count)
+                {
+                    return;
+                }
+
+                i = next++;
+                results[i].handler = _factory.create(i);
+            }
+
+            size_t chunk_begin = base + i * chunk_size;
+            decode_chunk(chunk_begin, std::min(size_, chunk_begin + chunk_size), results[i]);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results[i].done = true;
+            }
+
+            cond.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < _threads; i++)
+    {
+        threads.emplace_back(worker);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&]() { return results[i].done; });
+        }
+
+        _stats.frames += results[i].frames;
+        _stats.skipped += results[i].skipped;
+        _factory.merge(results[i].handler);
+        results[i].handler = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            merged = i + 1;
+        }
+
+        cond.notify_all();
+    }
+
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+
+    _stats.bytes += size_;
+    _stats.chunks += count;
+    _stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    return 0;
+}
+
+// private
+
+void BulkDecoder::decode_chunk(const size_t _begin, const size_t _end, Result &_result) const
+{
+    if (capture_)
+    {
+        decode_capture(_begin, _end, _result);
+    }
+    else
+    {
+        decode_stream(_begin, _end, _result);
+    }
+}
+
+void BulkDecoder::decode_stream(const size_t _begin, const size_t _end, Result &_result) const
+{
+    size_t offset = sync_stream(_begin);
+
+    while (offset < _end)
+    {
+        size_t len = FrameAssembler::frame_length(data_ + offset, size_ - offset);
+
+        if (FRAME_IDENTIFIER != data_[offset] || FRAME_HEADER_LENGTH > len || MAX_FRAME < len || offset + len > size_)
+        {
+            size_t next = sync_stream(offset + 1);
+            _result.skipped += std::min(next, _end) - offset;
+            offset = next;
+            continue;
+        }
+
+        _result.handler->on_frame(data_ + offset, len);
+        Packer::unpack(data_ + offset, len, *_result.handler);
+        _result.frames++;
+        offset += len;
+    }
+}
+
+void BulkDecoder::decode_capture(const size_t _begin, const size_t _end, Result &_result) const
+{
+    size_t offset = std::max<size_t>(sizeof(RecordSegmentHeader), (_begin + 7) & ~(size_t)7);
+
+    // first record starting in the chunk, records are 8 byte aligned
+    while (offset + sizeof(RecordHeader) <= size_ && offset < _end)
+    {
+        const RecordHeader *record = (const RecordHeader*)(data_ + offset);
+
+        if (RECORD_MAGIC == record->magic && MAX_FRAME >= record->size
+            && offset + FrameRecorder::record_length(record->size) <= size_)
+        {
+            size_t next = offset + FrameRecorder::record_length(record->size);
+
+            if (next + sizeof(RecordHeader) > size_ || RECORD_MAGIC == ((const RecordHeader*)(data_ + next))->magic
+                || 0 == ((const RecordHeader*)(data_ + next))->magic)
+            {
+                break;
+            }
+        }
+
+        offset += 8;
+    }
+
+    while (offset < _end && offset + sizeof(RecordHeader) <= size_)
+    {
+        const RecordHeader *record = (const RecordHeader*)(data_ + offset);
+
+        // zero magic, end of a live segment
+        if (RECORD_MAGIC != record->magic || offset + FrameRecorder::record_length(record->size) > size_)
+        {
+            break;
+        }
+
+        const uint8_t *frame = (const uint8_t*)(record + 1);
+
+        _result.handler->on_frame(frame, record->size);
+        Packer::unpack(frame, record->size, *_result.handler);
+        _result.frames++;
+        offset += FrameRecorder::record_length(record->size);
+    }
+}
+
+size_t BulkDecoder::sync_stream(size_t _offset) const
+{
+    const uint8_t *end = data_ + size_;
+
+    while (_offset < size_)
+    {
+        const uint8_t *p = FrameAssembler::find_identifier(data_ + _offset, end);
+
+        if (end == p)
+        {
+            return size_;
+        }
+
+        _offset = p - data_;
+
+        // accept when data_len_ chains over the next two frames or to the end
+        size_t next = _offset;
+        int chained = 0;
+
+        for (; chained < 3; chained++)
+        {
+            if (next == size_ || next + FRAME_HEADER_LENGTH > size_)
+            {
+                chained = 3;
+                break;
+            }
+
+            size_t len = FrameAssembler::frame_length(data_ + next, size_ - next);
+
+            if (FRAME_IDENTIFIER != data_[next] || FRAME_HEADER_LENGTH > len || MAX_FRAME < len)
+            {
+                break;
+            }
+
+            // a successor cut by the end of the dump still confirms
+            if (next + len > size_)
+            {
+                chained = 0 == chained ? 0 : 3;
+                break;
+            }
+
+            next += len;
+        }
+
+        if (3 == chained)
+        {
+            return _offset;
+        }
+
+        _offset++;
+    }
+
+    return size_;
+}
+} // namespace protocal
@@ -0,0 +1,344 @@
+#include "domain.h"
+#include "state_builder.h"
+#include "log.h"
+
+#define INH_MAX_STRING 0xFE
+
+namespace protocol
+{
+static inline uint16_t get16(const uint8_t *_p)
+{
+    uint16_t v;
+    memcpy(&v, _p, sizeof(v));
+    return __builtin_bswap16(v);
+}
+
+static inline uint32_t get32(const uint8_t *_p)
+{
+    uint32_t v;
+    memcpy(&v, _p, sizeof(v));
+    return __builtin_bswap32(v);
+}
+
+static inline uint64_t get64(const uint8_t *_p)
+{
+    uint64_t v;
+    memcpy(&v, _p, sizeof(v));
+    return __builtin_bswap64(v);
+}
+
+static inline void put16(uint8_t *_p, const uint16_t _v)
+{
+    uint16_t v = __builtin_bswap16(_v);
+    memcpy(_p, &v, sizeof(v));
+}
+
+static inline void put32(uint8_t *_p, const uint32_t _v)
+{
+    uint32_t v = __builtin_bswap32(_v);
+    memcpy(_p, &v, sizeof(v));
+}
+
+static inline void put64(uint8_t *_p, const uint64_t _v)
+{
+    uint64_t v = __builtin_bswap64(_v);
+    memcpy(_p, &v, sizeof(v));
+}
+
+static void put_header(uint8_t *_buf, const uint32_t _data_len, const uint8_t _data_type,
+    const uint8_t _version, const uint64_t _timestamp, const uint8_t _ctrl)
+{
+    _buf[0] = 0xF2;
+    put32(_buf + 1, _data_len);
+    _buf[5] = _data_type;
+    _buf[6] = _version;
+    put64(_buf + 7, _timestamp);
+    _buf[15] = _ctrl;
+}
+
+// strings longer than the length byte allows go out empty
+static uint8_t string_length(const std::string &_s)
+{
+    return INH_MAX_STRING < _s.length() ? 0 : (uint8_t)_s.length();
+}
+
+size_t DomainCodec::decode(const void *_buf, const size_t _size, VehicleState &_state)
+{
+    const uint8_t *buf = (const uint8_t*)_buf;
+
+    if (nullptr == buf || StateBuilder::PASS_POS > _size || 0xF2 != buf[0] || VEH2CLOUD_STATE != buf[5])
+    {
+        LOGE(TAG, "decode: Not a state frame, size %ld!\n", _size);
+        return 0;
+    }
+
+    size_t count = buf[StateBuilder::PASS_POS_NUM];
+    size_t size = StateBuilder::PASS_POS + count * sizeof(Position2D);
+
+    if (size > _size)
+    {
+        LOGE(TAG, "decode: Invalid size %ld, pass position number %ld!\n", _size, count);
+        return 0;
+    }
+
+    _state.version = buf[6];
+    _state.timestamp = get64(buf + StateBuilder::TIMESTAMP);
+    _state.ctrl = buf[15];
+    memcpy(_state.vehicle_id, buf + StateBuilder::VEHICLE_ID, sizeof(_state.vehicle_id));
+    _state.message_id = get64(buf + StateBuilder::MESSAGE_ID);
+    _state.gnss_timestamp = get64(buf + StateBuilder::GNSS_TIMESTAMP);
+    _state.gnss_velocity = get16(buf + StateBuilder::GNSS_VELOCITY);
+    _state.position.longitude = get32(buf + StateBuilder::POSITION);
+    _state.position.latitude = get32(buf + StateBuilder::POSITION + 4);
+    _state.position.elevation = get32(buf + StateBuilder::POSITION + 8);
+    _state.heading = get32(buf + StateBuilder::HEADING);
+    _state.gear = buf[StateBuilder::GEAR];
+    _state.steering_angle = get32(buf + StateBuilder::STEERING_ANGLE);
+    _state.velocity = get16(buf + StateBuilder::VELOCITY);
+    _state.acc_lon = get16(buf + StateBuilder::ACC);
+    _state.acc_lat = get16(buf + StateBuilder::ACC + 2);
+    _state.acc_ver = get16(buf + StateBuilder::ACC + 4);
+    _state.yaw_rate = get16(buf + StateBuilder::YAW_RATE);
+    _state.accel_pos = get16(buf + StateBuilder::ACCEL_POS);
+    _state.engine_speed = get16(buf + StateBuilder::ENGINE_SPEED);
+    _state.engine_torque = get32(buf + StateBuilder::ENGINE_TORQUE);
+    _state.break_flag = buf[StateBuilder::BREAK_FLAG];
+    _state.break_pos = get16(buf + StateBuilder::BREAK_POS);
+    _state.break_pressure = get16(buf + StateBuilder::BREAK_PRESSURE);
+    _state.fuel_consume = get16(buf + StateBuilder::FUEL_CONSUME);
+    _state.drive_mode = buf[StateBuilder::DRIVE_MODE];
+    _state.dest_location.longitude = get32(buf + StateBuilder::DEST_LOCATION);
+    _state.dest_location.latitude = get32(buf + StateBuilder::DEST_LOCATION + 4);
+
+    _state.pass_pos.resize(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint8_t *p = buf + StateBuilder::PASS_POS + i * sizeof(Position2D);
+
+        _state.pass_pos[i].longitude = get32(p);
+        _state.pass_pos[i].latitude = get32(p + 4);
+    }
+
+    return size;
+}
+
+size_t DomainCodec::encode(const VehicleState &_state, void *_buf, const size_t _size)
+{
+    size_t count = StateBuilder::MAX_PASS_POS < _state.pass_pos.size() ? StateBuilder::MAX_PASS_POS : _state.pass_pos.size();
+    size_t size = StateBuilder::PASS_POS + count * sizeof(Position2D);
+    uint8_t *buf = (uint8_t*)_buf;
+
+    if (nullptr == buf || size > _size)
+    {
+        LOGE(TAG, "encode: Invalid size %ld, state size %ld!\n", _size, size);
+        return 0;
+    }
+
+    put_header(buf, size - MessageHeader::HEADER_LENGTH, VEH2CLOUD_STATE, _state.version, _state.timestamp, _state.ctrl);
+    memcpy(buf + StateBuilder::VEHICLE_ID, _state.vehicle_id, sizeof(_state.vehicle_id));
+    put64(buf + StateBuilder::MESSAGE_ID, _state.message_id);
+    put64(buf + StateBuilder::GNSS_TIMESTAMP, _state.gnss_timestamp);
+    put16(buf + StateBuilder::GNSS_VELOCITY, _state.gnss_velocity);
+    put32(buf + StateBuilder::POSITION, _state.position.longitude);
+    put32(buf + StateBuilder::POSITION + 4, _state.position.latitude);
+    put32(buf + StateBuilder::POSITION + 8, _state.position.elevation);
+    put32(buf + StateBuilder::HEADING, _state.heading);
+    buf[StateBuilder::GEAR] = _state.gear;
+    put32(buf + StateBuilder::STEERING_ANGLE, _state.steering_angle);
+    put16(buf + StateBuilder::VELOCITY, _state.velocity);
+    put16(buf + StateBuilder::ACC, _state.acc_lon);
+    put16(buf + StateBuilder::ACC + 2, _state.acc_lat);
+    put16(buf + StateBuilder::ACC + 4, _state.acc_ver);
+    put16(buf + StateBuilder::YAW_RATE, _state.yaw_rate);
+    put16(buf + StateBuilder::ACCEL_POS, _state.accel_pos);
+    put16(buf + StateBuilder::ENGINE_SPEED, _state.engine_speed);
+    put32(buf + StateBuilder::ENGINE_TORQUE, _state.engine_torque);
+    buf[StateBuilder::BREAK_FLAG] = _state.break_flag;
+    put16(buf + StateBuilder::BREAK_POS, _state.break_pos);
+    put16(buf + StateBuilder::BREAK_PRESSURE, _state.break_pressure);
+    put16(buf + StateBuilder::FUEL_CONSUME, _state.fuel_consume);
+    buf[StateBuilder::DRIVE_MODE] = _state.drive_mode;
+    put32(buf + StateBuilder::DEST_LOCATION, _state.dest_location.longitude);
+    put32(buf + StateBuilder::DEST_LOCATION + 4, _state.dest_location.latitude);
+    buf[StateBuilder::PASS_POS_NUM] = (uint8_t)count;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t *p = buf + StateBuilder::PASS_POS + i * sizeof(Position2D);
+
+        put32(p, _state.pass_pos[i].longitude);
+        put32(p + 4, _state.pass_pos[i].latitude);
+    }
+
+    return size;
+}
+
+size_t DomainCodec::decode(const void *_buf, const size_t _size, VehicleInh &_inh)
+{
+    const uint8_t *buf = (const uint8_t*)_buf;
+    size_t size = MessageHeader::HEADER_LENGTH + Veh2CloudInh::DATA_LENGTH;
+
+    if (nullptr == buf || size > _size || 0xF2 != buf[0] || VEH2CLOUD_INH != buf[5])
+    {
+        LOGE(TAG, "decode: Not an INH frame, size %ld!\n", _size);
+        return 0;
+    }
+
+    size = MessageHeader::HEADER_LENGTH + get32(buf + 1);
+
+    if (size > _size)
+    {
+        LOGE(TAG, "decode: Invalid size %ld, frame size %ld!\n", _size, size);
+        return 0;
+    }
+
+    size_t offset = MessageHeader::HEADER_LENGTH;
+
+    _inh.version = buf[6];
+    _inh.timestamp = get64(buf + 7);
+    _inh.ctrl = buf[15];
+    memcpy(_inh.vehicle_id, buf + offset, sizeof(_inh.vehicle_id));
+    offset += sizeof(_inh.vehicle_id);
+
+    // a length byte, then as many bytes unless 0xFF, bounded by the frame
+    auto string = [&](std::string &_s, const bool _ff)
+    {
+        size_t len = offset < size ? buf[offset++] : 0;
+
+        if (0xFF == len && !_ff)
+        {
+            len = 0;
+        }
+
+        len = size - offset < len ? size - offset : len;
+        _s.assign((const char*)buf + offset, len);
+        offset += len;
+    };
+
+    string(_inh.sw_ver, false);
+    string(_inh.hw_ver, false);
+    string(_inh.ad_ver, false);
+
+    if (size < offset + 5)
+    {
+        LOGE(TAG, "decode: Invalid size %ld, offset %ld!\n", size, offset);
+        return 0;
+    }
+
+    _inh.com_type = buf[offset++];
+    _inh.pos_confidence = buf[offset++];
+    _inh.time_sync = buf[offset++];
+    _inh.gnss_type = buf[offset++];
+    string(_inh.user_data, true);
+
+    return size;
+}
+
+size_t DomainCodec::encode(const VehicleInh &_inh, void *_buf, const size_t _size)
+{
+    size_t size = DomainCodec::size(_inh);
+    uint8_t *buf = (uint8_t*)_buf;
+
+    if (nullptr == buf || size > _size)
+    {
+        LOGE(TAG, "encode: Invalid size %ld, INH size %ld!\n", _size, size);
+        return 0;
+    }
+
+    size_t offset = MessageHeader::HEADER_LENGTH;
+
+    put_header(buf, size - MessageHeader::HEADER_LENGTH, VEH2CLOUD_INH, _inh.version, _inh.timestamp, _inh.ctrl);
+    memcpy(buf + offset, _inh.vehicle_id, sizeof(_inh.vehicle_id));
+    offset += sizeof(_inh.vehicle_id);
+
+    auto string = [&](const std::string &_s)
+    {
+        uint8_t len = string_length(_s);
+
+        buf[offset++] = len;
+        memcpy(buf + offset, _s.data(), len);
+        offset += len;
+    };
+
+    string(_inh.sw_ver);
+    string(_inh.hw_ver);
+    string(_inh.ad_ver);
+    buf[offset++] = _inh.com_type;
+    buf[offset++] = _inh.pos_confidence;
+    buf[offset++] = _inh.time_sync;
+    buf[offset++] = _inh.gnss_type;
+    string(_inh.user_data);
+
+    return offset;
+}
+
+size_t DomainCodec::size(const VehicleState &_state)
+{
+    size_t count = StateBuilder::MAX_PASS_POS < _state.pass_pos.size() ? StateBuilder::MAX_PASS_POS : _state.pass_pos.size();
+
+    return StateBuilder::PASS_POS + count * sizeof(Position2D);
+}
+
+size_t DomainCodec::size(const VehicleInh &_inh)
+{
+    return MessageHeader::HEADER_LENGTH + Veh2CloudInh::DATA_LENGTH + string_length(_inh.sw_ver) + string_length(_inh.hw_ver)
+        + string_length(_inh.ad_ver) + string_length(_inh.user_data);
+}
+
+void DomainCodec::convert(const Veh2CloudState &_msg, VehicleState &_state)
+{
+    _state.version = _msg.version_;
+    _state.timestamp = _msg.timestamp_;
+    _state.ctrl = _msg.ctrl_;
+    memcpy(_state.vehicle_id, _msg.vehicle_id_, sizeof(_state.vehicle_id));
+    memcpy(&_state.message_id, _msg.message_id_, sizeof(_state.message_id));
+    _state.gnss_timestamp = _msg.gnss_timestamp_;
+    _state.gnss_velocity = _msg.gnss_velocity_;
+    _state.position.longitude = _msg.position_.longitude;
+    _state.position.latitude = _msg.position_.latitude;
+    _state.position.elevation = _msg.position_.elevation;
+    _state.heading = _msg.heading_;
+    _state.gear = _msg.gear_;
+    _state.steering_angle = _msg.steering_angle_;
+    _state.velocity = _msg.velocity_;
+    _state.acc_lon = _msg.acc_lon_;
+    _state.acc_lat = _msg.acc_lat_;
+    _state.acc_ver = _msg.acc_ver_;
+    _state.yaw_rate = _msg.yaw_rate_;
+    _state.accel_pos = _msg.accel_pos_;
+    _state.engine_speed = _msg.engine_speed_;
+    _state.engine_torque = _msg.engine_torque_;
+    _state.break_flag = _msg.break_flag_;
+    _state.break_pos = _msg.break_pos_;
+    _state.break_pressure = _msg.break_pressure_;
+    _state.fuel_consume = _msg.fuel_consume_;
+    _state.drive_mode = _msg.drive_mode_;
+    _state.dest_location.longitude = _msg.dest_location_.longitude;
+    _state.dest_location.latitude = _msg.dest_location_.latitude;
+
+    _state.pass_pos.resize(_msg.pass_pos_.size());
+
+    for (size_t i = 0; i < _msg.pass_pos_.size(); i++)
+    {
+        _state.pass_pos[i].longitude = _msg.pass_pos_[i].longitude;
+        _state.pass_pos[i].latitude = _msg.pass_pos_[i].latitude;
+    }
+}
+
+void DomainCodec::convert(const Veh2CloudInh &_msg, VehicleInh &_inh)
+{
+    _inh.version = _msg.version_;
+    _inh.timestamp = _msg.timestamp_;
+    _inh.ctrl = _msg.ctrl_;
+    memcpy(_inh.vehicle_id, _msg.vehicle_id_, sizeof(_inh.vehicle_id));
+    _inh.sw_ver = _msg.sw_ver_;
+    _inh.hw_ver = _msg.hw_ver_;
+    _inh.ad_ver = _msg.ad_ver_;
+    _inh.com_type = _msg.com_type_;
+    _inh.pos_confidence = _msg.pos_confidence_;
+    _inh.time_sync = _msg.time_sync_;
+    _inh.gnss_type = _msg.gnss_type_;
+    _inh.user_data = _msg.user_data_;
+}
+} // namespace protocol
@@ -0,0 +1,138 @@
+#include "jt1078.h"
+#include "log.h"
+
+#define CODEC_ERRORS_HELP "Frames a protocol codec rejected."
+
+static Counter &s_error_short = Metrics::instance().counter(
+    "csae_codec_errors_total", CODEC_ERRORS_HELP, "protocol=\"jt1078\",reason=\"short\"");
+static Counter &s_error_type = Metrics::instance().counter(
+    "csae_codec_errors_total", CODEC_ERRORS_HELP, "protocol=\"jt1078\",reason=\"type\"");
+
+namespace protocol
+{
+namespace jt1078
+{
+bool Codec::decode_header(const uint8_t *_frame, const size_t _size, Header &_header)
+{
+    uint32_t magic = 0;
+
+    if (HEADER_LENGTH <= _size)
+    {
+        memcpy(&magic, _frame, sizeof(magic));
+    }
+
+    if (JT1078_MAGIC != __builtin_bswap32(magic))
+    {
+        s_error_short.add();
+        return false;
+    }
+
+    _header.flags = _frame[4];
+    _header.marker_type = _frame[5];
+    _header.serial = (uint16_t)(_frame[6] << 8 | _frame[7]);
+    memcpy(_header.sim, _frame + 8, sizeof(_header.sim));
+    _header.channel = _frame[14];
+    _header.data_type = _frame[15] >> 4;
+    _header.subpackage = _frame[15] & 0x0F;
+
+    if (TRANSPARENT < _header.data_type)
+    {
+        LOGE(TAG, "decode_header: data type %u!\n", _header.data_type);
+        s_error_type.add();
+        return false;
+    }
+
+    if (_header.length() > _size)
+    {
+        s_error_short.add();
+        return false;
+    }
+
+    const uint8_t *p = _frame + 16;
+
+    _header.timestamp = 0;
+    _header.last_i_interval = 0;
+    _header.last_interval = 0;
+
+    if (TRANSPARENT != _header.data_type)
+    {
+        uint64_t timestamp = 0;
+
+        memcpy(&timestamp, p, sizeof(timestamp));
+        _header.timestamp = __builtin_bswap64(timestamp);
+        p += 8;
+    }
+
+    if (_header.video())
+    {
+        _header.last_i_interval = (uint16_t)(p[0] << 8 | p[1]);
+        _header.last_interval = (uint16_t)(p[2] << 8 | p[3]);
+        p += 4;
+    }
+
+    _header.body_length = (uint16_t)(p[0] << 8 | p[1]);
+
+    return true;
+}
+
+size_t Codec::pack(const Header &_header, const uint8_t *_body, const size_t _size, uint8_t *_buf, const size_t _buf_size)
+{
+    size_t length = _header.length();
+
+    if (MAX_BODY < _size || TRANSPARENT < _header.data_type || length + _size > _buf_size)
+    {
+        return 0;
+    }
+
+    uint8_t *p = _buf;
+    uint32_t magic = __builtin_bswap32(JT1078_MAGIC);
+
+    memcpy(p, &magic, sizeof(magic));
+    p[4] = _header.flags;
+    p[5] = _header.marker_type;
+    p[6] = (uint8_t)(_header.serial >> 8);
+    p[7] = (uint8_t)_header.serial;
+    memcpy(p + 8, _header.sim, sizeof(_header.sim));
+    p[14] = _header.channel;
+    p[15] = (uint8_t)(_header.data_type << 4 | (_header.subpackage & 0x0F));
+    p += 16;
+
+    if (TRANSPARENT != _header.data_type)
+    {
+        uint64_t timestamp = __builtin_bswap64(_header.timestamp);
+
+        memcpy(p, &timestamp, sizeof(timestamp));
+        p += 8;
+    }
+
+    if (_header.video())
+    {
+        p[0] = (uint8_t)(_header.last_i_interval >> 8);
+        p[1] = (uint8_t)_header.last_i_interval;
+        p[2] = (uint8_t)(_header.last_interval >> 8);
+        p[3] = (uint8_t)_header.last_interval;
+        p += 4;
+    }
+
+    p[0] = (uint8_t)(_size >> 8);
+    p[1] = (uint8_t)_size;
+
+    if (0 != _size)
+    {
+        memcpy(p + 2, _body, _size);
+    }
+
+    return length + _size;
+}
+
+std::shared_ptr<MessageBuffer> Codec::pack(const Header &_header, const uint8_t *_body, const size_t _size)
+{
+    std::shared_ptr<MessageBuffer> p((MessageBuffer*)new uint8_t[_header.length() + _size + sizeof(MessageBuffer)],
+        MessageBuffer::deleter<MessageBuffer>);
+
+    p->size = pack(_header, _body, _size, p->data, _header.length() + _size);
+
+    return 0 != p->size ? p : nullptr;
+}
+} // namespace jt1078
+} // namespace protocal
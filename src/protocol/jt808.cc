@@ -0,0 +1,332 @@
+#include "jt808.h"
+#include "log.h"
+
+#define CODEC_ERRORS_HELP "Frames a protocol codec rejected."
+
+static Counter &s_error_escape = Metrics::instance().counter(
+    "csae_codec_errors_total", CODEC_ERRORS_HELP, "protocol=\"jt808\",reason=\"escape\"");
+static Counter &s_error_short = Metrics::instance().counter(
+    "csae_codec_errors_total", CODEC_ERRORS_HELP, "protocol=\"jt808\",reason=\"short\"");
+static Counter &s_error_check = Metrics::instance().counter(
+    "csae_codec_errors_total", CODEC_ERRORS_HELP, "protocol=\"jt808\",reason=\"check\"");
+
+static inline uint16_t get16(const uint8_t *_p)
+{
+    return (uint16_t)(_p[0] << 8 | _p[1]);
+}
+
+static inline uint32_t get32(const uint8_t *_p)
+{
+    return (uint32_t)_p[0] << 24 | (uint32_t)_p[1] << 16 | (uint32_t)_p[2] << 8 | _p[3];
+}
+
+static inline uint8_t* put16(uint8_t *_p, const uint16_t _v)
+{
+    _p[0] = (uint8_t)(_v >> 8);
+    _p[1] = (uint8_t)_v;
+    return _p + 2;
+}
+
+static inline uint8_t* put32(uint8_t *_p, const uint32_t _v)
+{
+    _p[0] = (uint8_t)(_v >> 24);
+    _p[1] = (uint8_t)(_v >> 16);
+    _p[2] = (uint8_t)(_v >> 8);
+    _p[3] = (uint8_t)_v;
+    return _p + 4;
+}
+
+/**
+ * Unescape the bytes between the flags of a frame into _msg.
+ *
+ * @return unescaped size, 0 on a bad escape or more than _capacity bytes
+ */
+static size_t unescape(const uint8_t *_frame, const size_t _size, uint8_t *_msg, const size_t _capacity)
+{
+    const uint8_t *p = _frame + 1, *end = _frame + _size - 1;
+    size_t n = 0;
+
+    while (p < end)
+    {
+        // runs without escapes are copied whole
+        const uint8_t *e = protocol::find_byte(p, end, JT808_ESCAPE);
+        size_t run = e - p;
+
+        if (n + run > _capacity)
+        {
+            return 0;
+        }
+
+        memcpy(_msg + n, p, run);
+        n += run;
+        p = e;
+
+        if (p == end)
+        {
+            break;
+        }
+
+        if (p + 1 == end || (0x01 != p[1] && 0x02 != p[1]) || n == _capacity)
+        {
+            return 0;
+        }
+
+        _msg[n++] = 0x01 == p[1] ? JT808_ESCAPE : JT808_FLAG;
+        p += 2;
+    }
+
+    return n;
+}
+
+/**
+ * Header fields from an unescaped message.
+ *
+ * @return header length, 0 if _size is too short for it
+ */
+static size_t parse_header(const uint8_t *_msg, const size_t _size, protocol::jt808::Header &_header)
+{
+    if (4 > _size)
+    {
+        return 0;
+    }
+
+    _header.id = get16(_msg);
+    _header.attr = get16(_msg + 2);
+
+    size_t length = _header.length();
+
+    if (length > _size)
+    {
+        return 0;
+    }
+
+    const uint8_t *p = _msg + 4;
+
+    if (_header.v2019())
+    {
+        _header.version = *p++;
+    }
+
+    memset(_header.phone, 0, sizeof(_header.phone));
+    memcpy(_header.phone, p, _header.phone_length());
+    p += _header.phone_length();
+    _header.serial = get16(p);
+    p += 2;
+
+    if (_header.subpackaged())
+    {
+        _header.packets = get16(p);
+        _header.packet = get16(p + 2);
+    }
+
+    return length;
+}
+
+namespace protocol
+{
+namespace jt808
+{
+bool Codec::decode_header(const uint8_t *_frame, const size_t _size, Header &_header)
+{
+    uint8_t msg[MAX_MESSAGE];
+    size_t size = 2 > _size ? 0 : unescape(_frame, _size, msg, sizeof(msg));
+
+    return 0 != size && 0 != parse_header(msg, size, _header);
+}
+
+size_t Codec::decode(const uint8_t *_frame, const size_t _size, Header &_header, uint8_t *_msg, size_t &_body_size)
+{
+    if (HEADER_LENGTH > _size || JT808_FLAG != _frame[0] || JT808_FLAG != _frame[_size - 1])
+    {
+        s_error_short.add();
+        return 0;
+    }
+
+    size_t size = unescape(_frame, _size, _msg, MAX_MESSAGE);
+
+    if (0 == size)
+    {
+        LOGE(TAG, "decode: bad escape!\n");
+        s_error_escape.add();
+        return 0;
+    }
+
+    // check code, xor of the header and the body
+    uint8_t check = 0;
+
+    for (size_t i = 0; i < size - 1; i++)
+    {
+        check ^= _msg[i];
+    }
+
+    if (check != _msg[size - 1])
+    {
+        LOGE(TAG, "decode: check code 0x%02x, expected 0x%02x!\n", _msg[size - 1], check);
+        s_error_check.add();
+        return 0;
+    }
+
+    size_t offset = parse_header(_msg, size - 1, _header);
+
+    if (0 == offset || offset + _header.body_length() != size - 1)
+    {
+        LOGE(TAG, "decode: %zu bytes do not match the header!\n", size);
+        s_error_short.add();
+        return 0;
+    }
+
+    _body_size = _header.body_length();
+
+    return offset;
+}
+
+size_t Codec::pack(const Header &_header, const uint8_t *_body, const size_t _size, uint8_t *_buf, const size_t _buf_size)
+{
+    if (MAX_BODY < _size || 2 > _buf_size)
+    {
+        return 0;
+    }
+
+    uint8_t msg[MAX_MESSAGE];
+    Header header = _header;
+    uint8_t *p = msg;
+
+    header.attr = (uint16_t)((header.attr & ~Header::LENGTH_MASK) | _size);
+    p = put16(p, header.id);
+    p = put16(p, header.attr);
+
+    if (header.v2019())
+    {
+        *p++ = header.version;
+    }
+
+    memcpy(p, header.phone, header.phone_length());
+    p += header.phone_length();
+    p = put16(p, header.serial);
+
+    if (header.subpackaged())
+    {
+        p = put16(p, header.packets);
+        p = put16(p, header.packet);
+    }
+
+    if (0 != _size)
+    {
+        memcpy(p, _body, _size);
+        p += _size;
+    }
+
+    uint8_t check = 0;
+
+    for (const uint8_t *q = msg; q < p; q++)
+    {
+        check ^= *q;
+    }
+
+    *p++ = check;
+
+    // escape between the flags
+    size_t n = 0;
+
+    _buf[n++] = JT808_FLAG;
+
+    for (const uint8_t *q = msg; q < p; q++)
+    {
+        if (n + 3 > _buf_size)
+        {
+            return 0;
+        }
+
+        if (JT808_FLAG == *q || JT808_ESCAPE == *q)
+        {
+            _buf[n++] = JT808_ESCAPE;
+            _buf[n++] = JT808_FLAG == *q ? 0x02 : 0x01;
+        }
+        else
+        {
+            _buf[n++] = *q;
+        }
+    }
+
+    _buf[n++] = JT808_FLAG;
+
+    return n;
+}
+
+std::shared_ptr<MessageBuffer> Codec::pack(const Header &_header, const uint8_t *_body, const size_t _size)
+{
+    std::shared_ptr<MessageBuffer> p((MessageBuffer*)new uint8_t[MAX_FRAME + sizeof(MessageBuffer)],
+        MessageBuffer::deleter<MessageBuffer>);
+
+    p->size = pack(_header, _body, _size, p->data, MAX_FRAME);
+
+    return 0 != p->size ? p : nullptr;
+}
+
+size_t Codec::encode(const Location &_msg, uint8_t *_buf, const size_t _size)
+{
+    if (Location::LENGTH > _size)
+    {
+        return 0;
+    }
+
+    uint8_t *p = _buf;
+
+    p = put32(p, _msg.alarm);
+    p = put32(p, _msg.status);
+    p = put32(p, _msg.latitude);
+    p = put32(p, _msg.longitude);
+    p = put16(p, _msg.altitude);
+    p = put16(p, _msg.speed);
+    p = put16(p, _msg.direction);
+    memcpy(p, _msg.time, sizeof(_msg.time));
+
+    return Location::LENGTH;
+}
+
+bool Codec::decode(const uint8_t *_buf, const size_t _size, Location &_msg)
+{
+    if (Location::LENGTH > _size)
+    {
+        return false;
+    }
+
+    _msg.alarm = get32(_buf);
+    _msg.status = get32(_buf + 4);
+    _msg.latitude = get32(_buf + 8);
+    _msg.longitude = get32(_buf + 12);
+    _msg.altitude = get16(_buf + 16);
+    _msg.speed = get16(_buf + 18);
+    _msg.direction = get16(_buf + 20);
+    memcpy(_msg.time, _buf + 22, sizeof(_msg.time));
+
+    return true;
+}
+
+size_t Codec::encode(const GeneralResponse &_msg, uint8_t *_buf, const size_t _size)
+{
+    if (GeneralResponse::LENGTH > _size)
+    {
+        return 0;
+    }
+
+    put16(put16(_buf, _msg.serial), _msg.id)[0] = _msg.result;
+
+    return GeneralResponse::LENGTH;
+}
+
+bool Codec::decode(const uint8_t *_buf, const size_t _size, GeneralResponse &_msg)
+{
+    if (GeneralResponse::LENGTH > _size)
+    {
+        return false;
+    }
+
+    _msg.serial = get16(_buf);
+    _msg.id = get16(_buf + 2);
+    _msg.result = _buf[4];
+
+    return true;
+}
+} // namespace jt808
+} // namespace protocal
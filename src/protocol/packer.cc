@@ -1,13 +1,42 @@
 #include "packer.h"
 #include "log.h"
 
+#define DECODED_HELP       "Frames decoded by Packer::unpack."
+#define DECODE_ERRORS_HELP "Frames Packer::unpack rejected or could not dispatch."
+
+static Counter &s_decoded_inh = Metrics::instance().counter("csae_decoded_total", DECODED_HELP, "type=\"inh\"");
+static Counter &s_decoded_inh_res = Metrics::instance().counter("csae_decoded_total", DECODED_HELP, "type=\"inh_res\"");
+static Counter &s_decoded_state = Metrics::instance().counter("csae_decoded_total", DECODED_HELP, "type=\"state\"");
+static Counter &s_decoded_heartbeat = Metrics::instance().counter("csae_decoded_total", DECODED_HELP, "type=\"heartbeat\"");
+static Counter &s_decoded_heartbeat_res = Metrics::instance().counter(
+    "csae_decoded_total", DECODED_HELP, "type=\"heartbeat_res\"");
+static Counter &s_decoded_generated = Metrics::instance().counter("csae_decoded_total", DECODED_HELP, "type=\"generated\"");
+static Counter &s_error_empty = Metrics::instance().counter("csae_decode_errors_total", DECODE_ERRORS_HELP, "reason=\"empty\"");
+static Counter &s_error_identifier = Metrics::instance().counter(
+    "csae_decode_errors_total", DECODE_ERRORS_HELP, "reason=\"identifier\"");
+static Counter &s_error_short = Metrics::instance().counter("csae_decode_errors_total", DECODE_ERRORS_HELP, "reason=\"short\"");
+static Counter &s_error_type = Metrics::instance().counter("csae_decode_errors_total", DECODE_ERRORS_HELP, "reason=\"type\"");
+
 namespace protocol
 {
 void Packer::unpack(const void *_buf, const size_t _size, Handler &_handler)
+{
+    unpack(_buf, _size, _handler, nullptr);
+}
+
+void Packer::unpack(const void *_buf, const size_t _size, Handler &_handler, Pools &_pools)
+{
+    unpack(_buf, _size, _handler, &_pools);
+}
+
+// private
+
+void Packer::unpack(const void *_buf, const size_t _size, Handler &_handler, Pools *_pools)
 {
     if (nullptr == _buf || 0 == _size)
     {
         LOGE(TAG, "unpack: buffer is null or _size is 0!\n");
+        s_error_empty.add();
         return;
     }
 
@@ -15,18 +44,53 @@ void Packer::unpack(const void *_buf, const size_t _size, Handler &_handler)
     if (0xF2 != buf[0])
     {   
         LOGE(TAG, "unpack: No identifier!\n");
+        s_error_identifier.add();
+        return;
+    }
+
+    // a recycled message would carry the previous frame's fields, and a
+    // constructed one would go out reset, so neither path dispatches it
+    if (sizeof(MessageHeader) > _size || sizeof(MessageHeader) + __builtin_bswap32(*(uint32_t*)(buf + 1)) > _size)
+    {
+        LOGE(TAG, "unpack: Short frame, size %ld!\n", _size);
+        s_error_short.add();
         return;
     }
     
     // unpack message
     uint8_t data_type = *(uint8_t*)(buf + 5);
 
+    // a frame counts as decoded once handed over, and a rejected one under
+    // a single reason
     switch (data_type)
     {
     case VEH2CLOUD_INH:
     {
+        if (nullptr != _pools)
+        {
+            auto msg = _pools->inh.acquire(buf, _size);
+
+            if (!msg)
+            {
+                s_error_short.add();
+                break;
+            }
+
+            _handler.on_unpack(msg);
+            s_decoded_inh.add();
+            break;
+        }
+
         Veh2CloudInh msg(buf, _size);
+
+        if (0 == msg.get_data_length())
+        {
+            s_error_short.add();
+            break;
+        }
+
         _handler.on_unpack(msg);
+        s_decoded_inh.add();
         break;
     }
 
@@ -34,13 +98,37 @@ void Packer::unpack(const void *_buf, const size_t _size, Handler &_handler)
     {
         Cloud2VehInhRes msg(buf, _size);
         _handler.on_unpack(msg);
+        s_decoded_inh_res.add();
         break;
     }
 
     case VEH2CLOUD_STATE:
     {
+        if (nullptr != _pools)
+        {
+            auto msg = _pools->state.acquire(buf, _size);
+
+            if (!msg)
+            {
+                s_error_short.add();
+                break;
+            }
+
+            _handler.on_unpack(msg);
+            s_decoded_state.add();
+            break;
+        }
+
         Veh2CloudState msg(buf, _size);
+
+        if (0 == msg.get_data_length())
+        {
+            s_error_short.add();
+            break;
+        }
+
         _handler.on_unpack(msg);
+        s_decoded_state.add();
         break;
     }
 
@@ -48,6 +136,7 @@ void Packer::unpack(const void *_buf, const size_t _size, Handler &_handler)
     {
         MessageHeader msg(buf, _size);
         _handler.on_unpack(msg);
+        s_decoded_heartbeat.add();
         break;
     }
 
@@ -55,10 +144,26 @@ void Packer::unpack(const void *_buf, const size_t _size, Handler &_handler)
     {
         MessageHeader msg(buf, _size);
         _handler.on_unpack(msg);
+        s_decoded_heartbeat_res.add();
         break;
     }
 
     default:
+        if (nullptr == data::DISPATCH_TABLE[data_type].unpack)
+        {
+            LOGE(TAG, "unpack: Unknown data type 0x%02X!\n", data_type);
+            s_error_type.add();
+            break;
+        }
+
+        // a defined type fails only on data its frame cannot hold
+        if (0 == data::dispatch(buf, _size, _handler))
+        {
+            s_error_short.add();
+            break;
+        }
+
+        s_decoded_generated.add();
         break;
     }
 }
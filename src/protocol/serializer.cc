@@ -0,0 +1,390 @@
+#include "serializer.h"
+#include "log.h"
+
+namespace protocol
+{
+// TextBuffer
+
+TextBuffer::TextBuffer(const size_t _capacity)
+{
+    grow(0 == _capacity ? 64 : _capacity);
+}
+
+TextBuffer::~TextBuffer()
+{
+    free(data_);
+}
+
+void TextBuffer::append_hex(const void *_bytes, const size_t _size, const bool _reverse)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    const uint8_t *bytes = (const uint8_t*)_bytes;
+    char *p = reserve(2 * _size);
+
+    for (size_t i = 0; i < _size; i++)
+    {
+        uint8_t b = bytes[_reverse ? _size - 1 - i : i];
+        *p++ = hex[b >> 4];
+        *p++ = hex[b & 0x0F];
+    }
+
+    size_ += 2 * _size;
+}
+
+void TextBuffer::grow(const size_t _min)
+{
+    size_t capacity = 0 == capacity_ ? _min : capacity_;
+
+    while (capacity < _min)
+    {
+        capacity *= 2;
+    }
+
+    char *p = (char*)realloc(data_, capacity);
+
+    if (nullptr == p)
+    {
+        LOGE(TAG, "grow: realloc %zu bytes failed!\n", capacity);
+        abort();
+    }
+
+    data_ = p;
+    capacity_ = capacity;
+}
+
+// helpers
+
+static inline void json_key(TextBuffer &_buf, const char *_key, const size_t _len)
+{
+    char *p = _buf.reserve(_len + 4);
+
+    *p++ = ',';
+    *p++ = '"';
+    memcpy(p, _key, _len);
+    p += _len;
+    *p++ = '"';
+    *p++ = ':';
+    _buf.commit(_len + 4);
+}
+
+#define JSON_KEY(buf, key) json_key(buf, key, sizeof(key) - 1)
+
+static inline void json_uint(TextBuffer &_buf, const char *_key, const size_t _len, const uint64_t _value)
+{
+    json_key(_buf, _key, _len);
+    _buf.append_uint(_value);
+}
+
+#define JSON_UINT(buf, key, value) json_uint(buf, key, sizeof(key) - 1, value)
+
+static void json_string(TextBuffer &_buf, const char *_s, const size_t _n)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    // worst case every byte becomes \u00XX
+    char *p = _buf.reserve(6 * _n + 2);
+    char *begin = p;
+
+    *p++ = '"';
+
+    for (size_t i = 0; i < _n; i++)
+    {
+        uint8_t c = (uint8_t)_s[i];
+
+        if ('"' == c || '\\' == c)
+        {
+            *p++ = '\\';
+            *p++ = (char)c;
+        }
+        else if (0x20 > c)
+        {
+            *p++ = '\\';
+            *p++ = 'u';
+            *p++ = '0';
+            *p++ = '0';
+            *p++ = hex[c >> 4];
+            *p++ = hex[c & 0x0F];
+        }
+        else
+        {
+            *p++ = (char)c;
+        }
+    }
+
+    *p++ = '"';
+    _buf.commit(p - begin);
+}
+
+static void csv_string(TextBuffer &_buf, const char *_s, const size_t _n)
+{
+    bool quote = false;
+
+    for (size_t i = 0; i < _n && !quote; i++)
+    {
+        quote = ',' == _s[i] || '"' == _s[i] || '\n' == _s[i] || '\r' == _s[i];
+    }
+
+    if (!quote)
+    {
+        _buf.append(_s, _n);
+        return;
+    }
+
+    char *p = _buf.reserve(2 * _n + 2);
+    char *begin = p;
+
+    *p++ = '"';
+
+    for (size_t i = 0; i < _n; i++)
+    {
+        if ('"' == _s[i])
+        {
+            *p++ = '"';
+        }
+
+        *p++ = _s[i];
+    }
+
+    *p++ = '"';
+    _buf.commit(p - begin);
+}
+
+static inline size_t vehicle_id_length(const char _vehicle_id[8])
+{
+    return strnlen(_vehicle_id, 8);
+}
+
+// JsonSerializer
+
+static void json_header(TextBuffer &_buf, const MessageHeader &_msg)
+{
+    _buf.append_literal("{\"id\":");
+    _buf.append_uint(_msg.id_);
+    JSON_UINT(_buf, "data_len", _msg.data_len_);
+    JSON_UINT(_buf, "data_type", _msg.data_type_);
+    JSON_UINT(_buf, "version", _msg.version_);
+    JSON_UINT(_buf, "timestamp", _msg.timestamp_);
+    JSON_UINT(_buf, "ctrl", _msg.ctrl_);
+}
+
+void JsonSerializer::write(TextBuffer &_buf, const MessageHeader &_msg)
+{
+    json_header(_buf, _msg);
+    _buf.append_literal("}\n");
+}
+
+void JsonSerializer::write(TextBuffer &_buf, const Veh2CloudInh &_msg)
+{
+    json_header(_buf, _msg);
+    JSON_KEY(_buf, "vehicle_id");
+    json_string(_buf, _msg.vehicle_id_, vehicle_id_length(_msg.vehicle_id_));
+    JSON_KEY(_buf, "sw_ver");
+    json_string(_buf, _msg.sw_ver_.data(), _msg.sw_ver_.size());
+    JSON_KEY(_buf, "hw_ver");
+    json_string(_buf, _msg.hw_ver_.data(), _msg.hw_ver_.size());
+    JSON_KEY(_buf, "ad_ver");
+    json_string(_buf, _msg.ad_ver_.data(), _msg.ad_ver_.size());
+    JSON_UINT(_buf, "com_type", _msg.com_type_);
+    JSON_UINT(_buf, "pos_confidence", _msg.pos_confidence_);
+    JSON_UINT(_buf, "time_sync", _msg.time_sync_);
+    JSON_UINT(_buf, "gnss_type", _msg.gnss_type_);
+    JSON_KEY(_buf, "user_data");
+    json_string(_buf, _msg.user_data_.data(), _msg.user_data_.size());
+    _buf.append_literal("}\n");
+}
+
+void JsonSerializer::write(TextBuffer &_buf, const Cloud2VehInhRes &_msg)
+{
+    json_header(_buf, _msg);
+    JSON_KEY(_buf, "vehicle_id");
+    json_string(_buf, _msg.vehicle_id_, vehicle_id_length(_msg.vehicle_id_));
+    JSON_UINT(_buf, "res", _msg.res_);
+    _buf.append_literal("}\n");
+}
+
+void JsonSerializer::write(TextBuffer &_buf, const Veh2CloudState &_msg)
+{
+    json_header(_buf, _msg);
+    JSON_KEY(_buf, "vehicle_id");
+    json_string(_buf, _msg.vehicle_id_, vehicle_id_length(_msg.vehicle_id_));
+    JSON_KEY(_buf, "message_id");
+    _buf.append('"');
+    _buf.append_hex(_msg.message_id_, sizeof(_msg.message_id_), true);
+    _buf.append('"');
+    JSON_UINT(_buf, "gnss_timestamp", _msg.gnss_timestamp_);
+    JSON_UINT(_buf, "gnss_velocity", _msg.gnss_velocity_);
+    JSON_UINT(_buf, "longitude", _msg.position_.longitude);
+    JSON_UINT(_buf, "latitude", _msg.position_.latitude);
+    JSON_UINT(_buf, "elevation", _msg.position_.elevation);
+    JSON_UINT(_buf, "heading", _msg.heading_);
+    JSON_UINT(_buf, "gear", _msg.gear_);
+    JSON_UINT(_buf, "steering_angle", _msg.steering_angle_);
+    JSON_UINT(_buf, "velocity", _msg.velocity_);
+    JSON_UINT(_buf, "acc_lon", _msg.acc_lon_);
+    JSON_UINT(_buf, "acc_lat", _msg.acc_lat_);
+    JSON_UINT(_buf, "acc_ver", _msg.acc_ver_);
+    JSON_UINT(_buf, "yaw_rate", _msg.yaw_rate_);
+    JSON_UINT(_buf, "accel_pos", _msg.accel_pos_);
+    JSON_UINT(_buf, "engine_speed", _msg.engine_speed_);
+    JSON_UINT(_buf, "engine_torque", _msg.engine_torque_);
+    JSON_UINT(_buf, "break_flag", _msg.break_flag_);
+    JSON_UINT(_buf, "break_pos", _msg.break_pos_);
+    JSON_UINT(_buf, "break_pressure", _msg.break_pressure_);
+    JSON_UINT(_buf, "fuel_consume", _msg.fuel_consume_);
+    JSON_UINT(_buf, "drive_mode", _msg.drive_mode_);
+    JSON_UINT(_buf, "dest_longitude", _msg.dest_location_.longitude);
+    JSON_UINT(_buf, "dest_latitude", _msg.dest_location_.latitude);
+    JSON_KEY(_buf, "pass_pos");
+    _buf.append('[');
+
+    for (size_t i = 0; i < _msg.pass_pos_.size(); i++)
+    {
+        if (0 != i)
+        {
+            _buf.append(',');
+        }
+
+        _buf.append('[');
+        _buf.append_uint(_msg.pass_pos_[i].longitude);
+        _buf.append(',');
+        _buf.append_uint(_msg.pass_pos_[i].latitude);
+        _buf.append(']');
+    }
+
+    _buf.append_literal("]}\n");
+}
+
+// CsvSerializer
+
+#define CSV_HEADER_COLUMNS "id,data_len,data_type,version,timestamp,ctrl"
+
+void CsvSerializer::write_header(TextBuffer &_buf, const uint8_t _data_type)
+{
+    switch (_data_type)
+    {
+    case VEH2CLOUD_INH:
+        _buf.append_literal(CSV_HEADER_COLUMNS ",vehicle_id,sw_ver,hw_ver,ad_ver,com_type,pos_confidence,"
+            "time_sync,gnss_type,user_data\n");
+        break;
+
+    case CLOUD2VEH_INH_RES:
+        _buf.append_literal(CSV_HEADER_COLUMNS ",vehicle_id,res\n");
+        break;
+
+    case VEH2CLOUD_STATE:
+        _buf.append_literal(CSV_HEADER_COLUMNS ",vehicle_id,message_id,gnss_timestamp,gnss_velocity,"
+            "longitude,latitude,elevation,heading,gear,steering_angle,velocity,acc_lon,acc_lat,acc_ver,"
+            "yaw_rate,accel_pos,engine_speed,engine_torque,break_flag,break_pos,break_pressure,fuel_consume,"
+            "drive_mode,dest_longitude,dest_latitude,pass_pos\n");
+        break;
+
+    default:
+        _buf.append_literal(CSV_HEADER_COLUMNS "\n");
+        break;
+    }
+}
+
+static void csv_header(TextBuffer &_buf, const MessageHeader &_msg)
+{
+    _buf.append_uint(_msg.id_);
+    _buf.append(',');
+    _buf.append_uint(_msg.data_len_);
+    _buf.append(',');
+    _buf.append_uint(_msg.data_type_);
+    _buf.append(',');
+    _buf.append_uint(_msg.version_);
+    _buf.append(',');
+    _buf.append_uint(_msg.timestamp_);
+    _buf.append(',');
+    _buf.append_uint(_msg.ctrl_);
+}
+
+static inline void csv_uint(TextBuffer &_buf, const uint64_t _value)
+{
+    _buf.append(',');
+    _buf.append_uint(_value);
+}
+
+static inline void csv_field(TextBuffer &_buf, const char *_s, const size_t _n)
+{
+    _buf.append(',');
+    csv_string(_buf, _s, _n);
+}
+
+void CsvSerializer::write(TextBuffer &_buf, const MessageHeader &_msg)
+{
+    csv_header(_buf, _msg);
+    _buf.append('\n');
+}
+
+void CsvSerializer::write(TextBuffer &_buf, const Veh2CloudInh &_msg)
+{
+    csv_header(_buf, _msg);
+    csv_field(_buf, _msg.vehicle_id_, vehicle_id_length(_msg.vehicle_id_));
+    csv_field(_buf, _msg.sw_ver_.data(), _msg.sw_ver_.size());
+    csv_field(_buf, _msg.hw_ver_.data(), _msg.hw_ver_.size());
+    csv_field(_buf, _msg.ad_ver_.data(), _msg.ad_ver_.size());
+    csv_uint(_buf, _msg.com_type_);
+    csv_uint(_buf, _msg.pos_confidence_);
+    csv_uint(_buf, _msg.time_sync_);
+    csv_uint(_buf, _msg.gnss_type_);
+    csv_field(_buf, _msg.user_data_.data(), _msg.user_data_.size());
+    _buf.append('\n');
+}
+
+void CsvSerializer::write(TextBuffer &_buf, const Cloud2VehInhRes &_msg)
+{
+    csv_header(_buf, _msg);
+    csv_field(_buf, _msg.vehicle_id_, vehicle_id_length(_msg.vehicle_id_));
+    csv_uint(_buf, _msg.res_);
+    _buf.append('\n');
+}
+
+void CsvSerializer::write(TextBuffer &_buf, const Veh2CloudState &_msg)
+{
+    csv_header(_buf, _msg);
+    csv_field(_buf, _msg.vehicle_id_, vehicle_id_length(_msg.vehicle_id_));
+    _buf.append(',');
+    _buf.append_hex(_msg.message_id_, sizeof(_msg.message_id_), true);
+    csv_uint(_buf, _msg.gnss_timestamp_);
+    csv_uint(_buf, _msg.gnss_velocity_);
+    csv_uint(_buf, _msg.position_.longitude);
+    csv_uint(_buf, _msg.position_.latitude);
+    csv_uint(_buf, _msg.position_.elevation);
+    csv_uint(_buf, _msg.heading_);
+    csv_uint(_buf, _msg.gear_);
+    csv_uint(_buf, _msg.steering_angle_);
+    csv_uint(_buf, _msg.velocity_);
+    csv_uint(_buf, _msg.acc_lon_);
+    csv_uint(_buf, _msg.acc_lat_);
+    csv_uint(_buf, _msg.acc_ver_);
+    csv_uint(_buf, _msg.yaw_rate_);
+    csv_uint(_buf, _msg.accel_pos_);
+    csv_uint(_buf, _msg.engine_speed_);
+    csv_uint(_buf, _msg.engine_torque_);
+    csv_uint(_buf, _msg.break_flag_);
+    csv_uint(_buf, _msg.break_pos_);
+    csv_uint(_buf, _msg.break_pressure_);
+    csv_uint(_buf, _msg.fuel_consume_);
+    csv_uint(_buf, _msg.drive_mode_);
+    csv_uint(_buf, _msg.dest_location_.longitude);
+    csv_uint(_buf, _msg.dest_location_.latitude);
+    _buf.append(',');
+
+    // pass positions in one column, "lon:lat;lon:lat"
+    for (size_t i = 0; i < _msg.pass_pos_.size(); i++)
+    {
+        if (0 != i)
+        {
+            _buf.append(';');
+        }
+
+        _buf.append_uint(_msg.pass_pos_[i].longitude);
+        _buf.append(':');
+        _buf.append_uint(_msg.pass_pos_[i].latitude);
+    }
+
+    _buf.append('\n');
+}
+} // namespace protocal
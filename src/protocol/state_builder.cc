@@ -0,0 +1,92 @@
+#include "state_builder.h"
+
+namespace protocol
+{
+StateBuilder::StateBuilder(const char _vehicle_id[], const uint8_t _version, const uint8_t _ctrl):
+    pool_(std::make_shared<Pool>())
+{
+    memset(frame_, 0, sizeof(frame_));
+
+    MessageHeader(PASS_POS - sizeof(MessageHeader), VEH2CLOUD_STATE, _version, 0, _ctrl).to_bytes(frame_, sizeof(frame_));
+    memcpy(frame_ + VEHICLE_ID, _vehicle_id, strnlen(_vehicle_id, 8));
+}
+
+StateBuilder::StateBuilder(const Veh2CloudState &_msg):
+    pool_(std::make_shared<Pool>())
+{
+    memset(frame_, 0, sizeof(frame_));
+
+    size_ = _msg.to_bytes(frame_, sizeof(frame_));
+}
+
+StateBuilder& StateBuilder::pass_pos(const Position2D _points[], const size_t _count)
+{
+    size_t count = MAX_PASS_POS < _count ? MAX_PASS_POS : _count;
+    size_t size = PASS_POS + count * sizeof(Position2D);
+
+    if (size != size_)
+    {
+        frame_[PASS_POS_NUM] = (uint8_t)count;
+        *(uint32_t*)(frame_ + 1) = __builtin_bswap32(size - sizeof(MessageHeader));
+        size_ = size;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        put32(PASS_POS + i * sizeof(Position2D), _points[i].longitude);
+        put32(PASS_POS + i * sizeof(Position2D) + 4, _points[i].latitude);
+    }
+
+    return *this;
+}
+
+std::shared_ptr<MessageBuffer> StateBuilder::build()
+{
+    MessageBuffer *buf = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(pool_->mutex);
+
+        if (!pool_->free.empty())
+        {
+            buf = pool_->free.back();
+            pool_->free.pop_back();
+        }
+    }
+
+    // all sized for the largest frame, so any is reusable
+    if (nullptr == buf)
+    {
+        buf = (MessageBuffer*)new uint8_t[sizeof(MessageBuffer) + MAX_SIZE];
+    }
+
+    buf->size = size_;
+    memcpy(buf->data, frame_, size_);
+
+    std::shared_ptr<Pool> pool = pool_;
+
+    return std::shared_ptr<MessageBuffer>(buf, [pool](MessageBuffer *_buf)
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+
+        if (POOL > pool->free.size())
+        {
+            pool->free.push_back(_buf);
+        }
+        else
+        {
+            MessageBuffer::deleter<MessageBuffer>(_buf);
+        }
+    });
+}
+
+// private
+
+StateBuilder::Pool::~Pool()
+{
+    for (auto b : free)
+    {
+        MessageBuffer::deleter<MessageBuffer>(b);
+    }
+}
+} // namespace protocol
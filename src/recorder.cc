@@ -0,0 +1,686 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "recorder.h"
+#include "frame_assembler.h"
+#include "log.h"
+
+static std::string segment_path(const std::string &_dir, const std::string &_prefix, const uint32_t _sequence, const char *_ext)
+{
+    char name[64] = "";
+
+    snprintf(name, sizeof(name), "-%06u.%s", _sequence, _ext);
+
+    return _dir + "/" + _prefix + name;
+}
+
+/**
+ * List the segment sequences of _prefix in _dir, sorted.
+ */
+static std::vector<uint32_t> list_segments(const std::string &_dir, const std::string &_prefix)
+{
+    std::vector<uint32_t> sequences;
+    DIR *dir = opendir(_dir.c_str());
+
+    if (nullptr == dir)
+    {
+        return sequences;
+    }
+
+    struct dirent *entry = nullptr;
+    std::string head = _prefix + "-";
+
+    while (nullptr != (entry = readdir(dir)))
+    {
+        const char *name = entry->d_name;
+        size_t len = strlen(name);
+        unsigned sequence = 0;
+        char ext[8] = "";
+
+        if (len <= head.size() + 4 || 0 != strncmp(name, head.c_str(), head.size()))
+        {
+            continue;
+        }
+
+        if (2 == sscanf(name + head.size(), "%u.%7s", &sequence, ext) && 0 == strcmp(ext, "seg"))
+        {
+            sequences.push_back(sequence);
+        }
+    }
+
+    closedir(dir);
+    std::sort(sequences.begin(), sequences.end());
+
+    return sequences;
+}
+
+static void index_record(std::vector<RecordIndexEntry> &_index, const size_t _offset, const RecordHeader *_record, const size_t _interval)
+{
+    if (_index.empty() || _offset - _index.back().offset >= _interval)
+    {
+        RecordIndexEntry entry;
+
+        memset(&entry, 0, sizeof(entry));
+        entry.offset = _offset;
+        entry.first_timestamp = _record->timestamp;
+        entry.last_timestamp = _record->timestamp;
+        _index.push_back(entry);
+    }
+
+    RecordIndexEntry &entry = _index.back();
+
+    entry.first_timestamp = std::min<uint64_t>(entry.first_timestamp, _record->timestamp);
+    entry.last_timestamp = std::max<uint64_t>(entry.last_timestamp, _record->timestamp);
+    entry.vehicle_bloom |= FrameRecorder::vehicle_bloom(_record->vehicle_id);
+    entry.count++;
+}
+
+// FrameRecorder
+
+FrameRecorder::~FrameRecorder()
+{
+    close();
+}
+
+int32_t FrameRecorder::open(const char _dir[], const char _prefix[], const size_t _segment_size, const size_t _ring_size)
+{
+    if (is_open())
+    {
+        LOGE(TAG, "open: already open!\n");
+        return -1;
+    }
+
+    if (0 != mkdir(_dir, 0755) && EEXIST != errno)
+    {
+        LOGE(TAG, "open: mkdir %s error(%d), %s!\n", _dir, errno, strerror(errno));
+        return -1;
+    }
+
+    dir_ = _dir;
+    prefix_ = _prefix;
+    segment_size_ = std::max<size_t>(_segment_size, 1 << 20);
+
+    std::vector<uint32_t> sequences = list_segments(dir_, prefix_);
+    sequence_ = sequences.empty() ? 0 : sequences.back() + 1;
+
+    if (0 != open_segment())
+    {
+        return -1;
+    }
+
+    size_t capacity = 4096;
+
+    while (capacity < _ring_size)
+    {
+        capacity <<= 1;
+    }
+
+    for (auto &ring : rings_)
+    {
+        ring.buf = new uint8_t[capacity];
+        ring.capacity = capacity;
+        ring.head.store(0, std::memory_order_relaxed);
+        ring.tail.store(0, std::memory_order_relaxed);
+        ring.dropped.store(0, std::memory_order_relaxed);
+    }
+
+    stopped_.store(false, std::memory_order_release);
+
+    thread_ = std::thread([this]()
+    {
+        this->writer_thread();
+    });
+
+    return 0;
+}
+
+void FrameRecorder::close()
+{
+    if (!is_open())
+    {
+        return;
+    }
+
+    // seq_cst against record(): it either sees the stop or is waited for
+    stopped_.store(true);
+
+    for (auto &ring : rings_)
+    {
+        while (ring.writing.load())
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    thread_.join();
+
+    // pushed after the writer's last pass
+    for (auto &ring : rings_)
+    {
+        drain(ring);
+    }
+
+    seal_segment();
+
+    for (auto &ring : rings_)
+    {
+        delete [] ring.buf;
+        ring.buf = nullptr;
+        ring.capacity = 0;
+    }
+}
+
+bool FrameRecorder::record(const uint8_t _direction, const void *_buf, const size_t _size)
+{
+    if (3 < _direction || nullptr == _buf || 0 == _size)
+    {
+        return false;
+    }
+
+    Ring &ring = rings_[_direction];
+
+    ring.writing.store(true);
+
+    if (stopped_.load())
+    {
+        ring.writing.store(false, std::memory_order_release);
+        return false;
+    }
+
+    bool pushed = push(ring, _direction, _buf, _size);
+
+    ring.writing.store(false, std::memory_order_release);
+
+    return pushed;
+}
+
+uint64_t FrameRecorder::dropped() const
+{
+    uint64_t dropped = 0;
+
+    for (auto &ring : rings_)
+    {
+        dropped += ring.dropped.load(std::memory_order_relaxed);
+    }
+
+    return dropped;
+}
+
+uint64_t FrameRecorder::now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uint64_t FrameRecorder::vehicle_bloom(const char _vehicle_id[8])
+{
+    uint64_t key = 0;
+
+    memcpy(&key, _vehicle_id, sizeof(key));
+
+    if (0 == key)
+    {
+        return 0;
+    }
+
+    uint64_t hash = key * 0x9E3779B97F4A7C15ULL;
+
+    return (1ULL << (hash >> 58)) | (1ULL << ((hash >> 52) & 0x3F));
+}
+
+// private
+
+bool FrameRecorder::push(Ring &_ring, const uint8_t _direction, const void *_buf, const size_t _size)
+{
+    size_t len = record_length(_size);
+    size_t mask = _ring.capacity - 1;
+    size_t head = _ring.head.load(std::memory_order_relaxed);
+    size_t tail = _ring.tail.load(std::memory_order_acquire);
+    size_t offset = head & mask;
+    size_t contiguous = _ring.capacity - offset;
+    size_t need = contiguous < len ? contiguous + len : len;
+
+    if (len > segment_size_ - sizeof(RecordSegmentHeader) || _ring.capacity - (head - tail) < need)
+    {
+        _ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // no room at the end of the ring, mark the tail and restart at 0
+    if (contiguous < len)
+    {
+        uint32_t wrap = RECORD_WRAP;
+        memcpy(_ring.buf + offset, &wrap, sizeof(wrap));
+        head += contiguous;
+        offset = 0;
+    }
+
+    RecordHeader *record = (RecordHeader*)(_ring.buf + offset);
+    const uint8_t *buf = (const uint8_t*)_buf;
+
+    memset(record, 0, sizeof(RecordHeader));
+    record->magic = RECORD_MAGIC;
+    record->size = _size;
+    record->timestamp = now();
+    record->direction = _direction;
+    record->data_type = FRAME_DATA_TYPE_POS < _size ? buf[FRAME_DATA_TYPE_POS] : 0;
+
+    if (FRAME_VEHICLE_ID_POS + sizeof(record->vehicle_id) <= _size
+        && HEARTBEAT != record->data_type && HEARTBEAT_RES != record->data_type)
+    {
+        memcpy(record->vehicle_id, buf + FRAME_VEHICLE_ID_POS, sizeof(record->vehicle_id));
+    }
+
+    memcpy(record + 1, buf, _size);
+    _ring.head.store(head + len, std::memory_order_release);
+
+    return true;
+}
+
+void FrameRecorder::writer_thread()
+{
+    while (true)
+    {
+        bool stop = stopped_.load(std::memory_order_acquire);
+        size_t n = 0;
+
+        for (auto &ring : rings_)
+        {
+            n += drain(ring);
+        }
+
+        if (0 == n)
+        {
+            if (stop)
+            {
+                return;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+size_t FrameRecorder::drain(Ring &_ring)
+{
+    size_t mask = _ring.capacity - 1;
+    size_t tail = _ring.tail.load(std::memory_order_relaxed);
+    size_t head = _ring.head.load(std::memory_order_acquire);
+    size_t n = 0;
+
+    while (tail < head)
+    {
+        size_t offset = tail & mask;
+        uint32_t magic = 0;
+
+        memcpy(&magic, _ring.buf + offset, sizeof(magic));
+
+        if (RECORD_WRAP == magic)
+        {
+            tail += _ring.capacity - offset;
+            continue;
+        }
+
+        const RecordHeader *record = (const RecordHeader*)(_ring.buf + offset);
+
+        write(record);
+        tail += record_length(record->size);
+        n++;
+    }
+
+    _ring.tail.store(tail, std::memory_order_release);
+
+    return n;
+}
+
+void FrameRecorder::write(const RecordHeader *_record)
+{
+    size_t len = record_length(_record->size);
+
+    if (nullptr == segment_ || used_ + len > segment_size_)
+    {
+        seal_segment();
+
+        if (0 != open_segment())
+        {
+            return;
+        }
+    }
+
+    RecordHeader *record = (RecordHeader*)(segment_ + used_);
+
+    // magic last, a reader of the live segment stops at the first zero magic
+    memcpy((uint8_t*)record + sizeof(record->magic), (const uint8_t*)_record + sizeof(record->magic), len - sizeof(record->magic));
+    __atomic_store_n(&record->magic, RECORD_MAGIC, __ATOMIC_RELEASE);
+
+    index_record(index_, used_, _record, RECORD_INDEX_INTERVAL);
+    used_ += len;
+    recorded_.fetch_add(1, std::memory_order_relaxed);
+}
+
+int32_t FrameRecorder::open_segment()
+{
+    std::string path = segment_path(dir_, prefix_, sequence_, "seg");
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (0 > fd_)
+    {
+        LOGE(TAG, "open_segment: open %s error(%d), %s!\n", path.c_str(), errno, strerror(errno));
+        return -1;
+    }
+
+    int err = posix_fallocate(fd_, 0, segment_size_);
+
+    if (0 != err)
+    {
+        LOGE(TAG, "open_segment: fallocate %s error(%d), %s!\n", path.c_str(), err, strerror(err));
+        ::close(fd_);
+        fd_ = -1;
+        return -1;
+    }
+
+    void *p = mmap(nullptr, segment_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+
+    if (MAP_FAILED == p)
+    {
+        LOGE(TAG, "open_segment: mmap %s error(%d), %s!\n", path.c_str(), errno, strerror(errno));
+        ::close(fd_);
+        fd_ = -1;
+        return -1;
+    }
+
+    segment_ = (uint8_t*)p;
+
+    RecordSegmentHeader *header = (RecordSegmentHeader*)segment_;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    memset(header, 0, sizeof(RecordSegmentHeader));
+    header->magic = RECORD_SEGMENT_MAGIC;
+    header->version = 1;
+    header->sequence = sequence_;
+    header->monotonic_base = now();
+    header->realtime_base = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    used_ = sizeof(RecordSegmentHeader);
+    index_.clear();
+
+    return 0;
+}
+
+void FrameRecorder::seal_segment()
+{
+    if (nullptr == segment_)
+    {
+        return;
+    }
+
+    munmap(segment_, segment_size_);
+    segment_ = nullptr;
+
+    if (0 != ftruncate(fd_, used_))
+    {
+        LOGE(TAG, "seal_segment: ftruncate error(%d), %s!\n", errno, strerror(errno));
+    }
+
+    ::close(fd_);
+    fd_ = -1;
+
+    // sparse index beside the segment
+    std::string path = segment_path(dir_, prefix_, sequence_, "idx");
+    FILE *fp = fopen(path.c_str(), "wb");
+
+    if (nullptr == fp)
+    {
+        LOGE(TAG, "seal_segment: open %s error(%d), %s!\n", path.c_str(), errno, strerror(errno));
+    }
+    else
+    {
+        uint64_t header[2] = {RECORD_INDEX_MAGIC, index_.size()};
+
+        fwrite(header, sizeof(header), 1, fp);
+        fwrite(index_.data(), sizeof(RecordIndexEntry), index_.size(), fp);
+        fclose(fp);
+    }
+
+    index_.clear();
+    sequence_++;
+}
+
+// FrameReader
+
+FrameReader::~FrameReader()
+{
+    close();
+}
+
+int32_t FrameReader::open(const char _dir[], const char _prefix[])
+{
+    close();
+
+    std::vector<uint32_t> sequences = list_segments(_dir, _prefix);
+
+    for (auto sequence : sequences)
+    {
+        Segment segment;
+        segment.path = segment_path(_dir, _prefix, sequence, "seg");
+        segment.sequence = sequence;
+
+        int fd = ::open(segment.path.c_str(), O_RDONLY);
+
+        if (0 > fd)
+        {
+            LOGE(TAG, "open: open %s error(%d), %s!\n", segment.path.c_str(), errno, strerror(errno));
+            continue;
+        }
+
+        struct stat st;
+
+        if (0 != fstat(fd, &st) || (size_t)st.st_size < sizeof(RecordSegmentHeader))
+        {
+            ::close(fd);
+            continue;
+        }
+
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (MAP_FAILED == p)
+        {
+            LOGE(TAG, "open: mmap %s error(%d), %s!\n", segment.path.c_str(), errno, strerror(errno));
+            continue;
+        }
+
+        segment.data = (const uint8_t*)p;
+        segment.size = st.st_size;
+
+        if (RECORD_SEGMENT_MAGIC != ((const RecordSegmentHeader*)segment.data)->magic)
+        {
+            LOGE(TAG, "open: %s isn't a segment!\n", segment.path.c_str());
+            munmap(p, segment.size);
+            continue;
+        }
+
+        // the live or a crashed segment has no index file
+        if (0 != load_index(segment))
+        {
+            build_index(segment);
+        }
+
+        madvise(p, segment.size, MADV_SEQUENTIAL);
+        segments_.push_back(segment);
+    }
+
+    return segments_.empty() ? -1 : 0;
+}
+
+void FrameReader::close()
+{
+    for (auto &segment : segments_)
+    {
+        munmap((void*)segment.data, segment.size);
+    }
+
+    segments_.clear();
+}
+
+size_t FrameReader::read(const uint64_t _begin, const uint64_t _end, const char *_vehicle_id, Visitor &_visitor) const
+{
+    char vehicle_id[8] = {0};
+    uint64_t bloom = 0;
+    size_t n = 0;
+
+    if (nullptr != _vehicle_id)
+    {
+        memcpy(vehicle_id, _vehicle_id, strnlen(_vehicle_id, sizeof(vehicle_id)));
+        bloom = FrameRecorder::vehicle_bloom(vehicle_id);
+    }
+
+    for (auto &segment : segments_)
+    {
+        for (auto &entry : segment.index)
+        {
+            if (entry.last_timestamp < _begin || entry.first_timestamp >= _end || bloom != (entry.vehicle_bloom & bloom))
+            {
+                continue;
+            }
+
+            size_t offset = entry.offset;
+
+            for (uint32_t i = 0; i < entry.count && offset + sizeof(RecordHeader) <= segment.size; i++)
+            {
+                const RecordHeader *record = (const RecordHeader*)(segment.data + offset);
+
+                offset += FrameRecorder::record_length(record->size);
+
+                if (RECORD_MAGIC != record->magic || offset > segment.size)
+                {
+                    break;
+                }
+
+                if (record->timestamp < _begin || record->timestamp >= _end
+                    || (0 != bloom && 0 != memcmp(record->vehicle_id, vehicle_id, sizeof(vehicle_id))))
+                {
+                    continue;
+                }
+
+                Frame frame;
+                frame.timestamp = record->timestamp;
+                frame.direction = record->direction;
+                frame.data_type = record->data_type;
+                frame.vehicle_id = record->vehicle_id;
+                frame.data = (const uint8_t*)(record + 1);
+                frame.size = record->size;
+                n++;
+
+                if (!_visitor.on_frame(frame))
+                {
+                    return n;
+                }
+            }
+        }
+    }
+
+    return n;
+}
+
+uint64_t FrameReader::first_timestamp() const
+{
+    uint64_t ts = UINT64_MAX;
+
+    for (auto &segment : segments_)
+    {
+        for (auto &entry : segment.index)
+        {
+            ts = std::min<uint64_t>(ts, entry.first_timestamp);
+        }
+    }
+
+    return ts;
+}
+
+uint64_t FrameReader::last_timestamp() const
+{
+    uint64_t ts = 0;
+
+    for (auto &segment : segments_)
+    {
+        for (auto &entry : segment.index)
+        {
+            ts = std::max<uint64_t>(ts, entry.last_timestamp);
+        }
+    }
+
+    return ts;
+}
+
+// private
+
+int32_t FrameReader::load_index(Segment &_segment)
+{
+    std::string path = _segment.path.substr(0, _segment.path.size() - 3) + "idx";
+    FILE *fp = fopen(path.c_str(), "rb");
+
+    if (nullptr == fp)
+    {
+        return -1;
+    }
+
+    uint64_t header[2] = {0};
+
+    if (1 != fread(header, sizeof(header), 1, fp) || RECORD_INDEX_MAGIC != header[0])
+    {
+        fclose(fp);
+        return -1;
+    }
+
+    _segment.index.resize(header[1]);
+
+    if (header[1] != fread(_segment.index.data(), sizeof(RecordIndexEntry), header[1], fp))
+    {
+        _segment.index.clear();
+        fclose(fp);
+        return -1;
+    }
+
+    fclose(fp);
+
+    return 0;
+}
+
+void FrameReader::build_index(Segment &_segment)
+{
+    size_t offset = sizeof(RecordSegmentHeader);
+
+    _segment.index.clear();
+
+    while (offset + sizeof(RecordHeader) <= _segment.size)
+    {
+        const RecordHeader *record = (const RecordHeader*)(_segment.data + offset);
+        size_t len = FrameRecorder::record_length(record->size);
+
+        if (RECORD_MAGIC != record->magic || offset + len > _segment.size)
+        {
+            break;
+        }
+
+        index_record(_segment.index, offset, record, RECORD_INDEX_INTERVAL);
+        offset += len;
+    }
+}
@@ -0,0 +1,344 @@
+#include <string.h>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include "replayer.h"
+#include "log.h"
+
+static int listen_loopback(const uint32_t _port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (0 > fd)
+    {
+        return -1;
+    }
+
+    int value = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(_port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (0 != bind(fd, (struct sockaddr*)&addr, sizeof(addr)) || 0 != listen(fd, 1))
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static bool write_all(const int _fd, const uint8_t *_buf, size_t _size)
+{
+    while (0 < _size)
+    {
+        ssize_t n = ::send(_fd, _buf, _size, MSG_NOSIGNAL);
+
+        if (0 > n)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+
+            return false;
+        }
+
+        _buf += n;
+        _size -= n;
+    }
+
+    return true;
+}
+
+// FNV-1a over the frame, a frame the controller drops leaves its own send
+// time unmatched instead of shifting the others'
+static uint64_t frame_key(const void *_buf, const size_t _size)
+{
+    const uint8_t *buf = (const uint8_t*)_buf;
+    uint64_t key = 0xCBF29CE484222325ULL;
+
+    for (size_t i = 0; i < _size; i++)
+    {
+        key = (key ^ buf[i]) * 0x100000001B3ULL;
+    }
+
+    return key;
+}
+
+// Replayer::Report
+
+void Replayer::Report::print(FILE *_fp) const
+{
+    double fps = 0.0 < seconds ? frames / seconds : 0.0;
+    double mbps = 0.0 < seconds ? bytes / seconds / 1e6 : 0.0;
+
+    fprintf(_fp, "frames %" PRIu64 ", bytes %" PRIu64 ", lost %" PRIu64 ", %.3f s, %.0f frames/s, %.2f MB/s\n",
+        frames, bytes, lost, seconds, fps, mbps);
+    fprintf(_fp, "latency us: p50 %.2f, p90 %.2f, p99 %.2f, p999 %.2f, max %.2f\n",
+        latency.percentile(50) / 1e3, latency.percentile(90) / 1e3, latency.percentile(99) / 1e3,
+        latency.percentile(99.9) / 1e3, latency.max() / 1e3);
+    fprintf(_fp, "lag us: p50 %.2f, p99 %.2f, max %.2f\n",
+        lag.percentile(50) / 1e3, lag.percentile(99) / 1e3, lag.max() / 1e3);
+}
+
+// Replayer
+
+int32_t Replayer::open(const char _dir[], const char _prefix[])
+{
+    return reader_.open(_dir, _prefix);
+}
+
+void Replayer::close()
+{
+    reader_.close();
+}
+
+void Replayer::set_vehicle(const char *_vehicle_id)
+{
+    has_vehicle_ = nullptr != _vehicle_id;
+
+    if (has_vehicle_)
+    {
+        strncpy(vehicle_id_, _vehicle_id, sizeof(vehicle_id_) - 1);
+    }
+}
+
+int32_t Replayer::replay(protocol::Packer::Handler &_handler, Report &_report)
+{
+    class Visitor : public FrameReader::Visitor
+    {
+    public:
+        Visitor(Replayer &_replayer, protocol::Packer::Handler &_handler, Report &_report):
+            replayer_(_replayer), handler_(_handler), report_(_report) {}
+
+        bool on_frame(const FrameReader::Frame &_frame) override
+        {
+            if (0 == (replayer_.directions_ & (1 << _frame.direction)))
+            {
+                return true;
+            }
+
+            report_.lag.record(replayer_.pace(_frame.timestamp));
+
+            uint64_t begin = FrameRecorder::now();
+            protocol::Packer::unpack(_frame.data, _frame.size, handler_);
+            report_.latency.record(FrameRecorder::now() - begin);
+
+            report_.frames++;
+            report_.bytes += _frame.size;
+
+            return true;
+        }
+
+    private:
+        Replayer &replayer_;
+        protocol::Packer::Handler &handler_;
+        Report &report_;
+    } visitor(*this, _handler, _report);
+
+    first_timestamp_ = 0;
+    start_ = FrameRecorder::now();
+    reader_.read(begin_, end_, has_vehicle_ ? vehicle_id_ : nullptr, visitor);
+    _report.seconds = (FrameRecorder::now() - start_) / 1e9;
+
+    return 0;
+}
+
+int32_t Replayer::replay(Controller &_controller, const uint32_t _up_port, const uint32_t _down_port, Report &_report)
+{
+    /**
+     * Times frames from the write to the controller's receive path.
+     */
+    class Sink : public Tracer::Sink
+    {
+    public:
+        void on_frame(const uint32_t _direction, const void *_buf, const size_t _size) override
+        {
+            Channel &channel = TRACE_UP_RX == _direction ? up : down;
+            uint64_t now = FrameRecorder::now();
+            uint64_t key = frame_key(_buf, _size);
+            std::lock_guard<std::mutex> lock(channel.mutex);
+            auto it = channel.sent.find(key);
+
+            if (channel.sent.end() == it)
+            {
+                return;
+            }
+
+            // identical frames are received in the order they were written
+            latency->record(now - it->second.front());
+            it->second.pop_front();
+            received.fetch_add(1, std::memory_order_relaxed);
+
+            if (it->second.empty())
+            {
+                channel.sent.erase(it);
+            }
+        }
+
+        struct Channel
+        {
+            std::mutex mutex;
+            std::unordered_map<uint64_t, std::deque<uint64_t>> sent; // write times by frame_key()
+        };
+
+        Channel up;
+        Channel down;
+        Histogram *latency = nullptr;
+        std::atomic<uint64_t> received{0};
+    } sink;
+
+    int up_listen = listen_loopback(_up_port);
+    int down_listen = listen_loopback(_down_port);
+
+    if (0 > up_listen || 0 > down_listen)
+    {
+        LOGE(TAG, "replay: listen on %u/%u error(%d), %s!\n", _up_port, _down_port, errno, strerror(errno));
+
+        if (0 <= up_listen) ::close(up_listen);
+        if (0 <= down_listen) ::close(down_listen);
+
+        return -1;
+    }
+
+    sink.latency = &_report.latency;
+    _controller.tracer().set_sink(&sink);
+    _controller.tracer().set_sample(1);
+    _controller.tracer().set_all_types(true);
+    _controller.tracer().enable(TRACE_UP_RX | TRACE_DOWN_RX);
+    _controller.start("127.0.0.1", _up_port, "127.0.0.1", _down_port);
+
+    int up_fd = accept(up_listen, nullptr, nullptr);
+    int down_fd = accept(down_listen, nullptr, nullptr);
+
+    ::close(up_listen);
+    ::close(down_listen);
+
+    if (0 > up_fd || 0 > down_fd)
+    {
+        LOGE(TAG, "replay: accept error(%d), %s!\n", errno, strerror(errno));
+    }
+    else
+    {
+        int value = 1;
+        setsockopt(up_fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+        setsockopt(down_fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+
+        class Visitor : public FrameReader::Visitor
+        {
+        public:
+            Visitor(Replayer &_replayer, Sink &_sink, const int _up_fd, const int _down_fd, Report &_report):
+                replayer_(_replayer), sink_(_sink), up_fd_(_up_fd), down_fd_(_down_fd), report_(_report) {}
+
+            bool on_frame(const FrameReader::Frame &_frame) override
+            {
+                if (0 == (replayer_.directions_ & (1 << _frame.direction)))
+                {
+                    return true;
+                }
+
+                bool up = RECORD_UP_TX == _frame.direction || RECORD_UP_RX == _frame.direction;
+                Sink::Channel &channel = up ? sink_.up : sink_.down;
+
+                report_.lag.record(replayer_.pace(_frame.timestamp));
+
+                {
+                    uint64_t key = frame_key(_frame.data, _frame.size);
+                    std::lock_guard<std::mutex> lock(channel.mutex);
+                    channel.sent[key].push_back(FrameRecorder::now());
+                }
+
+                if (!write_all(up ? up_fd_ : down_fd_, _frame.data, _frame.size))
+                {
+                    LOGE(TAG, "replay: write error(%d), %s!\n", errno, strerror(errno));
+                    return false;
+                }
+
+                report_.frames++;
+                report_.bytes += _frame.size;
+
+                return true;
+            }
+
+        private:
+            Replayer &replayer_;
+            Sink &sink_;
+            int up_fd_;
+            int down_fd_;
+            Report &report_;
+        } visitor(*this, sink, up_fd, down_fd, _report);
+
+        first_timestamp_ = 0;
+        start_ = FrameRecorder::now();
+        reader_.read(begin_, end_, has_vehicle_ ? vehicle_id_ : nullptr, visitor);
+
+        // wait for the controller to drain, at most 2 s
+        uint64_t deadline = FrameRecorder::now() + 2000000000ULL;
+
+        while (sink.received.load(std::memory_order_relaxed) < _report.frames && FrameRecorder::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        _report.seconds = (FrameRecorder::now() - start_) / 1e9;
+    }
+
+    _controller.stop();
+    _controller.tracer().disable(TRACE_UP_RX | TRACE_DOWN_RX);
+    _controller.tracer().set_sink(nullptr);
+    _report.lost = _report.frames - sink.received.load(std::memory_order_relaxed);
+
+    if (0 <= up_fd) ::close(up_fd);
+    if (0 <= down_fd) ::close(down_fd);
+
+    return 0 > up_fd || 0 > down_fd ? -1 : 0;
+}
+
+// private
+
+uint64_t Replayer::pace(const uint64_t _timestamp)
+{
+    if (0 == first_timestamp_)
+    {
+        first_timestamp_ = _timestamp;
+        start_ = FrameRecorder::now();
+    }
+
+    if (0.0 == speed_)
+    {
+        return 0;
+    }
+
+    // the directions are drained from separate rings, a frame may be slightly older
+    uint64_t elapsed = _timestamp > first_timestamp_ ? _timestamp - first_timestamp_ : 0;
+    uint64_t due = start_ + (uint64_t)(elapsed / speed_);
+    uint64_t now = FrameRecorder::now();
+
+    if (due > now)
+    {
+        // short gaps are not worth a sleep
+        if (due - now > 50000)
+        {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+        }
+
+        return 0;
+    }
+
+    return now - due;
+}
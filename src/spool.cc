@@ -0,0 +1,535 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "spool.h"
+#include "frame_assembler.h"
+#include "message.h"
+#include "log.h"
+
+#define FRAME_TIMESTAMP_POS  7
+#define FRAME_MESSAGE_ID_POS (FRAME_VEHICLE_ID_POS + 8)
+
+static size_t record_length(const size_t _size)
+{
+    return sizeof(SpoolRecord) + ((_size + 7) & ~(size_t)7);
+}
+
+StateSpool::StateSpool():
+    depth_(Metrics::instance().gauge("csae_spool_frames", "Frames waiting in the spool.")),
+    appended_total_(Metrics::instance().counter("csae_spool_appended_total", "Frames appended to the spool.")),
+    evicted_total_(Metrics::instance().counter("csae_spool_evicted_total", "Frames evicted by the spool cap.")),
+    duplicates_total_(Metrics::instance().counter("csae_spool_duplicates_total", "Frames dropped as already spooled or sent."))
+{
+}
+
+StateSpool::~StateSpool()
+{
+    close();
+}
+
+int32_t StateSpool::open(const char _path[], const size_t _capacity, const bool _compact)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (nullptr != map_)
+    {
+        LOGE(TAG, "open: already open!\n");
+        return -1;
+    }
+
+    size_t capacity = (_capacity < 4096 ? 4096 : _capacity + 7) & ~(size_t)7;
+
+    fd_ = ::open(_path, O_RDWR | O_CREAT, 0644);
+
+    if (0 > fd_)
+    {
+        LOGE(TAG, "open: open %s error(%d), %s!\n", _path, errno, strerror(errno));
+        return -1;
+    }
+
+    int err = posix_fallocate(fd_, 0, DATA_OFFSET + capacity);
+
+    if (0 != err)
+    {
+        LOGE(TAG, "open: fallocate %s error(%d), %s!\n", _path, err, strerror(err));
+        ::close(fd_);
+        fd_ = -1;
+        return -1;
+    }
+
+    void *p = mmap(nullptr, DATA_OFFSET + capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+
+    if (MAP_FAILED == p)
+    {
+        LOGE(TAG, "open: mmap %s error(%d), %s!\n", _path, errno, strerror(errno));
+        ::close(fd_);
+        fd_ = -1;
+        return -1;
+    }
+
+    path_ = _path;
+    map_ = (uint8_t*)p;
+    map_size_ = DATA_OFFSET + capacity;
+    header_ = (SpoolFileHeader*)map_;
+    data_ = map_ + DATA_OFFSET;
+    appended_ = 0;
+    last_.clear();
+    read_base_.clear();
+
+    if (SPOOL_MAGIC != header_->magic || 1 != header_->version || capacity != header_->capacity
+        || (uint32_t)_compact != header_->compact || header_->used > capacity)
+    {
+        memset(header_, 0, sizeof(SpoolFileHeader));
+        header_->magic = SPOOL_MAGIC;
+        header_->version = 1;
+        header_->compact = _compact;
+        header_->capacity = capacity;
+    }
+    else
+    {
+        const SpoolRecord *record = tail_record();
+
+        // the base of a delta at the tail, saved by pop()
+        if (nullptr != record && SPOOL_DELTA == record->encoding
+            && 0 != header_->base_size && DATA_OFFSET - sizeof(SpoolFileHeader) >= header_->base_size)
+        {
+            read_base_.assign(map_ + sizeof(SpoolFileHeader), map_ + sizeof(SpoolFileHeader) + header_->base_size);
+        }
+
+        // lost, e.g. too large to save
+        while (read_base_.empty() && nullptr != (record = tail_record()) && SPOOL_DELTA == record->encoding)
+        {
+            evict();
+        }
+
+        LOGI(TAG, "open: %s has %" PRIu64 " frames\n", _path, header_->count);
+    }
+
+    depth_.set(header_->count);
+
+    return 0;
+}
+
+void StateSpool::close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (nullptr == map_)
+    {
+        return;
+    }
+
+    msync(map_, map_size_, MS_SYNC);
+    munmap(map_, map_size_);
+    ::close(fd_);
+
+    fd_ = -1;
+    map_ = nullptr;
+    header_ = nullptr;
+    data_ = nullptr;
+}
+
+bool StateSpool::append(const void *_frame, const size_t _size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (nullptr == map_ || nullptr == _frame || 0 == _size)
+    {
+        return false;
+    }
+
+    uint64_t k = key(_frame, _size);
+
+    if (0 != k && keys_.end() != keys_.find(k))
+    {
+        duplicates_total_.add();
+        return false;
+    }
+
+    const uint8_t *frame = (const uint8_t*)_frame;
+    uint8_t encoding = SPOOL_RAW;
+    size_t size = _size;
+
+    if (header_->compact)
+    {
+        bool delta = 0 != appended_ % SPOOL_KEY_INTERVAL && 0 != header_->count && !last_.empty();
+
+        // worst case a token per byte
+        scratch_.resize(2 * _size + 2);
+        size = encode(frame, _size, delta ? &last_ : nullptr, scratch_.data());
+        encoding = delta ? SPOOL_DELTA : SPOOL_KEY;
+    }
+
+    size_t len = record_length(size);
+    uint64_t capacity = header_->capacity;
+
+    if (len > capacity)
+    {
+        LOGE(TAG, "append: frame of %zu bytes exceeds the spool!\n", _size);
+        return false;
+    }
+
+    if (0 == header_->count)
+    {
+        header_->head = header_->tail = header_->used = 0;
+    }
+
+    // the end of the data area is skipped when the record does not fit there
+    size_t skip = header_->head + len > capacity ? capacity - header_->head : 0;
+
+    while (0 != header_->count && capacity - header_->used < skip + len)
+    {
+        evict();
+
+        if (0 == header_->count)
+        {
+            header_->head = header_->tail = header_->used = 0;
+            skip = 0;
+        }
+    }
+
+    // a new tail can not be a delta, its base was just evicted
+    if (header_->compact && SPOOL_DELTA == encoding && 0 == header_->count)
+    {
+        size = encode(frame, _size, nullptr, scratch_.data());
+        encoding = SPOOL_KEY;
+        len = record_length(size);
+
+        if (len > capacity)
+        {
+            LOGE(TAG, "append: frame of %zu bytes exceeds the spool!\n", _size);
+            return false;
+        }
+    }
+
+    if (0 != skip)
+    {
+        if (sizeof(uint32_t) <= skip)
+        {
+            uint32_t wrap = SPOOL_WRAP;
+            memcpy(data_ + header_->head, &wrap, sizeof(wrap));
+        }
+
+        header_->used += skip;
+        header_->head = 0;
+    }
+
+    SpoolRecord *record = (SpoolRecord*)(data_ + header_->head);
+
+    memset(record, 0, sizeof(SpoolRecord));
+    record->magic = SPOOL_RECORD_MAGIC;
+    record->size = size;
+    record->frame_size = _size;
+    record->encoding = encoding;
+    record->key = k;
+    memcpy(record + 1, SPOOL_RAW == encoding ? frame : scratch_.data(), size);
+
+    header_->head += len;
+    header_->used += len;
+    header_->count++;
+
+    appended_++;
+    last_.assign(frame, frame + _size);
+
+    if (0 != k)
+    {
+        remember(k);
+    }
+
+    depth_.set(header_->count);
+    appended_total_.add();
+
+    return true;
+}
+
+bool StateSpool::front(std::vector<uint8_t> &_frame)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (nullptr == map_)
+    {
+        return false;
+    }
+
+    const SpoolRecord *record = nullptr;
+
+    while (nullptr != (record = tail_record()))
+    {
+        if (decode(record, _frame))
+        {
+            return true;
+        }
+
+        evict();
+    }
+
+    return false;
+}
+
+void StateSpool::pop()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (nullptr == map_)
+    {
+        return;
+    }
+
+    const SpoolRecord *record = tail_record();
+
+    if (nullptr == record)
+    {
+        return;
+    }
+
+    // the next record may be a delta against this one
+    if (header_->compact)
+    {
+        std::vector<uint8_t> frame;
+
+        if (decode(record, frame))
+        {
+            read_base_.swap(frame);
+        }
+    }
+
+    size_t len = record_length(record->size);
+
+    header_->tail += len;
+    header_->used -= len;
+    header_->count--;
+
+    if (header_->compact)
+    {
+        save_base();
+    }
+
+    depth_.set(header_->count);
+}
+
+void StateSpool::sent(const void *_frame, const size_t _size)
+{
+    uint64_t k = key(_frame, _size);
+
+    if (0 == k)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (keys_.end() == keys_.find(k))
+    {
+        remember(k);
+    }
+}
+
+size_t StateSpool::count() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return nullptr == header_ ? 0 : header_->count;
+}
+
+size_t StateSpool::bytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return nullptr == header_ ? 0 : header_->used;
+}
+
+uint64_t StateSpool::key(const void *_frame, const size_t _size)
+{
+    const uint8_t *frame = (const uint8_t*)_frame;
+
+    if (nullptr == frame || FRAME_MESSAGE_ID_POS + 8 > _size || VEH2CLOUD_STATE != frame[FRAME_DATA_TYPE_POS])
+    {
+        return 0;
+    }
+
+    uint64_t timestamp = 0;
+    uint64_t message_id = 0;
+
+    memcpy(&timestamp, frame + FRAME_TIMESTAMP_POS, sizeof(timestamp));
+    memcpy(&message_id, frame + FRAME_MESSAGE_ID_POS, sizeof(message_id));
+
+    uint64_t k = (timestamp ^ (message_id * 0x9E3779B97F4A7C15ULL)) * 0xBF58476D1CE4E5B9ULL;
+
+    return 0 == k ? 1 : k;
+}
+
+// private
+
+/**
+ * Tokens of a zero run and a literal run, each up to 255, then the literals.
+ */
+size_t StateSpool::encode(const uint8_t *_frame, const size_t _size, const std::vector<uint8_t> *_base, uint8_t *_out) const
+{
+    size_t base_size = nullptr == _base ? 0 : _base->size();
+    const uint8_t *base = nullptr == _base ? nullptr : _base->data();
+    size_t i = 0;
+    size_t n = 0;
+
+    while (i < _size)
+    {
+        uint8_t zeros = 0;
+        uint8_t literals = 0;
+
+        while (i < _size && 255 > zeros && _frame[i] == (i < base_size ? base[i] : 0))
+        {
+            zeros++;
+            i++;
+        }
+
+        size_t token = n;
+
+        n += 2;
+
+        while (i < _size && 255 > literals && _frame[i] != (i < base_size ? base[i] : 0))
+        {
+            _out[n++] = _frame[i] ^ (i < base_size ? base[i] : 0);
+            literals++;
+            i++;
+        }
+
+        _out[token] = zeros;
+        _out[token + 1] = literals;
+    }
+
+    return n;
+}
+
+bool StateSpool::decode(const SpoolRecord *_record, std::vector<uint8_t> &_frame)
+{
+    const uint8_t *in = (const uint8_t*)(_record + 1);
+
+    if (SPOOL_RAW == _record->encoding)
+    {
+        _frame.assign(in, in + _record->size);
+        return true;
+    }
+
+    const std::vector<uint8_t> *base = SPOOL_DELTA == _record->encoding ? &read_base_ : nullptr;
+
+    if (nullptr != base && base->empty())
+    {
+        LOGE(TAG, "decode: delta without a base!\n");
+        return false;
+    }
+
+    size_t size = _record->frame_size;
+    size_t i = 0;
+
+    _frame.resize(size);
+
+    for (size_t n = 0; n + 2 <= _record->size && i < size;)
+    {
+        uint8_t zeros = in[n];
+        uint8_t literals = in[n + 1];
+
+        n += 2;
+
+        for (uint8_t z = 0; z < zeros && i < size; z++, i++)
+        {
+            _frame[i] = nullptr != base && i < base->size() ? (*base)[i] : 0;
+        }
+
+        for (uint8_t l = 0; l < literals && i < size && n < _record->size; l++, i++, n++)
+        {
+            _frame[i] = in[n] ^ (nullptr != base && i < base->size() ? (*base)[i] : 0);
+        }
+    }
+
+    return i == size;
+}
+
+const SpoolRecord* StateSpool::tail_record()
+{
+    if (0 == header_->count)
+    {
+        return nullptr;
+    }
+
+    uint64_t capacity = header_->capacity;
+    uint64_t rest = capacity - header_->tail;
+
+    // skipped end before a wrap
+    if (sizeof(SpoolRecord) > rest || SPOOL_WRAP == *(const uint32_t*)(data_ + header_->tail))
+    {
+        header_->used -= rest;
+        header_->tail = 0;
+    }
+
+    const SpoolRecord *record = (const SpoolRecord*)(data_ + header_->tail);
+
+    if (SPOOL_RECORD_MAGIC != record->magic || record_length(record->size) > capacity - header_->tail)
+    {
+        LOGE(TAG, "tail_record: corrupted at %" PRIu64 ", spool reset!\n", header_->tail);
+        header_->head = header_->tail = header_->used = header_->count = 0;
+        return nullptr;
+    }
+
+    return record;
+}
+
+void StateSpool::evict()
+{
+    do
+    {
+        const SpoolRecord *record = tail_record();
+
+        if (nullptr == record)
+        {
+            break;
+        }
+
+        size_t len = record_length(record->size);
+
+        header_->tail += len;
+        header_->used -= len;
+        header_->count--;
+        evicted_total_.add();
+
+        record = tail_record();
+
+        // leave a record standing alone at the tail
+        if (nullptr == record || SPOOL_DELTA != record->encoding)
+        {
+            break;
+        }
+    } while (true);
+
+    read_base_.clear();
+    depth_.set(header_->count);
+}
+
+void StateSpool::save_base()
+{
+    const SpoolRecord *record = tail_record();
+
+    if (nullptr == record || SPOOL_DELTA != record->encoding
+        || read_base_.empty() || DATA_OFFSET - sizeof(SpoolFileHeader) < read_base_.size())
+    {
+        header_->base_size = 0;
+        return;
+    }
+
+    memcpy(map_ + sizeof(SpoolFileHeader), read_base_.data(), read_base_.size());
+    header_->base_size = read_base_.size();
+}
+
+void StateSpool::remember(const uint64_t _key)
+{
+    keys_.insert(_key);
+    order_.push_back(_key);
+
+    if (DEDUP < order_.size())
+    {
+        keys_.erase(order_.front());
+        order_.pop_front();
+    }
+}
@@ -0,0 +1,126 @@
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "state_publisher.h"
+
+using namespace protocol;
+
+static bool outside(const int64_t _a, const int64_t _b, const uint32_t _deadband)
+{
+    return (uint64_t)llabs(_a - _b) > _deadband;
+}
+
+/**
+ * Across north the short way, 359.9 and 0.1 degrees are 0.2 apart.
+ */
+static bool outside_angle(const uint32_t _a, const uint32_t _b, const uint32_t _deadband, const uint32_t _circle)
+{
+    uint32_t d = _a > _b ? _a - _b : _b - _a;
+
+    return (d <= _circle ? std::min(d, _circle - d) : d) > _deadband;
+}
+
+StatePublisher::StatePublisher(sender _send):
+    send_(std::move(_send)),
+    published_(Metrics::instance().counter("csae_state_published_total", "States sent by the send-on-change filter.")),
+    suppressed_(Metrics::instance().counter("csae_state_suppressed_total", "States within their deadbands, not sent.")),
+    saved_bytes_(Metrics::instance().counter("csae_state_saved_bytes_total", "Frame bytes of the suppressed states."))
+{
+}
+
+void StatePublisher::configure(const StateDeadband &_deadband)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    deadband_ = _deadband;
+}
+
+bool StatePublisher::publish(const Veh2CloudState &_msg)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (nullptr != last_ && !changed(_msg))
+        {
+            size_t size = _msg.get_header_length() + _msg.get_data_length();
+
+            suppressed_count_++;
+            saved_bytes_count_ += size;
+            suppressed_.add();
+            saved_bytes_.add(size);
+
+            return false;
+        }
+
+        if (nullptr == last_)
+        {
+            last_.reset(new Veh2CloudState(_msg));
+        }
+        else
+        {
+            *last_ = _msg;
+        }
+
+        published_count_++;
+        published_.add();
+    }
+
+    send_(_msg);
+
+    return true;
+}
+
+void StatePublisher::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    last_.reset();
+}
+
+// private
+
+bool StatePublisher::changed(const Veh2CloudState &_msg) const
+{
+    const Veh2CloudState &l = *last_;
+    const StateDeadband &d = deadband_;
+
+    // a clock step back counts as due
+    if (_msg.timestamp_ < l.timestamp_ || _msg.timestamp_ - l.timestamp_ >= d.max_interval)
+    {
+        return true;
+    }
+
+    if (_msg.gear_ != l.gear_ || _msg.break_flag_ != l.break_flag_ || _msg.drive_mode_ != l.drive_mode_
+        || _msg.dest_location_.longitude != l.dest_location_.longitude
+        || _msg.dest_location_.latitude != l.dest_location_.latitude
+        || _msg.pass_pos_.size() != l.pass_pos_.size()
+        || 0 != memcmp(_msg.vehicle_id_, l.vehicle_id_, sizeof(l.vehicle_id_)))
+    {
+        return true;
+    }
+
+    for (size_t i = 0; i < l.pass_pos_.size(); i++)
+    {
+        if (_msg.pass_pos_[i].longitude != l.pass_pos_[i].longitude || _msg.pass_pos_[i].latitude != l.pass_pos_[i].latitude)
+        {
+            return true;
+        }
+    }
+
+    return outside(_msg.position_.longitude, l.position_.longitude, d.position)
+        || outside(_msg.position_.latitude, l.position_.latitude, d.position)
+        || outside(_msg.position_.elevation, l.position_.elevation, d.elevation)
+        || outside_angle(_msg.heading_, l.heading_, d.heading, d.heading_circle)
+        || outside(_msg.steering_angle_, l.steering_angle_, d.steering_angle)
+        || outside(_msg.velocity_, l.velocity_, d.velocity)
+        || outside(_msg.gnss_velocity_, l.gnss_velocity_, d.velocity)
+        || outside(_msg.acc_lon_, l.acc_lon_, d.acc)
+        || outside(_msg.acc_lat_, l.acc_lat_, d.acc)
+        || outside(_msg.acc_ver_, l.acc_ver_, d.acc)
+        || outside(_msg.yaw_rate_, l.yaw_rate_, d.yaw_rate)
+        || outside(_msg.accel_pos_, l.accel_pos_, d.pedal)
+        || outside(_msg.break_pos_, l.break_pos_, d.pedal)
+        || outside(_msg.break_pressure_, l.break_pressure_, d.break_pressure)
+        || outside(_msg.engine_speed_, l.engine_speed_, d.engine_speed)
+        || outside(_msg.engine_torque_, l.engine_torque_, d.engine_torque)
+        || outside(_msg.fuel_consume_, l.fuel_consume_, d.fuel_consume);
+}
@@ -0,0 +1,139 @@
+#include "tracer.h"
+#include "log.h"
+
+// Tracer::StdoutSink
+
+void Tracer::StdoutSink::on_frame(const uint32_t _direction, const void *_buf, const size_t _size)
+{
+    const char *prefix = "SOCK";
+
+    switch (_direction)
+    {
+    case TRACE_UP_TX:
+        prefix = "SOCK-TX(UP)";
+        break;
+
+    case TRACE_UP_RX:
+        prefix = "SOCK-RX(UP)";
+        break;
+
+    case TRACE_DOWN_TX:
+        prefix = "SOCK-TX(DOWN)";
+        break;
+
+    case TRACE_DOWN_RX:
+        prefix = "SOCK-RX(DOWN)";
+        break;
+
+    default:
+        break;
+    }
+
+    printf("\n");
+    print_buffer(prefix, 0, _buf, _size);
+}
+
+void Tracer::StdoutSink::on_unpack(const protocol::MessageHeader &_msg)
+{
+    std::cout << std::endl << _msg;
+}
+
+void Tracer::StdoutSink::on_unpack(const protocol::Veh2CloudInh &_msg)
+{
+    std::cout << std::endl << _msg;
+}
+
+void Tracer::StdoutSink::on_unpack(const protocol::Cloud2VehInhRes &_msg)
+{
+    std::cout << std::endl << _msg;
+}
+
+void Tracer::StdoutSink::on_unpack(const protocol::Veh2CloudState &_msg)
+{
+    std::cout << std::endl << _msg;
+}
+
+// Tracer
+
+Tracer::Tracer(): directions_(TRACE_NONE), sample_(1), sink_(&stdout_sink_)
+{
+    for (auto &t : types_)
+    {
+        t.store(~0ULL, std::memory_order_relaxed);
+    }
+
+    for (auto &c : counters_)
+    {
+        c.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Tracer::set_sink(Sink *_sink)
+{
+    sink_.store(nullptr == _sink ? &stdout_sink_ : _sink, std::memory_order_release);
+}
+
+void Tracer::enable(const uint32_t _directions)
+{
+    directions_.fetch_or(_directions & TRACE_ALL, std::memory_order_relaxed);
+}
+
+void Tracer::disable(const uint32_t _directions)
+{
+    directions_.fetch_and(~_directions, std::memory_order_relaxed);
+}
+
+void Tracer::enable_type(const uint8_t _data_type)
+{
+    types_[_data_type >> 6].fetch_or(1ULL << (_data_type & 0x3F), std::memory_order_relaxed);
+}
+
+void Tracer::disable_type(const uint8_t _data_type)
+{
+    types_[_data_type >> 6].fetch_and(~(1ULL << (_data_type & 0x3F)), std::memory_order_relaxed);
+}
+
+void Tracer::set_all_types(const bool _enabled)
+{
+    for (auto &t : types_)
+    {
+        t.store(_enabled ? ~0ULL : 0ULL, std::memory_order_relaxed);
+    }
+}
+
+void Tracer::set_sample(const uint32_t _n)
+{
+    sample_.store(0 == _n ? 1 : _n, std::memory_order_relaxed);
+}
+
+// private
+
+void Tracer::trace_frame(const uint32_t _direction, const void *_buf, const size_t _size)
+{
+    // the data type is at offset 5 of the frame header
+    uint8_t data_type = 5 < _size ? ((const uint8_t*)_buf)[5] : 0;
+
+    if (accept(_direction, data_type))
+    {
+        sink_.load(std::memory_order_acquire)->on_frame(_direction, _buf, _size);
+    }
+}
+
+bool Tracer::accept(const uint32_t _direction, const uint8_t _data_type)
+{
+    if (0 == (types_[_data_type >> 6].load(std::memory_order_relaxed) & (1ULL << (_data_type & 0x3F))))
+    {
+        return false;
+    }
+
+    uint32_t n = sample_.load(std::memory_order_relaxed);
+
+    if (1 == n)
+    {
+        return true;
+    }
+
+    uint32_t count = counters_[__builtin_ctz(_direction)].fetch_add(1, std::memory_order_relaxed);
+
+    return 0 == count % n;
+}
@@ -0,0 +1,127 @@
+#include <math.h>
+#include <string.h>
+
+#include "trajectory.h"
+
+using namespace protocol;
+
+#define EARTH_RADIUS 6371008.8 // m, mean
+
+size_t Trajectory::simplify(const Position2D _in[], const size_t _count, const double _tolerance,
+    Position2D _out[], TrajectoryStats *_stats)
+{
+    TrajectoryStats stats;
+
+    stats.in = stats.out = _count;
+
+    if (3 > _count || TRAJECTORY_MAX_POINTS < _count || !(0 < _tolerance))
+    {
+        if (_out != _in)
+        {
+            memmove(_out, _in, _count * sizeof(Position2D));
+        }
+
+        if (nullptr != _stats)
+        {
+            *_stats = stats;
+        }
+
+        return _count;
+    }
+
+    // local plane in mm, equirectangular around the first point
+    int64_t x[TRAJECTORY_MAX_POINTS];
+    int64_t y[TRAJECTORY_MAX_POINTS];
+    double lat = _in[0].latitude * 1e-7 * M_PI / 180;
+    double mm = 1e-7 * M_PI / 180 * EARTH_RADIUS * 1000;
+    double mm_lon = mm * cos(lat);
+
+    for (size_t i = 0; i < _count; i++)
+    {
+        x[i] = llround(((int64_t)_in[i].longitude - (int64_t)_in[0].longitude) * mm_lon);
+        y[i] = llround(((int64_t)_in[i].latitude - (int64_t)_in[0].latitude) * mm);
+    }
+
+    bool keep[TRAJECTORY_MAX_POINTS] = {false};
+    uint8_t stack[2 * TRAJECTORY_MAX_POINTS];
+    size_t top = 0;
+    double tolerance = _tolerance * 1000;
+    double max_deviation = 0; // mm
+
+    keep[0] = keep[_count - 1] = true;
+    stack[top++] = 0;
+    stack[top++] = (uint8_t)(_count - 1);
+
+    while (0 != top)
+    {
+        size_t last = stack[--top];
+        size_t first = stack[--top];
+        int64_t dx = x[last] - x[first];
+        int64_t dy = y[last] - y[first];
+        double length = sqrt((double)dx * dx + (double)dy * dy);
+        double farthest = -1;
+        size_t index = first;
+
+        for (size_t i = first + 1; i < last; i++)
+        {
+            double d = 0;
+
+            // distance to the chord, or to the point itself if the chord is empty
+            if (0 == dx && 0 == dy)
+            {
+                double ex = x[i] - x[first];
+                double ey = y[i] - y[first];
+
+                d = sqrt(ex * ex + ey * ey);
+            }
+            else
+            {
+                d = fabs((double)(dx * (y[i] - y[first]) - dy * (x[i] - x[first]))) / length;
+            }
+
+            if (d > farthest)
+            {
+                farthest = d;
+                index = i;
+            }
+        }
+
+        if (first == index)
+        {
+            continue;
+        }
+
+        if (farthest > tolerance)
+        {
+            keep[index] = true;
+            stack[top++] = (uint8_t)first;
+            stack[top++] = (uint8_t)index;
+            stack[top++] = (uint8_t)index;
+            stack[top++] = (uint8_t)last;
+        }
+        else if (farthest > max_deviation)
+        {
+            max_deviation = farthest;
+        }
+    }
+
+    size_t n = 0;
+
+    for (size_t i = 0; i < _count; i++)
+    {
+        if (keep[i])
+        {
+            _out[n++] = _in[i];
+        }
+    }
+
+    stats.out = n;
+    stats.max_deviation = max_deviation / 1000;
+
+    if (nullptr != _stats)
+    {
+        *_stats = stats;
+    }
+
+    return n;
+}
@@ -0,0 +1,56 @@
+#include "adaptive_rate.h"
+
+void AdaptiveRate::configure(const double _min, const double _max, const size_t _depth, const double _rtt_factor)
+{
+    max_ = 0 < _max ? _max : 0;
+    min_ = _min < max_ ? (0 < _min ? _min : max_ / 100) : max_;
+    depth_ = 0 == _depth ? 1 : _depth;
+    rtt_factor_ = 1.0 < _rtt_factor ? _rtt_factor : 1.0;
+    hold_ = 0;
+    congested_ = false;
+    rate_.store(max_, std::memory_order_relaxed);
+}
+
+double AdaptiveRate::update(const size_t _depth, const uint64_t _srtt, const uint64_t _min_rtt)
+{
+    double rate = rate_.load(std::memory_order_relaxed);
+
+    if (!enabled())
+    {
+        return rate;
+    }
+
+    bool inflated = 0 != _srtt && 0 != _min_rtt
+        && _srtt > _min_rtt * rtt_factor_ && _srtt - _min_rtt > RTT_SLACK;
+
+    congested_ = depth_ <= _depth || inflated;
+
+    // let the last decrease take effect
+    if (0 != hold_)
+    {
+        hold_--;
+        return rate;
+    }
+
+    if (congested_)
+    {
+        rate = rate / 2 < min_ ? min_ : rate / 2;
+        hold_ = HOLD;
+    }
+    else if (!inflated && _depth * 4 < depth_)
+    {
+        rate += (max_ - min_) / 20;
+        rate = max_ < rate ? max_ : rate;
+    }
+
+    rate_.store(rate, std::memory_order_relaxed);
+
+    return rate;
+}
+
+uint32_t AdaptiveRate::interval() const
+{
+    double rate = rate_.load(std::memory_order_relaxed);
+
+    return 0 < rate ? (uint32_t)(1000 / rate + 0.5) : 0;
+}
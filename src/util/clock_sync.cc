@@ -0,0 +1,160 @@
+#include "clock_sync.h"
+
+bool ClockSync::sample(const uint64_t _request, const uint64_t _remote, const uint64_t _response)
+{
+    if (_remote == _request || _response < _request)
+    {
+        return false;
+    }
+
+    Sample s;
+
+    s.time = _response;
+    s.delay = _response - _request;
+    s.offset = (2 * (int64_t)_remote - (int64_t)_request - (int64_t)_response) / 2;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    window_[window_next_] = s;
+    window_next_ = (window_next_ + 1) % WINDOW;
+
+    if (window_size_ < WINDOW)
+    {
+        window_size_++;
+    }
+
+    // clock filter, the shortest round trip had the least queueing
+    const Sample *best = &window_[0];
+
+    for (size_t i = 1; i < window_size_; i++)
+    {
+        if (window_[i].delay < best->delay)
+        {
+            best = &window_[i];
+        }
+    }
+
+    size_t last = (history_next_ + HISTORY - 1) % HISTORY;
+
+    if (0 == history_size_ || history_[last].time != best->time)
+    {
+        history_[history_next_] = *best;
+        history_next_ = (history_next_ + 1) % HISTORY;
+
+        if (history_size_ < HISTORY)
+        {
+            history_size_++;
+        }
+    }
+
+    delay_ = best->delay;
+    samples_++;
+    offset_.store(best->offset, std::memory_order_relaxed);
+    ref_.store(best->time, std::memory_order_relaxed);
+    update_drift();
+    synced_.store(true, std::memory_order_release);
+
+    return true;
+}
+
+void ClockSync::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    synced_.store(false, std::memory_order_release);
+    offset_.store(0, std::memory_order_relaxed);
+    ref_.store(0, std::memory_order_relaxed);
+    drift_.store(0, std::memory_order_relaxed);
+    window_size_ = 0;
+    window_next_ = 0;
+    history_size_ = 0;
+    history_next_ = 0;
+    delay_ = 0;
+    samples_ = 0;
+}
+
+int64_t ClockSync::offset(const uint64_t _now) const
+{
+    if (!synced())
+    {
+        return 0;
+    }
+
+    int64_t elapsed = (int64_t)_now - (int64_t)ref_.load(std::memory_order_relaxed);
+
+    return offset_.load(std::memory_order_relaxed)
+        + (int64_t)((double)drift_.load(std::memory_order_relaxed) * elapsed / 1e9);
+}
+
+ClockStats ClockSync::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ClockStats stats;
+
+    stats.offset = offset_.load(std::memory_order_relaxed);
+    stats.drift = drift_.load(std::memory_order_relaxed) / 1e3;
+    stats.delay = delay_;
+    stats.samples = samples_;
+    stats.synced = synced();
+
+    return stats;
+}
+
+// private
+
+void ClockSync::update_drift()
+{
+    if (4 > history_size_)
+    {
+        return;
+    }
+
+    size_t first = HISTORY == history_size_ ? history_next_ : 0;
+    size_t last = (history_next_ + HISTORY - 1) % HISTORY;
+    uint64_t base = history_[first].time;
+
+    if (history_[last].time - base < DRIFT_SPAN)
+    {
+        return;
+    }
+
+    // least squares slope of offset over time
+    double mx = 0, my = 0;
+
+    for (size_t i = 0; i < history_size_; i++)
+    {
+        mx += (double)(history_[i].time - base);
+        my += (double)history_[i].offset;
+    }
+
+    mx /= history_size_;
+    my /= history_size_;
+
+    double sxy = 0, sxx = 0;
+
+    for (size_t i = 0; i < history_size_; i++)
+    {
+        double dx = (double)(history_[i].time - base) - mx;
+
+        sxy += dx * ((double)history_[i].offset - my);
+        sxx += dx * dx;
+    }
+
+    if (0 == sxx)
+    {
+        return;
+    }
+
+    double ppm = sxy / sxx * 1e6;
+
+    if (ppm > MAX_DRIFT)
+    {
+        ppm = MAX_DRIFT;
+    }
+    else if (ppm < -MAX_DRIFT)
+    {
+        ppm = -MAX_DRIFT;
+    }
+
+    drift_.store((int64_t)(ppm * 1e3), std::memory_order_relaxed);
+}
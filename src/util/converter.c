@@ -4,6 +4,11 @@
 #include <stdlib.h>
 
 #include <iconv.h>
+#include <pthread.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "converter.h"
 #include "log.h"
@@ -13,10 +18,66 @@
 /*******************************************************************************
  * Definitions
  ******************************************************************************/
+#define ICONV_CACHE_SIZE 4
+
+typedef struct
+{
+    char    from[32];
+    char    to[32];
+    iconv_t cd;
+} iconv_entry_t;
+
+/* per thread iconv descriptors, closed at thread exit */
+typedef struct
+{
+    iconv_entry_t entries[ICONV_CACHE_SIZE];
+    size_t        count;
+    size_t        next;
+} iconv_cache_t;
+
+/* two ASCII digits per packed byte, empty when a nibble is not a digit */
+static const char s_bcd_digits[256][3] =
+{
+    "00", "01", "02", "03", "04", "05", "06", "07", "08", "09", "",   "",   "",   "",   "",   "",
+    "10", "11", "12", "13", "14", "15", "16", "17", "18", "19", "",   "",   "",   "",   "",   "",
+    "20", "21", "22", "23", "24", "25", "26", "27", "28", "29", "",   "",   "",   "",   "",   "",
+    "30", "31", "32", "33", "34", "35", "36", "37", "38", "39", "",   "",   "",   "",   "",   "",
+    "40", "41", "42", "43", "44", "45", "46", "47", "48", "49", "",   "",   "",   "",   "",   "",
+    "50", "51", "52", "53", "54", "55", "56", "57", "58", "59", "",   "",   "",   "",   "",   "",
+    "60", "61", "62", "63", "64", "65", "66", "67", "68", "69", "",   "",   "",   "",   "",   "",
+    "70", "71", "72", "73", "74", "75", "76", "77", "78", "79", "",   "",   "",   "",   "",   "",
+    "80", "81", "82", "83", "84", "85", "86", "87", "88", "89", "",   "",   "",   "",   "",   "",
+    "90", "91", "92", "93", "94", "95", "96", "97", "98", "99", "",   "",   "",   "",   "",   "",
+    "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",
+    "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",
+    "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",
+    "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",
+    "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",
+    "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",   "",
+};
+
+extern const uint16_t gbk_to_unicode_table[126][190];
+
+static pthread_key_t  s_iconv_key;
+static pthread_once_t s_iconv_once = PTHREAD_ONCE_INIT;
+
+static uint16_t       s_unicode_to_gbk[0x10000];
+static pthread_once_t s_unicode_once = PTHREAD_ONCE_INIT;
 
 /*******************************************************************************
  * Local function prototypes
  ******************************************************************************/
+static int pack_digits(const char *_str, const size_t _len, uint8_t *_bcd);
+
+static int unpack_digits(const uint8_t *_bcd, const size_t _size, char *_str);
+
+static iconv_t iconv_get(const char *_from, const char *_to);
+
+static void unicode_to_gbk_init(void);
+
+static size_t utf8_decode(const uint8_t *_buf, const size_t _size, uint32_t *_cp);
+
+static size_t utf8_encode(const uint32_t _cp, uint8_t *_buf);
 
 /*******************************************************************************
  * Functions
@@ -68,62 +129,609 @@ void bytes_to_string(const void *_bytes, const size_t _size, char _str[])
     }		
 }
 
-void string_to_bcd(const char _str[], uint8_t _bcd[], const size_t _size)
+int string_to_bcd(const char _str[], uint8_t _bcd[], const size_t _size)
 {
-    if (NULL == _bcd)
-    {       
-        LOGE(TAG, "string_to_bcd: Buffer is null!\n"); 
+    if (NULL == _str || NULL == _bcd)
+    {
+        LOGE(TAG, "string_to_bcd: String or buffer is null!\n");
+        return -1;
     }
 
     size_t len = strlen(_str);
-    bool is_even = !(len % 2);
 
-    memset(_bcd, 0, _size);
+    if (len > 2 * _size)
+    {
+        LOGE(TAG, "string_to_bcd: Out of range!\n");
+        return -1;
+    }
+
+    // right aligned, leading zeros
+    size_t pad = 2 * _size - len;
 
-    for (size_t i = 0; i < len; ++i)
+    memset(_bcd, 0, pad / 2);
+    _bcd += pad / 2;
+
+    if (0 != pad % 2)
     {
-        char c = _str[i];
-        int value = atoi(&c);
-        int j = (2 * _size - len + i) / 2;
+        uint8_t d = (uint8_t)(*_str++ - '0');
 
-        if (j >= _size)
+        if (9 < d)
         {
-            LOGE(TAG, "string_to_bcd: Out of range!\n"); 
-            return;
+            return -1;
         }
-        
-        _bcd[(2 * _size - len + i) / 2] |= value << (4 * ((is_even ? i + 1 : i) % 2));
+
+        *_bcd++ = d;
+        len--;
+    }
+
+    return pack_digits(_str, len, _bcd);
+}
+
+int bcd_to_string(const uint8_t _bcd[], const size_t _size, char _str[])
+{
+    if (NULL == _bcd || NULL == _str)
+    {
+        LOGE(TAG, "bcd_to_string: Buffer or string is null!\n");
+        return -1;
     }
+
+    _str[2 * _size] = '\0';
+
+    return unpack_digits(_bcd, _size, _str);
+}
+
+int string_to_bcd_var(const char _str[], uint8_t _bcd[], const size_t _size)
+{
+    if (NULL == _str || NULL == _bcd)
+    {
+        LOGE(TAG, "string_to_bcd_var: String or buffer is null!\n");
+        return -1;
+    }
+
+    size_t len = strlen(_str);
+
+    if ((len + 1) / 2 > _size)
+    {
+        LOGE(TAG, "string_to_bcd_var: Out of range!\n");
+        return -1;
+    }
+
+    if (0 != pack_digits(_str, len & ~(size_t)1, _bcd))
+    {
+        return -1;
+    }
+
+    // odd length, 0xF filler in the low nibble, the rest of the field 0xFF
+    if (0 != len % 2)
+    {
+        uint8_t d = (uint8_t)(_str[len - 1] - '0');
+
+        if (9 < d)
+        {
+            return -1;
+        }
+
+        _bcd[len / 2] = (uint8_t)(d << 4 | 0x0F);
+    }
+
+    memset(_bcd + (len + 1) / 2, 0xFF, _size - (len + 1) / 2);
+
+    return (int)((len + 1) / 2);
+}
+
+int bcd_to_string_var(const uint8_t _bcd[], const size_t _size, char _str[])
+{
+    if (NULL == _bcd || NULL == _str)
+    {
+        LOGE(TAG, "bcd_to_string_var: Buffer or string is null!\n");
+        return -1;
+    }
+
+    // the digits end at the first 0xF nibble or with the buffer
+    size_t n = 0;
+
+    while (n < _size && 0xF0 != (_bcd[n] & 0xF0) && 0x0F != (_bcd[n] & 0x0F))
+    {
+        n++;
+    }
+
+    if (0 != unpack_digits(_bcd, n, _str))
+    {
+        return -1;
+    }
+
+    size_t len = 2 * n;
+
+    if (n < _size && 0xF0 != (_bcd[n] & 0xF0))
+    {
+        if (9 < (_bcd[n] >> 4))
+        {
+            return -1;
+        }
+
+        _str[len++] = (char)('0' + (_bcd[n] >> 4));
+    }
+
+    _str[len] = '\0';
+
+    return (int)len;
+}
+
+int string_to_bcd_batch(const char _strs[], const size_t _len, const size_t _count, uint8_t _bcd[], const size_t _size)
+{
+    if (NULL == _strs || NULL == _bcd)
+    {
+        LOGE(TAG, "string_to_bcd_batch: Strings or buffer is null!\n");
+        return -1;
+    }
+
+    if (_len > 2 * _size)
+    {
+        LOGE(TAG, "string_to_bcd_batch: Out of range!\n");
+        return -1;
+    }
+
+    char str[2 * _size + 1];
+    size_t pad = 2 * _size - _len;
+
+    // pad once, then every id is an even digit run
+    memset(str, '0', pad);
+
+    for (size_t i = 0; i < _count; i++)
+    {
+        const char *src = _strs + i * _len;
+        uint8_t *dst = _bcd + i * _size;
+
+        if (0 == pad)
+        {
+            if (0 != pack_digits(src, _len, dst))
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            memcpy(str + pad, src, _len);
+
+            if (0 != pack_digits(str, 2 * _size, dst))
+            {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int bcd_to_string_batch(const uint8_t _bcd[], const size_t _size, const size_t _count, char _strs[])
+{
+    if (NULL == _bcd || NULL == _strs)
+    {
+        LOGE(TAG, "bcd_to_string_batch: Buffer or strings is null!\n");
+        return -1;
+    }
+
+    // contiguous input and output, one run for the whole column
+    return unpack_digits(_bcd, _size * _count, _strs);
 }
 
 int code_convert(char *from_charset, char *to_charset, char *inbuf, size_t inlen, char *outbuf, size_t outlen) 
 {
-    iconv_t cd;
+    iconv_t cd = iconv_get(from_charset, to_charset);
     char **pin = &inbuf;
     char **pout = &outbuf;
 
-    cd = iconv_open(to_charset, from_charset);
-    if (cd == 0)
+    if ((iconv_t)-1 == cd)
+    {
+        LOGE(TAG, "code_convert: iconv_open %s to %s failed!\n", from_charset, to_charset);
         return -1;
+    }
+
     memset(outbuf, 0, outlen);
-    if (iconv(cd, pin, &inlen, pout, &outlen) != 0)
+
+    if ((size_t)-1 == iconv(cd, pin, &inlen, pout, &outlen))
+    {
+        // drop the shift state, the descriptor is reused
+        iconv(cd, NULL, NULL, NULL, NULL);
         return -1;
-    iconv_close(cd);
-    *pout = '\0';
+    }
 
     return 0;
 }
 
 int utf8_to_gbk(char *inbuf, size_t inlen, char *outbuf, size_t outlen) 
 {
-    return code_convert((char*)"utf-8", (char*)"gb2312", inbuf, inlen, outbuf, outlen);
+    const uint8_t *in = (const uint8_t*)inbuf;
+    uint8_t *out = (uint8_t*)outbuf;
+    size_t i = 0;
+    size_t o = 0;
+
+    pthread_once(&s_unicode_once, unicode_to_gbk_init);
+
+    while (i < inlen)
+    {
+        // runs of ASCII are copied through
+        size_t n = ascii_length(in + i, inlen - i);
+
+        if (o + n > outlen)
+        {
+            return -1;
+        }
+
+        memcpy(out + o, in + i, n);
+        i += n;
+        o += n;
+
+        if (i >= inlen)
+        {
+            break;
+        }
+
+        uint32_t cp = 0;
+        size_t len = utf8_decode(in + i, inlen - i, &cp);
+
+        if (0 == len || 0xFFFF < cp || 0 == s_unicode_to_gbk[cp] || o + 2 > outlen)
+        {
+            return -1;
+        }
+
+        out[o++] = (uint8_t)(s_unicode_to_gbk[cp] >> 8);
+        out[o++] = (uint8_t)(s_unicode_to_gbk[cp] & 0xFF);
+        i += len;
+    }
+
+    if (o < outlen)
+    {
+        out[o] = '\0';
+    }
+
+    return 0;
 }
 
 int gbk_to_utf8(char *inbuf, size_t inlen, char *outbuf, size_t outlen) 
 {
-    return code_convert((char*)"gb2312", (char*)"utf-8", inbuf, inlen, outbuf, outlen);
+    const uint8_t *in = (const uint8_t*)inbuf;
+    uint8_t *out = (uint8_t*)outbuf;
+    size_t i = 0;
+    size_t o = 0;
+
+    while (i < inlen)
+    {
+        // runs of ASCII are copied through
+        size_t n = ascii_length(in + i, inlen - i);
+
+        if (o + n > outlen)
+        {
+            return -1;
+        }
+
+        memcpy(out + o, in + i, n);
+        i += n;
+        o += n;
+
+        if (i >= inlen)
+        {
+            break;
+        }
+
+        uint8_t lead = in[i];
+        uint8_t trail = i + 1 < inlen ? in[i + 1] : 0;
+
+        if (0x81 > lead || 0xFE < lead || 0x40 > trail || 0xFE < trail || 0x7F == trail)
+        {
+            return -1;
+        }
+
+        uint16_t cp = gbk_to_unicode_table[lead - 0x81][trail - 0x40 - (trail > 0x7F)];
+
+        if (0 == cp || o + 3 > outlen)
+        {
+            return -1;
+        }
+
+        o += utf8_encode(cp, out + o);
+        i += 2;
+    }
+
+    if (o < outlen)
+    {
+        out[o] = '\0';
+    }
+
+    return 0;
+}
+
+int utf8_to_gbk_iconv(char *inbuf, size_t inlen, char *outbuf, size_t outlen) 
+{
+    return code_convert((char*)"utf-8", (char*)"gbk", inbuf, inlen, outbuf, outlen);
+}
+
+int gbk_to_utf8_iconv(char *inbuf, size_t inlen, char *outbuf, size_t outlen) 
+{
+    return code_convert((char*)"gbk", (char*)"utf-8", inbuf, inlen, outbuf, outlen);
+}
+
+size_t ascii_length(const void *_buf, const size_t _size)
+{
+    const uint8_t *buf = (const uint8_t*)_buf;
+    size_t i = 0;
+
+#ifdef __SSE2__
+    for (; i + 16 <= _size; i += 16)
+    {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(buf + i)));
+
+        if (0 != mask)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    for (; i < _size; i++)
+    {
+        if (0 != (buf[i] & 0x80))
+        {
+            return i;
+        }
+    }
+
+    return i;
 }
 
 /*******************************************************************************
  * Local functions
- ******************************************************************************/
\ No newline at end of file
+ ******************************************************************************/
+static int pack_digits(const char *_str, const size_t _len, uint8_t *_bcd)
+{
+    const uint8_t *str = (const uint8_t*)_str;
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i low = _mm_set1_epi16(0x00FF);
+
+    // 16 digits to 8 bytes
+    for (; i + 16 <= _len; i += 16)
+    {
+        __m128i d = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(str + i)), zero);
+
+        if (0xFFFF != _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(d, nine), d)))
+        {
+            return -1;
+        }
+
+        __m128i v = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(d, low), 4), _mm_srli_epi16(d, 8));
+        _mm_storel_epi64((__m128i*)(_bcd + i / 2), _mm_packus_epi16(v, v));
+    }
+#endif
+
+    for (; i + 2 <= _len; i += 2)
+    {
+        uint8_t hi = (uint8_t)(str[i] - '0');
+        uint8_t lo = (uint8_t)(str[i + 1] - '0');
+
+        if (9 < hi || 9 < lo)
+        {
+            return -1;
+        }
+
+        _bcd[i / 2] = (uint8_t)(hi << 4 | lo);
+    }
+
+    return 0;
+}
+
+static int unpack_digits(const uint8_t *_bcd, const size_t _size, char *_str)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_set1_epi8('0');
+
+    // 8 bytes to 16 digits
+    for (; i + 8 <= _size; i += 8)
+    {
+        __m128i b = _mm_loadl_epi64((const __m128i*)(_bcd + i));
+        __m128i d = _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(b, 4), mask), _mm_and_si128(b, mask));
+
+        if (0 != _mm_movemask_epi8(_mm_cmpgt_epi8(d, nine)))
+        {
+            return -1;
+        }
+
+        _mm_storeu_si128((__m128i*)(_str + 2 * i), _mm_add_epi8(d, zero));
+    }
+#endif
+
+    for (; i < _size; i++)
+    {
+        const char *digits = s_bcd_digits[_bcd[i]];
+
+        if ('\0' == digits[0])
+        {
+            return -1;
+        }
+
+        _str[2 * i] = digits[0];
+        _str[2 * i + 1] = digits[1];
+    }
+
+    return 0;
+}
+
+static void iconv_cache_free(void *_p)
+{
+    iconv_cache_t *cache = (iconv_cache_t*)_p;
+
+    for (size_t i = 0; i < cache->count; i++)
+    {
+        iconv_close(cache->entries[i].cd);
+    }
+
+    free(cache);
+}
+
+static void iconv_key_create(void)
+{
+    pthread_key_create(&s_iconv_key, iconv_cache_free);
+}
+
+static iconv_t iconv_get(const char *_from, const char *_to)
+{
+    pthread_once(&s_iconv_once, iconv_key_create);
+
+    iconv_cache_t *cache = (iconv_cache_t*)pthread_getspecific(s_iconv_key);
+
+    if (NULL == cache)
+    {
+        cache = (iconv_cache_t*)calloc(1, sizeof(iconv_cache_t));
+
+        if (NULL == cache)
+        {
+            return (iconv_t)-1;
+        }
+
+        pthread_setspecific(s_iconv_key, cache);
+    }
+
+    for (size_t i = 0; i < cache->count; i++)
+    {
+        iconv_entry_t *entry = &cache->entries[i];
+
+        if (0 == strcmp(entry->from, _from) && 0 == strcmp(entry->to, _to))
+        {
+            return entry->cd;
+        }
+    }
+
+    if (sizeof(cache->entries[0].from) <= strlen(_from) || sizeof(cache->entries[0].to) <= strlen(_to))
+    {
+        return (iconv_t)-1;
+    }
+
+    iconv_t cd = iconv_open(_to, _from);
+
+    if ((iconv_t)-1 == cd)
+    {
+        return cd;
+    }
+
+    // round robin eviction once full
+    iconv_entry_t *entry = NULL;
+
+    if (ICONV_CACHE_SIZE > cache->count)
+    {
+        entry = &cache->entries[cache->count++];
+    }
+    else
+    {
+        entry = &cache->entries[cache->next];
+        cache->next = (cache->next + 1) % ICONV_CACHE_SIZE;
+        iconv_close(entry->cd);
+    }
+
+    strcpy(entry->from, _from);
+    strcpy(entry->to, _to);
+    entry->cd = cd;
+
+    return cd;
+}
+
+static void unicode_to_gbk_init(void)
+{
+    for (int lead = 0x81; lead <= 0xFE; lead++)
+    {
+        for (int trail = 0x40; trail <= 0xFE; trail++)
+        {
+            if (0x7F == trail)
+            {
+                continue;
+            }
+
+            uint16_t cp = gbk_to_unicode_table[lead - 0x81][trail - 0x40 - (trail > 0x7F)];
+
+            // first code wins where GBK maps twice
+            if (0 != cp && 0 == s_unicode_to_gbk[cp])
+            {
+                s_unicode_to_gbk[cp] = (uint16_t)((lead << 8) | trail);
+            }
+        }
+    }
+}
+
+static size_t utf8_decode(const uint8_t *_buf, const size_t _size, uint32_t *_cp)
+{
+    uint8_t c = _buf[0];
+    size_t len = 0;
+    uint32_t cp = 0;
+
+    if (0xC2 <= c && 0xDF >= c)
+    {
+        len = 2;
+        cp = c & 0x1F;
+    }
+    else if (0xE0 <= c && 0xEF >= c)
+    {
+        len = 3;
+        cp = c & 0x0F;
+    }
+    else if (0xF0 <= c && 0xF4 >= c)
+    {
+        len = 4;
+        cp = c & 0x07;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (len > _size)
+    {
+        return 0;
+    }
+
+    for (size_t i = 1; i < len; i++)
+    {
+        if (0x80 != (_buf[i] & 0xC0))
+        {
+            return 0;
+        }
+
+        cp = (cp << 6) | (_buf[i] & 0x3F);
+    }
+
+    // overlong and surrogate forms
+    if ((3 == len && 0x800 > cp) || (4 == len && 0x10000 > cp) || (0xD800 <= cp && 0xDFFF >= cp) || 0x10FFFF < cp)
+    {
+        return 0;
+    }
+
+    *_cp = cp;
+
+    return len;
+}
+
+static size_t utf8_encode(const uint32_t _cp, uint8_t *_buf)
+{
+    if (0x80 > _cp)
+    {
+        _buf[0] = (uint8_t)_cp;
+        return 1;
+    }
+
+    if (0x800 > _cp)
+    {
+        _buf[0] = (uint8_t)(0xC0 | (_cp >> 6));
+        _buf[1] = (uint8_t)(0x80 | (_cp & 0x3F));
+        return 2;
+    }
+
+    _buf[0] = (uint8_t)(0xE0 | (_cp >> 12));
+    _buf[1] = (uint8_t)(0x80 | ((_cp >> 6) & 0x3F));
+    _buf[2] = (uint8_t)(0x80 | (_cp & 0x3F));
+    return 3;
+}
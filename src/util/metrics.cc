@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <string.h>
+#include <cinttypes>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "metrics.h"
+#include "log.h"
+
+std::atomic<size_t> Counter::next_{0};
+
+// Metrics
+
+Metrics& Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Counter& Metrics::counter(const char _name[], const char _help[], const char _labels[])
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    void *p = find(_name, _labels, METRIC_COUNTER);
+
+    if (nullptr == p)
+    {
+        counters_.emplace_back(new Counter());
+        p = add(_name, _help, _labels, METRIC_COUNTER, counters_.back().get());
+    }
+
+    return *(Counter*)p;
+}
+
+Gauge& Metrics::gauge(const char _name[], const char _help[], const char _labels[])
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    void *p = find(_name, _labels, METRIC_GAUGE);
+
+    if (nullptr == p)
+    {
+        gauges_.emplace_back(new Gauge());
+        p = add(_name, _help, _labels, METRIC_GAUGE, gauges_.back().get());
+    }
+
+    return *(Gauge*)p;
+}
+
+Histogram& Metrics::histogram(const char _name[], const char _help[], const char _labels[])
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    void *p = find(_name, _labels, METRIC_HISTOGRAM);
+
+    if (nullptr == p)
+    {
+        histograms_.emplace_back(new Histogram());
+        p = add(_name, _help, _labels, METRIC_HISTOGRAM, histograms_.back().get());
+    }
+
+    return *(Histogram*)p;
+}
+
+void Metrics::snapshot(std::vector<Sample> &_samples) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    snapshot_locked(_samples);
+}
+
+void Metrics::write_prometheus(std::string &_out) const
+{
+    static const char *types[] = {"counter", "gauge", "summary"};
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Sample> samples;
+    char line[512];
+
+    snapshot_locked(samples);
+
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        const Sample &s = samples[i];
+        const char *sep = s.labels.empty() ? "" : ",";
+
+        // one HELP and TYPE per family, entries of a family are kept together
+        if (0 == i || samples[i - 1].name != s.name)
+        {
+            snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n",
+                s.name.c_str(), entries_[i].help.c_str(), s.name.c_str(), types[s.type]);
+            _out += line;
+        }
+
+        if (METRIC_HISTOGRAM != s.type)
+        {
+            snprintf(line, sizeof(line), "%s%s%s%s %" PRId64 "\n", s.name.c_str(),
+                s.labels.empty() ? "" : "{", s.labels.c_str(), s.labels.empty() ? "" : "}", s.value);
+            _out += line;
+            continue;
+        }
+
+        const struct { const char *q; uint64_t v; } quantiles[] =
+        {
+            {"0.5", s.p50}, {"0.9", s.p90}, {"0.99", s.p99}, {"0.999", s.p999}, {"1", s.max}
+        };
+
+        for (auto &q : quantiles)
+        {
+            snprintf(line, sizeof(line), "%s{%s%squantile=\"%s\"} %" PRIu64 "\n",
+                s.name.c_str(), s.labels.c_str(), sep, q.q, q.v);
+            _out += line;
+        }
+
+        snprintf(line, sizeof(line), "%s_sum%s%s%s %" PRIu64 "\n%s_count%s%s%s %" PRIu64 "\n",
+            s.name.c_str(), s.labels.empty() ? "" : "{", s.labels.c_str(), s.labels.empty() ? "" : "}", s.sum,
+            s.name.c_str(), s.labels.empty() ? "" : "{", s.labels.c_str(), s.labels.empty() ? "" : "}", s.count);
+        _out += line;
+    }
+}
+
+// private
+
+void Metrics::snapshot_locked(std::vector<Sample> &_samples) const
+{
+    _samples.resize(entries_.size());
+
+    for (size_t i = 0; i < entries_.size(); i++)
+    {
+        const Entry &entry = entries_[i];
+        Sample &sample = _samples[i];
+
+        if (sample.name != entry.name || sample.labels != entry.labels)
+        {
+            sample.name = entry.name;
+            sample.labels = entry.labels;
+        }
+
+        sample.type = entry.type;
+
+        switch (entry.type)
+        {
+        case METRIC_COUNTER:
+            sample.value = (int64_t)((const Counter*)entry.metric)->value();
+            break;
+
+        case METRIC_GAUGE:
+            sample.value = ((const Gauge*)entry.metric)->value();
+            break;
+
+        case METRIC_HISTOGRAM:
+        {
+            const Histogram *h = (const Histogram*)entry.metric;
+
+            sample.count = h->count();
+            sample.sum = h->sum();
+            sample.p50 = h->percentile(50);
+            sample.p90 = h->percentile(90);
+            sample.p99 = h->percentile(99);
+            sample.p999 = h->percentile(99.9);
+            sample.max = h->max();
+            sample.value = (int64_t)sample.count;
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+}
+
+void* Metrics::find(const char _name[], const char _labels[], const uint32_t _type) const
+{
+    for (auto &entry : entries_)
+    {
+        if (entry.type == _type && entry.name == _name && entry.labels == _labels)
+        {
+            return entry.metric;
+        }
+    }
+
+    return nullptr;
+}
+
+void* Metrics::add(const char _name[], const char _help[], const char _labels[], const uint32_t _type, void *_metric)
+{
+    Entry entry = {_name, _help, _labels, _type, _metric};
+
+    // keep a family together behind its last entry
+    auto it = entries_.end();
+
+    for (auto i = entries_.begin(); i != entries_.end(); ++i)
+    {
+        if (i->name == _name)
+        {
+            it = i + 1;
+        }
+    }
+
+    entries_.insert(it, entry);
+
+    return _metric;
+}
+
+// MetricsEndpoint
+
+MetricsEndpoint::~MetricsEndpoint()
+{
+    stop();
+}
+
+int32_t MetricsEndpoint::start(const char _path[])
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (0 <= fd_ || sizeof(addr.sun_path) <= strlen(_path))
+    {
+        LOGE(TAG, "start: started or path %s too long!\n", _path);
+        return -1;
+    }
+
+    memcpy(addr.sun_path, _path, strlen(_path));
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (0 > fd)
+    {
+        LOGE(TAG, "start: socket error(%d), %s!\n", errno, strerror(errno));
+        return -1;
+    }
+
+    unlink(_path);
+
+    if (0 != bind(fd, (struct sockaddr*)&addr, sizeof(addr)) || 0 != listen(fd, 4))
+    {
+        LOGE(TAG, "start: listen on %s error(%d), %s!\n", _path, errno, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    path_ = _path;
+    fd_ = fd;
+    thread_ = std::thread([this]()
+    {
+        this->serve();
+    });
+
+    return 0;
+}
+
+void MetricsEndpoint::stop()
+{
+    if (0 > fd_)
+    {
+        return;
+    }
+
+    // wakes accept()
+    shutdown(fd_, SHUT_RDWR);
+    thread_.join();
+    close(fd_.exchange(-1));
+    unlink(path_.c_str());
+}
+
+// private
+
+void MetricsEndpoint::serve()
+{
+    std::string text;
+
+    while (true)
+    {
+        int fd = accept(fd_, nullptr, nullptr);
+
+        if (0 > fd)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+
+            return;
+        }
+
+        text.clear();
+        Metrics::instance().write_prometheus(text);
+
+        const char *p = text.data();
+        size_t size = text.size();
+
+        while (0 < size)
+        {
+            ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+
+            if (0 >= n)
+            {
+                break;
+            }
+
+            p += n;
+            size -= n;
+        }
+
+        close(fd);
+    }
+}
@@ -16,8 +16,21 @@
 #include <arpa/inet.h>
 
 #include "socketlib.h"
+#include "metrics.h"
 #include "log.h"
 
+static Counter &s_connect_errors = Metrics::instance().counter(
+    "csae_socket_connect_errors_total", "Failed socket creations and connects.");
+static Counter &s_send_calls = Metrics::instance().counter("csae_socket_send_calls_total", "send() calls.");
+static Counter &s_send_errors = Metrics::instance().counter("csae_socket_send_errors_total", "send() errors.");
+static Counter &s_recv_calls = Metrics::instance().counter("csae_socket_recv_calls_total", "recv() calls.");
+static Counter &s_recv_errors = Metrics::instance().counter(
+    "csae_socket_recv_errors_total", "recv() errors and remote shutdowns.");
+static Counter &s_state_connected = Metrics::instance().counter(
+    "csae_socket_state_changes_total", "Connect state changes.", "state=\"connected\"");
+static Counter &s_state_lost = Metrics::instance().counter(
+    "csae_socket_state_changes_total", "Connect state changes.", "state=\"lost\"");
+
 namespace socketlib
 {
     Client::~Client()
@@ -38,6 +51,7 @@ namespace socketlib
         {
             //printf("[socketlib::Client::open] create socket error(%d), %s!\n", errno, strerror(errno));
             LOGE(TAG, "open: create socket error(%d), %s!\n", errno, strerror(errno));
+            s_connect_errors.add();
             return -1;
         }
 
@@ -66,11 +80,16 @@ namespace socketlib
         setsockopt(sockfd_, SOL_TCP, TCP_KEEPCNT, &value,  sizeof(value));
 #endif
 
+        // frames are written whole, Nagle only holds small requests behind unacked states
+        int nodelay = 1;
+        setsockopt(sockfd_, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
         // connect
         if (0 != ::connect(sockfd_, (struct sockaddr*)&addr, sizeof(addr)))
         {
             //printf("[socketlib::Client::open] connect error(%d), %s!\n", errno, strerror(errno));
             LOGE(TAG, "open: connect error(%d), %s!\n", errno, strerror(errno));
+            s_connect_errors.add();
             return -1;
         }
 
@@ -116,6 +135,8 @@ namespace socketlib
             return -1;
         }
 
+        opened_ = true;
+
         return 0;
     }
 
@@ -124,16 +145,19 @@ namespace socketlib
         ssize_t size = 0;
 
         size = ::recv(sockfd_, _buf, _size, 0);
+        s_recv_calls.add();
 
         if (0 == size)
         {
             //printf("[socketlib::Client::receive]: receive error(%d), %s!\n", errno, strerror(errno));
             LOGE(TAG, "recv: remote shutdown, error(%d), %s!\n", errno, strerror(errno));
+            s_recv_errors.add();
         }
         else if(0 > size) 
         {  
             //printf("[socketlib::Client::receive]: receive error(%d), %s!\n", errno, strerror(errno));
             LOGE(TAG, "recv: receive error(%d), %s!\n", errno, strerror(errno));
+            s_recv_errors.add();
         }
 
         return size;
@@ -143,12 +167,14 @@ namespace socketlib
     {
         ssize_t size = 0;
 
-        size = ::send(sockfd_, _buf, _size, 0);
+        size = ::send(sockfd_, _buf, _size, MSG_NOSIGNAL);
+        s_send_calls.add();
 
         if (0 > size)
         {
             //printf("[socketlib::Client::send] send error(%d), %s!\n", errno, strerror(errno));
             LOGE(TAG, "send: send error(%d), %s!\n", errno, strerror(errno));
+            s_send_errors.add();
         }  
 
         return size;
@@ -156,7 +182,7 @@ namespace socketlib
 
     int32_t Client::close()
     {
-        if (CLOSED == state_)
+        if (!opened_)
         {
             return 0;
         }
@@ -183,6 +209,7 @@ namespace socketlib
         }
 
         state_ = CLOSED;
+        opened_ = false;
 
         return 0;
     }
@@ -226,10 +253,15 @@ namespace socketlib
                 }
             }
             
-            if (state != state_ && nullptr != callback_)
+            if (state != state_)
             {
                 state_ = state;
-                callback_(state_, param_);
+                (CONNECTED == state_ ? s_state_connected : s_state_lost).add();
+
+                if (nullptr != callback_)
+                {
+                    callback_(state_, param_);
+                }
 
                 // std::thread t([=]()
                 // {
@@ -0,0 +1,200 @@
+#include "timer_wheel.h"
+#include "log.h"
+
+TimerWheel::TimerWheel(const uint32_t _tick, const size_t _slots):
+    tick_(0 == _tick ? 1 : _tick), slots_(0 == _slots ? 1 : _slots)
+{
+}
+
+TimerWheel::~TimerWheel()
+{
+    stop();
+}
+
+int32_t TimerWheel::start()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!stopped_)
+    {
+        LOGE(TAG, "start: already started!\n");
+        return -1;
+    }
+
+    stopped_ = false;
+    base_ = std::chrono::steady_clock::now();
+    processed_ = 0;
+    thread_ = std::thread([this]()
+    {
+        this->run();
+    });
+
+    return 0;
+}
+
+void TimerWheel::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (stopped_)
+        {
+            return;
+        }
+
+        stopped_ = true;
+        cond_.notify_all();
+    }
+
+    // stopped from one of its own handlers
+    if (std::this_thread::get_id() == thread_.get_id())
+    {
+        thread_.detach();
+    }
+    else
+    {
+        thread_.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto &slot : slots_)
+    {
+        slot.clear();
+    }
+
+    index_.clear();
+}
+
+uint64_t TimerWheel::schedule(const uint32_t _delay, handler _handler)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (stopped_)
+    {
+        LOGE(TAG, "schedule: not started!\n");
+        return 0;
+    }
+
+    uint64_t now = current_tick();
+
+    // the thread slept through the idle ticks, nothing to catch up on
+    if (index_.empty())
+    {
+        processed_ = now;
+    }
+
+    // round up, and never into a tick already handled
+    uint64_t expire = now + (_delay + tick_ - 1) / tick_;
+
+    if (expire <= processed_)
+    {
+        expire = processed_ + 1;
+    }
+
+    Slot &slot = slots_[expire % slots_.size()];
+    uint64_t id = next_id_++;
+
+    slot.push_back(Entry{id, expire, std::move(_handler)});
+    index_[id] = std::prev(slot.end());
+    cond_.notify_all();
+
+    return id;
+}
+
+bool TimerWheel::cancel(const uint64_t _id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(_id);
+
+    if (index_.end() == it)
+    {
+        return false;
+    }
+
+    slots_[it->second->expire % slots_.size()].erase(it->second);
+    index_.erase(it);
+
+    return true;
+}
+
+size_t TimerWheel::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.size();
+}
+
+// private
+
+uint64_t TimerWheel::current_tick() const
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - base_).count() / tick_;
+}
+
+void TimerWheel::run()
+{
+    std::vector<handler> expired;
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (!stopped_)
+    {
+        if (index_.empty())
+        {
+            cond_.wait(lock);
+            continue;
+        }
+
+        uint64_t now = current_tick();
+
+        if (now <= processed_)
+        {
+            cond_.wait_until(lock, base_ + std::chrono::milliseconds((processed_ + 1) * tick_));
+            continue;
+        }
+
+        // a full turn visits every slot, so cap the catch up there
+        uint64_t from = processed_ + 1;
+
+        if (now - processed_ > slots_.size())
+        {
+            from = now - slots_.size() + 1;
+        }
+
+        for (uint64_t t = from; t <= now; t++)
+        {
+            Slot &slot = slots_[t % slots_.size()];
+
+            for (auto it = slot.begin(); it != slot.end();)
+            {
+                if (it->expire <= now)
+                {
+                    expired.push_back(std::move(it->fn));
+                    index_.erase(it->id);
+                    it = slot.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+
+        processed_ = now;
+
+        if (expired.empty())
+        {
+            continue;
+        }
+
+        lock.unlock();
+
+        for (auto &fn : expired)
+        {
+            fn();
+        }
+
+        expired.clear();
+        lock.lock();
+    }
+}
@@ -0,0 +1,92 @@
+#include <math.h>
+
+#include "token_bucket.h"
+
+void TokenBucket::configure(const uint64_t _bytes, const uint32_t _frames, const uint64_t _burst_bytes, const uint32_t _burst_frames)
+{
+    bytes_ = _bytes;
+    frames_ = _frames;
+    burst_bytes_ = 0 != _burst_bytes ? _burst_bytes : _bytes / 10;
+    burst_frames_ = 0 != _burst_frames ? _burst_frames : _frames / 10;
+
+    // a single frame must always fit
+    if (1 > burst_frames_)
+    {
+        burst_frames_ = 1;
+    }
+
+    if (1 > burst_bytes_)
+    {
+        burst_bytes_ = 1;
+    }
+
+    // start full
+    byte_tokens_ = burst_bytes_;
+    frame_tokens_ = burst_frames_;
+    last_ = 0;
+    window_ = 0;
+    window_bytes_ = 0;
+    rate_ = 0;
+}
+
+uint64_t TokenBucket::reserve(const size_t _size, const uint64_t _now)
+{
+    if (0 == window_)
+    {
+        window_ = _now;
+    }
+
+    if (enabled())
+    {
+        refill(_now);
+
+        double need = _size < burst_bytes_ ? _size : burst_bytes_;
+        double wait = 0;
+
+        if (0 != bytes_ && byte_tokens_ < need)
+        {
+            wait = (need - byte_tokens_) * 1e6 / bytes_;
+        }
+
+        if (0 != frames_ && frame_tokens_ < 1)
+        {
+            wait = fmax(wait, (1 - frame_tokens_) * 1e6 / frames_);
+        }
+
+        if (0 < wait)
+        {
+            return (uint64_t)ceil(wait);
+        }
+
+        byte_tokens_ -= _size;
+        frame_tokens_ -= 1;
+    }
+
+    window_bytes_ += _size;
+
+    if (1000000 <= _now - window_)
+    {
+        rate_ = window_bytes_ * 1000000 / (_now - window_);
+        window_ = _now;
+        window_bytes_ = 0;
+    }
+
+    return 0;
+}
+
+// private
+
+void TokenBucket::refill(const uint64_t _now)
+{
+    if (0 == last_ || _now <= last_)
+    {
+        last_ = 0 == last_ ? _now : last_;
+        return;
+    }
+
+    double elapsed = (_now - last_) / 1e6;
+
+    byte_tokens_ = fmin(burst_bytes_, byte_tokens_ + elapsed * bytes_);
+    frame_tokens_ = fmin(burst_frames_, frame_tokens_ + elapsed * frames_);
+    last_ = _now;
+}
@@ -12,7 +12,38 @@ int main(int argc, char *argv[])
     Test::test<Cloud2VehInhRes>();
     Test::test<Veh2CloudState>();
 
+    size_t failed = Test::test_bcd();
+    failed += Test::test_gbk();
+    failed += Test::test_clock_sync();
+    failed += Test::test_token_bucket();
+    failed += Test::test_state_publisher();
+    failed += Test::test_adaptive_rate();
+    failed += Test::test_trajectory();
+    failed += Test::test_state_builder();
+    failed += Test::test_serializer();
+    failed += Test::test_tracer();
+    failed += Test::test_metrics();
+    failed += Test::test_pending_requests();
+    failed += Test::test_heartbeat();
+    failed += Test::test_dispatcher();
+    failed += Test::test_message_batch();
+    failed += Test::test_message_pool();
+    failed += Test::test_domain();
+    failed += Test::test_codegen();
+    failed += Test::test_codecs();
+    failed += Test::test_cloud_stub();
+
+    char dir[] = "/tmp/protocol_test_XXXXXX";
+    if (nullptr != mkdtemp(dir))
+    {
+        failed += Test::test_recorder(dir);
+        failed += Test::test_replayer(dir);
+        failed += Test::test_bulk_decoder(dir);
+        failed += Test::test_spool(dir, false);
+        failed += Test::test_spool(dir, true);
+    }
+
     printf("\nProtocol Test End\n");
     
-    return 0;
+    return 0 == failed ? 0 : 1;
 }
@@ -1,11 +1,45 @@
 #ifndef __PROTOCOL_TEST_H__
 #define __PROTOCOL_TEST_H__
 
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cinttypes>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
 
 #include "packer.h"
 #include "packer_handler.h"
+#include "bulk_decoder.h"
+#include "serializer.h"
+#include "recorder.h"
+#include "replayer.h"
+#include "cloud_stub.h"
+#include "tracer.h"
+#include "clock_sync.h"
+#include "spool.h"
+#include "state_publisher.h"
+#include "trajectory.h"
+#include "state_builder.h"
+#include "domain.h"
+#include "token_bucket.h"
+#include "adaptive_rate.h"
+#include "dispatcher.h"
+#include "message_batch.h"
+#include "heartbeat.h"
+#include "pending_requests.h"
+#include "jt808.h"
+#include "jt1078.h"
+#include "protocol_link.h"
+#include "metrics.h"
 #include "util.h"
 
 #define SPLIT_LINE    (std::string(100, '='))
@@ -15,6 +49,1580 @@ using namespace protocol;
 class Test
 {
 public:
+    /**
+     * Shape a backlog of frames and check the burst and the long run rate.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_token_bucket()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        TokenBucket bucket;
+        size_t failed = 0;
+        uint64_t now = 1000000;
+        size_t burst = 0;
+
+        failed += 0 != bucket.reserve(100000, now);
+
+        // 10 kB/s and 20 frames/s, 2 kB or 4 frames at once
+        bucket.configure(10000, 20, 2000, 4);
+
+        while (0 == bucket.reserve(300, now))
+        {
+            burst++;
+        }
+
+        failed += 4 != burst;
+
+        // a frame larger than the burst goes once the bucket is full
+        failed += 0 == bucket.reserve(5000, now) || 0 != bucket.reserve(5000, now + 1000000);
+
+        size_t sent = 0;
+        uint64_t end = now + 11000000;
+
+        for (now += 1000000; now < end; )
+        {
+            uint64_t wait = bucket.reserve(200, now);
+
+            if (0 == wait)
+            {
+                sent++;
+            }
+
+            now += 0 == wait ? 0 : wait;
+        }
+
+        // frames/s bound: 20/s over 10 s after paying off the large frame
+        failed += 190 > sent || 205 < sent;
+        failed += 3000 > bucket.rate() || 5000 < bucket.rate();
+
+        printf("token_bucket: burst %zu, %zu frames in 10 s, %llu B/s, %zu failed\n",
+            burst, sent, (unsigned long long)bucket.rate(), failed);
+
+        return failed;
+    }
+
+    /**
+     * Jittering and drifting states through the deadbands.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_state_publisher()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        std::vector<uint64_t> sent;
+        StatePublisher publisher([&sent](const Veh2CloudState &_msg)
+        {
+            sent.push_back(_msg.timestamp_);
+        });
+
+        StateDeadband deadband;
+        deadband.position = 10;
+        deadband.velocity = 5;
+        deadband.max_interval = 1000;
+        publisher.configure(deadband);
+
+        size_t failed = 0;
+        uint64_t t0 = 1600000000000ULL;
+        auto state = [t0](const uint32_t _i, const uint32_t _lon, const uint16_t _velocity, const uint8_t _gear)
+        {
+            return Veh2CloudState(0x01, t0 + _i * 100, 0xFC, "Q1001", std::vector<uint8_t>{1}, t0 + _i * 100,
+                _velocity, Position(_lon, 90, 700), 100000, _gear, 200000, _velocity, 500, 400, 300, 200, 500, 3000, 50000,
+                1, 500, 20000, 1000, 1, Position2D(80, 80), std::vector<Position2D>());
+        };
+
+        // first, then jitter within the deadbands until max_interval
+        for (uint32_t i = 0; i < 10; i++)
+        {
+            failed += (0 == i) != publisher.publish(state(i, 1000 + i % 3, 100 + i % 2, 4));
+        }
+
+        failed += !publisher.publish(state(10, 1000, 100, 4));
+
+        // a drift of 2 per state crosses 10 on the sixth, a gear change goes at once
+        for (uint32_t i = 1; i <= 6; i++)
+        {
+            failed += (6 == i) != publisher.publish(state(10 + i, 1000 + 2 * i, 100, 4));
+        }
+
+        failed += !publisher.publish(state(17, 1012, 100, 3));
+
+        publisher.reset();
+        failed += !publisher.publish(state(18, 1012, 100, 3));
+
+        failed += 5 != sent.size() || 5 != publisher.published() || 14 != publisher.suppressed();
+        failed += publisher.saved_bytes() != 14 * Packer::pack(state(0, 0, 0, 0))->size;
+
+        // heading across north, 359.9 to 0.1 degrees is 0.2 within 1, 359.9 to 2 is not
+        StatePublisher compass([](const Veh2CloudState &_msg) {});
+        auto heading = [t0](const uint32_t _i, const uint32_t _heading)
+        {
+            return Veh2CloudState(0x01, t0 + _i * 100, 0xFC, "Q1001", std::vector<uint8_t>{1}, t0 + _i * 100,
+                100, Position(1000, 90, 700), _heading, 4, 200000, 100, 500, 400, 300, 200, 500, 3000, 50000,
+                1, 500, 20000, 1000, 1, Position2D(80, 80), std::vector<Position2D>());
+        };
+
+        deadband.heading = 10000;
+        compass.configure(deadband);
+        failed += !compass.publish(heading(0, 3599000)) || compass.publish(heading(1, 1000));
+        failed += compass.publish(heading(2, 3590000)) || !compass.publish(heading(3, 20000));
+        failed += compass.publish(heading(4, 10000)) || !compass.publish(heading(5, 3590000));
+
+        printf("state_publisher: %llu sent, %llu suppressed, %llu bytes saved, %zu failed\n",
+            (unsigned long long)publisher.published(), (unsigned long long)publisher.suppressed(),
+            (unsigned long long)publisher.saved_bytes(), failed);
+
+        return failed;
+    }
+
+    /**
+     * Back off on a growing queue and an inflated RTT, recover after.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_adaptive_rate()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        AdaptiveRate rate;
+        size_t failed = 0;
+
+        failed += 0 != rate.interval();
+
+        rate.configure(1, 10, 8, 2.0);
+        failed += 10 != rate.rate() || 100 != rate.interval();
+
+        // healthy link stays at the max
+        failed += 10 != rate.update(0, 20000, 15000);
+
+        // backlog: halve, hold, halve again down to the min
+        failed += 5 != rate.update(8, 20000, 15000);
+        failed += 5 != rate.update(8, 20000, 15000) || 5 != rate.update(8, 20000, 15000);
+        failed += 2.5 != rate.update(9, 20000, 15000);
+
+        for (int i = 0; i < 20; i++)
+        {
+            rate.update(20, 20000, 15000);
+        }
+
+        failed += 1 != rate.rate() || 1000 != rate.interval();
+
+        // queue drained but RTT still inflated: no increase
+        for (int i = 0; i < 5; i++)
+        {
+            rate.update(0, 80000, 15000);
+        }
+
+        failed += 1 != rate.rate();
+
+        // recovered: additive increase back to the max
+        size_t updates = 0;
+
+        while (10 > rate.rate() && 100 > updates++)
+        {
+            rate.update(0, 16000, 15000);
+        }
+
+        failed += 10 != rate.rate() || 20 + AdaptiveRate::HOLD < updates;
+
+        // RTT growth under the slack is not congestion
+        failed += 10 != rate.update(0, 5000, 1000) || rate.congested();
+
+        printf("adaptive_rate: back to %.1f/s in %zu updates, %zu failed\n", rate.rate(), updates, failed);
+
+        return failed;
+    }
+
+    /**
+     * An L shaped route with GNSS noise keeps its corner and ends, a
+     * gentle arc keeps enough points to stay within the tolerance.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_trajectory()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        std::vector<Position2D> route;
+        TrajectoryStats stats;
+        size_t failed = 0;
+
+        // 1e-7 deg: about 1.1 cm of latitude, 0.85 cm of longitude at 40 N
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            route.push_back(Position2D(1163000000 + i * 1000, 400000000 + (i * 7919) % 21));
+        }
+
+        for (uint32_t i = 1; i < 100; i++)
+        {
+            route.push_back(Position2D(1163099000 + (i * 7919) % 21, 400000000 + i * 1000));
+        }
+
+        std::vector<Position2D> simplified = route;
+        Trajectory::simplify(simplified, 1.0, &stats);
+
+        failed += 3 != simplified.size() || 199 != stats.in || 3 != stats.out;
+        failed += route[99].longitude != simplified[1].longitude || route.back().latitude != simplified[2].latitude;
+        failed += 1.0 < stats.max_deviation || 0.1 > stats.max_deviation;
+
+        double ratio = stats.ratio();
+
+        // quarter circle of 200 m radius in 255 points
+        std::vector<Position2D> arc;
+        double r = 200.0 / 0.0111; // 1e-7 deg of latitude
+
+        for (uint32_t i = 0; i < TRAJECTORY_MAX_POINTS; i++)
+        {
+            double a = i * M_PI / 2 / (TRAJECTORY_MAX_POINTS - 1);
+
+            arc.push_back(Position2D(1163000000 + (uint32_t)(r * sin(a) * 1.1 / 0.85), 400000000 + (uint32_t)(r * (1 - cos(a)))));
+        }
+
+        Position2D out[TRAJECTORY_MAX_POINTS];
+        size_t n = Trajectory::simplify(arc.data(), arc.size(), 0.5, out, &stats);
+
+        // sagitta 0.5 m on a 200 m radius: chords of about 28 m, 12 of them
+        failed += 8 > n || 20 < n || 0.5 < stats.max_deviation;
+        failed += out[0].longitude != arc[0].longitude || out[n - 1].latitude != arc.back().latitude;
+
+        // too short or no tolerance: unchanged
+        failed += 2 != Trajectory::simplify(arc.data(), 2, 0.5, out) || arc.size() != Trajectory::simplify(arc.data(), arc.size(), 0, out);
+
+        printf("trajectory: L %.1fx, arc %zu of %zu points within %.2f m, %zu failed\n",
+            ratio, n, arc.size(), stats.max_deviation, failed);
+
+        return failed;
+    }
+
+    /**
+     * Frames edited in place by StateBuilder match packing the same state.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_state_builder()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        auto state = [](const uint64_t _t, const uint16_t _velocity, const std::vector<Position2D> &_pass_pos)
+        {
+            return Veh2CloudState(0x01, _t, 0xFC, "Q1001", std::vector<uint8_t>{0x78, 0x56, 0x34, 0x12}, _t + 1,
+                4000, Position(1213000000, 312000000, 700), 100000, 31, 200000, _velocity, 500, 400, 300, 200, 500,
+                3000, 50000, BREAK_FLAG_UP, 500, 20000, 1000, DRIVE_MODE_AUTO, Position2D(1214000000, 313000000), _pass_pos);
+        };
+        auto same = [](const std::shared_ptr<MessageBuffer> &_a, const std::shared_ptr<MessageBuffer> &_b)
+        {
+            return _a->size == _b->size && 0 == memcmp(_a->data, _b->data, _a->size);
+        };
+
+        std::vector<Position2D> route{Position2D(1, 2), Position2D(3, 4), Position2D(5, 6)};
+        StateBuilder builder("Q1001");
+        size_t failed = 0;
+
+        builder.timestamp(1600000000000ULL).message_id(0x12345678).gnss_timestamp(1600000000001ULL)
+            .gnss_velocity(4000).position(Position(1213000000, 312000000, 700)).heading(100000).gear(31)
+            .steering_angle(200000).velocity(4100).acc(500, 400, 300).yaw_rate(200).accel_pos(500)
+            .engine_speed(3000).engine_torque(50000).break_flag(BREAK_FLAG_UP).break_pos(500).break_pressure(20000)
+            .fuel_consume(1000).drive_mode(DRIVE_MODE_AUTO).dest_location(Position2D(1214000000, 313000000));
+
+        failed += !same(builder.build(), Packer::pack(state(1600000000000ULL, 4100, {})));
+
+        // grow, change in place, shrink
+        failed += !same(builder.pass_pos(route).build(), Packer::pack(state(1600000000000ULL, 4100, route)));
+
+        route[1].latitude = 40;
+        builder.timestamp(1600000000200ULL).gnss_timestamp(1600000000201ULL).velocity(4200).pass_pos(route);
+        failed += !same(builder.build(), Packer::pack(state(1600000000200ULL, 4200, route)));
+
+        builder.pass_pos(nullptr, 0);
+        failed += !same(builder.build(), Packer::pack(state(1600000000200ULL, 4200, {})));
+
+        // seeded from a message, the frame decodes back to it
+        StateBuilder seeded(state(1600000000400ULL, 4300, route));
+        auto frame = seeded.velocity(4400).build();
+        Veh2CloudState decoded(frame->data, frame->size);
+
+        failed += 4400 != decoded.velocity_ || 3 != decoded.pass_pos_num_ || 40 != decoded.pass_pos_[1].latitude;
+        failed += 0x12 != decoded.message_id_[3] || 0x78 != decoded.message_id_[0];
+
+        // released buffers come back, and outlive the builder
+        const MessageBuffer *first = frame.get();
+        frame.reset();
+        frame = seeded.build();
+        failed += first != frame.get();
+
+        printf("state_builder: %u byte frame, %zu failed\n", frame->size, failed);
+
+        return failed;
+    }
+
+    /**
+     * JSON and CSV of every message type against golden text, escaping
+     * included, and TextBuffer's digits and growth.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_serializer()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        TextBuffer text(16);
+        size_t failed = 0;
+
+        auto expect = [&text, &failed](const char *_name, const std::string &_golden)
+        {
+            if (_golden != std::string(text.data(), text.size()))
+            {
+                printf("serializer: %s is\n%.*s", _name, (int)text.size(), text.data());
+                failed++;
+            }
+
+            text.clear();
+        };
+
+        const uint64_t values[] = {0, 9, 10, 99, 100, 12345678901234ULL, UINT64_MAX};
+
+        for (uint64_t v : values)
+        {
+            text.append_uint(v);
+            text.append(' ');
+        }
+
+        expect("digits", "0 9 10 99 100 12345678901234 18446744073709551615 ");
+        failed += 16 >= text.capacity();
+
+        MessageHeader heartbeat(0, HEARTBEAT, 0x01, 1600000000123ULL, 0xFC);
+        JsonSerializer::write(text, heartbeat);
+        CsvSerializer::write_header(text, heartbeat.data_type_);
+        CsvSerializer::write(text, heartbeat);
+        expect("heartbeat",
+            "{\"id\":242,\"data_len\":0,\"data_type\":12,\"version\":1,\"timestamp\":1600000000123,\"ctrl\":252}\n"
+            "id,data_len,data_type,version,timestamp,ctrl\n"
+            "242,0,12,1,1600000000123,252\n");
+
+        Veh2CloudInh inh(0x01, 1600000000123ULL, 0xFC, "Q1001", "sw_v1.0", "hw_v1.0", "ad_v1.0",
+            COMM_TYPE_4G, 15, TIME_SYNC_GNSS, GNSS_TYPE_GCJ02, "a \"quoted\", line\n");
+        JsonSerializer::write(text, inh);
+        CsvSerializer::write_header(text, inh.data_type_);
+        CsvSerializer::write(text, inh);
+        expect("inh",
+            "{\"id\":242,\"data_len\":54,\"data_type\":52,\"version\":1,\"timestamp\":1600000000123,\"ctrl\":252,"
+            "\"vehicle_id\":\"Q1001\",\"sw_ver\":\"sw_v1.0\",\"hw_ver\":\"hw_v1.0\",\"ad_ver\":\"ad_v1.0\",\"com_type\":0,"
+            "\"pos_confidence\":15,\"time_sync\":2,\"gnss_type\":0,\"user_data\":\"a \\\"quoted\\\", line\\u000a\"}\n"
+            "id,data_len,data_type,version,timestamp,ctrl,vehicle_id,sw_ver,hw_ver,ad_ver,com_type,pos_confidence,"
+            "time_sync,gnss_type,user_data\n"
+            "242,54,52,1,1600000000123,252,Q1001,sw_v1.0,hw_v1.0,ad_v1.0,0,15,2,0,\"a \"\"quoted\"\", line\n\"\n");
+
+        Cloud2VehInhRes res(0x01, 1600000000123ULL, 0xFC, "Q1001", CLOUD2VEH_INH_RES_COMFIRM);
+        JsonSerializer::write(text, res);
+        CsvSerializer::write_header(text, res.data_type_);
+        CsvSerializer::write(text, res);
+        expect("inh_res",
+            "{\"id\":242,\"data_len\":9,\"data_type\":53,\"version\":1,\"timestamp\":1600000000123,\"ctrl\":252,"
+            "\"vehicle_id\":\"Q1001\",\"res\":0}\n"
+            "id,data_len,data_type,version,timestamp,ctrl,vehicle_id,res\n"
+            "242,9,53,1,1600000000123,252,Q1001,0\n");
+
+        Veh2CloudState state(0x01, 1600000000123ULL, 0xFC, "Q1001", std::vector<uint8_t>{1, 0xAB}, 1600000000100ULL,
+            4000, Position(90, 91, 700), 100000, 31, 200000, 4100, 500, 400, 300, 200, 500, 3000, 50000,
+            1, 500, 20000, 1000, 1, Position2D(80, 81), std::vector<Position2D>{Position2D(1, 2), Position2D(3, 4)});
+        JsonSerializer::write(text, state);
+        CsvSerializer::write_header(text, state.data_type_);
+        CsvSerializer::write(text, state);
+        expect("state",
+            "{\"id\":242,\"data_len\":98,\"data_type\":21,\"version\":1,\"timestamp\":1600000000123,\"ctrl\":252,"
+            "\"vehicle_id\":\"Q1001\",\"message_id\":\"000000000000AB01\",\"gnss_timestamp\":1600000000100,"
+            "\"gnss_velocity\":4000,\"longitude\":90,\"latitude\":91,\"elevation\":700,\"heading\":100000,\"gear\":31,"
+            "\"steering_angle\":200000,\"velocity\":4100,\"acc_lon\":500,\"acc_lat\":400,\"acc_ver\":300,\"yaw_rate\":200,"
+            "\"accel_pos\":500,\"engine_speed\":3000,\"engine_torque\":50000,\"break_flag\":1,\"break_pos\":500,"
+            "\"break_pressure\":20000,\"fuel_consume\":1000,\"drive_mode\":1,\"dest_longitude\":80,\"dest_latitude\":81,"
+            "\"pass_pos\":[[1,2],[3,4]]}\n"
+            "id,data_len,data_type,version,timestamp,ctrl,vehicle_id,message_id,gnss_timestamp,gnss_velocity,"
+            "longitude,latitude,elevation,heading,gear,steering_angle,velocity,acc_lon,acc_lat,acc_ver,yaw_rate,"
+            "accel_pos,engine_speed,engine_torque,break_flag,break_pos,break_pressure,fuel_consume,drive_mode,"
+            "dest_longitude,dest_latitude,pass_pos\n"
+            "242,98,21,1,1600000000123,252,Q1001,000000000000AB01,1600000000100,4000,90,91,700,100000,31,200000,"
+            "4100,500,400,300,200,500,3000,50000,1,500,20000,1000,1,80,81,1:2;3:4\n");
+
+        printf("serializer: %zu failed\n", failed);
+
+        return failed;
+    }
+
+    /**
+     * Tracing off by default, per direction, per data type and 1-in-N per
+     * direction, frames and messages.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_tracer()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        class Counting : public Tracer::Sink
+        {
+        public:
+            void on_frame(const uint32_t _direction, const void *_buf, const size_t _size) override
+            {
+                frames[__builtin_ctz(_direction)]++;
+            }
+
+            void on_unpack(const Cloud2VehInhRes &_msg) override
+            {
+                messages++;
+            }
+
+            size_t frames[4] = {0, 0, 0, 0};
+            size_t messages = 0;
+        };
+
+        Tracer tracer;
+        Counting sink;
+        Cloud2VehInhRes res(0x01, get_utc_timestamp_ms(), 0xFC, "Q1001", CLOUD2VEH_INH_RES_COMFIRM);
+        auto heartbeat = Packer::pack(MessageHeader(0, HEARTBEAT, 0x01, get_utc_timestamp_ms(), 0xFC));
+        auto inh_res = Packer::pack(res);
+        size_t failed = 0;
+
+        auto trace = [&](const size_t _n)
+        {
+            for (size_t i = 0; i < _n; i++)
+            {
+                tracer.frame(TRACE_UP_TX, heartbeat->data, heartbeat->size);
+                tracer.frame(TRACE_UP_RX, inh_res->data, inh_res->size);
+                tracer.frame(TRACE_DOWN_TX, heartbeat->data, heartbeat->size);
+                tracer.message(res);
+            }
+        };
+
+        auto expect = [&](const size_t _up_tx, const size_t _up_rx, const size_t _down_tx, const size_t _messages)
+        {
+            size_t failed = _up_tx != sink.frames[0] || _up_rx != sink.frames[1] || _down_tx != sink.frames[2]
+                || 0 != sink.frames[3] || _messages != sink.messages;
+            sink = Counting();
+            return failed;
+        };
+
+        tracer.set_sink(&sink);
+        trace(10);
+        failed += tracer.enabled(TRACE_ALL) || expect(0, 0, 0, 0);
+
+        tracer.enable(TRACE_UP_TX | TRACE_MESSAGE);
+        trace(10);
+        failed += !tracer.enabled(TRACE_UP_TX) || tracer.enabled(TRACE_UP_RX) || expect(10, 0, 0, 10);
+
+        // CLOUD2VEH_INH_RES only, the heartbeats and the ones off are dropped
+        tracer.enable(TRACE_ALL);
+        tracer.disable(TRACE_DOWN_TX);
+        tracer.set_all_types(false);
+        tracer.enable_type(CLOUD2VEH_INH_RES);
+        trace(10);
+        failed += expect(0, 10, 0, 10);
+
+        tracer.set_all_types(true);
+        tracer.disable_type(CLOUD2VEH_INH_RES);
+        trace(10);
+        failed += expect(10, 0, 0, 0);
+
+        // counted per direction, the first of every 4 passes
+        tracer.enable_type(CLOUD2VEH_INH_RES);
+        tracer.set_sample(4);
+        trace(10);
+        failed += expect(3, 3, 0, 3);
+
+        tracer.set_sample(0);
+        tracer.disable(TRACE_ALL);
+        trace(10);
+        failed += expect(0, 0, 0, 0);
+
+        printf("tracer: %zu failed\n", failed);
+
+        return failed;
+    }
+
+    /**
+     * Histogram buckets and percentiles, and the Prometheus text of counters,
+     * gauges and histograms with a family kept together.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_metrics()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        size_t failed = 0;
+
+        // every value lies in the bucket that ends at or above it, ~3% wide
+        const uint64_t values[] = {0, 1, 31, 32, 33, 1000, 123456789, 1ULL << 40, UINT64_MAX};
+
+        for (uint64_t v : values)
+        {
+            uint32_t i = Histogram::bucket(v);
+            uint64_t high = Histogram::bucket_value(i);
+            uint64_t low = 0 == i ? 0 : Histogram::bucket_value(i - 1) + 1;
+
+            failed += Histogram::BUCKETS <= i || v < low || v > high || (high - low) > high / Histogram::SUB_COUNT;
+        }
+
+        Histogram h;
+
+        for (uint64_t v = 1; v <= 1000; v++)
+        {
+            h.record(v);
+        }
+
+        failed += 1000 != h.count() || 500500 != h.sum() || 1 != h.min() || 1000 != h.max();
+        failed += fabs(500.0 - (double)h.percentile(50)) > 500 * 0.04 || fabs(990.0 - (double)h.percentile(99)) > 990 * 0.04;
+        failed += 1000 != h.percentile(100);
+
+        Histogram copy(h);
+        copy.merge(h);
+        failed += 2000 != copy.count() || 1001000 != copy.sum() || h.percentile(50) != copy.percentile(50);
+
+        h.reset();
+        failed += 0 != h.count() || 0 != h.min() || 0 != h.max() || 0 != h.percentile(50);
+
+        Metrics &metrics = Metrics::instance();
+        Counter &a = metrics.counter("test_frames_total", "Frames.", "direction=\"up\"");
+        metrics.gauge("test_depth", "Depth.").set(-3);
+        Counter &b = metrics.counter("test_frames_total", "Frames.", "direction=\"down\"");
+        Histogram &latency = metrics.histogram("test_latency_us", "Latency.");
+
+        failed += &a != &metrics.counter("test_frames_total", "Frames.", "direction=\"up\"");
+
+        std::vector<std::thread> threads;
+
+        for (int i = 0; i < 4; i++)
+        {
+            threads.emplace_back([&a]()
+            {
+                for (int j = 0; j < 1000; j++)
+                {
+                    a.add();
+                }
+            });
+        }
+
+        for (auto &t : threads)
+        {
+            t.join();
+        }
+
+        b.add(7);
+        latency.record(10);
+        latency.record(30);
+
+        std::string text;
+        metrics.write_prometheus(text);
+
+        const char *expected[] =
+        {
+            "# HELP test_frames_total Frames.\n# TYPE test_frames_total counter\n"
+            "test_frames_total{direction=\"up\"} 4000\ntest_frames_total{direction=\"down\"} 7\n",
+            "# HELP test_depth Depth.\n# TYPE test_depth gauge\ntest_depth -3\n",
+            "# TYPE test_latency_us summary\ntest_latency_us{quantile=\"0.5\"} 10\n",
+            "test_latency_us{quantile=\"1\"} 30\ntest_latency_us_sum 40\ntest_latency_us_count 2\n",
+        };
+
+        for (const char *e : expected)
+        {
+            if (std::string::npos == text.find(e))
+            {
+                printf("metrics: missing %s", e);
+                failed++;
+            }
+        }
+
+        failed += text.find("# HELP test_frames_total") != text.rfind("# HELP test_frames_total");
+
+        printf("metrics: %zu bytes of text, %zu failed\n", text.size(), failed);
+
+        return failed;
+    }
+
+    /**
+     * Retries on timeout, responses matched to the attempt they echo, the
+     * RTT taken only when that is unambiguous, duplicates and cancel_all().
+     *
+     * @return number of failed checks
+     */
+    static size_t test_pending_requests()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        TimerWheel wheel;
+        PendingRequests requests(wheel);
+        std::map<std::string, std::vector<uint64_t>> sent;
+        std::map<std::string, int32_t> status;
+        std::mutex mutex;
+        size_t failed = 0;
+
+        wheel.start();
+
+        auto add = [&](const std::string &_key, const uint32_t _timeout, const uint32_t _tries)
+        {
+            return requests.add(VEH2CLOUD_INH, _key, "test", [&mutex, &sent, _key](const uint64_t _timestamp)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                sent[_key].push_back(_timestamp);
+            }, [&mutex, &status, _key](const int32_t _status, const MessageHeader *_res)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                status[_key] = _status;
+            }, _timeout, _tries);
+        };
+
+        auto attempts = [&mutex, &sent](const std::string &_key, const size_t _n)
+        {
+            for (int i = 0; i < 1000; i++)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    if (_n <= sent[_key].size())
+                    {
+                        return sent[_key];
+                    }
+                }
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            return std::vector<uint64_t>();
+        };
+
+        auto response = [](const std::string &_key, const uint64_t _timestamp)
+        {
+            return Cloud2VehInhRes(0x01, _timestamp, 0xFC, _key, CLOUD2VEH_INH_RES_COMFIRM);
+        };
+
+        uint64_t request = 0;
+        uint64_t rtt = 0;
+
+        // the echo of the first attempt answers it, after a retry
+        failed += 0 != add("Q1001", 30, 3) || -1 != add("Q1001", 30, 3);
+        std::vector<uint64_t> q1001 = attempts("Q1001", 2);
+        failed += 2 > q1001.size() || q1001[0] == q1001[1];
+        failed += !requests.complete(VEH2CLOUD_INH, "Q1001", response("Q1001", q1001[0]), &request, &rtt);
+        failed += q1001[0] != request || 0 == rtt || REQUEST_OK != status["Q1001"];
+
+        // stamped with the peer's time after a retry, which attempt is unknown
+        failed += 0 != add("Q1002", 30, 3);
+        failed += 2 > attempts("Q1002", 2).size();
+        failed += !requests.complete(VEH2CLOUD_INH, "Q1002", response("Q1002", 12345), &request, &rtt);
+        failed += 0 != request || 0 != rtt || REQUEST_OK != status["Q1002"];
+
+        // but it answers a single attempt
+        failed += 0 != add("Q1003", 1000, 3);
+        std::vector<uint64_t> q1003 = attempts("Q1003", 1);
+        failed += !requests.complete(VEH2CLOUD_INH, "Q1003", response("Q1003", 12345), &request, &rtt);
+        failed += 1 != q1003.size() || q1003[0] != request || 0 == rtt;
+        failed += requests.complete(VEH2CLOUD_INH, "Q1003", response("Q1003", 12345));
+
+        // no response after the last try
+        failed += 0 != add("Q1004", 10, 2);
+
+        for (int i = 0; i < 1000 && 0 != requests.size(); i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        failed += REQUEST_TIMEOUT != status["Q1004"] || 2 != attempts("Q1004", 2).size();
+
+        failed += 0 != add("Q1005", 1000, 3) || 0 != add("Q1006", 1000, 3) || 2 != requests.size();
+        requests.cancel_all();
+        failed += 0 != requests.size() || REQUEST_CANCELLED != status["Q1005"] || REQUEST_CANCELLED != status["Q1006"];
+
+        wheel.stop();
+
+        printf("pending_requests: %zu requests, %zu failed\n", status.size(), failed);
+
+        return failed;
+    }
+
+    /**
+     * Heartbeats suppressed by traffic unless the RTT estimate needs a
+     * probe, request RTTs fed in as samples, a sender that answers inline.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_heartbeat()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        TimerWheel wheel;
+        std::atomic<uint64_t> outstanding{0};
+        size_t failed = 0;
+
+        wheel.start();
+
+        auto run = [&wheel, &outstanding, &failed](const uint32_t _probe, const uint64_t _rtt)
+        {
+            Heartbeat heartbeat(wheel, "test");
+
+            heartbeat.configure(1000, 1000, 3);
+            heartbeat.probe(_probe);
+            heartbeat.start([&outstanding](const uint64_t _timestamp)
+            {
+                outstanding = _timestamp;
+            }, [](const uint32_t _missed) {});
+
+            // a busy link, answered heartbeats and one request RTT
+            for (int i = 0; i < 300; i++)
+            {
+                heartbeat.activity();
+
+                if (0 != outstanding)
+                {
+                    failed += !heartbeat.response(outstanding.exchange(0));
+                }
+
+                if (100 == i)
+                {
+                    heartbeat.sample(_rtt);
+                }
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            HeartbeatStats stats = heartbeat.stats();
+            heartbeat.stop();
+
+            return stats;
+        };
+
+        HeartbeatStats quiet = run(0, 7000);
+        HeartbeatStats probed = run(50, 0);
+
+        failed += 0 != quiet.sent || 1 != quiet.samples || 7000 != quiet.srtt;
+        failed += 2 > probed.sent || probed.samples + 1 < probed.sent || 0 != probed.missed;
+
+        // sent outside the lock, a sender answered at once does not deadlock
+        {
+            Heartbeat heartbeat(wheel, "test");
+            std::atomic<uint64_t> answered{0};
+
+            heartbeat.configure(20, 1000, 3);
+            heartbeat.start([&heartbeat, &answered](const uint64_t _timestamp)
+            {
+                answered += heartbeat.response(_timestamp);
+            }, [](const uint32_t _missed) {});
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            heartbeat.stop();
+            failed += 2 > answered || answered != heartbeat.stats().samples;
+
+            // a wheel callback may still be on its way out
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        wheel.stop();
+
+        printf("heartbeat: %llu probes in 300 ms of traffic, %zu failed\n", (unsigned long long)probed.sent, failed);
+
+        return failed;
+    }
+
+    /**
+     * Tasks of a key run in order, a worker stopping the dispatcher from its
+     * own task keeps its queue across a start() that follows at once.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_dispatcher()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        Dispatcher dispatcher;
+        std::vector<int> order;
+        std::atomic<size_t> ran{0};
+        std::atomic<bool> stopped{false};
+        size_t failed = 0;
+
+        failed += 0 != dispatcher.start(DISPATCH_POOL, 2, 4) || DISPATCH_POOL != dispatcher.mode();
+
+        for (int i = 0; i < 100; i++)
+        {
+            dispatcher.dispatch(1, [&order, i]()
+            {
+                order.push_back(i);
+            });
+        }
+
+        dispatcher.stop();
+        failed += 100 != order.size() || !std::is_sorted(order.begin(), order.end());
+
+        // the worker is still in its task when start() runs
+        failed += 0 != dispatcher.start(DISPATCH_POOL, 2, 4);
+        dispatcher.dispatch(0, [&dispatcher, &ran, &stopped]()
+        {
+            dispatcher.stop();
+            stopped = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            ran++;
+        });
+
+        while (!stopped)
+        {
+            std::this_thread::yield();
+        }
+
+        failed += 0 != dispatcher.start(DISPATCH_POOL, 2, 4) || 1 != ran;
+
+        for (uint8_t i = 0; i < 10; i++)
+        {
+            dispatcher.dispatch(i, [&ran]()
+            {
+                ran++;
+            });
+        }
+
+        dispatcher.stop();
+        failed += 11 != ran;
+
+        // inline once stopped
+        dispatcher.dispatch(0, [&ran]()
+        {
+            ran++;
+        });
+        failed += 12 != ran;
+
+        printf("dispatcher: %zu tasks, %zu failed\n", order.size() + ran, failed);
+
+        return failed;
+    }
+
+    /**
+     * Batches handed over when full, at the end of a read or at the latency
+     * bound, recycled with their capacity and in order while add() races the
+     * timer.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_message_batch()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        typedef MessageBatch<std::string> Batches;
+
+        TimerWheel wheel(1);
+        Batches batches(wheel);
+        std::vector<Batches::Batch*> handed;
+        std::mutex mutex;
+        std::thread::id sink_thread;
+        size_t failed = 0;
+
+        wheel.start();
+
+        auto collect = [&](Batches::Batch *_batch)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            handed.push_back(_batch);
+            sink_thread = std::this_thread::get_id();
+        };
+
+        auto size = [&]()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return handed.size();
+        };
+
+        auto wait = [&](const size_t _count)
+        {
+            for (int i = 0; i < 1000 && _count > size(); i++)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            return _count <= size();
+        };
+
+        // full at max, the rest at the end of the read when there is no latency bound
+        batches.configure(4, 0, collect);
+
+        for (int i = 0; i < 6; i++)
+        {
+            batches.add(std::string(64, 'a' + i));
+        }
+
+        failed += 1 != handed.size() || 4 != handed[0]->size() || std::string(64, 'd') != handed[0]->data()[3];
+        batches.flush();
+        failed += 2 != handed.size() || 2 != handed[1]->size() || std::string(64, 'f') != handed[1]->data()[1];
+        batches.flush();
+        failed += 2 != handed.size();
+
+        // a released batch comes back with its slots and their buffers
+        Batches::Batch *full = handed[0];
+        size_t capacity = full->msgs.capacity();
+
+        batches.release(handed[1]);
+        batches.release(full);
+        handed.clear();
+
+        for (int i = 0; i < 4; i++)
+        {
+            batches.add("b");
+        }
+
+        failed += 1 != handed.size() || full != handed[0] || 4 != full->size() || capacity != full->msgs.capacity();
+        failed += "b" != full->data()[0] || 64 > full->msgs[0].capacity();
+        batches.release(full);
+        handed.clear();
+
+        // a latency bound holds the end of a read back until the timer
+        batches.configure(100, 20, collect);
+        batches.add("c");
+        batches.flush();
+        failed += 0 != size() || !wait(1) || 1 != handed[0]->size() || std::this_thread::get_id() == sink_thread;
+        batches.release(handed[0]);
+        handed.clear();
+
+        batches.add("d");
+        batches.flush(true);
+        failed += 1 != handed.size() || std::this_thread::get_id() != sink_thread;
+        batches.release(handed[0]);
+        handed.clear();
+
+        // hand-overs from add() and the timer interleave, messages stay in order
+        const size_t COUNT = 20000;
+        std::atomic<size_t> next{0}, total_batches{0}, timer_batches{0}, disorder{0};
+        std::thread::id producer = std::this_thread::get_id();
+
+        batches.configure(7, 1, [&](Batches::Batch *_batch)
+        {
+            for (size_t i = 0; i < _batch->size(); i++)
+            {
+                disorder += std::to_string(next++) != _batch->data()[i];
+            }
+
+            total_batches++;
+            timer_batches += producer != std::this_thread::get_id();
+            batches.release(_batch);
+        });
+
+        for (size_t i = 0; i < COUNT; i++)
+        {
+            batches.add(std::to_string(i));
+
+            if (0 == i % 3)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+
+        batches.flush(true);
+        wheel.stop();
+        failed += COUNT != next || 0 != disorder || 0 == timer_batches;
+
+        printf("message_batch: %zu of %zu batches handed over by the timer, %zu failed\n",
+            timer_batches.load(), total_batches.load(), failed);
+
+        return failed;
+    }
+
+    /**
+     * Messages decoded through Packer::Pools are recycled with their capacity
+     * and kept alive by retained handles, also past the pools.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_message_pool()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        class Retainer : public Packer::Handler
+        {
+        public:
+            void on_unpack(const Pooled<Veh2CloudInh> &_msg) override { inh = _msg; }
+
+            void on_unpack(const Veh2CloudState &_msg) override { plain++; }
+
+            void on_unpack(const Pooled<Veh2CloudState> &_msg) override
+            {
+                last = _msg.get();
+
+                if (retain)
+                {
+                    kept.push_back(_msg);
+                }
+            }
+
+            Pooled<Veh2CloudInh> inh;
+            std::vector<Pooled<Veh2CloudState>> kept;
+            const Veh2CloudState *last = nullptr;
+            size_t plain = 0;
+            bool retain = false;
+        };
+
+        auto frame = [](const size_t _pass_pos, const uint16_t _velocity)
+        {
+            return Packer::pack(Veh2CloudState(0x01, 1600000000000ULL, 0xFC, "Q1001", std::vector<uint8_t>{1, 2},
+                1600000000001ULL, 4000, Position(1213000000, 312000000, 700), 100000, 31, 200000, _velocity, 500, 400, 300,
+                200, 500, 3000, 50000, BREAK_FLAG_UP, 500, 20000, 1000, DRIVE_MODE_AUTO, Position2D(1214000000, 313000000),
+                std::vector<Position2D>(_pass_pos, Position2D(7, 8))));
+        };
+
+        std::unique_ptr<Packer::Pools> pools(new Packer::Pools());
+        Retainer handler;
+        size_t failed = 0;
+
+        // one message recycled, pass_pos_ keeps the capacity of the longest
+        auto big = frame(16, 4100);
+        auto small = frame(2, 4200);
+
+        Packer::unpack(big->data, big->size, handler, *pools);
+        const Veh2CloudState *first = handler.last;
+
+        Packer::unpack(small->data, small->size, handler, *pools);
+        failed += first != handler.last || 1 != pools->state.idle();
+        failed += 2 != first->pass_pos_.size() || 16 > first->pass_pos_.capacity() || 4200 != first->velocity_;
+        failed += 1 != first->message_id_[0] || 2 != first->message_id_[1];
+
+        // retained handles keep theirs until dropped
+        handler.retain = true;
+        Packer::unpack(big->data, big->size, handler, *pools);
+        Packer::unpack(small->data, small->size, handler, *pools);
+        failed += 2 != handler.kept.size() || handler.kept[0].get() == handler.kept[1].get() || 0 != pools->state.idle();
+        failed += 16 != handler.kept[0]->pass_pos_num_ || 2 != handler.kept[1]->pass_pos_num_;
+
+        handler.kept.clear();
+        failed += 2 != pools->state.idle();
+
+        // strings of an earlier decode do not leak into the next
+        auto inh = Packer::pack(Veh2CloudInh(0x01, 1600000000000ULL, 0xFC, "Q1001", "sw_v1.0", "hw_v1.0", "ad_v1.0",
+            COMM_TYPE_4G, 15, TIME_SYNC_GNSS, GNSS_TYPE_GCJ02, "VEH2CLOUD_INH"));
+        auto bare = Packer::pack(Veh2CloudInh(0x01, 1600000000000ULL, 0xFC, "Q1001", "", "", "",
+            COMM_TYPE_4G, 15, TIME_SYNC_GNSS, GNSS_TYPE_GCJ02, ""));
+
+        Packer::unpack(inh->data, inh->size, handler, *pools);
+        failed += "sw_v1.0" != handler.inh->sw_ver_ || "VEH2CLOUD_INH" != handler.inh->user_data_;
+        handler.inh.reset();
+        Packer::unpack(bare->data, bare->size, handler, *pools);
+        failed += !handler.inh->sw_ver_.empty() || !handler.inh->user_data_.empty() || 0 != pools->inh.idle();
+
+        // a short frame is dropped, not handed over with the fields of the last one
+        handler.retain = false;
+        handler.last = nullptr;
+        Packer::unpack(big->data, big->size - 1, handler, *pools);
+        failed += nullptr != handler.last;
+
+        {
+            auto state = pools->state.acquire(big->data, big->size);
+            failed += !state || 4100 != state->velocity_ || 16 != state->pass_pos_.size();
+            failed += state->decode(big->data, MessageHeader::HEADER_LENGTH + 20);
+            failed += 0 != state->velocity_ || 0 != state->vehicle_id_[0] || 0 != state->position_.longitude;
+            failed += !state->pass_pos_.empty() || 0 != state->pass_pos_num_ || 0 != state->get_data_length();
+            failed += state->decode(big->data, 4) || !state->decode(big->data, big->size) || 4100 != state->velocity_;
+        }
+
+        failed += (bool)pools->state.acquire(big->data, big->size - 1) || 0 == pools->state.idle();
+
+        // data length covers the fixed part but not the pass positions it counts
+        std::vector<uint8_t> cut(big->data, big->data + big->size - 3 * sizeof(Position2D));
+        uint32_t cut_len = __builtin_bswap32((uint32_t)(cut.size() - MessageHeader::HEADER_LENGTH));
+        VehicleState domain;
+
+        memcpy(cut.data() + 1, &cut_len, sizeof(cut_len));
+        failed += Veh2CloudState(cut.data(), cut.size()).decode(cut.data(), cut.size());
+        failed += 0 != DomainCodec::decode(cut.data(), cut.size(), domain);
+        failed += (bool)pools->state.acquire(cut.data(), cut.size());
+
+        Packer::unpack(cut.data(), cut.size(), handler, *pools);
+        Packer::unpack(cut.data(), cut.size(), handler);
+        Packer::unpack(big->data, big->size - 1, handler);
+        failed += nullptr != handler.last || 0 != handler.plain;
+
+        Packer::unpack(big->data, big->size, handler);
+        failed += 1 != handler.plain;
+        handler.retain = true;
+
+        // handles outlive the pools
+        Packer::unpack(big->data, big->size, handler, *pools);
+        pools.reset();
+        failed += 16 != handler.kept[0]->pass_pos_.size() || "Q1001" != std::string(handler.inh->vehicle_id_);
+        handler.kept.clear();
+        handler.inh.reset();
+
+        printf("message_pool: %zu failed\n", failed);
+
+        return failed;
+    }
+
+    /**
+     * DomainCodec frames match the packed messages' byte for byte, both ways.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_domain()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        std::vector<Position2D> route{Position2D(1213000100, 312000050), Position2D(1213000200, 312000100)};
+        Veh2CloudState msg(0x01, 1600000000000ULL, 0xFC, "Q1001", std::vector<uint8_t>{0x78, 0x56, 0x34, 0x12}, 1600000000001ULL,
+            4000, Position(1213000000, 312000000, 700), 100000, 31, 200000, 4100, 500, 400, 300, 200, 500, 3000, 50000,
+            BREAK_FLAG_UP, 500, 20000, 1000, DRIVE_MODE_AUTO, Position2D(1214000000, 313000000), route);
+        auto frame = Packer::pack(msg);
+        VehicleState state, converted;
+        uint8_t buf[StateBuilder::MAX_SIZE];
+        size_t failed = 0;
+
+        failed += frame->size != DomainCodec::decode(frame->data, frame->size, state);
+        failed += 0x12345678 != state.message_id || 4100 != state.velocity || 2 != state.pass_pos.size();
+        failed += 312000100 != state.pass_pos[1].latitude || 0 != strcmp("Q1001", state.vehicle_id);
+        failed += frame->size != DomainCodec::encode(state, buf, sizeof(buf)) || 0 != memcmp(buf, frame->data, frame->size);
+        failed += 0 != DomainCodec::encode(state, buf, frame->size - 1) || 0 != DomainCodec::decode(frame->data, frame->size - 1, state);
+
+        DomainCodec::convert(msg, converted);
+        failed += frame->size != DomainCodec::encode(converted, buf, sizeof(buf)) || 0 != memcmp(buf, frame->data, frame->size);
+
+        Veh2CloudInh inh_msg(0x01, 1600000000000ULL, 0xFC, "Q1001", "sw_v1.0", "", std::string(300, 'a'),
+            COMM_TYPE_4G, 15, TIME_SYNC_GNSS, GNSS_TYPE_GCJ02, "VEH2CLOUD_INH");
+        auto inh_frame = Packer::pack(inh_msg);
+        VehicleInh inh;
+
+        DomainCodec::convert(inh_msg, inh);
+        failed += inh_frame->size != DomainCodec::pack(inh)->size || 0 != memcmp(DomainCodec::pack(inh)->data, inh_frame->data, inh_frame->size);
+
+        inh = VehicleInh();
+        failed += inh_frame->size != DomainCodec::decode(inh_frame->data, inh_frame->size, inh);
+        failed += "sw_v1.0" != inh.sw_ver || !inh.hw_ver.empty() || !inh.ad_ver.empty() || "VEH2CLOUD_INH" != inh.user_data;
+        failed += TIME_SYNC_GNSS != inh.time_sync || 15 != inh.pos_confidence;
+
+        printf("domain: %zu byte state in a %zu byte VehicleState, %zu failed\n", (size_t)frame->size, sizeof(VehicleState), failed);
+
+        return failed;
+    }
+
+    /**
+     * The codecs generated from csae295.def agree byte for byte with the
+     * hand-written ones, reject truncated frames and dispatch by data type.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_codegen()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        class Collector : public data::Handler
+        {
+        public:
+            void on_message(const data::Veh2CloudState &_msg) override { state = _msg; }
+
+            void on_message(const data::HeartbeatRes &_msg) override { heartbeat_res++; }
+
+            data::Veh2CloudState state;
+            size_t heartbeat_res = 0;
+        };
+
+        auto same = [](const std::shared_ptr<MessageBuffer> &_frame, const uint8_t *_buf, const size_t _size)
+        {
+            return _frame->size == _size && 0 == memcmp(_frame->data, _buf, _size);
+        };
+
+        uint8_t buf[data::Veh2CloudState::MAX_SIZE];
+        size_t failed = 0;
+
+        // decode what Packer packed, encode it back
+        auto state = Packer::pack(Veh2CloudState(0x01, 1600000000000ULL, 0xFC, "Q1001", std::vector<uint8_t>{0x78, 0x56},
+            1600000000001ULL, 4000, Position(1213000000, 312000000, 700), 100000, 31, 200000, 4100, 500, 400, 300, 200, 500,
+            3000, 50000, BREAK_FLAG_UP, 500, 20000, 1000, DRIVE_MODE_AUTO, Position2D(1214000000, 313000000),
+            std::vector<Position2D>{Position2D(1, 2), Position2D(3, 4)}));
+        data::Veh2CloudState gen_state;
+
+        failed += state->size != gen_state.decode(state->data, state->size);
+        failed += 0x5678 != gen_state.message_id || 2 != gen_state.pass_pos_num || 4 != gen_state.pass_pos[1].latitude;
+        failed += 700 != gen_state.position.elevation || 1214000000 != gen_state.dest_location.longitude;
+        failed += !same(state, buf, gen_state.encode(buf, sizeof(buf)));
+        failed += 0 != gen_state.decode(state->data, state->size - 1) || 0 != gen_state.encode(buf, state->size - 1);
+
+        auto inh = Packer::pack(Veh2CloudInh(0x01, 1600000000000ULL, 0xFC, "Q1001", "sw_v1.0", "", "ad_v1.0",
+            COMM_TYPE_4G, 15, TIME_SYNC_GNSS, GNSS_TYPE_GCJ02, "VEH2CLOUD_INH"));
+        data::Veh2CloudInh gen_inh;
+
+        failed += inh->size != gen_inh.decode(inh->data, inh->size) || 7 != gen_inh.sw_ver_len || 0 != gen_inh.hw_ver_len;
+        failed += 13 != gen_inh.user_data_len || 0 != memcmp("ad_v1.0", gen_inh.ad_ver, 7) || 15 != gen_inh.pos_confidence;
+        failed += !same(inh, buf, gen_inh.encode(buf, sizeof(buf)));
+
+        auto res = Packer::pack(Cloud2VehInhRes(0x01, 1600000000000ULL, 0xFC, "Q1001", CLOUD2VEH_INH_RES_FAIL));
+        data::Cloud2VehInhRes gen_res;
+
+        failed += res->size != gen_res.decode(res->data, res->size) || CLOUD2VEH_INH_RES_FAIL != gen_res.res;
+        failed += !same(res, buf, gen_res.encode(buf, sizeof(buf)));
+
+        auto heartbeat = Packer::pack(MessageHeader(0, HEARTBEAT_RES, 0x01, 1600000000000ULL, 0xFC));
+        data::HeartbeatRes gen_heartbeat;
+
+        failed += heartbeat->size != gen_heartbeat.decode(heartbeat->data, heartbeat->size);
+        failed += 1600000000000ULL != gen_heartbeat.timestamp || !same(heartbeat, buf, gen_heartbeat.encode(buf, sizeof(buf)));
+        failed += 0 != data::Heartbeat().decode(heartbeat->data, heartbeat->size);
+
+        // by data type through the table
+        Collector collector;
+        size_t types = 0;
+
+        for (auto &e : data::DISPATCH_TABLE)
+        {
+            types += nullptr != e.unpack;
+        }
+
+        failed += state->size != data::dispatch(state->data, state->size, collector) || 4100 != collector.state.velocity;
+        failed += heartbeat->size != data::dispatch(heartbeat->data, heartbeat->size, collector) || 1 != collector.heartbeat_res;
+        heartbeat->data[5] = 0xEE;
+        failed += 0 != data::dispatch(heartbeat->data, heartbeat->size, collector);
+
+        // a type with no hand-written codec through Packer::unpack, from test/data/fixture.def
+        class Fixtures : public Packer::Handler
+        {
+        public:
+            void on_message(const data::TestFixture &_msg) override { fixture = _msg; fixtures++; }
+
+            data::TestFixture fixture;
+            size_t fixtures = 0;
+        };
+
+        Fixtures fixtures;
+        data::TestFixture fixture;
+        fixture.timestamp = 1600000000000ULL;
+        memcpy(fixture.vehicle_id, "Q1001", 5);
+        fixture.sequence = 7;
+        fixture.kind = 0x0102;
+        fixture.position = data::Point3D{1213000000, 312000000, 700};
+        fixture.text_len = 5;
+        memcpy(fixture.text, "fixed", 5);
+
+        size_t size = fixture.encode(buf, sizeof(buf));
+        Packer::unpack(buf, size, fixtures);
+        failed += 16 + 8 + 4 + 2 + 12 + 1 + 5 != size || TEST_FIXTURE != buf[5] || 1 != fixtures.fixtures;
+        failed += 7 != fixtures.fixture.sequence || 0x0102 != fixtures.fixture.kind || 700 != fixtures.fixture.position.elevation;
+        failed += 5 != fixtures.fixture.text_len || 0 != memcmp("fixed", fixtures.fixture.text, 5);
+
+        // a frame is decoded once handed over, a rejected one counted under a single reason
+        Counter &decoded = Metrics::instance().counter("csae_decoded_total", "", "type=\"generated\"");
+        Counter &error_short = Metrics::instance().counter("csae_decode_errors_total", "", "reason=\"short\"");
+        Counter &error_type = Metrics::instance().counter("csae_decode_errors_total", "", "reason=\"type\"");
+        uint64_t counts[] = {decoded.value(), error_short.value(), error_type.value()};
+
+        Packer::unpack(buf, size - 1, fixtures);
+        buf[size - 6] = 9;
+        Packer::unpack(buf, size, fixtures);
+        buf[5] = 0xEE;
+        Packer::unpack(buf, size, fixtures);
+        failed += 1 != fixtures.fixtures || counts[0] != decoded.value();
+        failed += counts[1] + 2 != error_short.value() || counts[2] + 1 != error_type.value();
+
+        printf("codegen: %zu generated types, %zu failed\n", types, failed);
+
+        return failed;
+    }
+
+    /**
+     * CloudStub answers a Controller on loopback: HEARTBEAT with
+     * HEARTBEAT_RES and Veh2CloudInh with a Cloud2VehInhRes of the same
+     * vehicle.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_cloud_stub()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        class Collector : public Controller::Callback, public Tracer::Sink
+        {
+        public:
+            void on_up_connect_state(const socketlib::ConnectState _state) override { up += socketlib::CONNECTED == _state; }
+
+            void on_down_connect_state(const socketlib::ConnectState _state) override { down += socketlib::CONNECTED == _state; }
+
+            void on_cloud2veh_inh_res(const Cloud2VehInhRes &_msg) override
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                vehicle_id = std::string(_msg.vehicle_id_, strnlen(_msg.vehicle_id_, sizeof(_msg.vehicle_id_)));
+                res = _msg.res_;
+                inh_reses++;
+            }
+
+            void on_frame(const uint32_t _direction, const void *_buf, const size_t _size) override
+            {
+                heartbeat_reses += 5 < _size && HEARTBEAT_RES == ((const uint8_t*)_buf)[5];
+            }
+
+            std::mutex mutex;
+            std::string vehicle_id;
+            uint8_t res = 0;
+            std::atomic<size_t> up{0}, down{0}, inh_reses{0}, heartbeat_reses{0};
+        };
+
+        auto wait = [](const std::atomic<size_t> &_value)
+        {
+            for (int i = 0; i < 2000 && 0 == _value; i++)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            return 0 != _value;
+        };
+
+        CloudStub stub;
+        Controller controller;
+        Collector collector;
+        size_t failed = 0;
+
+        if (0 != stub.start("127.0.0.1", 38821, 38822))
+        {
+            printf("cloud_stub: start failed\n");
+            return 1;
+        }
+
+        controller.set_callback(&collector);
+        controller.tracer().set_sink(&collector);
+        controller.tracer().set_sample(1);
+        controller.tracer().set_all_types(true);
+        controller.tracer().enable(TRACE_DOWN_RX);
+        controller.start("127.0.0.1", 38821, "127.0.0.1", 38822);
+        failed += !wait(collector.up) || !wait(collector.down);
+
+        controller.send(MessageHeader(0, HEARTBEAT, 0x01, get_utc_timestamp_ms(), 0xFC));
+        failed += !wait(collector.heartbeat_reses) || 1 != stub.stats().heartbeats;
+
+        controller.send(Veh2CloudInh(0x01, get_utc_timestamp_ms(), 0xFC, "Q1001", "sw_v1.0", "hw_v1.0", "ad_v1.0",
+            COMM_TYPE_4G, 15, TIME_SYNC_GNSS, GNSS_TYPE_GCJ02, "VEH2CLOUD_INH"));
+        failed += !wait(collector.inh_reses) || 1 != stub.stats().inhs;
+
+        {
+            std::lock_guard<std::mutex> lock(collector.mutex);
+            failed += "Q1001" != collector.vehicle_id || CLOUD2VEH_INH_RES_COMFIRM != collector.res;
+        }
+
+        controller.stop();
+        controller.tracer().disable(TRACE_DOWN_RX);
+        controller.tracer().set_sink(nullptr);
+        stub.stop();
+
+        printf("cloud_stub: %" PRIu64 " frames from %" PRIu64 " connections, %zu failed\n",
+            stub.stats().frames.load(), stub.stats().connections.load(), failed);
+
+        return failed;
+    }
+
+    /**
+     * Frame CSAE, JT/T 808 and JT/T 1078 streams fed in pieces with garbage
+     * in between, then run a JT/T 808 link against a local socket.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_codecs()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        class Jt808Collector : public jt808::Handler
+        {
+        public:
+            void on_message(const jt808::Header &_header, const uint8_t *_body, const size_t _size) { messages++; }
+
+            void on_heartbeat(const jt808::Header &_header) { heartbeats++; version = _header.version; }
+
+            void on_location(const jt808::Header &_header, const jt808::Location &_msg, const uint8_t *_items, const size_t _size)
+            {
+                locations++;
+                serial = _header.serial;
+                alarm = _msg.alarm;
+                items = _size;
+            }
+
+            std::atomic<size_t> messages{0}, heartbeats{0}, locations{0};
+            uint8_t version = 0;
+            uint16_t serial = 0;
+            uint32_t alarm = 0;
+            size_t items = 0;
+        };
+
+        class Jt1078Collector : public jt1078::Handler
+        {
+        public:
+            void on_packet(const jt1078::Header &_header, const uint8_t *_body, const size_t _size)
+            {
+                packets[_header.data_type]++;
+                bytes += _size;
+                timestamp = _header.timestamp;
+            }
+
+            size_t packets[5] = {0};
+            size_t bytes = 0;
+            uint64_t timestamp = 0;
+        };
+
+        // in pieces of 1 to 13 bytes, and whole
+        auto feed = [](const std::vector<uint8_t> &_stream, std::function<void(const uint8_t*, size_t)> _feed)
+        {
+            for (size_t step = 1; step <= 14; step++)
+            {
+                size_t n = 14 == step ? _stream.size() : step;
+
+                for (size_t i = 0; i < _stream.size(); i += n)
+                {
+                    _feed(_stream.data() + i, n < _stream.size() - i ? n : _stream.size() - i);
+                }
+            }
+        };
+
+        auto append = [](std::vector<uint8_t> &_stream, const std::shared_ptr<MessageBuffer> &_frame)
+        {
+            _stream.insert(_stream.end(), _frame->data, _frame->data + _frame->size);
+        };
+
+        size_t failed = 0;
+
+        // CSAE, behind junk with 0xF2 in it
+        std::vector<uint8_t> csae{0x00, 0xF2, 0x7E};
+        FrameAssembler csae_assembler;
+        size_t csae_frames = 0;
+
+        append(csae, Packer::pack(MessageHeader(0, HEARTBEAT, 0x01, 1600000000000ULL, 0xFC)));
+        append(csae, Packer::pack(Cloud2VehInhRes(0x01, 1600000000000ULL, 0xFC, "Q1001", CLOUD2VEH_INH_RES_COMFIRM)));
+        append(csae, Packer::pack(Veh2CloudState(0x01, 1600000000000ULL, 0xFC, "Q1001", std::vector<uint8_t>{1},
+            1600000000001ULL, 4000, Position(1213000000, 312000000, 700), 100000, 31, 200000, 4100, 500, 400, 300, 200, 500,
+            3000, 50000, BREAK_FLAG_UP, 500, 20000, 1000, DRIVE_MODE_AUTO, Position2D(1214000000, 313000000),
+            std::vector<Position2D>(20, Position2D(1, 2)))));
+        feed(csae, [&](const uint8_t *_buf, const size_t _size)
+        {
+            csae_assembler.feed(_buf, _size, [&](const uint8_t *_frame, const size_t _frame_size)
+            {
+                csae_frames += MessageHeader::HEADER_LENGTH <= _frame_size;
+            });
+        });
+        failed += 3 * 14 != csae_frames;
+
+        // JT/T 808, escapes in the header and the body, a stray flag and a bad check code
+        std::vector<uint8_t> jt808_stream{0x7E, 0x11, 0x7E};
+        BasicFrameAssembler<jt808::Codec> jt808_assembler;
+        jt808::Codec jt808_codec;
+        Jt808Collector jt808_collector;
+        jt808::Header header;
+        jt808::Location location;
+        uint8_t body[64];
+        size_t rejected = 0;
+
+        header.id = jt808::LOCATION_REPORT;
+        header.serial = 0x7E7D;
+        string_to_bcd("13800138000", header.phone, 6);
+        location.alarm = 0x7D7E7D7E;
+        location.latitude = 31200000;
+        location.longitude = 121300000;
+        memcpy(body + jt808::Codec::encode(location, body, sizeof(body)), "\x01\x04\x00\x00\x7E\x7D", 6);
+        append(jt808_stream, jt808::Codec::pack(header, body, jt808::Location::LENGTH + 6));
+
+        auto bad = jt808::Codec::pack(header, body, jt808::Location::LENGTH);
+        bad->data[bad->size - 2] ^= 0x01;
+        append(jt808_stream, bad);
+
+        header.id = jt808::TERMINAL_HEARTBEAT;
+        header.attr = jt808::Header::VERSION_FLAG;
+        header.version = 1;
+        append(jt808_stream, jt808::Codec::pack(header, nullptr, 0));
+        feed(jt808_stream, [&](const uint8_t *_buf, const size_t _size)
+        {
+            jt808_assembler.feed(_buf, _size, [&](const uint8_t *_frame, const size_t _frame_size)
+            {
+                rejected += 0 == jt808_codec.dispatch(_frame, _frame_size, jt808_collector);
+            });
+        });
+        failed += 2 * 14 != jt808_collector.messages || 14 != jt808_collector.locations || 14 != jt808_collector.heartbeats;
+        failed += 14 != rejected || 0x7E7D != jt808_collector.serial || 0x7D7E7D7E != jt808_collector.alarm;
+        failed += 6 != jt808_collector.items || 1 != jt808_collector.version;
+        failed += !jt808::Codec::decode_header(bad->data, bad->size, header) || jt808::LOCATION_REPORT != header.id;
+
+        // JT/T 1078, a cut magic before the first packet and the magic in a body
+        std::vector<uint8_t> jt1078_stream{0x30, 0x31, 0x63, 0x00, 0x30, 0x31};
+        BasicFrameAssembler<jt1078::Codec> jt1078_assembler;
+        jt1078::Codec jt1078_codec;
+        Jt1078Collector jt1078_collector;
+        jt1078::Header packet;
+        uint8_t media[jt1078::Codec::MAX_BODY];
+
+        for (size_t i = 0; i < sizeof(media); i++)
+        {
+            media[i] = "01cd"[i % 4];
+        }
+
+        packet.timestamp = 1600000000000ULL;
+        packet.subpackage = jt1078::FIRST;
+        append(jt1078_stream, jt1078::Codec::pack(packet, media, sizeof(media)));
+        packet.data_type = jt1078::AUDIO;
+        packet.subpackage = jt1078::ATOMIC;
+        append(jt1078_stream, jt1078::Codec::pack(packet, media, 160));
+        packet.data_type = jt1078::TRANSPARENT;
+        append(jt1078_stream, jt1078::Codec::pack(packet, media, 3));
+        failed += nullptr != jt1078::Codec::pack(packet, media, sizeof(media) + 1);
+        feed(jt1078_stream, [&](const uint8_t *_buf, const size_t _size)
+        {
+            jt1078_assembler.feed(_buf, _size, [&](const uint8_t *_frame, const size_t _frame_size)
+            {
+                rejected += 0 == jt1078_codec.dispatch(_frame, _frame_size, jt1078_collector);
+            });
+        });
+        failed += 14 != jt1078_collector.packets[jt1078::VIDEO_I] || 14 != jt1078_collector.packets[jt1078::AUDIO];
+        failed += 14 != jt1078_collector.packets[jt1078::TRANSPARENT] || (sizeof(media) + 163) * 14 != jt1078_collector.bytes;
+        failed += 14 != rejected || 0 != jt1078_collector.timestamp;
+
+        printf("codecs: csae %zu, jt808 %zu, jt1078 %zu frames, %zu+%zu+%zu bytes skipped\n",
+            csae_assembler.frames(), jt808_assembler.frames(), jt1078_assembler.frames(),
+            csae_assembler.skipped(), jt808_assembler.skipped(), jt1078_assembler.skipped());
+
+        // a JT/T 808 link, location reports in and a platform response out
+        int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (0 != bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) || 0 != listen(listen_fd, 1)
+            || 0 != getsockname(listen_fd, (struct sockaddr*)&addr, &len))
+        {
+            close(listen_fd);
+            printf("codecs: no loopback socket, link skipped, %zu failed\n", failed);
+            return failed;
+        }
+
+        Jt808Collector link_collector;
+        ProtocolLink<jt808::Codec, Jt808Collector> link("127.0.0.1", ntohs(addr.sin_port), link_collector);
+
+        link.start();
+
+        int fd = accept(listen_fd, nullptr, nullptr);
+        failed += (ssize_t)jt808_stream.size() != ::send(fd, jt808_stream.data(), jt808_stream.size(), MSG_NOSIGNAL);
+
+        jt808::GeneralResponse res;
+        uint8_t res_body[jt808::GeneralResponse::LENGTH];
+
+        header = jt808::Header();
+        header.id = jt808::PLATFORM_RESPONSE;
+        res.serial = 0x7E7D;
+        res.id = jt808::LOCATION_REPORT;
+        link.send(jt808::Codec::pack(header, res_body, jt808::Codec::encode(res, res_body, sizeof(res_body))));
+
+        uint8_t buf[64];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        jt808::Header res_header;
+
+        failed += 0 >= n || !jt808::Codec::decode_header(buf, n, res_header) || jt808::PLATFORM_RESPONSE != res_header.id;
+
+        for (size_t i = 0; i < 200 && 2 > link_collector.messages; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        failed += 2 != link_collector.messages || 1 != link_collector.locations || 1 != link_collector.heartbeats;
+
+        link.stop();
+        close(fd);
+        close(listen_fd);
+
+        printf("codecs: jt808 link %zu messages, %zu failed\n", link_collector.messages.load(), failed);
+
+        return failed;
+    }
+
     template<typename T, typename std::enable_if<std::is_base_of<MessageHeader, T>::value>::type* = nullptr>
     static void run(const T &_t) 
     {
@@ -30,6 +1638,623 @@ public:
         Packer::unpack(buf->data, buf->size, handler);
     }
 
+    /**
+     * Record frames of every direction and read them back whole, by vehicle
+     * and through the index by time, then close while a socket thread is
+     * still recording.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_recorder(const char _dir[])
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        class Visitor : public FrameReader::Visitor
+        {
+        public:
+            bool on_frame(const FrameReader::Frame &_frame) override
+            {
+                frames.push_back(_frame);
+                return true;
+            }
+
+            std::vector<FrameReader::Frame> frames;
+        };
+
+        FrameRecorder recorder;
+        size_t failed = 0;
+
+        if (0 != recorder.open(_dir, "test", 1 << 20, 1 << 20))
+        {
+            printf("recorder: open %s failed\n", _dir);
+            return 1;
+        }
+
+        std::vector<std::shared_ptr<MessageBuffer>> bufs;
+        const uint8_t directions[3] = {RECORD_UP_TX, RECORD_UP_RX, RECORD_DOWN_TX};
+
+        bufs.push_back(Packer::pack(Veh2CloudInh(
+            0x01, get_utc_timestamp_ms(), 0xFC, "Q1001", "sw_v1.0", "hw_v1.0", "ad_v1.0",
+            COMM_TYPE_4G, 15, TIME_SYNC_GNSS, GNSS_TYPE_GCJ02, "VEH2CLOUD_INH")));
+        bufs.push_back(Packer::pack(Cloud2VehInhRes(0x01, get_utc_timestamp_ms(), 0xFC, "Q1002", CLOUD2VEH_INH_RES_COMFIRM)));
+        bufs.push_back(Packer::pack(MessageHeader(0, HEARTBEAT, 0x01, get_utc_timestamp_ms(), 0xFC)));
+
+        // past RECORD_INDEX_INTERVAL, several index entries
+        for (size_t i = 0; i < 2000; i++)
+        {
+            failed += !recorder.record(directions[i % 3], bufs[i % 3]->data, bufs[i % 3]->size);
+        }
+
+        recorder.close();
+        failed += 2000 != recorder.recorded() || 0 != recorder.dropped() || recorder.record(RECORD_UP_TX, bufs[0]->data, bufs[0]->size);
+
+        FrameReader reader;
+        Visitor all;
+        Visitor q1002;
+        Visitor range;
+
+        failed += 0 != reader.open(_dir, "test") || 1 != reader.segment_count();
+        failed += 2000 != reader.read(all) || 2000 != all.frames.size();
+
+        // in order within a direction, the rings are drained one by one
+        size_t counts[3] = {0, 0, 0};
+        uint64_t last[3] = {0, 0, 0};
+
+        for (auto &frame : all.frames)
+        {
+            size_t k = std::find(directions, directions + 3, frame.direction) - directions;
+
+            if (3 == k)
+            {
+                failed++;
+                continue;
+            }
+
+            failed += bufs[k]->size != frame.size || 0 != memcmp(bufs[k]->data, frame.data, frame.size);
+            failed += last[k] > frame.timestamp;
+            last[k] = frame.timestamp;
+            counts[k]++;
+        }
+
+        failed += 667 != counts[0] || 667 != counts[1] || 666 != counts[2];
+
+        failed += 667 != reader.read(0, UINT64_MAX, "Q1002", q1002);
+
+        for (auto &frame : q1002.frames)
+        {
+            failed += RECORD_UP_RX != frame.direction || CLOUD2VEH_INH_RES != frame.data_type;
+        }
+
+        // seek to a time range in the middle
+        uint64_t begin = all.frames[1200].timestamp;
+        uint64_t end = all.frames[1300].timestamp;
+        size_t expected = 0;
+
+        if (begin > end)
+        {
+            std::swap(begin, end);
+        }
+
+        for (auto &frame : all.frames)
+        {
+            expected += begin <= frame.timestamp && end > frame.timestamp;
+        }
+
+        failed += expected != reader.read(begin, end, nullptr, range) || 0 == expected;
+
+        for (auto &frame : range.frames)
+        {
+            failed += begin > frame.timestamp || end <= frame.timestamp;
+        }
+        reader.close();
+
+        // close() and open() under a socket thread's record()
+        std::atomic<bool> done{false};
+        std::thread producer([&recorder, &bufs, &done]()
+        {
+            while (!done)
+            {
+                recorder.record(RECORD_DOWN_RX, bufs[1]->data, bufs[1]->size);
+            }
+        });
+
+        for (int i = 0; i < 20; i++)
+        {
+            failed += 0 != recorder.open(_dir, "race", 1 << 20, 1 << 12);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            recorder.close();
+        }
+
+        done = true;
+        producer.join();
+
+        printf("recorder: %zu frames, %zu of Q1002, %zu in range, %zu failed\n",
+            all.frames.size(), q1002.frames.size(), range.frames.size(), failed);
+
+        return failed;
+    }
+
+    /**
+     * A capture replayed in process and to a Controller over loopback, each
+     * frame's latency matched to its own write, a junk frame lost without
+     * shifting the rest.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_replayer(const char _dir[])
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        class Collector : public Packer::Handler
+        {
+        public:
+            void on_unpack(const MessageHeader &_msg) override { heartbeats++; }
+
+            void on_unpack(const Veh2CloudState &_msg) override { velocities.push_back(_msg.velocity_); }
+
+            std::vector<uint16_t> velocities;
+            size_t heartbeats = 0;
+        };
+
+        FrameRecorder recorder;
+        size_t failed = 0;
+
+        if (0 != recorder.open(_dir, "replay", 1 << 20, 1 << 20))
+        {
+            printf("replayer: open %s failed\n", _dir);
+            return 1;
+        }
+
+        const size_t COUNT = 300;
+        const uint8_t junk[8] = {0};
+        size_t bytes = 0;
+
+        for (size_t i = 0; i < COUNT; i++)
+        {
+            auto state = Packer::pack(Veh2CloudState(0x01, 1600000000000ULL + i, 0xFC, 0 == i % 2 ? "Q1001" : "Q1002",
+                std::vector<uint8_t>{1, 2}, 1600000000001ULL, 4000, Position(1213000000, 312000000, 700), 100000, 31,
+                200000, (uint16_t)i, 500, 400, 300, 200, 500, 3000, 50000, BREAK_FLAG_UP, 500, 20000, 1000,
+                DRIVE_MODE_AUTO, Position2D(1214000000, 313000000), std::vector<Position2D>()));
+
+            failed += !recorder.record(RECORD_UP_RX, state->data, state->size);
+            bytes += state->size;
+
+            if (0 == i % 10)
+            {
+                auto heartbeat = Packer::pack(MessageHeader(0, HEARTBEAT_RES, 0x01, 1600000000000ULL + i, 0xFC));
+                failed += !recorder.record(RECORD_DOWN_RX, heartbeat->data, heartbeat->size);
+                bytes += heartbeat->size;
+            }
+
+            // framed by nothing, the controller's assembler skips it
+            if (COUNT / 2 == i)
+            {
+                failed += !recorder.record(RECORD_UP_RX, junk, sizeof(junk));
+            }
+        }
+
+        recorder.close();
+
+        Replayer replayer;
+        Replayer::Report all;
+        Replayer::Report q1002;
+        Collector collector;
+        Collector vehicle;
+
+        failed += 0 != replayer.open(_dir, "replay");
+        replayer.set_speed(0);
+        replayer.replay(collector, all);
+        failed += COUNT + COUNT / 10 + 1 != all.frames || bytes + sizeof(junk) != all.bytes || all.frames != all.latency.count();
+        failed += COUNT != collector.velocities.size() || COUNT / 10 != collector.heartbeats;
+
+        for (size_t i = 0; i < collector.velocities.size(); i++)
+        {
+            failed += i != collector.velocities[i];
+        }
+
+        replayer.set_vehicle("Q1002");
+        replayer.set_directions(1 << RECORD_UP_RX);
+        replayer.replay(vehicle, q1002);
+        failed += COUNT / 2 != vehicle.velocities.size() || 1 != vehicle.velocities[0] || 0 != vehicle.heartbeats;
+
+        // every frame but the junk reaches the controller, and only those are timed
+        Controller controller;
+        Replayer::Report loopback;
+
+        replayer.set_vehicle(nullptr);
+        replayer.set_directions(0x0F);
+        failed += 0 != replayer.replay(controller, 38811, 38812, loopback);
+        failed += all.frames != loopback.frames || 1 != loopback.lost || all.frames - 1 != loopback.latency.count();
+        replayer.close();
+
+        printf("replayer: %" PRIu64 " frames, %" PRIu64 " lost over loopback, p99 %.2f us, %zu failed\n",
+            loopback.frames, loopback.lost, loopback.latency.percentile(99) / 1e3, failed);
+
+        return failed;
+    }
+
+    /**
+     * A raw stream dump with junk between frames and a recorder capture of
+     * the same states, decoded over several chunks on one and on four
+     * threads, back in file order.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_bulk_decoder(const char _dir[])
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        class Collector : public BulkDecoder::Handler
+        {
+        public:
+            void on_frame(const uint8_t *_frame, const size_t _size) override
+            {
+                frames++;
+            }
+
+            void on_unpack(const Veh2CloudState &_msg) override
+            {
+                timestamps.push_back(_msg.timestamp_);
+            }
+
+            size_t frames = 0;
+            std::vector<uint64_t> timestamps;
+        };
+
+        class Merger : public BulkDecoder::Factory
+        {
+        public:
+            BulkDecoder::Handler* create(const size_t _chunk) override
+            {
+                return new Collector();
+            }
+
+            void merge(BulkDecoder::Handler *_handler) override
+            {
+                Collector *c = (Collector*)_handler;
+                frames += c->frames;
+                timestamps.insert(timestamps.end(), c->timestamps.begin(), c->timestamps.end());
+                delete c;
+            }
+
+            size_t frames = 0;
+            std::vector<uint64_t> timestamps;
+        };
+
+        const size_t count = 10000;
+        const uint8_t junk[5] = {FRAME_IDENTIFIER, 0xFF, 0xFF, 0xFF, 0xFF};
+        std::string stream = std::string(_dir) + "/bulk.stream";
+        FILE *fp = fopen(stream.c_str(), "wb");
+        FrameRecorder recorder;
+        size_t skipped = 0;
+        size_t failed = 0;
+
+        if (nullptr == fp || 0 != recorder.open(_dir, "bulk", 1 << 22, 1 << 22))
+        {
+            printf("bulk_decoder: open in %s failed\n", _dir);
+            return 1;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            auto buf = Packer::pack(Veh2CloudState(
+                0x01, 1600000000000ULL + i, 0xFC, "Q1001", std::vector<uint8_t>{(uint8_t)i, 1}, 1600000000000ULL + i,
+                4000, Position(90, 90, 700), 100000, 31, 200000, 4100, 500, 400, 300, 200, 500, 3000, 50000,
+                1, 500, 20000, 1000, 1, Position2D(80, 80), std::vector<Position2D>(i % 4, Position2D(i, i))));
+
+            failed += buf->size != fwrite(buf->data, 1, buf->size, fp);
+            failed += !recorder.record(RECORD_UP_TX, buf->data, buf->size);
+
+            if (999 == i % 1000)
+            {
+                skipped += fwrite(junk, 1, sizeof(junk), fp);
+            }
+        }
+
+        fclose(fp);
+        recorder.close();
+
+        const std::string paths[2] = {stream, std::string(_dir) + "/bulk-000000.seg"};
+
+        for (auto &path : paths)
+        {
+            for (size_t threads : {1, 4})
+            {
+                BulkDecoder decoder;
+                BulkDecoder::Stats stats;
+                Merger merger;
+
+                failed += 0 != decoder.open(path.c_str()) || decoder.is_capture() != (&path != &paths[0]);
+                failed += 0 != decoder.decode(merger, threads, 0, stats);
+                failed += 2 > stats.chunks || count != stats.frames || count != merger.frames || count != merger.timestamps.size();
+                failed += (&path == &paths[0] ? skipped : 0) != stats.skipped;
+
+                for (size_t i = 0; i < merger.timestamps.size(); i++)
+                {
+                    failed += 1600000000000ULL + i != merger.timestamps[i];
+                }
+
+                printf("bulk_decoder: %s on %zu threads, %" PRIu64 " chunks, %" PRIu64 " frames, %" PRIu64 " skipped\n",
+                    path.c_str(), threads, stats.chunks, stats.frames, stats.skipped);
+            }
+        }
+
+        printf("bulk_decoder: %zu frames, %zu failed\n", count, failed);
+
+        return failed;
+    }
+
+    /**
+     * Spool states past the cap, reopen and read back the newest in order,
+     * across another reopen after a partial read.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_spool(const char _dir[], const bool _compact)
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        std::string path = std::string(_dir) + (_compact ? "/compact.spool" : "/raw.spool");
+        std::vector<std::shared_ptr<MessageBuffer>> frames;
+        size_t failed = 0;
+
+        for (uint32_t i = 0; i < 300; i++)
+        {
+            frames.push_back(Packer::pack(Veh2CloudState(
+                0x01, 1600000000000ULL + i * 200, 0xFC, "Q1001", std::vector<uint8_t>{(uint8_t)i, 1}, 1600000000000ULL + i * 200,
+                4000 + i, Position(90 + i, 90, 700), 100000, 31, 200000, 4100, 500, 400, 300, 200, 500, 3000, 50000,
+                1, 500, 20000, 1000, 1, Position2D(80, 80), std::vector<Position2D>(i % 4, Position2D(i, i)))));
+        }
+
+        StateSpool spool;
+        failed += 0 != spool.open(path.c_str(), 8192, _compact);
+
+        for (auto &f : frames)
+        {
+            failed += !spool.append(f->data, f->size);
+        }
+
+        failed += spool.append(frames.back()->data, frames.back()->size);
+        failed += spool.bytes() > 8192 || 0 == spool.count();
+
+        size_t count = spool.count();
+        spool.close();
+        failed += 0 != spool.open(path.c_str(), 8192, _compact);
+
+        // the newest frames, oldest first
+        std::vector<std::vector<uint8_t>> kept;
+        std::vector<uint8_t> frame;
+
+        // a restart after a partial pop, a compact tail is then a delta
+        for (size_t i = 0; i < 5 && spool.front(frame); i++)
+        {
+            kept.push_back(frame);
+            spool.pop();
+        }
+
+        spool.close();
+        failed += 0 != spool.open(path.c_str(), 8192, _compact) || count - kept.size() != spool.count();
+
+        while (spool.front(frame))
+        {
+            kept.push_back(frame);
+            spool.pop();
+        }
+
+        failed += kept.size() != count;
+
+        for (size_t i = 0; i < kept.size(); i++)
+        {
+            auto &f = frames[frames.size() - kept.size() + i];
+
+            failed += f->size != kept[i].size() || 0 != memcmp(f->data, kept[i].data(), f->size);
+        }
+
+        printf("spool %s: kept %zu of %zu in %zu bytes, %zu failed\n",
+            _compact ? "compact" : "raw", count, frames.size(), (size_t)8192, failed);
+
+        return failed;
+    }
+
+    /**
+     * BCD pack and unpack against a scalar reference, returns the failures.
+     */
+    static size_t test_bcd()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        size_t failed = 0;
+        char str[128];
+        char ref[128];
+        uint8_t bcd[64];
+
+        // every packed byte
+        for (int b = 0; b < 256; b++)
+        {
+            uint8_t byte = (uint8_t)b;
+            bool valid = 9 >= (b >> 4) && 9 >= (b & 0x0F);
+            int ret = bcd_to_string(&byte, 1, str);
+
+            failed += valid != (0 == ret) || (valid && (str[0] != '0' + (b >> 4) || str[1] != '0' + (b & 0x0F)));
+        }
+
+        // every 6 digit id through a 3 byte field
+        for (uint32_t i = 0; i < 1000000; i++)
+        {
+            snprintf(str, sizeof(str), "%u", i);
+            snprintf(ref, sizeof(ref), "%06u", i);
+            failed += 0 != string_to_bcd(str, bcd, 3) || (i / 10000 / 10 * 16 + i / 10000 % 10) != bcd[0]
+                || (i % 100 / 10 * 16 + i % 10) != bcd[2];
+            failed += 0 != bcd_to_string(bcd, 3, str) || 0 != strcmp(str, ref);
+        }
+
+        // every length and field size across the SIMD blocks, and a bad digit at every position
+        for (size_t size = 1; size <= 40; size++)
+        {
+            for (size_t len = 0; len <= 2 * size; len++)
+            {
+                for (size_t i = 0; i < len; i++)
+                {
+                    str[i] = (char)('0' + (i * 7 + size) % 10);
+                }
+
+                str[len] = '\0';
+                memset(ref, '0', 2 * size - len);
+                memcpy(ref + 2 * size - len, str, len + 1);
+
+                char out[128];
+                failed += 0 != string_to_bcd(str, bcd, size) || 0 != bcd_to_string(bcd, size, out) || 0 != strcmp(out, ref);
+                failed += (int)(len + 1) / 2 != string_to_bcd_var(str, bcd, size)
+                    || (int)len != bcd_to_string_var(bcd, size, out) || 0 != strcmp(out, str);
+
+                for (size_t i = 0; i < len; i++)
+                {
+                    char c = str[i];
+
+                    str[i] = 0 == i % 2 ? ':' : '/';
+                    failed += -1 != string_to_bcd(str, bcd, size) || -1 != string_to_bcd_var(str, bcd, size);
+                    str[i] = c;
+                }
+            }
+
+            failed += -1 != string_to_bcd(std::string(2 * size + 1, '1').c_str(), bcd, size);
+
+            memset(bcd, 0x12, size);
+            bcd[size - 1] = 0x1A;
+            failed += -1 != bcd_to_string(bcd, size, str);
+        }
+
+        // a column of ids against one at a time
+        const char ids[] = "013800138000139001390001370013700";
+        uint8_t column[5 * 6];
+
+        failed += 0 != string_to_bcd_batch(ids, 11, 3, column, 6);
+
+        for (size_t i = 0; i < 3; i++)
+        {
+            std::string id(ids + i * 11, 11);
+
+            string_to_bcd(id.c_str(), bcd, 6);
+            failed += 0 != memcmp(bcd, column + i * 6, 6);
+        }
+
+        failed += 0 != bcd_to_string_batch(column, 6, 3, str) || 0 != memcmp(str + 1, ids, 11) || 0 != memcmp(str + 25, ids + 22, 11);
+
+        printf("bcd: %zu failed\n", failed);
+
+        return failed;
+    }
+
+    /**
+     * The CP936 tables against iconv on every double byte code, both ways,
+     * and on mixed and malformed text.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_gbk()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        size_t mapped = 0;
+        size_t failed = 0;
+
+        for (int lead = 0x81; lead <= 0xFE; lead++)
+        {
+            for (int trail = 0x40; trail <= 0xFE; trail++)
+            {
+                if (0x7F == trail)
+                {
+                    continue;
+                }
+
+                char gbk[2] = {(char)lead, (char)trail};
+                char utf8[8] = "";
+                char expected[8] = "";
+                int ret = gbk_to_utf8(gbk, sizeof(gbk), utf8, sizeof(utf8));
+
+                failed += ret != gbk_to_utf8_iconv(gbk, sizeof(gbk), expected, sizeof(expected));
+                failed += 0 == ret && 0 != strcmp(utf8, expected);
+
+                if (0 != ret)
+                {
+                    continue;
+                }
+
+                char back[4] = "";
+                char oracle[4] = "";
+
+                ret = utf8_to_gbk(utf8, strlen(utf8), back, sizeof(back));
+                failed += ret != utf8_to_gbk_iconv(utf8, strlen(utf8), oracle, sizeof(oracle));
+                failed += 0 == ret && 0 != strcmp(back, oracle);
+                mapped++;
+            }
+        }
+
+        char text[] = "VEH2CLOUD_INH \xe4\xba\xac" "A12345 \xe8\xbd\xa6\xe8\xbe\x86, \xe2\x80\x94 ok";
+        char gbk[64] = "";
+        char oracle[64] = "";
+        char utf8[64] = "";
+
+        failed += 0 != utf8_to_gbk(text, strlen(text), gbk, sizeof(gbk));
+        failed += 0 != utf8_to_gbk_iconv(text, strlen(text), oracle, sizeof(oracle)) || 0 != strcmp(gbk, oracle);
+        failed += 0 != gbk_to_utf8(gbk, strlen(gbk), utf8, sizeof(utf8)) || 0 != strcmp(text, utf8);
+
+        // a cut lead byte, a lone continuation byte and no room for the output
+        failed += 0 == gbk_to_utf8(gbk, 15, utf8, sizeof(utf8)) || 0 == gbk_to_utf8_iconv(gbk, 15, utf8, sizeof(utf8));
+        failed += 0 == utf8_to_gbk(text + 15, 3, gbk, sizeof(gbk)) || 0 == utf8_to_gbk_iconv(text + 15, 3, gbk, sizeof(gbk));
+        failed += 0 == utf8_to_gbk(text, strlen(text), gbk, 16);
+
+        printf("gbk: %zu mapped codes, %zu failed\n", mapped, failed);
+
+        return failed;
+    }
+
+    /**
+     * Round trips against a remote clock 1234 ms ahead running 100 ppm fast,
+     * with queueing on either leg.
+     *
+     * @return number of failed checks
+     */
+    static size_t test_clock_sync()
+    {
+        std::cout << std::endl << SPLIT_LINE << std::endl << std::endl;
+
+        ClockSync clock;
+        size_t failed = 0;
+        uint64_t t0 = 1600000000000ULL;
+
+        failed += clock.synced() || clock.sample(t0, t0, t0 + 10);
+
+        for (uint64_t i = 0; i < 200; i++)
+        {
+            uint64_t request = t0 + i * 1000;
+            bool quiet = 0 == i % 8;            // no queueing either way
+            uint64_t up = 10 + (quiet ? 0 : 1 + (i * 37) % 50);
+            uint64_t down = 10 + (quiet ? 0 : 1 + (i * 53) % 70);
+            uint64_t remote = request + up + 1234 + (request + up - t0) / 10000;
+
+            failed += !clock.sample(request, remote, request + up + down);
+        }
+
+        uint64_t now = t0 + 200000;
+        int64_t offset = 1234 + (int64_t)(now - t0) / 10000;
+        ClockStats stats = clock.stats();
+        int64_t estimate = clock.offset(now);
+
+        failed += !clock.synced() || 200 != stats.samples;
+        failed += 3 < llabs(estimate - offset);
+        failed += 20 < fabs(stats.drift - 100);
+        failed += 3 < llabs(clock.downlink(now + offset, now + 25) - 25);
+        failed += 3 < llabs(clock.uplink(now, now + offset + 25) - 25);
+
+        clock.reset();
+        failed += clock.synced() || 0 != clock.offset(now);
+
+        printf("clock_sync: offset %lld ms, drift %.1f ppm, %zu failed\n", (long long)estimate, stats.drift, failed);
+
+        return failed;
+    }
+
     template<typename T, typename std::enable_if<std::is_base_of<MessageHeader, T>::value>::type* = nullptr>
     static void test() 
     {
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <thread>
+
+#include "bulk_decoder.h"
+#include "serializer.h"
+
+using namespace protocol;
+
+static void usage(const char *_name)
+{
+    printf("Usage: %s [options] <capture segment | raw stream dump>\n"
+        "  -t <threads>  decode threads, default all cores\n"
+        "  -c <MiB>      chunk size, default 4\n"
+        "  -f <format>   json, csv (states only) or count, default json\n"
+        "  -B            scaling benchmark from 1 to the -t threads\n", _name);
+}
+
+/**
+ * Per chunk JSON lines or CSV output.
+ */
+class TextHandler : public BulkDecoder::Handler
+{
+public:
+    explicit TextHandler(const bool _csv): csv_(_csv) {}
+
+    void on_unpack(const MessageHeader &_msg) override
+    {
+        if (!csv_) JsonSerializer::write(text_, _msg);
+    }
+
+    void on_unpack(const Veh2CloudInh &_msg) override
+    {
+        if (!csv_) JsonSerializer::write(text_, _msg);
+    }
+
+    void on_unpack(const Cloud2VehInhRes &_msg) override
+    {
+        if (!csv_) JsonSerializer::write(text_, _msg);
+    }
+
+    void on_unpack(const Veh2CloudState &_msg) override
+    {
+        if (csv_)
+        {
+            CsvSerializer::write(text_, _msg);
+        }
+        else
+        {
+            JsonSerializer::write(text_, _msg);
+        }
+    }
+
+    TextBuffer text_{1 << 20};
+
+private:
+    bool csv_;
+};
+
+class TextFactory : public BulkDecoder::Factory
+{
+public:
+    explicit TextFactory(const bool _csv): csv_(_csv)
+    {
+        if (csv_)
+        {
+            TextBuffer header(1024);
+            CsvSerializer::write_header(header, VEH2CLOUD_STATE);
+            fwrite(header.data(), 1, header.size(), stdout);
+        }
+    }
+
+    BulkDecoder::Handler* create(const size_t _chunk) override
+    {
+        return new TextHandler(csv_);
+    }
+
+    void merge(BulkDecoder::Handler *_handler) override
+    {
+        TextHandler *handler = (TextHandler*)_handler;
+
+        fwrite(handler->text_.data(), 1, handler->text_.size(), stdout);
+        delete handler;
+    }
+
+private:
+    bool csv_;
+};
+
+/**
+ * Counts decoded messages per data type.
+ */
+class CountHandler : public BulkDecoder::Handler
+{
+public:
+    void on_unpack(const MessageHeader &_msg) override { counts_[_msg.data_type_]++; }
+
+    void on_unpack(const Veh2CloudInh &_msg) override { counts_[_msg.data_type_]++; }
+
+    void on_unpack(const Cloud2VehInhRes &_msg) override { counts_[_msg.data_type_]++; }
+
+    void on_unpack(const Veh2CloudState &_msg) override { counts_[_msg.data_type_]++; }
+
+    uint64_t counts_[256] = {0};
+};
+
+class CountFactory : public BulkDecoder::Factory
+{
+public:
+    BulkDecoder::Handler* create(const size_t _chunk) override
+    {
+        return new CountHandler();
+    }
+
+    void merge(BulkDecoder::Handler *_handler) override
+    {
+        CountHandler *handler = (CountHandler*)_handler;
+
+        for (size_t i = 0; i < 256; i++)
+        {
+            counts_[i] += handler->counts_[i];
+        }
+
+        delete handler;
+    }
+
+    void print(FILE *_fp) const
+    {
+        for (size_t i = 0; i < 256; i++)
+        {
+            if (0 != counts_[i])
+            {
+                fprintf(_fp, "data type 0x%02zX: %" PRIu64 "\n", i, counts_[i]);
+            }
+        }
+    }
+
+private:
+    uint64_t counts_[256] = {0};
+};
+
+static void print_stats(FILE *_fp, const size_t _threads, const BulkDecoder::Stats &_stats)
+{
+    fprintf(_fp, "threads %zu, frames %" PRIu64 ", skipped %" PRIu64 " bytes, chunks %" PRIu64
+        ", %.3f s, %.0f frames/s, %.1f MB/s\n", _threads, _stats.frames, _stats.skipped, _stats.chunks,
+        _stats.seconds, _stats.frames / _stats.seconds, _stats.bytes / _stats.seconds / 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    size_t chunk = 4;
+    const char *format = "json";
+    bool bench = false;
+    int opt = 0;
+
+    while (-1 != (opt = getopt(argc, argv, "t:c:f:Bh")))
+    {
+        switch (opt)
+        {
+        case 't': threads = std::max(1, atoi(optarg)); break;
+        case 'c': chunk = std::max(1, atoi(optarg)); break;
+        case 'f': format = optarg; break;
+        case 'B': bench = true; break;
+        default:
+            usage(argv[0]);
+            return 'h' == opt ? 0 : 1;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    BulkDecoder decoder;
+
+    if (0 != decoder.open(argv[optind]))
+    {
+        return 1;
+    }
+
+    if (bench)
+    {
+        double base = 0.0;
+
+        printf("%s: %zu bytes, %s\n", argv[optind], decoder.size(), decoder.is_capture() ? "capture" : "raw stream");
+
+        for (size_t n = 1; n <= threads; n = n * 2 > threads && n != threads ? threads : n * 2)
+        {
+            CountFactory factory;
+            BulkDecoder::Stats stats;
+
+            decoder.decode(factory, n, chunk << 20, stats);
+
+            double fps = stats.frames / stats.seconds;
+            base = 1 == n ? fps : base;
+            print_stats(stdout, n, stats);
+            printf("speedup %.2fx\n", fps / base);
+        }
+
+        return 0;
+    }
+
+    BulkDecoder::Stats stats;
+
+    if (0 == strcmp(format, "count"))
+    {
+        CountFactory factory;
+
+        decoder.decode(factory, threads, chunk << 20, stats);
+        factory.print(stdout);
+        print_stats(stdout, threads, stats);
+    }
+    else
+    {
+        TextFactory factory(0 == strcmp(format, "csv"));
+
+        decoder.decode(factory, threads, chunk << 20, stats);
+        print_stats(stderr, threads, stats);
+    }
+
+    return 0;
+}
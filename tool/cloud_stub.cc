@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <signal.h>
+
+#include "cloud_stub.h"
+
+static void usage(const char *_name)
+{
+    printf("Usage: %s [options]\n"
+        "  -a <addr>     listen address, default 127.0.0.1\n"
+        "  -u <port>     upstream port, default 50011\n"
+        "  -d <port>     downstream port, default 50012\n"
+        "  -r <res>      CLOUD2VEH_INH_RES result, default 0 (confirm)\n", _name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *addr = "127.0.0.1";
+    uint32_t up_port = 50011;
+    uint32_t down_port = 50012;
+    uint8_t res = CLOUD2VEH_INH_RES_COMFIRM;
+    int opt = 0;
+
+    while (-1 != (opt = getopt(argc, argv, "a:u:d:r:h")))
+    {
+        switch (opt)
+        {
+        case 'a': addr = optarg; break;
+        case 'u': up_port = atoi(optarg); break;
+        case 'd': down_port = atoi(optarg); break;
+        case 'r': res = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return 'h' == opt ? 0 : 1;
+        }
+    }
+
+    // handled by sigwait, block before the stand-in threads exist
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    sigprocmask(SIG_BLOCK, &set, nullptr);
+
+    CloudStub stub;
+    stub.set_inh_res(res);
+
+    if (0 != stub.start(addr, up_port, down_port))
+    {
+        return 1;
+    }
+
+    printf("listening on %s %u/%u\n", addr, up_port, down_port);
+
+    int sig = 0;
+    sigwait(&set, &sig);
+    stub.stop();
+
+    const CloudStub::Stats &stats = stub.stats();
+    printf("connections %" PRIu64 ", frames %" PRIu64 ", bytes %" PRIu64 ", states %" PRIu64 ", inh %" PRIu64
+        ", heartbeat %" PRIu64 "\n", stats.connections.load(), stats.frames.load(), stats.bytes.load(),
+        stats.states.load(), stats.inhs.load(), stats.heartbeats.load());
+
+    return 0;
+}
@@ -0,0 +1,826 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define HEADER_LENGTH 16
+#define MAX_STRING    254
+
+static void usage(const char *_name)
+{
+    printf("Usage: %s [options] <definition file>...\n"
+        "  -o <dir>   output directory, default .\n"
+        "  -n <name>  output base name, default csae295\n", _name);
+}
+
+struct Field
+{
+    std::string kind; // u8 u16 u32 u64 char bytes struct str8 list8
+    std::string type; // struct of struct and list8
+    std::string name;
+    size_t      count = 0; // bytes of char and bytes, capacity of list8
+};
+
+struct Type
+{
+    std::string name;
+    std::string constant; // data type macro of a message
+    std::string description;
+    bool message = false;
+    int data_type = 0;
+    std::vector<Field> fields;
+};
+
+static std::vector<Type> s_types;
+static std::map<std::string, size_t> s_structs; // name to wire size
+
+static size_t width(const std::string &_kind)
+{
+    return "u8" == _kind ? 1 : "u16" == _kind ? 2 : "u32" == _kind ? 4 : "u64" == _kind ? 8 : 0;
+}
+
+static std::string ctype(const std::string &_kind)
+{
+    return "u8" == _kind ? "uint8_t" : "u16" == _kind ? "uint16_t" : "u32" == _kind ? "uint32_t" : "uint64_t";
+}
+
+/**
+ * Wire size of a fixed field, or of the count or length byte of a
+ * variable one.
+ */
+static size_t fixed_size(const Field &_f)
+{
+    if (0 != width(_f.kind))
+    {
+        return width(_f.kind);
+    }
+
+    if ("char" == _f.kind || "bytes" == _f.kind)
+    {
+        return _f.count;
+    }
+
+    if ("struct" == _f.kind)
+    {
+        return s_structs[_f.type];
+    }
+
+    return 1;
+}
+
+static bool variable(const Field &_f)
+{
+    return "str8" == _f.kind || "list8" == _f.kind;
+}
+
+static bool fail(const char *_file, const size_t _line, const std::string &_what)
+{
+    fprintf(stderr, "%s:%zu: %s\n", _file, _line, _what.c_str());
+    return false;
+}
+
+static bool parse_field(const char *_file, const size_t _line, const std::string &_text, const bool _message, Field &_f)
+{
+    std::string type, name;
+    std::istringstream in(_text);
+    size_t open = _text.find('<');
+
+    // list8<Struct, N> may hold spaces
+    if (std::string::npos != open)
+    {
+        size_t close = _text.find('>', open);
+        char element[64] = "";
+        unsigned long count = 0;
+
+        if (std::string::npos == close || "list8" != _text.substr(0, open)
+            || 2 != sscanf(_text.substr(open + 1, close - open - 1).c_str(), " %63[A-Za-z0-9_] , %lu", element, &count))
+        {
+            return fail(_file, _line, "bad list: " + _text);
+        }
+
+        in.str(_text.substr(close + 1));
+        _f.kind = "list8";
+        _f.type = element;
+        _f.count = count;
+    }
+    else
+    {
+        in >> type;
+
+        if (0 != width(type) || "str8" == type)
+        {
+            _f.kind = type;
+        }
+        else if (0 == type.compare(0, 5, "char[") || 0 == type.compare(0, 6, "bytes["))
+        {
+            _f.kind = type.substr(0, type.find('['));
+            _f.count = strtoul(type.c_str() + type.find('[') + 1, nullptr, 10);
+        }
+        else
+        {
+            _f.kind = "struct";
+            _f.type = type;
+        }
+    }
+
+    in >> name;
+    _f.name = name;
+
+    if (name.empty())
+    {
+        return fail(_file, _line, "missing field name: " + _text);
+    }
+
+    if (("struct" == _f.kind || "list8" == _f.kind) && 0 == s_structs.count(_f.type))
+    {
+        return fail(_file, _line, "unknown struct " + _f.type);
+    }
+
+    if (("char" == _f.kind || "bytes" == _f.kind) && 0 == _f.count)
+    {
+        return fail(_file, _line, "empty array " + name);
+    }
+
+    if ("list8" == _f.kind && (0 == _f.count || 255 < _f.count))
+    {
+        return fail(_file, _line, "list capacity out of 1..255: " + name);
+    }
+
+    if (!_message && variable(_f))
+    {
+        return fail(_file, _line, "variable field in a struct: " + name);
+    }
+
+    return true;
+}
+
+static bool parse(const char *_file)
+{
+    std::ifstream in(_file);
+    std::string line;
+    size_t number = 0;
+    Type *current = nullptr;
+
+    if (!in)
+    {
+        return fail(_file, 0, "cannot open");
+    }
+
+    while (std::getline(in, line))
+    {
+        number++;
+
+        size_t hash = line.find('#');
+        if (std::string::npos != hash)
+        {
+            line.erase(hash);
+        }
+
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (std::string::npos == begin)
+        {
+            continue;
+        }
+
+        line = line.substr(begin, line.find_last_not_of(" \t\r") + 1 - begin);
+
+        std::istringstream words(line);
+        std::string word;
+
+        words >> word;
+
+        if ("struct" == word || "message" == word)
+        {
+            Type t;
+
+            if (nullptr != current)
+            {
+                return fail(_file, number, "missing end of " + current->name);
+            }
+
+            t.message = "message" == word;
+            words >> t.name;
+
+            if (t.message)
+            {
+                std::string data_type;
+
+                words >> data_type >> t.constant;
+                t.data_type = (int)strtol(data_type.c_str(), nullptr, 0);
+
+                if (data_type.empty() || 0 > t.data_type || 0xFF < t.data_type)
+                {
+                    return fail(_file, number, "bad data type of " + t.name);
+                }
+
+                if (t.constant.empty() || std::string::npos != t.constant.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_"))
+                {
+                    return fail(_file, number, "bad data type constant of " + t.name);
+                }
+            }
+
+            std::getline(words, t.description);
+            t.description.erase(0, t.description.find_first_not_of(" \t"));
+
+            for (auto &o : s_types)
+            {
+                if (o.name == t.name || (t.message && o.message && (o.data_type == t.data_type || o.constant == t.constant)))
+                {
+                    return fail(_file, number, "duplicate " + t.name);
+                }
+            }
+
+            s_types.push_back(t);
+            current = &s_types.back();
+        }
+        else if ("end" == word)
+        {
+            if (nullptr == current)
+            {
+                return fail(_file, number, "end outside a definition");
+            }
+
+            if (!current->message)
+            {
+                size_t size = 0;
+
+                for (auto &f : current->fields)
+                {
+                    size += fixed_size(f);
+                }
+
+                s_structs[current->name] = size;
+            }
+
+            current = nullptr;
+        }
+        else
+        {
+            Field f;
+
+            if (nullptr == current)
+            {
+                return fail(_file, number, "field outside a definition");
+            }
+
+            if (!parse_field(_file, number, line, current->message, f))
+            {
+                return false;
+            }
+
+            current->fields.push_back(f);
+        }
+    }
+
+    return nullptr == current || fail(_file, number, "missing end of " + current->name);
+}
+
+/**
+ * Doc comment line of _t, its description as a sentence.
+ */
+static std::string summary(const Type &_t)
+{
+    std::string text = _t.description.empty() ? (_t.message ? _t.constant : _t.name) : _t.description;
+
+    text[0] = (char)toupper((unsigned char)text[0]);
+
+    return '.' == text.back() ? text : text + ".";
+}
+
+static void emit_struct(std::ostream &_h, const Type &_t)
+{
+    // type and declarator, the declarators aligned as in the hand-written headers
+    std::vector<std::pair<std::string, std::string>> members;
+    size_t column = 0;
+
+    if (_t.message)
+    {
+        members.push_back({"uint8_t", "version = 0x01"});
+        members.push_back({"uint64_t", "timestamp = 0"});
+        members.push_back({"uint8_t", "ctrl = 0xFC"});
+    }
+
+    for (auto &f : _t.fields)
+    {
+        std::string init = _t.message ? " = 0" : "";
+
+        if (0 != width(f.kind))
+        {
+            members.push_back({ctype(f.kind), f.name + init});
+        }
+        else if ("char" == f.kind || "bytes" == f.kind)
+        {
+            members.push_back({"char" == f.kind ? "char" : "uint8_t",
+                f.name + "[" + std::to_string(f.count) + "]" + (_t.message ? " = {0}" : "")});
+        }
+        else if ("struct" == f.kind)
+        {
+            members.push_back({f.type, f.name + (_t.message ? "{}" : "")});
+        }
+        else if ("str8" == f.kind)
+        {
+            members.push_back({"uint8_t", f.name + "_len = 0"});
+            members.push_back({"char", f.name + "[" + std::to_string(MAX_STRING) + "]"});
+        }
+        else
+        {
+            members.push_back({"uint8_t", f.name + "_num = 0"});
+            members.push_back({f.type, f.name + "[" + std::to_string(f.count) + "]"});
+        }
+    }
+
+    for (auto &m : members)
+    {
+        column = std::max(column, m.first.size() + 1);
+    }
+
+    _h << "/**\n * " << summary(_t) << "\n */\n";
+    _h << "struct " << _t.name << "\n{\n";
+
+    if (_t.message)
+    {
+        size_t max = HEADER_LENGTH;
+        for (auto &f : _t.fields)
+        {
+            max += fixed_size(f) + ("str8" == f.kind ? MAX_STRING : "list8" == f.kind ? f.count * s_structs[f.type] : 0);
+        }
+
+        _h << "    static const uint8_t DATA_TYPE = " << _t.constant << ";\n";
+        _h << "    static const size_t MAX_SIZE = " << max << "; // bytes on the wire\n\n";
+    }
+
+    for (auto &m : members)
+    {
+        _h << "    " << m.first << std::string(column - m.first.size(), ' ') << m.second << ";\n";
+    }
+
+    if (_t.message)
+    {
+        _h << "\n    /**\n     * @return frame size\n     */\n";
+        _h << "    size_t size() const;\n\n";
+        _h << "    /**\n     * @return frame size, 0 if _size is too small\n     */\n";
+        _h << "    size_t encode(void *_buf, const size_t _size) const;\n\n";
+        _h << "    /**\n     * @return frame size, 0 if _buf is not a complete " << _t.name << "\n     */\n";
+        _h << "    size_t decode(const void *_buf, const size_t _size);\n";
+    }
+
+    _h << "};\n\n";
+}
+
+static void emit_header(std::ostream &_h, const std::string &_guard)
+{
+    _h << "// Generated by tool/codegen.cc from include/protocol/data/*.def, do not edit.\n\n";
+    _h << "#ifndef " << _guard << "\n#define " << _guard << "\n\n";
+    _h << "#include <stdint.h>\n#include <stddef.h>\n\n";
+
+    // the same values as message.h where a hand-written codec exists
+    size_t column = 0;
+
+    for (auto &t : s_types)
+    {
+        column = t.message ? std::max(column, t.constant.size() + 1) : column;
+    }
+
+    for (auto &t : s_types)
+    {
+        if (t.message)
+        {
+            char type[8];
+
+            snprintf(type, sizeof(type), "0x%02X", t.data_type);
+            _h << "#define " << t.constant << std::string(column - t.constant.size(), ' ') << type << "\n";
+        }
+    }
+
+    _h << "\nnamespace protocol\n{\nnamespace data\n{\n";
+
+    for (auto &t : s_types)
+    {
+        emit_struct(_h, t);
+    }
+
+    _h << "/**\n * Receiver of the generated messages.\n */\nclass Handler\n{\npublic:\n    virtual ~Handler() {}\n";
+
+    for (auto &t : s_types)
+    {
+        if (t.message)
+        {
+            _h << "\n    virtual void on_message(const " << t.name << " &_msg) {}\n";
+        }
+    }
+
+    _h << "};\n\n";
+    _h << "/**\n * Generated codec of one data type.\n */\nstruct DispatchEntry\n{\n";
+    _h << "    const char *name;\n";
+    _h << "    size_t (*unpack)(const uint8_t *_buf, const size_t _size, Handler &_handler);\n};\n\n";
+    _h << "/**\n * By data type, name and unpack are null for types without a definition.\n */\n";
+    _h << "extern const DispatchEntry DISPATCH_TABLE[256];\n\n";
+    _h << "/**\n * Decode a frame on the stack and hand it to _handler.\n *\n"
+        " * @return frame size, 0 if the data type has no definition or the frame is invalid\n */\n";
+    _h << "size_t dispatch(const void *_buf, const size_t _size, Handler &_handler);\n";
+    _h << "} // namespace data\n} // namespace protocal\n\n#endif // " << _guard << "\n";
+}
+
+static void emit_put(std::ostream &_c, const Field &_f, const std::string &_v, const std::string &_indent)
+{
+    if (0 != width(_f.kind))
+    {
+        if ("u8" == _f.kind)
+        {
+            _c << _indent << "buf[offset] = " << _v << ";\n";
+        }
+        else
+        {
+            _c << _indent << "put" << width(_f.kind) * 8 << "(buf + offset, " << _v << ");\n";
+        }
+
+        _c << _indent << "offset += " << width(_f.kind) << ";\n";
+    }
+    else if ("char" == _f.kind || "bytes" == _f.kind)
+    {
+        _c << _indent << "memcpy(buf + offset, " << _v << ", " << _f.count << ");\n";
+        _c << _indent << "offset += " << _f.count << ";\n";
+    }
+    else if ("struct" == _f.kind)
+    {
+        _c << _indent << "put_" << _f.type << "(buf + offset, " << _v << ");\n";
+        _c << _indent << "offset += " << s_structs[_f.type] << ";\n";
+    }
+}
+
+static void emit_get(std::ostream &_c, const Field &_f, const std::string &_v, const std::string &_indent)
+{
+    if (0 != width(_f.kind))
+    {
+        if ("u8" == _f.kind)
+        {
+            _c << _indent << _v << " = buf[offset];\n";
+        }
+        else
+        {
+            _c << _indent << _v << " = get" << width(_f.kind) * 8 << "(buf + offset);\n";
+        }
+
+        _c << _indent << "offset += " << width(_f.kind) << ";\n";
+    }
+    else if ("char" == _f.kind || "bytes" == _f.kind)
+    {
+        _c << _indent << "memcpy(" << _v << ", buf + offset, " << _f.count << ");\n";
+        _c << _indent << "offset += " << _f.count << ";\n";
+    }
+    else if ("struct" == _f.kind)
+    {
+        _c << _indent << "get_" << _f.type << "(buf + offset, " << _v << ");\n";
+        _c << _indent << "offset += " << s_structs[_f.type] << ";\n";
+    }
+}
+
+static void emit_message(std::ostream &_c, const Type &_t)
+{
+    size_t fixed = 0;
+
+    for (auto &f : _t.fields)
+    {
+        fixed += fixed_size(f);
+    }
+
+    // size
+    _c << "size_t " << _t.name << "::size() const\n{\n";
+    _c << "    size_t size = " << HEADER_LENGTH + fixed << ";\n";
+
+    for (auto &f : _t.fields)
+    {
+        if ("str8" == f.kind)
+        {
+            _c << "    size += string_length(" << f.name << "_len);\n";
+        }
+        else if ("list8" == f.kind)
+        {
+            _c << "    size += (" << f.count << " < " << f.name << "_num ? " << f.count << " : " << f.name << "_num) * "
+                << s_structs[f.type] << ";\n";
+        }
+    }
+
+    _c << "\n    return size;\n}\n\n";
+
+    // encode
+    _c << "size_t " << _t.name << "::encode(void *_buf, const size_t _size) const\n{\n";
+    _c << "    uint8_t *buf = (uint8_t*)_buf;\n";
+    _c << "    size_t size = this->size();\n";
+    _c << "    size_t offset = " << HEADER_LENGTH << ";\n\n";
+    _c << "    if (nullptr == buf || size > _size)\n    {\n        return 0;\n    }\n\n";
+    _c << "    put_header(buf, size, DATA_TYPE, version, timestamp, ctrl);\n";
+
+    for (auto &f : _t.fields)
+    {
+        _c << "\n";
+
+        if ("str8" == f.kind)
+        {
+            _c << "    {\n";
+            _c << "        uint8_t len = string_length(" << f.name << "_len);\n\n";
+            _c << "        buf[offset++] = len;\n";
+            _c << "        memcpy(buf + offset, " << f.name << ", len);\n";
+            _c << "        offset += len;\n";
+            _c << "    }\n";
+        }
+        else if ("list8" == f.kind)
+        {
+            _c << "    {\n";
+            _c << "        size_t num = " << f.count << " < " << f.name << "_num ? " << f.count << " : " << f.name << "_num;\n\n";
+            _c << "        buf[offset++] = (uint8_t)num;\n\n";
+            _c << "        for (size_t i = 0; i < num; i++)\n        {\n";
+            _c << "            put_" << f.type << "(buf + offset, " << f.name << "[i]);\n";
+            _c << "            offset += " << s_structs[f.type] << ";\n";
+            _c << "        }\n    }\n";
+        }
+        else
+        {
+            emit_put(_c, f, f.name, "    ");
+        }
+    }
+
+    _c << "\n    return offset;\n}\n\n";
+
+    // decode, fixed fields are checked up front until the first variable one
+    _c << "size_t " << _t.name << "::decode(const void *_buf, const size_t _size)\n{\n";
+    _c << "    const uint8_t *buf = (const uint8_t*)_buf;\n";
+    _c << "    size_t size = check_header(buf, _size, DATA_TYPE);\n";
+    _c << (_t.fields.empty() ? "\n" : "    size_t offset = " + std::to_string(HEADER_LENGTH) + ";\n\n");
+    _c << "    if (" << HEADER_LENGTH + fixed << " > size)\n    {\n        return 0;\n    }\n\n";
+    _c << "    version = buf[6];\n";
+    _c << "    timestamp = get64(buf + 7);\n";
+    _c << "    ctrl = buf[15];\n";
+
+    bool checked = true; // fixed fields until the first variable one
+
+    for (auto &f : _t.fields)
+    {
+        _c << "\n";
+
+        if (!checked)
+        {
+            _c << "    if (" << fixed_size(f) << " > size - offset)\n    {\n        return 0;\n    }\n\n";
+        }
+
+        if ("str8" == f.kind)
+        {
+            _c << "    " << f.name << "_len = buf[offset++];\n";
+            _c << "    " << f.name << "_len = 0xFF == " << f.name << "_len ? 0 : " << f.name << "_len;\n\n";
+            _c << "    if (" << f.name << "_len > size - offset)\n    {\n        return 0;\n    }\n\n";
+            _c << "    memcpy(" << f.name << ", buf + offset, " << f.name << "_len);\n";
+            _c << "    offset += " << f.name << "_len;\n";
+            checked = false;
+        }
+        else if ("list8" == f.kind)
+        {
+            _c << "    " << f.name << "_num = buf[offset++];\n\n";
+            _c << "    if (" << f.count << " < " << f.name << "_num || (size_t)" << f.name << "_num * " << s_structs[f.type]
+                << " > size - offset)\n    {\n        return 0;\n    }\n\n";
+            _c << "    for (size_t i = 0; i < " << f.name << "_num; i++)\n    {\n";
+            _c << "        get_" << f.type << "(buf + offset, " << f.name << "[i]);\n";
+            _c << "        offset += " << s_structs[f.type] << ";\n";
+            _c << "    }\n";
+            checked = false;
+        }
+        else
+        {
+            emit_get(_c, f, f.name, "    ");
+        }
+    }
+
+    _c << "\n    return size;\n}\n\n";
+
+    _c << "static size_t unpack_" << _t.name << "(const uint8_t *_buf, const size_t _size, Handler &_handler)\n{\n";
+    _c << "    " << _t.name << " msg;\n";
+    _c << "    size_t size = msg.decode(_buf, _size);\n\n";
+    _c << "    if (0 != size)\n    {\n        _handler.on_message(msg);\n    }\n\n";
+    _c << "    return size;\n}\n\n";
+}
+
+static void emit_source(std::ostream &_c, const std::string &_header)
+{
+    _c << "// Generated by tool/codegen.cc from include/protocol/data/*.def, do not edit.\n\n";
+    _c << "#include <string.h>\n\n#include \"" << _header << "\"\n\n";
+    _c << "namespace protocol\n{\nnamespace data\n{\n";
+    _c << R"(static inline uint16_t get16(const uint8_t *_p)
+{
+    uint16_t v;
+    memcpy(&v, _p, sizeof(v));
+    return __builtin_bswap16(v);
+}
+
+static inline uint32_t get32(const uint8_t *_p)
+{
+    uint32_t v;
+    memcpy(&v, _p, sizeof(v));
+    return __builtin_bswap32(v);
+}
+
+static inline uint64_t get64(const uint8_t *_p)
+{
+    uint64_t v;
+    memcpy(&v, _p, sizeof(v));
+    return __builtin_bswap64(v);
+}
+
+static inline void put16(uint8_t *_p, const uint16_t _v)
+{
+    uint16_t v = __builtin_bswap16(_v);
+    memcpy(_p, &v, sizeof(v));
+}
+
+static inline void put32(uint8_t *_p, const uint32_t _v)
+{
+    uint32_t v = __builtin_bswap32(_v);
+    memcpy(_p, &v, sizeof(v));
+}
+
+static inline void put64(uint8_t *_p, const uint64_t _v)
+{
+    uint64_t v = __builtin_bswap64(_v);
+    memcpy(_p, &v, sizeof(v));
+}
+
+static inline uint8_t string_length(const uint8_t _len)
+{
+)";
+    _c << "    return " << MAX_STRING << " < _len ? 0 : _len;\n}\n\n";
+    _c << R"(static void put_header(uint8_t *_buf, const size_t _size, const uint8_t _data_type,
+    const uint8_t _version, const uint64_t _timestamp, const uint8_t _ctrl)
+{
+    _buf[0] = 0xF2;
+)";
+    _c << "    put32(_buf + 1, (uint32_t)(_size - " << HEADER_LENGTH << "));\n";
+    _c << R"(    _buf[5] = _data_type;
+    _buf[6] = _version;
+    put64(_buf + 7, _timestamp);
+    _buf[15] = _ctrl;
+}
+
+// frame size if _buf holds a whole frame of _data_type, else 0
+static size_t check_header(const uint8_t *_buf, const size_t _size, const uint8_t _data_type)
+{
+)";
+    _c << "    if (nullptr == _buf || " << HEADER_LENGTH << " > _size || 0xF2 != _buf[0] || _data_type != _buf[5])\n";
+    _c << "    {\n        return 0;\n    }\n\n";
+    _c << "    size_t size = " << HEADER_LENGTH << " + (size_t)get32(_buf + 1);\n\n";
+    _c << "    return size > _size ? 0 : size;\n}\n\n";
+
+    for (auto &t : s_types)
+    {
+        if (t.message)
+        {
+            continue;
+        }
+
+        _c << "static inline void put_" << t.name << "(uint8_t *_p, const " << t.name << " &_v)\n{\n";
+        _c << "    uint8_t *buf = _p;\n    size_t offset = 0;\n\n";
+        for (auto &f : t.fields)
+        {
+            emit_put(_c, f, "_v." + f.name, "    ");
+        }
+        _c << "}\n\n";
+
+        _c << "static inline void get_" << t.name << "(const uint8_t *_p, " << t.name << " &_v)\n{\n";
+        _c << "    const uint8_t *buf = _p;\n    size_t offset = 0;\n\n";
+        for (auto &f : t.fields)
+        {
+            emit_get(_c, f, "_v." + f.name, "    ");
+        }
+        _c << "}\n\n";
+    }
+
+    for (auto &t : s_types)
+    {
+        if (t.message)
+        {
+            emit_message(_c, t);
+        }
+    }
+
+    // designated initializers are not C++11, so the table is filled in order
+    _c << "const DispatchEntry DISPATCH_TABLE[256] =\n{\n";
+
+    for (int i = 0; i < 256; i++)
+    {
+        const Type *type = nullptr;
+
+        for (auto &t : s_types)
+        {
+            if (t.message && i == t.data_type)
+            {
+                type = &t;
+            }
+        }
+
+        if (nullptr == type)
+        {
+            _c << "    {nullptr, nullptr},\n";
+        }
+        else
+        {
+            _c << "    {\"" << type->name << "\", unpack_" << type->name << "},\n";
+        }
+    }
+
+    _c << "};\n\n";
+    _c << R"(size_t dispatch(const void *_buf, const size_t _size, Handler &_handler)
+{
+    const uint8_t *buf = (const uint8_t*)_buf;
+
+)";
+    _c << "    if (nullptr == buf || " << HEADER_LENGTH << " > _size || nullptr == DISPATCH_TABLE[buf[5]].unpack)\n";
+    _c << R"(    {
+        return 0;
+    }
+
+    return DISPATCH_TABLE[buf[5]].unpack(buf, _size, _handler);
+}
+} // namespace data
+} // namespace protocal
+)";
+}
+
+/**
+ * Write _content unless the file already holds it, so a rerun with the
+ * same definitions rebuilds nothing.
+ */
+static bool write(const std::string &_path, const std::string &_content)
+{
+    std::ifstream in(_path, std::ios::binary);
+    std::stringstream old;
+
+    old << in.rdbuf();
+
+    if (in && old.str() == _content)
+    {
+        return true;
+    }
+
+    std::ofstream out(_path, std::ios::binary | std::ios::trunc);
+    out << _content;
+
+    if (!out)
+    {
+        fprintf(stderr, "%s: write error\n", _path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string dir = ".";
+    std::string name = "csae295";
+    int opt = 0;
+
+    while (-1 != (opt = getopt(argc, argv, "o:n:h")))
+    {
+        switch (opt)
+        {
+        case 'o': dir = optarg; break;
+        case 'n': name = optarg; break;
+        default:
+            usage(argv[0]);
+            return 'h' == opt ? 0 : 1;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (int i = optind; i < argc; i++)
+    {
+        if (!parse(argv[i]))
+        {
+            return 1;
+        }
+    }
+
+    std::string guard = "__PROTOCOL_DATA_";
+    for (char c : name)
+    {
+        guard += isalnum((unsigned char)c) ? (char)toupper((unsigned char)c) : '_';
+    }
+    guard += "_H__";
+
+    std::ostringstream h, c;
+
+    emit_header(h, guard);
+    emit_source(c, name + ".h");
+
+    return write(dir + "/" + name + ".h", h.str()) && write(dir + "/" + name + ".cc", c.str()) ? 0 : 1;
+}
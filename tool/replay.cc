@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "replayer.h"
+
+static void usage(const char *_name)
+{
+    printf("Usage: %s [options] <capture dir>\n"
+        "  -p <prefix>     segment prefix, default capture\n"
+        "  -s <speed>      1 original pace, 2 twice as fast, 0 as fast as possible, default 1\n"
+        "  -l              feed a Controller over loopback instead of Packer::unpack\n"
+        "  -u <port>       loopback upstream port, default 50011\n"
+        "  -d <port>       loopback downstream port, default 50012\n"
+        "  -v <vehicle>    only frames of this vehicle\n"
+        "  -b <ns>         first monotonic timestamp\n"
+        "  -e <ns>         end monotonic timestamp\n"
+        "  -D <mask>       directions, bits of 1 << RECORD_*, default 0xF\n", _name);
+}
+
+/**
+ * Counts decoded messages, the in-process target.
+ */
+class CountHandler : public Packer::Handler
+{
+public:
+    void on_unpack(const MessageHeader &_msg) override { headers_++; }
+
+    void on_unpack(const Veh2CloudInh &_msg) override { inhs_++; }
+
+    void on_unpack(const Cloud2VehInhRes &_msg) override { inh_reses_++; }
+
+    void on_unpack(const Veh2CloudState &_msg) override { states_++; }
+
+    void print(FILE *_fp) const
+    {
+        fprintf(_fp, "decoded: header %zu, inh %zu, inh_res %zu, state %zu\n", headers_, inhs_, inh_reses_, states_);
+    }
+
+private:
+    size_t headers_ = 0;
+    size_t inhs_ = 0;
+    size_t inh_reses_ = 0;
+    size_t states_ = 0;
+};
+
+int main(int argc, char *argv[])
+{
+    const char *prefix = "capture";
+    double speed = 1.0;
+    bool loopback = false;
+    uint32_t up_port = 50011;
+    uint32_t down_port = 50012;
+    const char *vehicle = nullptr;
+    uint64_t begin = 0;
+    uint64_t end = UINT64_MAX;
+    uint32_t directions = 0x0F;
+    int opt = 0;
+
+    while (-1 != (opt = getopt(argc, argv, "p:s:lu:d:v:b:e:D:h")))
+    {
+        switch (opt)
+        {
+        case 'p': prefix = optarg; break;
+        case 's': speed = atof(optarg); break;
+        case 'l': loopback = true; break;
+        case 'u': up_port = atoi(optarg); break;
+        case 'd': down_port = atoi(optarg); break;
+        case 'v': vehicle = optarg; break;
+        case 'b': begin = strtoull(optarg, nullptr, 0); break;
+        case 'e': end = strtoull(optarg, nullptr, 0); break;
+        case 'D': directions = strtoul(optarg, nullptr, 0); break;
+        default:
+            usage(argv[0]);
+            return 'h' == opt ? 0 : 1;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Replayer replayer;
+
+    if (0 != replayer.open(argv[optind], prefix))
+    {
+        fprintf(stderr, "no segments of %s in %s\n", prefix, argv[optind]);
+        return 1;
+    }
+
+    replayer.set_speed(speed);
+    replayer.set_range(begin, end);
+    replayer.set_vehicle(vehicle);
+    replayer.set_directions(directions);
+
+    Replayer::Report report;
+
+    if (loopback)
+    {
+        Controller controller;
+
+        if (0 != replayer.replay(controller, up_port, down_port, report))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        CountHandler handler;
+
+        replayer.replay(handler, report);
+        handler.print(stdout);
+    }
+
+    report.print(stdout);
+
+    return 0;
+}